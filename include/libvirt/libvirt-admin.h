@@ -213,6 +213,90 @@ virAdmServerPtr virAdmConnectLookupServer(virAdmConnectPtr conn,
 
 # define VIR_THREADPOOL_JOB_QUEUE_DEPTH "jobQueueDepth"
 
+/**
+ * VIR_THREADPOOL_JOB_WAIT_1MS:
+ * Macro for the threadpool jobWait1ms attribute: represents the number of jobs
+ * which waited in the queue less than 1 millisecond before a worker started
+ * processing them, as VIR_TYPED_PARAM_ULLONG.
+ *
+ * NOTE: This attribute is read-only and any attempt to set it will be denied
+ * by daemon
+ *
+ * Since: 11.9.0
+ */
+
+# define VIR_THREADPOOL_JOB_WAIT_1MS "jobWait1ms"
+
+/**
+ * VIR_THREADPOOL_JOB_WAIT_10MS:
+ * Macro for the threadpool jobWait10ms attribute: represents the number of jobs
+ * which waited in the queue at least 1 but less than 10 milliseconds before a
+ * worker started processing them, as VIR_TYPED_PARAM_ULLONG.
+ *
+ * NOTE: This attribute is read-only and any attempt to set it will be denied
+ * by daemon
+ *
+ * Since: 11.9.0
+ */
+
+# define VIR_THREADPOOL_JOB_WAIT_10MS "jobWait10ms"
+
+/**
+ * VIR_THREADPOOL_JOB_WAIT_100MS:
+ * Macro for the threadpool jobWait100ms attribute: represents the number of
+ * jobs which waited in the queue at least 10 but less than 100 milliseconds
+ * before a worker started processing them, as VIR_TYPED_PARAM_ULLONG.
+ *
+ * NOTE: This attribute is read-only and any attempt to set it will be denied
+ * by daemon
+ *
+ * Since: 11.9.0
+ */
+
+# define VIR_THREADPOOL_JOB_WAIT_100MS "jobWait100ms"
+
+/**
+ * VIR_THREADPOOL_JOB_WAIT_1S:
+ * Macro for the threadpool jobWait1s attribute: represents the number of jobs
+ * which waited in the queue at least 100 milliseconds but less than 1 second
+ * before a worker started processing them, as VIR_TYPED_PARAM_ULLONG.
+ *
+ * NOTE: This attribute is read-only and any attempt to set it will be denied
+ * by daemon
+ *
+ * Since: 11.9.0
+ */
+
+# define VIR_THREADPOOL_JOB_WAIT_1S "jobWait1s"
+
+/**
+ * VIR_THREADPOOL_JOB_WAIT_10S:
+ * Macro for the threadpool jobWait10s attribute: represents the number of jobs
+ * which waited in the queue at least 1 but less than 10 seconds before a worker
+ * started processing them, as VIR_TYPED_PARAM_ULLONG.
+ *
+ * NOTE: This attribute is read-only and any attempt to set it will be denied
+ * by daemon
+ *
+ * Since: 11.9.0
+ */
+
+# define VIR_THREADPOOL_JOB_WAIT_10S "jobWait10s"
+
+/**
+ * VIR_THREADPOOL_JOB_WAIT_LONGER:
+ * Macro for the threadpool jobWaitLonger attribute: represents the number of
+ * jobs which waited in the queue 10 seconds or longer before a worker started
+ * processing them, as VIR_TYPED_PARAM_ULLONG.
+ *
+ * NOTE: This attribute is read-only and any attempt to set it will be denied
+ * by daemon
+ *
+ * Since: 11.9.0
+ */
+
+# define VIR_THREADPOOL_JOB_WAIT_LONGER "jobWaitLonger"
+
 /* Tunables for a server workerpool */
 int virAdmServerGetThreadPoolParameters(virAdmServerPtr srv,
                                         virTypedParameterPtr *params,
@@ -497,6 +581,162 @@ typedef enum {
 int virAdmConnectDaemonShutdown(virAdmConnectPtr conn,
                                 unsigned int flags);
 
+/* Statistics of caches kept by the daemon */
+
+/**
+ * VIR_ADMIN_CACHE_STATS_MSG_BUFFER_HITS:
+ * Macro for the number of RPC message buffers reused from the pool of
+ * message buffers, as VIR_TYPED_PARAM_ULLONG.
+ *
+ * Since: 11.9.0
+ */
+
+# define VIR_ADMIN_CACHE_STATS_MSG_BUFFER_HITS "msgbuffer.hits"
+
+/**
+ * VIR_ADMIN_CACHE_STATS_MSG_BUFFER_MISSES:
+ * Macro for the number of RPC message buffers which had to be allocated,
+ * as VIR_TYPED_PARAM_ULLONG.
+ *
+ * Since: 11.9.0
+ */
+
+# define VIR_ADMIN_CACHE_STATS_MSG_BUFFER_MISSES "msgbuffer.misses"
+
+/**
+ * VIR_ADMIN_CACHE_STATS_MSG_BUFFER_IN_USE:
+ * Macro for the current number of pooled RPC message buffers in use,
+ * as VIR_TYPED_PARAM_ULLONG.
+ *
+ * Since: 11.9.0
+ */
+
+# define VIR_ADMIN_CACHE_STATS_MSG_BUFFER_IN_USE "msgbuffer.inuse"
+
+/**
+ * VIR_ADMIN_CACHE_STATS_MSG_BUFFER_PEAK:
+ * Macro for the highest number of pooled RPC message buffers in use at the
+ * same time, as VIR_TYPED_PARAM_ULLONG.
+ *
+ * Since: 11.9.0
+ */
+
+# define VIR_ADMIN_CACHE_STATS_MSG_BUFFER_PEAK "msgbuffer.peak"
+
+/**
+ * VIR_ADMIN_CACHE_STATS_MSG_BUFFER_CACHED:
+ * Macro for the number of RPC message buffers kept in the pool for reuse,
+ * as VIR_TYPED_PARAM_ULLONG.
+ *
+ * Since: 11.9.0
+ */
+
+# define VIR_ADMIN_CACHE_STATS_MSG_BUFFER_CACHED "msgbuffer.cached"
+
+/**
+ * VIR_ADMIN_CACHE_STATS_MSG_BUFFER_CACHED_BYTES:
+ * Macro for the size of RPC message buffers kept in the pool for reuse in
+ * bytes, as VIR_TYPED_PARAM_ULLONG.
+ *
+ * Since: 11.9.0
+ */
+
+# define VIR_ADMIN_CACHE_STATS_MSG_BUFFER_CACHED_BYTES "msgbuffer.cachedbytes"
+
+/**
+ * VIR_ADMIN_CACHE_STATS_QEMU_BLOCK_NODE_HITS:
+ * Macro for the number of block statistics polls of QEMU domains which used
+ * cached sizes of block nodes, as VIR_TYPED_PARAM_ULLONG.
+ *
+ * Since: 11.9.0
+ */
+
+# define VIR_ADMIN_CACHE_STATS_QEMU_BLOCK_NODE_HITS "qemu.blocknode.hits"
+
+/**
+ * VIR_ADMIN_CACHE_STATS_QEMU_BLOCK_NODE_MISSES:
+ * Macro for the number of block statistics polls of QEMU domains which had to
+ * query sizes of block nodes, as VIR_TYPED_PARAM_ULLONG.
+ *
+ * Since: 11.9.0
+ */
+
+# define VIR_ADMIN_CACHE_STATS_QEMU_BLOCK_NODE_MISSES "qemu.blocknode.misses"
+
+/**
+ * VIR_ADMIN_CACHE_STATS_STORAGE_HEADER_HITS:
+ * Macro for the number of image headers served from the cache of image
+ * headers used for probing backing chains, as VIR_TYPED_PARAM_ULLONG.
+ *
+ * Since: 11.9.0
+ */
+
+# define VIR_ADMIN_CACHE_STATS_STORAGE_HEADER_HITS "storage.header.hits"
+
+/**
+ * VIR_ADMIN_CACHE_STATS_STORAGE_HEADER_MISSES:
+ * Macro for the number of image headers which had to be read as they were
+ * not cached or their cached copy was outdated, as VIR_TYPED_PARAM_ULLONG.
+ *
+ * Since: 11.9.0
+ */
+
+# define VIR_ADMIN_CACHE_STATS_STORAGE_HEADER_MISSES "storage.header.misses"
+
+/**
+ * VIR_ADMIN_CACHE_STATS_STORAGE_HEADER_STALE:
+ * Macro for the number of cached image headers found outdated as the image
+ * was modified, as VIR_TYPED_PARAM_ULLONG.
+ *
+ * Since: 11.9.0
+ */
+
+# define VIR_ADMIN_CACHE_STATS_STORAGE_HEADER_STALE "storage.header.stale"
+
+/**
+ * VIR_ADMIN_CACHE_STATS_STORAGE_HEADER_EVICTIONS:
+ * Macro for the number of cached image headers evicted to keep the size of
+ * the cache within its limit, as VIR_TYPED_PARAM_ULLONG.
+ *
+ * Since: 11.9.0
+ */
+
+# define VIR_ADMIN_CACHE_STATS_STORAGE_HEADER_EVICTIONS "storage.header.evictions"
+
+/**
+ * VIR_ADMIN_CACHE_STATS_STORAGE_HEADER_INVALIDATIONS:
+ * Macro for the number of cached image headers dropped as the image was
+ * modified by libvirt, as VIR_TYPED_PARAM_ULLONG.
+ *
+ * Since: 11.9.0
+ */
+
+# define VIR_ADMIN_CACHE_STATS_STORAGE_HEADER_INVALIDATIONS "storage.header.invalidations"
+
+/**
+ * VIR_ADMIN_CACHE_STATS_STORAGE_HEADER_ENTRIES:
+ * Macro for the number of cached image headers, as VIR_TYPED_PARAM_ULLONG.
+ *
+ * Since: 11.9.0
+ */
+
+# define VIR_ADMIN_CACHE_STATS_STORAGE_HEADER_ENTRIES "storage.header.entries"
+
+/**
+ * VIR_ADMIN_CACHE_STATS_STORAGE_HEADER_BYTES:
+ * Macro for the size of cached image headers in bytes, as
+ * VIR_TYPED_PARAM_ULLONG.
+ *
+ * Since: 11.9.0
+ */
+
+# define VIR_ADMIN_CACHE_STATS_STORAGE_HEADER_BYTES "storage.header.bytes"
+
+int virAdmConnectGetCacheStats(virAdmConnectPtr conn,
+                               virTypedParameterPtr *params,
+                               int *nparams,
+                               unsigned int flags);
+
 # ifdef __cplusplus
 }
 # endif
@@ -1775,6 +1775,29 @@ char *                  virDomainScreenshot     (virDomainPtr domain,
 
 int                     virDomainGetInfo        (virDomainPtr domain,
                                                  virDomainInfoPtr info);
+
+/**
+ * virDomainGetInfoCallback:
+ * @domain: the domain the information was requested for
+ * @ret: 0 in case of success, -1 in case of failure
+ * @info: information about @domain, NULL in case of failure
+ * @opaque: application specified data
+ *
+ * Callback run with the result of virDomainGetInfoAsync(). In case of
+ * failure, the error can be obtained using virGetLastError(). @info
+ * is only valid during the callback.
+ *
+ * Since: 11.9.0
+ */
+typedef void (*virDomainGetInfoCallback)(virDomainPtr domain,
+                                         int ret,
+                                         virDomainInfoPtr info,
+                                         void *opaque);
+
+int                     virDomainGetInfoAsync   (virDomainPtr domain,
+                                                 virDomainGetInfoCallback cb,
+                                                 void *opaque,
+                                                 virFreeCallback freecb);
 int                     virDomainGetState       (virDomainPtr domain,
                                                  int *state,
                                                  int *reason,
@@ -3942,6 +3965,38 @@ struct _virDomainStatsRecord {
  */
 # define VIR_DOMAIN_STATS_VM_PREFIX "vm."
 
+/**
+ * VIR_DOMAIN_STATS_XML_DESC:
+ *
+ * XML description of the domain as returned by virDomainGetXMLDesc()
+ * without any flags, as VIR_TYPED_PARAM_STRING.
+ *
+ * Since: 11.9.0
+ */
+# define VIR_DOMAIN_STATS_XML_DESC "xml.desc"
+
+/**
+ * VIR_DOMAIN_STATS_METADATA_TITLE:
+ *
+ * Title of the domain as returned by virDomainGetMetadata() with
+ * VIR_DOMAIN_METADATA_TITLE, as VIR_TYPED_PARAM_STRING. Missing if the
+ * domain has no title.
+ *
+ * Since: 11.9.0
+ */
+# define VIR_DOMAIN_STATS_METADATA_TITLE "metadata.title"
+
+/**
+ * VIR_DOMAIN_STATS_METADATA_DESCRIPTION:
+ *
+ * Description of the domain as returned by virDomainGetMetadata() with
+ * VIR_DOMAIN_METADATA_DESCRIPTION, as VIR_TYPED_PARAM_STRING. Missing if
+ * the domain has no description.
+ *
+ * Since: 11.9.0
+ */
+# define VIR_DOMAIN_STATS_METADATA_DESCRIPTION "metadata.description"
+
 /**
  * virDomainStatsTypes:
  *
@@ -3959,6 +4014,8 @@ typedef enum {
     VIR_DOMAIN_STATS_MEMORY = (1 << 8), /* return domain memory info (Since: 6.0.0) */
     VIR_DOMAIN_STATS_DIRTYRATE = (1 << 9), /* return domain dirty rate info (Since: 7.2.0) */
     VIR_DOMAIN_STATS_VM = (1 << 10), /* return vm info (Since: 8.9.0) */
+    VIR_DOMAIN_STATS_XML = (1 << 11), /* return domain XML description (Since: 11.9.0) */
+    VIR_DOMAIN_STATS_METADATA = (1 << 12), /* return domain title and description (Since: 11.9.0) */
 } virDomainStatsTypes;
 
 /**
@@ -46,6 +46,9 @@ const ADMIN_CLIENT_INFO_PARAMETERS_MAX = 64;
 /* Upper limit on number of client processing controls */
 const ADMIN_SERVER_CLIENT_LIMITS_MAX = 32;
 
+/* Upper limit on number of cache statistics */
+const ADMIN_CONNECT_CACHE_STATS_MAX = 64;
+
 /* A long string, which may NOT be NULL. */
 typedef string admin_nonnull_string<ADMIN_STRING_MAX>;
 
@@ -223,6 +226,14 @@ struct admin_connect_daemon_shutdown_args {
     unsigned int flags;
 };
 
+struct admin_connect_get_cache_stats_args {
+    unsigned int flags;
+};
+
+struct admin_connect_get_cache_stats_ret {
+    admin_typed_param params<ADMIN_CONNECT_CACHE_STATS_MAX>;
+};
+
 /* Define the program number, protocol version and procedure numbers here. */
 const ADMIN_PROGRAM = 0x06900690;
 const ADMIN_PROTOCOL_VERSION = 1;
@@ -343,5 +354,10 @@ enum admin_procedure {
     /**
      * @generate: both
      */
-    ADMIN_PROC_CONNECT_DAEMON_SHUTDOWN = 20
+    ADMIN_PROC_CONNECT_DAEMON_SHUTDOWN = 20,
+
+    /**
+     * @generate: none
+     */
+    ADMIN_PROC_CONNECT_GET_CACHE_STATS = 21
 };
@@ -432,3 +432,35 @@ remoteAdminConnectGetLoggingFilters(virAdmConnectPtr conn,
 
     return ret.nfilters;
 }
+
+static int
+remoteAdminConnectGetCacheStats(virAdmConnectPtr conn,
+                                virTypedParameterPtr *params,
+                                int *nparams,
+                                unsigned int flags)
+{
+    remoteAdminPriv *priv = conn->privateData;
+    admin_connect_get_cache_stats_args args;
+    g_auto(admin_connect_get_cache_stats_ret) ret = {0};
+    VIR_LOCK_GUARD lock = virObjectLockGuard(priv);
+
+    args.flags = flags;
+
+    if (call(conn,
+             0,
+             ADMIN_PROC_CONNECT_GET_CACHE_STATS,
+             (xdrproc_t) xdr_admin_connect_get_cache_stats_args,
+             (char *) &args,
+             (xdrproc_t) xdr_admin_connect_get_cache_stats_ret,
+             (char *) &ret) == -1)
+        return -1;
+
+    if (virTypedParamsDeserialize((struct _virTypedParameterRemote *) ret.params.params_val,
+                                  ret.params.params_len,
+                                  ADMIN_CONNECT_CACHE_STATS_MAX,
+                                  params,
+                                  nparams) < 0)
+        return -1;
+
+    return 0;
+}
@@ -21,10 +21,13 @@
 #include <config.h>
 
 #include "admin_server.h"
+#include "vircachestats.h"
 #include "virerror.h"
 #include "viridentity.h"
 #include "virlog.h"
+#include "virthreadpool.h"
 #include "rpc/virnetdaemon.h"
+#include "rpc/virnetmessage.h"
 #include "rpc/virnetserver.h"
 #include "virtypedparam.h"
 
@@ -76,6 +79,7 @@ adminServerGetThreadPoolParameters(virNetServer *srv,
     size_t freeWorkers;
     size_t nPrioWorkers;
     size_t jobQueueDepth;
+    unsigned long long jobWait[VIR_THREAD_POOL_JOB_WAIT_BUCKETS];
     g_autoptr(virTypedParamList) paramlist = virTypedParamListNew();
 
     virCheckFlags(0, -1);
@@ -96,6 +100,16 @@ adminServerGetThreadPoolParameters(virNetServer *srv,
     virTypedParamListAddUInt(paramlist, nPrioWorkers, VIR_THREADPOOL_WORKERS_PRIORITY);
     virTypedParamListAddUInt(paramlist, jobQueueDepth, VIR_THREADPOOL_JOB_QUEUE_DEPTH);
 
+    G_STATIC_ASSERT(VIR_THREAD_POOL_JOB_WAIT_BUCKETS == 6);
+    virNetServerGetJobWaitStats(srv, jobWait);
+
+    virTypedParamListAddULLong(paramlist, jobWait[0], VIR_THREADPOOL_JOB_WAIT_1MS);
+    virTypedParamListAddULLong(paramlist, jobWait[1], VIR_THREADPOOL_JOB_WAIT_10MS);
+    virTypedParamListAddULLong(paramlist, jobWait[2], VIR_THREADPOOL_JOB_WAIT_100MS);
+    virTypedParamListAddULLong(paramlist, jobWait[3], VIR_THREADPOOL_JOB_WAIT_1S);
+    virTypedParamListAddULLong(paramlist, jobWait[4], VIR_THREADPOOL_JOB_WAIT_10S);
+    virTypedParamListAddULLong(paramlist, jobWait[5], VIR_THREADPOOL_JOB_WAIT_LONGER);
+
     if (virTypedParamListSteal(paramlist, params, nparams) < 0)
         return -1;
 
@@ -322,3 +336,32 @@ adminServerUpdateTlsFiles(virNetServer *srv,
 
     return virNetServerUpdateTlsFiles(srv);
 }
+
+int
+adminConnectGetCacheStats(virNetDaemon *dmn G_GNUC_UNUSED,
+                          virTypedParameterPtr *params,
+                          int *nparams,
+                          unsigned int flags)
+{
+    virNetMessageBufferStats bufferStats;
+    g_autoptr(virTypedParamList) paramlist = virTypedParamListNew();
+
+    virCheckFlags(0, -1);
+
+    virNetMessageGetBufferStats(&bufferStats);
+
+    virTypedParamListAddULLong(paramlist, bufferStats.hits, VIR_ADMIN_CACHE_STATS_MSG_BUFFER_HITS);
+    virTypedParamListAddULLong(paramlist, bufferStats.misses, VIR_ADMIN_CACHE_STATS_MSG_BUFFER_MISSES);
+    virTypedParamListAddULLong(paramlist, bufferStats.inUse, VIR_ADMIN_CACHE_STATS_MSG_BUFFER_IN_USE);
+    virTypedParamListAddULLong(paramlist, bufferStats.peakInUse, VIR_ADMIN_CACHE_STATS_MSG_BUFFER_PEAK);
+    virTypedParamListAddULLong(paramlist, bufferStats.cached, VIR_ADMIN_CACHE_STATS_MSG_BUFFER_CACHED);
+    virTypedParamListAddULLong(paramlist, bufferStats.cachedBytes, VIR_ADMIN_CACHE_STATS_MSG_BUFFER_CACHED_BYTES);
+
+    /* caches of the drivers loaded by the daemon */
+    virCacheStatsCollect(paramlist);
+
+    if (virTypedParamListSteal(paramlist, params, nparams) < 0)
+        return -1;
+
+    return 0;
+}
@@ -539,4 +539,37 @@ adminDispatchConnectGetLoggingFilters(virNetServer *server G_GNUC_UNUSED,
 
     return 0;
 }
+
+static int
+adminDispatchConnectGetCacheStats(virNetServer *server G_GNUC_UNUSED,
+                                  virNetServerClient *client,
+                                  virNetMessage *msg G_GNUC_UNUSED,
+                                  struct virNetMessageError *rerr,
+                                  admin_connect_get_cache_stats_args *args,
+                                  admin_connect_get_cache_stats_ret *ret)
+{
+    int rv = -1;
+    virTypedParameterPtr params = NULL;
+    int nparams = 0;
+    struct daemonAdmClientPrivate *priv =
+        virNetServerClientGetPrivateData(client);
+
+    if (adminConnectGetCacheStats(priv->dmn, &params, &nparams,
+                                  args->flags) < 0)
+        goto cleanup;
+
+    if (virTypedParamsSerialize(params, nparams,
+                                ADMIN_CONNECT_CACHE_STATS_MAX,
+                                (struct _virTypedParameterRemote **) &ret->params.params_val,
+                                &ret->params.params_len, 0) < 0)
+        goto cleanup;
+
+    rv = 0;
+ cleanup:
+    if (rv < 0)
+        virNetMessageSaveError(rerr);
+
+    virTypedParamsFree(params, nparams);
+    return rv;
+}
 #include "admin_server_dispatch_stubs.h"
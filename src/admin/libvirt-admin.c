@@ -1390,3 +1390,46 @@ virAdmConnectDaemonShutdown(virAdmConnectPtr conn,
 
     return ret;
 }
+
+
+/**
+ * virAdmConnectGetCacheStats:
+ * @conn: pointer to an active admin connection
+ * @params: pointer to statistics of the caches
+ *          (return value, allocated automatically)
+ * @nparams: pointer to number of parameters returned in @params
+ * @flags: extra flags; not used yet, so callers should always pass 0
+ *
+ * Retrieve statistics of the caches kept by the daemon, such as the pool of
+ * RPC message buffers shared by all its servers. The statistics of caches of
+ * hypervisor or storage drivers are only reported by the daemon running the
+ * driver. The names of the parameters are prefixed by the name of the cache,
+ * e.g. VIR_ADMIN_CACHE_STATS_MSG_BUFFER_HITS.
+ *
+ * Returns 0 on success, allocating @params to size returned in @nparams, or
+ * -1 in case of an error. Caller is responsible for deallocating @params.
+ *
+ * Since: 11.9.0
+ */
+int
+virAdmConnectGetCacheStats(virAdmConnectPtr conn,
+                           virTypedParameterPtr *params,
+                           int *nparams,
+                           unsigned int flags)
+{
+    VIR_DEBUG("conn=%p, params=%p, nparams=%p, flags=0x%x",
+              conn, params, nparams, flags);
+
+    virResetLastError();
+    virCheckAdmConnectReturn(conn, -1);
+    virCheckNonNullArgGoto(params, error);
+    virCheckNonNullArgGoto(nparams, error);
+
+    if (remoteAdminConnectGetCacheStats(conn, params, nparams, flags) < 0)
+        goto error;
+
+    return 0;
+ error:
+    virDispatchError(NULL);
+    return -1;
+}
@@ -228,7 +228,7 @@ virBhyveProcessStartImpl(struct _bhyveConn *driver,
         goto cleanup;
     }
 
-    vm->def->id = vm->pid;
+    virDomainObjListSetID(driver->domains, vm, vm->pid);
     virDomainObjSetState(vm, VIR_DOMAIN_RUNNING, reason);
     priv->mon = bhyveMonitorOpen(vm, driver);
 
@@ -495,7 +495,7 @@ virBhyveProcessStop(struct _bhyveConn *driver,
 
     virDomainObjSetState(vm, VIR_DOMAIN_SHUTOFF, reason);
     vm->pid = 0;
-    vm->def->id = -1;
+    virDomainObjListSetID(driver->domains, vm, -1);
 
     bhyveProcessStopHook(driver, vm, VIR_HOOK_BHYVE_OP_RELEASE);
 
@@ -641,7 +641,7 @@ virBhyveProcessReconnect(virDomainObj *vm,
          * its PID, then we clear information about the PID and
          * set state to 'shutdown' */
         vm->pid = 0;
-        vm->def->id = -1;
+        virDomainObjListSetID(data->driver->domains, vm, -1);
         virDomainObjSetState(vm, VIR_DOMAIN_SHUTOFF,
                              VIR_DOMAIN_SHUTOFF_UNKNOWN);
         ignore_value(virDomainObjSave(vm, data->driver->xmlopt,
@@ -1501,6 +1501,9 @@ chConnectSupportsFeature(virConnectPtr conn,
         case VIR_DRV_FEATURE_REMOTE:
         case VIR_DRV_FEATURE_PROGRAM_KEEPALIVE:
         case VIR_DRV_FEATURE_REMOTE_CLOSE_CALLBACK:
+        case VIR_DRV_FEATURE_REMOTE_STREAM_LARGE_PAYLOAD:
+        case VIR_DRV_FEATURE_REMOTE_STREAM_LOCAL_FD:
+        case VIR_DRV_FEATURE_REMOTE_COMPRESSION:
         case VIR_DRV_FEATURE_REMOTE_EVENT_CALLBACK:
         case VIR_DRV_FEATURE_TYPED_PARAM_STRING:
         case VIR_DRV_FEATURE_NETWORK_UPDATE_HAS_CORRECT_ORDER:
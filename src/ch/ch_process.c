@@ -961,7 +961,7 @@ virCHProcessStart(virCHDriver *driver,
         }
     }
 
-    vm->def->id = vm->pid;
+    virDomainObjListSetID(driver->domains, vm, vm->pid);
     priv->machineName = virCHDomainGetMachineName(vm);
 
     if (chProcessAddNetworkDevices(driver, priv->monitor, vm->def,
@@ -1061,7 +1061,7 @@ virCHProcessStop(virCHDriver *driver,
     }
 
     vm->pid = 0;
-    vm->def->id = -1;
+    virDomainObjListSetID(driver->domains, vm, -1);
     g_clear_pointer(&priv->machineName, g_free);
 
     if (priv->pidfile) {
@@ -1130,7 +1130,7 @@ virCHProcessStartRestore(virCHDriver *driver, virDomainObj *vm, const char *from
         }
     }
 
-    vm->def->id = vm->pid;
+    virDomainObjListSetID(driver->domains, vm, vm->pid);
     priv->machineName = virCHDomainGetMachineName(vm);
 
     if (virCHMonitorBuildRestoreJson(vm->def, from, &payload) < 0) {
@@ -29499,6 +29499,9 @@ unsigned int virDomainDefFormatConvertXMLFlags(unsigned int flags)
 }
 
 
+/* Typical size of a formatted domain XML, used to preallocate buffers */
+#define VIR_DOMAIN_DEF_FORMAT_SIZE_HINT (16 * 1024)
+
 char *
 virDomainDefFormat(virDomainDef *def,
                    virDomainXMLOption *xmlopt,
@@ -29507,6 +29510,9 @@ virDomainDefFormat(virDomainDef *def,
     g_auto(virBuffer) buf = VIR_BUFFER_INITIALIZER;
 
     virCheckFlags(VIR_DOMAIN_DEF_FORMAT_COMMON_FLAGS, NULL);
+
+    virBufferReserve(&buf, VIR_DOMAIN_DEF_FORMAT_SIZE_HINT);
+
     if (virDomainDefFormatInternal(def, xmlopt, &buf, flags) < 0)
         return NULL;
 
@@ -29524,6 +29530,13 @@ virDomainObjFormat(virDomainObj *obj,
     int reason;
     size_t i;
 
+    /* status XML is formatted repeatedly, avoid growing the buffer
+     * step by step by reserving the size it had the last time */
+    if (obj->formatSize > 0)
+        virBufferReserve(&buf, obj->formatSize + 1024);
+    else
+        virBufferReserve(&buf, VIR_DOMAIN_DEF_FORMAT_SIZE_HINT);
+
     state = virDomainObjGetState(obj, &reason);
     virBufferAsprintf(&buf, "<domstatus state='%s' reason='%s' pid='%lld'>\n",
                       virDomainStateTypeToString(state),
@@ -29552,6 +29565,8 @@ virDomainObjFormat(virDomainObj *obj,
     virBufferAdjustIndent(&buf, -2);
     virBufferAddLit(&buf, "</domstatus>\n");
 
+    obj->formatSize = virBufferUse(&buf);
+
     return virBufferContentAndReset(&buf);
 }
 
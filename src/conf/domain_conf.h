@@ -3421,6 +3421,8 @@ struct _virDomainObj {
     int taint;
     size_t ndeprecations;
     char **deprecations;
+
+    size_t formatSize; /* size of the last formatted status XML */
 };
 
 G_DEFINE_AUTOPTR_CLEANUP_FUNC(virDomainObj, virObjectUnref);
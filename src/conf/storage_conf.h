@@ -80,6 +80,10 @@ struct _virStorageVolDef {
     bool building;
     unsigned int in_use;
 
+    /* when the volume was last probed by a pool refresh, in microseconds
+     * since the epoch */
+    long long probeTime;
+
     virStorageVolSource source;
     virStorageSource target;
 };
@@ -50,6 +50,26 @@ struct _virDomainObjList {
     /* name -> virDomainObj mapping for O(1),
      * lookup-by-name */
     GHashTable *objsName;
+
+    /* id -> virDomainObj mapping for O(1) lookup-by-id of
+     * running domains. Entries are only a hint and are verified
+     * against obj->def->id on lookup. Guarded by @idLock which
+     * must not be held while acquiring any other lock. */
+    virMutex idLock;
+    GHashTable *objsID;
+
+    /* Immutable, ref counted copy of @objs used by readers which
+     * walk the list or look up many domains at once so that they
+     * don't need to hold the list lock while doing so. A new
+     * generation is published by writers whenever an object is
+     * added or removed. Guarded by @snapshotLock which must not be
+     * held while acquiring any other lock. */
+    virMutex snapshotLock;
+    GHashTable *snapshot;
+
+    /* Set while loading many objects at once so that the snapshot
+     * is published only once. Guarded by the list write lock. */
+    bool snapshotDeferred;
 };
 
 
@@ -73,8 +93,23 @@ virDomainObjList *virDomainObjListNew(void)
     if (!(doms = virObjectRWLockableNew(virDomainObjListClass)))
         return NULL;
 
+    if (virMutexInit(&doms->idLock) < 0) {
+        virReportSystemError(errno, "%s", _("cannot initialize mutex"));
+        virObjectUnref(doms);
+        return NULL;
+    }
+
+    if (virMutexInit(&doms->snapshotLock) < 0) {
+        virReportSystemError(errno, "%s", _("cannot initialize mutex"));
+        virObjectUnref(doms);
+        return NULL;
+    }
+
     doms->objs = virHashNew(virObjectUnref);
     doms->objsName = virHashNew(virObjectUnref);
+    doms->objsID = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+                                         NULL, virObjectUnref);
+    doms->snapshot = virHashNew(virObjectUnref);
     return doms;
 }
 
@@ -85,6 +120,140 @@ static void virDomainObjListDispose(void *obj)
 
     g_clear_pointer(&doms->objs, g_hash_table_unref);
     g_clear_pointer(&doms->objsName, g_hash_table_unref);
+    g_clear_pointer(&doms->objsID, g_hash_table_unref);
+    g_clear_pointer(&doms->snapshot, g_hash_table_unref);
+    virMutexDestroy(&doms->idLock);
+    virMutexDestroy(&doms->snapshotLock);
+}
+
+
+static int
+virDomainObjListSnapshotIterator(void *payload,
+                                 const char *name,
+                                 void *opaque)
+{
+    g_hash_table_insert(opaque, g_strdup(name), virObjectRef(payload));
+    return 0;
+}
+
+
+/**
+ * virDomainObjListGetSnapshot:
+ * @doms: Domain object list
+ *
+ * Returns the current generation of the list of domain objects as
+ * a hash table of UUID strings to objects which must be released
+ * using g_hash_table_unref. The table must not be modified. Objects
+ * in it are ref counted but not locked and may have been removed
+ * from @doms in the meantime, in which case they are marked as
+ * being removed.
+ *
+ * The list lock is not taken.
+ */
+static GHashTable *
+virDomainObjListGetSnapshot(virDomainObjList *doms)
+{
+    VIR_LOCK_GUARD lock = virLockGuardLock(&doms->snapshotLock);
+
+    return g_hash_table_ref(doms->snapshot);
+}
+
+
+/**
+ * virDomainObjListPublishSnapshot:
+ * @doms: Domain object list
+ *
+ * Publish a new generation of the list. Must be called with @doms
+ * locked for writing whenever an object is added or removed.
+ * Readers still holding the old generation are not affected.
+ */
+static void
+virDomainObjListPublishSnapshot(virDomainObjList *doms)
+{
+    g_autoptr(GHashTable) old = NULL;
+    GHashTable *snapshot;
+
+    if (doms->snapshotDeferred)
+        return;
+
+    snapshot = virHashNew(virObjectUnref);
+    virHashForEach(doms->objs, virDomainObjListSnapshotIterator, snapshot);
+
+    VIR_WITH_MUTEX_LOCK_GUARD(&doms->snapshotLock) {
+        old = g_steal_pointer(&doms->snapshot);
+        doms->snapshot = snapshot;
+    }
+}
+
+
+/**
+ * virDomainObjListIDIndexAdd:
+ * @doms: Domain object list
+ * @vm: domain object
+ * @id: running domain ID
+ * @replace: whether to replace an existing mapping for @id
+ *
+ * Record @vm as the domain running with @id in the ID index.
+ */
+static void
+virDomainObjListIDIndexAdd(virDomainObjList *doms,
+                           virDomainObj *vm,
+                           int id,
+                           bool replace)
+{
+    VIR_LOCK_GUARD lock = virLockGuardLock(&doms->idLock);
+
+    if (!replace &&
+        g_hash_table_contains(doms->objsID, GINT_TO_POINTER(id)))
+        return;
+
+    g_hash_table_insert(doms->objsID, GINT_TO_POINTER(id), virObjectRef(vm));
+}
+
+
+static gboolean
+virDomainObjListIDIndexMatch(gpointer key G_GNUC_UNUSED,
+                             gpointer value,
+                             gpointer opaque)
+{
+    return value == opaque;
+}
+
+
+/**
+ * virDomainObjListIDIndexRemove:
+ * @doms: Domain object list
+ * @vm: domain object
+ * @id: ID @vm was indexed under, or -1 if unknown
+ *
+ * Drop the ID index entry pointing to @vm. If @id is not known
+ * all entries are checked.
+ */
+static void
+virDomainObjListIDIndexRemove(virDomainObjList *doms,
+                              virDomainObj *vm,
+                              int id)
+{
+    VIR_LOCK_GUARD lock = virLockGuardLock(&doms->idLock);
+
+    if (id < 0) {
+        g_hash_table_foreach_remove(doms->objsID,
+                                    virDomainObjListIDIndexMatch, vm);
+        return;
+    }
+
+    if (g_hash_table_lookup(doms->objsID, GINT_TO_POINTER(id)) == vm)
+        g_hash_table_remove(doms->objsID, GINT_TO_POINTER(id));
+}
+
+
+static virDomainObj *
+virDomainObjListIDIndexLookup(virDomainObjList *doms,
+                              int id)
+{
+    VIR_LOCK_GUARD lock = virLockGuardLock(&doms->idLock);
+
+    return virObjectRef(g_hash_table_lookup(doms->objsID, GINT_TO_POINTER(id)));
 }
 
 
@@ -105,15 +274,39 @@ static int virDomainObjListSearchID(const void *payload,
 }
 
 
+/**
+ * @doms: Domain object list
+ * @id: ID of running domain to look up
+ *
+ * Lookup the @id in the doms->objsID table and verify the hit. If
+ * the index has no (valid) entry, fall back to searching the whole
+ * list and record the result for next time. Returns a locked and
+ * ref counted domain object if found. Caller is expected to use
+ * the virDomainObjEndAPI when done with the object.
+ */
 virDomainObj *
 virDomainObjListFindByID(virDomainObjList *doms,
                          int id)
 {
     virDomainObj *obj;
 
+    if (id < 0)
+        return NULL;
+
     virObjectRWLockRead(doms);
-    obj = virHashSearch(doms->objs, virDomainObjListSearchID, &id, NULL);
-    virObjectRef(obj);
+    if ((obj = virDomainObjListIDIndexLookup(doms, id))) {
+        if (virDomainObjListSearchID(obj, NULL, &id) == 0) {
+            virDomainObjListIDIndexRemove(doms, obj, id);
+            g_clear_pointer(&obj, virObjectUnref);
+        }
+    }
+
+    if (!obj) {
+        obj = virHashSearch(doms->objs, virDomainObjListSearchID, &id, NULL);
+        if (obj)
+            virDomainObjListIDIndexAdd(doms, obj, id, true);
+        virObjectRef(obj);
+    }
     virObjectRWUnlock(doms);
     if (obj) {
         virObjectLock(obj);
@@ -240,6 +433,11 @@ virDomainObjListAddObjLocked(virDomainObjList *doms,
     }
     virObjectRef(vm);
 
+    if (virDomainObjIsActive(vm))
+        virDomainObjListIDIndexAdd(doms, vm, vm->def->id, false);
+
+    virDomainObjListPublishSnapshot(doms);
+
     return 0;
 }
 
@@ -376,8 +574,40 @@ virDomainObjListRemoveLocked(virDomainObjList *doms,
 
     virUUIDFormat(dom->def->uuid, uuidstr);
 
+    /* The object can still be seen by walks of older generations */
+    dom->removing = true;
+
+    virDomainObjListIDIndexRemove(doms, dom, -1);
     virHashRemoveEntry(doms->objs, uuidstr);
     virHashRemoveEntry(doms->objsName, dom->def->name);
+    virDomainObjListPublishSnapshot(doms);
+}
+
+
+/**
+ * virDomainObjListSetID:
+ * @doms: Pointer to the domain object list
+ * @vm: domain object
+ * @id: new ID of the domain or -1 when it is no longer running
+ *
+ * Set the ID of @vm and keep the ID index of @doms in sync. This
+ * must be used instead of setting vm->def->id directly for any
+ * domain on @doms. The caller must hold a lock on @vm. Only the
+ * ID index lock is taken, so it may be called from
+ * virDomainObjListForEach callbacks too.
+ */
+void
+virDomainObjListSetID(virDomainObjList *doms,
+                      virDomainObj *vm,
+                      int id)
+{
+    if (vm->def->id >= 0)
+        virDomainObjListIDIndexRemove(doms, vm, vm->def->id);
+
+    vm->def->id = id;
+
+    if (id >= 0)
+        virDomainObjListIDIndexAdd(doms, vm, id, true);
 }
 
 
@@ -476,38 +706,63 @@ virDomainObjListRename(virDomainObjList *doms,
 }
 
 
+static virDomainDef *
+virDomainObjListParseConfig(virDomainXMLOption *xmlopt,
+                            const char *configDir,
+                            const char *name)
+{
+    g_autofree char *configFile = virDomainConfigFile(configDir, name);
+
+    return virDomainDefParseFile(configFile, xmlopt, NULL,
+                                 VIR_DOMAIN_DEF_PARSE_INACTIVE |
+                                 VIR_DOMAIN_DEF_PARSE_SKIP_VALIDATE |
+                                 VIR_DOMAIN_DEF_PARSE_ALLOW_POST_PARSE_FAIL);
+}
+
+
+static virDomainObj *
+virDomainObjListParseStatus(virDomainXMLOption *xmlopt,
+                            const char *statusDir,
+                            const char *name)
+{
+    g_autofree char *statusFile = virDomainConfigFile(statusDir, name);
+
+    return virDomainObjParseFile(statusFile, xmlopt,
+                                 VIR_DOMAIN_DEF_PARSE_STATUS |
+                                 VIR_DOMAIN_DEF_PARSE_ACTUAL_NET |
+                                 VIR_DOMAIN_DEF_PARSE_PCI_ORIG_STATES |
+                                 VIR_DOMAIN_DEF_PARSE_SKIP_VALIDATE |
+                                 VIR_DOMAIN_DEF_PARSE_ALLOW_POST_PARSE_FAIL |
+                                 VIR_DOMAIN_DEF_PARSE_VOLUME_TRANSLATED);
+}
+
+
 static virDomainObj *
 virDomainObjListLoadConfig(virDomainObjList *doms,
                            virDomainXMLOption *xmlopt,
                            const char *configDir,
                            const char *autostartDir,
                            const char *name,
+                           virDomainDef **def,
                            virDomainLoadConfigNotify notify,
                            void *opaque)
 {
     g_autofree char *configFile = NULL;
     g_autofree char *autostartLink = NULL;
     g_autofree char *autostartOnceLink = NULL;
-    g_autoptr(virDomainDef) def = NULL;
     virDomainObj *dom;
     int autostart;
     int autostartOnce;
     g_autoptr(virDomainDef) oldDef = NULL;
 
     configFile = virDomainConfigFile(configDir, name);
-    if (!(def = virDomainDefParseFile(configFile, xmlopt, NULL,
-                                      VIR_DOMAIN_DEF_PARSE_INACTIVE |
-                                      VIR_DOMAIN_DEF_PARSE_SKIP_VALIDATE |
-                                      VIR_DOMAIN_DEF_PARSE_ALLOW_POST_PARSE_FAIL)))
-        return NULL;
-
     autostartLink = virDomainConfigFile(autostartDir, name);
     autostartOnceLink = g_strdup_printf("%s.once", autostartLink);
 
     autostart = virFileLinkPointsTo(autostartLink, configFile);
     autostartOnce = virFileLinkPointsTo(autostartOnceLink, configFile);
 
-    if (!(dom = virDomainObjListAddLocked(doms, &def, xmlopt, 0, &oldDef)))
+    if (!(dom = virDomainObjListAddLocked(doms, def, xmlopt, 0, &oldDef)))
         return NULL;
 
     dom->autostart = autostart;
@@ -525,27 +780,12 @@ virDomainObjListLoadConfig(virDomainObjList *doms,
 
 static virDomainObj *
 virDomainObjListLoadStatus(virDomainObjList *doms,
-                           const char *statusDir,
-                           const char *name,
-                           virDomainXMLOption *xmlopt,
+                           virDomainObj *obj,
                            virDomainLoadConfigNotify notify,
                            void *opaque)
 {
-    g_autofree char *statusFile = NULL;
-    virDomainObj *obj = NULL;
     char uuidstr[VIR_UUID_STRING_BUFLEN];
 
-    statusFile = virDomainConfigFile(statusDir, name);
-
-    if (!(obj = virDomainObjParseFile(statusFile, xmlopt,
-                                      VIR_DOMAIN_DEF_PARSE_STATUS |
-                                      VIR_DOMAIN_DEF_PARSE_ACTUAL_NET |
-                                      VIR_DOMAIN_DEF_PARSE_PCI_ORIG_STATES |
-                                      VIR_DOMAIN_DEF_PARSE_SKIP_VALIDATE |
-                                      VIR_DOMAIN_DEF_PARSE_ALLOW_POST_PARSE_FAIL |
-                                      VIR_DOMAIN_DEF_PARSE_VOLUME_TRANSLATED)))
-        goto error;
-
     virUUIDFormat(obj->def->uuid, uuidstr);
 
     if (virHashLookup(doms->objs, uuidstr) != NULL) {
@@ -569,65 +809,189 @@ virDomainObjListLoadStatus(virDomainObjList *doms,
 }
 
 
+struct virDomainObjListLoadData {
+    virDomainXMLOption *xmlopt;
+    const char *configDir;
+    bool liveStatus;
+
+    GPtrArray *names;
+    int next; /* index of the next file to parse, accessed atomically */
+
+    /* parsed definitions indexed as @names */
+    virDomainObj **objs;
+    virDomainDef **defs;
+};
+
+
+static void
+virDomainObjListLoadWorker(void *opaque)
+{
+    struct virDomainObjListLoadData *data = opaque;
+    int i;
+
+    while ((i = g_atomic_int_add(&data->next, 1)) < data->names->len) {
+        const char *name = g_ptr_array_index(data->names, i);
+
+        if (data->liveStatus)
+            data->objs[i] = virDomainObjListParseStatus(data->xmlopt,
+                                                        data->configDir, name);
+        else
+            data->defs[i] = virDomainObjListParseConfig(data->xmlopt,
+                                                        data->configDir, name);
+    }
+}
+
+
+/* Parses all files of @data using up to @nworkers threads */
+static void
+virDomainObjListLoadParallel(struct virDomainObjListLoadData *data,
+                             unsigned int nworkers)
+{
+    g_autofree virThread *threads = NULL;
+    size_t nthreads = 0;
+    size_t i;
+
+    nworkers = MIN(nworkers, data->names->len);
+    threads = g_new0(virThread, nworkers);
+
+    for (nthreads = 0; nthreads < nworkers; nthreads++) {
+        if (virThreadCreateFull(&threads[nthreads], true,
+                                virDomainObjListLoadWorker,
+                                "dom-load", false, data) < 0)
+            break;
+    }
+
+    /* the remaining files are parsed by this thread, which also covers
+     * failure to create any worker */
+    virDomainObjListLoadWorker(data);
+
+    for (i = 0; i < nthreads; i++)
+        virThreadJoin(&threads[i]);
+}
+
+
+/**
+ * virDomainObjListLoadAllConfigsFull:
+ * @doms: domain object list
+ * @configDir: directory with domain configs or status XMLs
+ * @autostartDir: directory with autostart links (ignored for @liveStatus)
+ * @liveStatus: whether @configDir contains status XMLs
+ * @nworkers: number of threads used to parse the files
+ * @xmlopt: XML parser configuration
+ * @notify: callback invoked for every loaded domain
+ * @opaque: data for @notify
+ *
+ * Loads all domain definitions from @configDir into @doms. If @nworkers is
+ * greater than one, the files are parsed in parallel before the domains
+ * are added to @doms in the order of the directory listing. Errors in
+ * individual files are ignored so that one malformed config doesn't
+ * prevent loading of the others.
+ *
+ * Returns 0 on success, -1 if @configDir couldn't be read.
+ */
 int
-virDomainObjListLoadAllConfigs(virDomainObjList *doms,
-                               const char *configDir,
-                               const char *autostartDir,
-                               bool liveStatus,
-                               virDomainXMLOption *xmlopt,
-                               virDomainLoadConfigNotify notify,
-                               void *opaque)
+virDomainObjListLoadAllConfigsFull(virDomainObjList *doms,
+                                   const char *configDir,
+                                   const char *autostartDir,
+                                   bool liveStatus,
+                                   unsigned int nworkers,
+                                   virDomainXMLOption *xmlopt,
+                                   virDomainLoadConfigNotify notify,
+                                   void *opaque)
 {
     g_autoptr(DIR) dir = NULL;
+    g_autoptr(GPtrArray) names = g_ptr_array_new_with_free_func(g_free);
+    struct virDomainObjListLoadData data = { 0 };
     struct dirent *entry;
     int ret = -1;
     int rc;
+    size_t i;
 
     VIR_INFO("Scanning for configs in %s", configDir);
 
     if ((rc = virDirOpenIfExists(&dir, configDir)) <= 0)
         return rc;
 
-    virObjectRWLockWrite(doms);
-
     while ((ret = virDirRead(dir, &entry, configDir)) > 0) {
-        virDomainObj *dom;
-
         if (!virStringStripSuffix(entry->d_name, ".xml"))
             continue;
 
+        g_ptr_array_add(names, g_strdup(entry->d_name));
+    }
+
+    data.xmlopt = xmlopt;
+    data.configDir = configDir;
+    data.liveStatus = liveStatus;
+    data.names = names;
+    data.objs = g_new0(virDomainObj *, names->len);
+    data.defs = g_new0(virDomainDef *, names->len);
+
+    if (nworkers > 1 && names->len > 1) {
+        VIR_INFO("Parsing %u configs in %s using %u threads",
+                 names->len, configDir, nworkers);
+        virDomainObjListLoadParallel(&data, nworkers);
+    }
+
+    virObjectRWLockWrite(doms);
+    doms->snapshotDeferred = true;
+
+    for (i = 0; i < names->len; i++) {
+        const char *name = g_ptr_array_index(names, i);
+        virDomainObj *dom = NULL;
+
         /* NB: ignoring errors, so one malformed config doesn't
            kill the whole process */
-        VIR_INFO("Loading config file '%s.xml'", entry->d_name);
-        if (liveStatus)
-            dom = virDomainObjListLoadStatus(doms,
-                                             configDir,
-                                             entry->d_name,
-                                             xmlopt,
-                                             notify,
-                                             opaque);
-        else
-            dom = virDomainObjListLoadConfig(doms,
-                                             xmlopt,
-                                             configDir,
-                                             autostartDir,
-                                             entry->d_name,
-                                             notify,
-                                             opaque);
+        VIR_INFO("Loading config file '%s.xml'", name);
+        if (liveStatus) {
+            virDomainObj *obj = g_steal_pointer(&data.objs[i]);
+
+            if (obj || (nworkers <= 1 &&
+                        (obj = virDomainObjListParseStatus(xmlopt, configDir, name))))
+                dom = virDomainObjListLoadStatus(doms, obj, notify, opaque);
+        } else {
+            g_autoptr(virDomainDef) def = g_steal_pointer(&data.defs[i]);
+
+            if (def || (nworkers <= 1 &&
+                        (def = virDomainObjListParseConfig(xmlopt, configDir, name))))
+                dom = virDomainObjListLoadConfig(doms, xmlopt, configDir,
+                                                 autostartDir, name, &def,
+                                                 notify, opaque);
+        }
+
         if (dom) {
             if (!liveStatus)
                 dom->persistent = 1;
             virDomainObjEndAPI(&dom);
         } else {
-            VIR_ERROR(_("Failed to load config for domain '%1$s'"), entry->d_name);
+            VIR_ERROR(_("Failed to load config for domain '%1$s'"), name);
         }
     }
 
+    doms->snapshotDeferred = false;
+    virDomainObjListPublishSnapshot(doms);
     virObjectRWUnlock(doms);
+
+    g_free(data.objs);
+    g_free(data.defs);
     return ret;
 }
 
 
+int
+virDomainObjListLoadAllConfigs(virDomainObjList *doms,
+                               const char *configDir,
+                               const char *autostartDir,
+                               bool liveStatus,
+                               virDomainXMLOption *xmlopt,
+                               virDomainLoadConfigNotify notify,
+                               void *opaque)
+{
+    return virDomainObjListLoadAllConfigsFull(doms, configDir, autostartDir,
+                                              liveStatus, 0, xmlopt,
+                                              notify, opaque);
+}
+
+
 struct virDomainObjListData {
     virDomainObjListACLFilter filter;
     virConnectPtr conn;
@@ -667,9 +1031,9 @@ virDomainObjListNumOfDomains(virDomainObjList *doms,
                              virConnectPtr conn)
 {
     struct virDomainObjListData data = { filter, conn, active, 0 };
-    virObjectRWLockRead(doms);
-    virHashForEach(doms->objs, virDomainObjListCount, &data);
-    virObjectRWUnlock(doms);
+    g_autoptr(GHashTable) snapshot = virDomainObjListGetSnapshot(doms);
+
+    virHashForEach(snapshot, virDomainObjListCount, &data);
     return data.count;
 }
 
@@ -711,9 +1075,9 @@ virDomainObjListGetActiveIDs(virDomainObjList *doms,
 {
     struct virDomainIDData data = { filter, conn,
                                     0, maxids, ids };
-    virObjectRWLockRead(doms);
-    virHashForEach(doms->objs, virDomainObjListCopyActiveIDs, &data);
-    virObjectRWUnlock(doms);
+    g_autoptr(GHashTable) snapshot = virDomainObjListGetSnapshot(doms);
+
+    virHashForEach(snapshot, virDomainObjListCopyActiveIDs, &data);
     return data.numids;
 }
 
@@ -763,10 +1127,10 @@ virDomainObjListGetInactiveNames(virDomainObjList *doms,
 {
     struct virDomainNameData data = { filter, conn,
                                       0, 0, maxnames, names };
+    g_autoptr(GHashTable) snapshot = virDomainObjListGetSnapshot(doms);
     size_t i;
-    virObjectRWLockRead(doms);
-    virHashForEach(doms->objs, virDomainObjListCopyInactiveNames, &data);
-    virObjectRWUnlock(doms);
+
+    virHashForEach(snapshot, virDomainObjListCopyInactiveNames, &data);
     if (data.oom) {
         for (i = 0; i < data.numnames; i++)
             VIR_FREE(data.names[i]);
@@ -810,6 +1174,11 @@ virDomainObjListHelper(void *payload,
  * @callback wants to modify the list of domains (@doms) then
  * @modify must be set to true.
  *
+ * The domains are taken from the current generation of the list.
+ * Unless @modify is true the list lock is not held while @callback
+ * runs, so the domains may be removed from @doms concurrently, in
+ * which case they are marked as being removed.
+ *
  * Returns: 0 on success,
  *         -1 otherwise.
  */
@@ -822,13 +1191,16 @@ virDomainObjListForEach(virDomainObjList *doms,
     struct virDomainListIterData data = {
         callback, opaque, 0,
     };
+    g_autoptr(GHashTable) snapshot = NULL;
 
+    /* Callbacks may remove objects from the list, which is safe while
+     * walking the generation taken under the write lock */
     if (modify)
         virObjectRWLockWrite(doms);
-    else
-        virObjectRWLockRead(doms);
-    virHashForEachSafe(doms->objs, virDomainObjListHelper, &data);
-    virObjectRWUnlock(doms);
+    snapshot = virDomainObjListGetSnapshot(doms);
+    virHashForEach(snapshot, virDomainObjListHelper, &data);
+    if (modify)
+        virObjectRWUnlock(doms);
     return data.ret;
 }
 
@@ -906,39 +1278,21 @@ virDomainObjMatchFilter(virDomainObj *vm,
 #undef MATCH
 
 
-struct virDomainListData {
-    virDomainObj **vms;
-    size_t nvms;
-};
-
-
-static int
-virDomainObjListCollectIterator(void *payload,
-                                const char *name G_GNUC_UNUSED,
-                                void *opaque)
-{
-    struct virDomainListData *data = opaque;
-
-    data->vms[data->nvms++] = virObjectRef(payload);
-    return 0;
-}
-
-
 void
 virDomainObjListCollectAll(virDomainObjList *domlist,
                            virDomainObj ***vms,
                            size_t *nvms)
 {
-    struct virDomainListData data = { NULL, 0 };
-
-    virObjectRWLockRead(domlist);
-    data.vms = g_new0(virDomainObj *, virHashSize(domlist->objs));
-
-    virHashForEach(domlist->objs, virDomainObjListCollectIterator, &data);
-    virObjectRWUnlock(domlist);
-
-    *nvms = data.nvms;
-    *vms = data.vms;
+    g_autoptr(GHashTable) snapshot = virDomainObjListGetSnapshot(domlist);
+    GHashTableIter iter;
+    gpointer vm;
+    size_t n = 0;
+
+    *vms = g_new0(virDomainObj *, g_hash_table_size(snapshot));
+    g_hash_table_iter_init(&iter, snapshot);
+    while (g_hash_table_iter_next(&iter, NULL, &vm))
+        (*vms)[n++] = virObjectRef(vm);
+    *nvms = n;
 }
 
 
@@ -999,6 +1353,7 @@ virDomainObjListConvert(virDomainObjList *domlist,
                         unsigned int flags,
                         bool skip_missing)
 {
+    g_autoptr(GHashTable) snapshot = virDomainObjListGetSnapshot(domlist);
     char uuidstr[VIR_UUID_STRING_BUFLEN];
     virDomainObj *vm;
     size_t i;
@@ -1006,17 +1361,15 @@ virDomainObjListConvert(virDomainObjList *domlist,
     *nvms = 0;
     *vms = NULL;
 
-    virObjectRWLockRead(domlist);
     for (i = 0; i < ndoms; i++) {
         virDomainPtr dom = doms[i];
 
         virUUIDFormat(dom->uuid, uuidstr);
 
-        if (!(vm = virHashLookup(domlist->objs, uuidstr))) {
+        if (!(vm = virHashLookup(snapshot, uuidstr))) {
             if (skip_missing)
                 continue;
 
-            virObjectRWUnlock(domlist);
             virReportError(VIR_ERR_NO_DOMAIN,
                            _("no domain with matching uuid '%1$s' (%2$s)"),
                            uuidstr, dom->name);
@@ -1027,7 +1380,6 @@ virDomainObjListConvert(virDomainObjList *domlist,
 
         VIR_APPEND_ELEMENT(*vms, *nvms, vm);
     }
-    virObjectRWUnlock(domlist);
 
     virDomainObjListFilter(vms, nvms, conn, filter, flags);
 
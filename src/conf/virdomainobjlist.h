@@ -62,6 +62,11 @@ virDomainObjListRename(virDomainObjList *doms,
                        virDomainObjListRenameCallback callback,
                        void *opaque);
 
+void
+virDomainObjListSetID(virDomainObjList *doms,
+                      virDomainObj *vm,
+                      int id);
+
 void
 virDomainObjListRemove(virDomainObjList *doms,
                        virDomainObj *dom);
@@ -77,6 +82,15 @@ virDomainObjListLoadAllConfigs(virDomainObjList *doms,
                                virDomainXMLOption *xmlopt,
                                virDomainLoadConfigNotify notify,
                                void *opaque);
+int
+virDomainObjListLoadAllConfigsFull(virDomainObjList *doms,
+                                   const char *configDir,
+                                   const char *autostartDir,
+                                   bool liveStatus,
+                                   unsigned int nworkers,
+                                   virDomainXMLOption *xmlopt,
+                                   virDomainLoadConfigNotify notify,
+                                   void *opaque);
 
 int
 virDomainObjListNumOfDomains(virDomainObjList *doms,
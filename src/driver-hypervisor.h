@@ -1473,6 +1473,12 @@ typedef int
                                 const char *groupname,
                                 unsigned int flags);
 
+typedef int
+(*virDrvDomainGetInfoAsync)(virDomainPtr domain,
+                            virDomainGetInfoCallback cb,
+                            void *opaque,
+                            virFreeCallback freecb);
+
 typedef struct _virHypervisorDriver virHypervisorDriver;
 
 /**
@@ -1750,4 +1756,5 @@ struct _virHypervisorDriver {
     virDrvDomainGraphicsReload domainGraphicsReload;
     virDrvDomainSetThrottleGroup domainSetThrottleGroup;
     virDrvDomainDelThrottleGroup domainDelThrottleGroup;
+    virDrvDomainGetInfoAsync domainGetInfoAsync;
 };
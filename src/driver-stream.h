@@ -75,6 +75,10 @@ typedef int
 typedef int
 (*virDrvStreamAbort)(virStreamPtr st);
 
+typedef int
+(*virDrvStreamRedirect)(virStreamPtr st,
+                        int fd);
+
 typedef struct _virStreamDriver virStreamDriver;
 struct _virStreamDriver {
     virDrvStreamSend streamSend;
@@ -88,4 +92,5 @@ struct _virStreamDriver {
     virDrvStreamEventRemoveCallback streamEventRemoveCallback;
     virDrvStreamFinish streamFinish;
     virDrvStreamAbort streamAbort;
+    virDrvStreamRedirect streamRedirect;
 };
@@ -668,6 +668,36 @@ virDomainDriverGetIOThreadsConfig(virDomainDef *targetDef,
     return ret;
 }
 
+/* Longest string the remote driver can transfer in a typed parameter,
+ * see REMOTE_STRING_MAX */
+#define VIR_DOMAIN_DRIVER_STATS_STRING_MAX (4 * 1024 * 1024)
+
+/**
+ * virDomainDriverStatsAddXML:
+ * @params: list of domain statistics
+ * @vm: domain object
+ * @xml: XML description of @vm
+ *
+ * Adds @xml as the VIR_DOMAIN_STATS_XML_DESC statistic of @vm unless it
+ * is too large to be sent to a remote client, in which case it is
+ * skipped so that the statistics of the other domains are still
+ * reported. This is not worth a warning as it would be repeated on
+ * every poll of the statistics.
+ */
+void
+virDomainDriverStatsAddXML(virTypedParamList *params,
+                           virDomainObj *vm,
+                           const char *xml)
+{
+    if (strlen(xml) > VIR_DOMAIN_DRIVER_STATS_STRING_MAX) {
+        VIR_DEBUG("XML description of domain '%s' is too large to be reported in statistics",
+                  vm->def->name);
+        return;
+    }
+
+    virTypedParamListAddString(params, xml, VIR_DOMAIN_STATS_XML_DESC);
+}
+
 typedef struct _virDomainDriverAutoStartState {
     virDomainDriverAutoStartConfig *cfg;
     bool first;
@@ -74,6 +74,10 @@ int virDomainDriverGetIOThreadsConfig(virDomainDef *targetDef,
                                       virDomainIOThreadInfoPtr **info,
                                       unsigned int bitmap_size);
 
+void virDomainDriverStatsAddXML(virTypedParamList *params,
+                                virDomainObj *vm,
+                                const char *xml);
+
 /*
  * Will be called with 'vm' locked and ref count held,
  * which will be released when this returns.
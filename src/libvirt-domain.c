@@ -2751,6 +2751,62 @@ virDomainGetInfo(virDomainPtr domain, virDomainInfoPtr info)
 }
 
 
+/**
+ * virDomainGetInfoAsync:
+ * @domain: a domain object
+ * @cb: callback to run with the information
+ * @opaque: opaque data to pass to @cb
+ * @freecb: optional function to deallocate @opaque
+ *
+ * Request the same information as virDomainGetInfo() without waiting for
+ * it. @cb is run from the event loop once the information is available or
+ * the request failed, after which @freecb is run on @opaque.
+ *
+ * This allows issuing many requests, e.g. one for every domain, over a
+ * single connection at once without the need for a thread per request.
+ * An event loop implementation must have been registered before opening
+ * the connection, see virEventRegisterImpl() or
+ * virEventRegisterDefaultImpl(). It's supported by remote connections
+ * and by the test driver.
+ *
+ * Returns 0 if the request was issued, -1 in case of failure, in which
+ * case neither @cb nor @freecb are called.
+ *
+ * Since: 11.9.0
+ */
+int
+virDomainGetInfoAsync(virDomainPtr domain,
+                      virDomainGetInfoCallback cb,
+                      void *opaque,
+                      virFreeCallback freecb)
+{
+    virConnectPtr conn;
+
+    VIR_DOMAIN_DEBUG(domain, "cb=%p, opaque=%p, freecb=%p", cb, opaque, freecb);
+
+    virResetLastError();
+
+    virCheckDomainReturn(domain, -1);
+    virCheckNonNullArgGoto(cb, error);
+
+    conn = domain->conn;
+
+    if (conn->driver->domainGetInfoAsync) {
+        int ret;
+        ret = conn->driver->domainGetInfoAsync(domain, cb, opaque, freecb);
+        if (ret < 0)
+            goto error;
+        return ret;
+    }
+
+    virReportUnsupportedError();
+
+ error:
+    virDispatchError(domain->conn);
+    return -1;
+}
+
+
 /**
  * virDomainGetState:
  * @domain: a domain object
@@ -12505,6 +12561,30 @@ virConnectGetDomainCapabilities(virConnectPtr conn,
  *      naming or meaning will stay consistent. Changes to existing fields,
  *      however, are expected to be rare.
  *
+ * VIR_DOMAIN_STATS_XML:
+ *     Return the XML description of the domain, which saves a
+ *     virDomainGetXMLDesc() call per domain when polling many of them.
+ *     The VIR_DOMAIN_STATS_XML_* constants define the known typed
+ *     parameter keys.
+ *
+ *     As the description may be large, this group is only returned if
+ *     requested explicitly. Descriptions longer than 4 MiB are skipped.
+ *     The statistics of all the domains are sent by the remote driver
+ *     in a single message limited to 32 MiB, so when querying many
+ *     domains with large descriptions, use virDomainListGetStats() on
+ *     smaller batches of domains.
+ *
+ * VIR_DOMAIN_STATS_METADATA:
+ *     Return the title and description of the domain, which saves
+ *     virDomainGetMetadata() calls per domain when polling many of them.
+ *     Custom metadata elements are not reported by this group, they are
+ *     only available as part of the description returned by the
+ *     VIR_DOMAIN_STATS_XML group.
+ *     The VIR_DOMAIN_STATS_METADATA_* constants define the known typed
+ *     parameter keys.
+ *
+ *     This group is only returned if requested explicitly.
+ *
  * Note that entire stats groups or individual stat fields may be missing from
  * the output in case they are not supported by the given hypervisor, are not
  * applicable for the current state of the guest domain, or their retrieval
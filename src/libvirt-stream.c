@@ -29,9 +29,34 @@ VIR_LOG_INIT("libvirt.stream");
 #define VIR_FROM_THIS VIR_FROM_STREAMS
 
 /* To avoid dragging in RPC code (which may be not compiled in),
- * redefine this constant. Its value can't ever change, so we're
+ * redefine these constants. Their values can't ever change, so we're
  * safe to do so. */
 #define VIR_NET_MESSAGE_LEGACY_PAYLOAD_MAX 262120
+#define VIR_NET_MESSAGE_STREAM_PAYLOAD_MAX 4194304
+
+
+/*
+ * virStreamGetChunkSize:
+ * @stream: stream
+ *
+ * Returns the amount of data to transfer in one virStreamSend/virStreamRecv
+ * call by the helpers below. Larger chunks are used only if the remote side
+ * supports them.
+ */
+static size_t
+virStreamGetChunkSize(virStreamPtr stream)
+{
+    int rc = VIR_DRV_SUPPORTS_FEATURE(stream->conn->driver, stream->conn,
+                                      VIR_DRV_FEATURE_REMOTE_STREAM_LARGE_PAYLOAD);
+
+    if (rc > 0)
+        return VIR_NET_MESSAGE_STREAM_PAYLOAD_MAX;
+
+    if (rc < 0)
+        virResetLastError();
+
+    return VIR_NET_MESSAGE_LEGACY_PAYLOAD_MAX;
+}
 
 
 /**
@@ -552,6 +577,40 @@ virStreamInData(virStreamPtr stream,
 }
 
 
+/**
+ * virStreamRedirect:
+ * @stream: stream
+ * @fd: file descriptor to transfer the data through
+ *
+ * Asks the driver of @stream to move the data between the
+ * underlying file and @fd on its own, instead of handing it out
+ * through virStreamRecv or taking it through virStreamSend. This
+ * lets the daemon give local clients a socket carrying the data
+ * of a stream. Once the transfer is finished a read stream
+ * reports EOF from virStreamRecv.
+ *
+ * Upon successful return the stream owns @fd. Otherwise @fd is
+ * left untouched.
+ *
+ * Returns 1 if @stream was redirected to @fd,
+ *         0 if the driver of @stream can't do that,
+ *        -1 on error
+ */
+int
+virStreamRedirect(virStreamPtr stream,
+                  int fd)
+{
+    VIR_DEBUG("stream=%p, fd=%d", stream, fd);
+
+    virResetLastError();
+
+    if (stream->driver->streamRedirect)
+        return (stream->driver->streamRedirect)(stream, fd);
+
+    return 0;
+}
+
+
 /**
  * virStreamSendAll:
  * @stream: pointer to the stream object
@@ -600,7 +659,7 @@ virStreamSendAll(virStreamPtr stream,
                  void *opaque)
 {
     g_autofree char *bytes = NULL;
-    size_t want = VIR_NET_MESSAGE_LEGACY_PAYLOAD_MAX;
+    size_t want;
     int ret = -1;
     VIR_DEBUG("stream=%p, handler=%p, opaque=%p", stream, handler, opaque);
 
@@ -615,6 +674,7 @@ virStreamSendAll(virStreamPtr stream,
         goto cleanup;
     }
 
+    want = virStreamGetChunkSize(stream);
     bytes = g_new0(char, want);
 
     errno = 0;
@@ -732,7 +792,7 @@ int virStreamSparseSendAll(virStreamPtr stream,
                            void *opaque)
 {
     g_autofree char *bytes = NULL;
-    size_t bufLen = VIR_NET_MESSAGE_LEGACY_PAYLOAD_MAX;
+    size_t bufLen;
     int ret = -1;
     unsigned long long dataLen = 0;
 
@@ -752,6 +812,7 @@ int virStreamSparseSendAll(virStreamPtr stream,
         goto cleanup;
     }
 
+    bufLen = virStreamGetChunkSize(stream);
     bytes = g_new0(char, bufLen);
 
     errno = 0;
@@ -872,7 +933,7 @@ virStreamRecvAll(virStreamPtr stream,
                  void *opaque)
 {
     g_autofree char *bytes = NULL;
-    size_t want = VIR_NET_MESSAGE_LEGACY_PAYLOAD_MAX;
+    size_t want;
     int ret = -1;
     VIR_DEBUG("stream=%p, handler=%p, opaque=%p", stream, handler, opaque);
 
@@ -888,6 +949,7 @@ virStreamRecvAll(virStreamPtr stream,
     }
 
 
+    want = virStreamGetChunkSize(stream);
     bytes = g_new0(char, want);
 
     errno = 0;
@@ -988,7 +1050,7 @@ virStreamSparseRecvAll(virStreamPtr stream,
                        void *opaque)
 {
     g_autofree char *bytes = NULL;
-    size_t want = VIR_NET_MESSAGE_LEGACY_PAYLOAD_MAX;
+    size_t want;
     const unsigned int flags = VIR_STREAM_RECV_STOP_AT_HOLE;
     int ret = -1;
 
@@ -1007,6 +1069,7 @@ virStreamSparseRecvAll(virStreamPtr stream,
         goto cleanup;
     }
 
+    want = virStreamGetChunkSize(stream);
     bytes = g_new0(char, want);
 
     errno = 0;
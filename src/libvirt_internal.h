@@ -132,6 +132,27 @@ typedef enum {
      * Whether the virNetworkUpdate() API implementation passes arguments to
      * the driver's callback in correct order. */
     VIR_DRV_FEATURE_NETWORK_UPDATE_HAS_CORRECT_ORDER = 16,
+
+    /*
+     * Remote party supports stream data messages larger than
+     * VIR_NET_MESSAGE_LEGACY_PAYLOAD_MAX. By querying this feature the
+     * client also announces that it can receive them.
+     */
+    VIR_DRV_FEATURE_REMOTE_STREAM_LARGE_PAYLOAD = 17,
+
+    /*
+     * Remote party can hand a local client a socket carrying the data of
+     * a stream instead of sending it in stream data messages. By querying
+     * this feature the client asks for it.
+     */
+    VIR_DRV_FEATURE_REMOTE_STREAM_LOCAL_FD = 18,
+
+    /*
+     * Remote party can compress the data exchanged over the connection.
+     * By querying this feature the client asks for all data following the
+     * reply to be compressed.
+     */
+    VIR_DRV_FEATURE_REMOTE_COMPRESSION = 19,
 } virDrvFeature;
 
 
@@ -308,3 +329,6 @@ virTypedParameterValidateSet(virConnectPtr conn,
 int virStreamInData(virStreamPtr stream,
                     int *data,
                     long long *length);
+
+int virStreamRedirect(virStreamPtr stream,
+                      int fd);
@@ -892,7 +892,7 @@ libxlDomainCleanup(libxlDriverPrivate *driver,
     }
 
     libxlLoggerCloseFile(cfg->logger, vm->def->id);
-    vm->def->id = -1;
+    virDomainObjListSetID(driver->domains, vm, -1);
 
     if (priv->deathW) {
         libxl_evdisable_domain_death(cfg->ctx, priv->deathW);
@@ -1358,7 +1358,7 @@ libxlDomainStartPerform(libxlDriverPrivate *driver,
      * The domain has been successfully created with libxl, so it should
      * be cleaned up if there are any subsequent failures.
      */
-    vm->def->id = domid;
+    virDomainObjListSetID(driver->domains, vm, domid);
     config_json = libxl_domain_config_to_json(cfg->ctx, &d_config);
 
     libxlLoggerOpenFile(cfg->logger, domid, vm->def->name, config_json);
@@ -1412,7 +1412,7 @@ libxlDomainStartPerform(libxlDriverPrivate *driver,
 
  destroy_dom:
     libxlDomainDestroyInternal(driver, vm);
-    vm->def->id = -1;
+    virDomainObjListSetID(driver->domains, vm, -1);
     virDomainObjSetState(vm, VIR_DOMAIN_SHUTOFF, VIR_DOMAIN_SHUTOFF_FAILED);
 
  cleanup:
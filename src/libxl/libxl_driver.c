@@ -403,7 +403,7 @@ libxlReconnectDomain(virDomainObj *vm,
     }
 
     /* Update domid in case it changed (e.g. reboot) while we were gone? */
-    vm->def->id = d_info.domid;
+    virDomainObjListSetID(driver->domains, vm, d_info.domid);
 
     libxlLoggerOpenFile(cfg->logger, vm->def->id, vm->def->name, NULL);
 
@@ -1520,7 +1520,7 @@ libxlDomainPMWakeup(virDomainPtr dom, unsigned int flags)
 
  destroy_dom:
     libxlDomainDestroyInternal(driver, vm);
-    vm->def->id = -1;
+    virDomainObjListSetID(driver->domains, vm, -1);
     virDomainObjSetState(vm, VIR_DOMAIN_SHUTOFF, VIR_DOMAIN_SHUTOFF_FAILED);
     event = virDomainEventLifecycleNewFromObj(vm, VIR_DOMAIN_EVENT_STOPPED,
                                               VIR_DOMAIN_EVENT_STOPPED_FAILED);
@@ -5833,6 +5833,9 @@ libxlConnectSupportsFeature(virConnectPtr conn, int feature)
     case VIR_DRV_FEATURE_REMOTE:
     case VIR_DRV_FEATURE_PROGRAM_KEEPALIVE:
     case VIR_DRV_FEATURE_REMOTE_CLOSE_CALLBACK:
+    case VIR_DRV_FEATURE_REMOTE_STREAM_LARGE_PAYLOAD:
+    case VIR_DRV_FEATURE_REMOTE_STREAM_LOCAL_FD:
+    case VIR_DRV_FEATURE_REMOTE_COMPRESSION:
     case VIR_DRV_FEATURE_REMOTE_EVENT_CALLBACK:
     case VIR_DRV_FEATURE_TYPED_PARAM_STRING:
     case VIR_DRV_FEATURE_NETWORK_UPDATE_HAS_CORRECT_ORDER:
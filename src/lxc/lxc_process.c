@@ -201,7 +201,7 @@ static void virLXCProcessCleanup(virLXCDriver *driver,
 
     virDomainObjSetState(vm, VIR_DOMAIN_SHUTOFF, reason);
     vm->pid = 0;
-    vm->def->id = -1;
+    virDomainObjListSetID(driver->domains, vm, -1);
 
     virInhibitorRelease(driver->inhibitor);
 
@@ -1443,7 +1443,7 @@ int virLXCProcessStart(virLXCDriver * driver,
 
     priv->stopReason = VIR_DOMAIN_EVENT_STOPPED_FAILED;
     priv->wantReboot = false;
-    vm->def->id = vm->pid;
+    virDomainObjListSetID(driver->domains, vm, vm->pid);
     virDomainObjSetState(vm, VIR_DOMAIN_RUNNING, reason);
     priv->doneStopEvent = false;
 
@@ -1645,7 +1645,7 @@ virLXCProcessReconnectDomain(virDomainObj *vm,
     priv = vm->privateData;
 
     if (vm->pid != 0) {
-        vm->def->id = vm->pid;
+        virDomainObjListSetID(driver->domains, vm, vm->pid);
         virDomainObjSetState(vm, VIR_DOMAIN_RUNNING,
                              VIR_DOMAIN_RUNNING_UNKNOWN);
 
@@ -1693,7 +1693,7 @@ virLXCProcessReconnectDomain(virDomainObj *vm,
         }
 
     } else {
-        vm->def->id = -1;
+        virDomainObjListSetID(driver->domains, vm, -1);
     }
 
     ret = 0;
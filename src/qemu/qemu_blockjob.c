@@ -195,7 +195,7 @@ qemuBlockJobRegister(qemuBlockJobData *job,
     }
 
     if (savestatus)
-        qemuDomainSaveStatus(vm);
+        qemuDomainSaveStatusSync(vm);
 
     return 0;
 }
@@ -221,7 +221,7 @@ qemuBlockJobUnregister(qemuBlockJobData *job,
     /* this may remove the last reference of 'job' */
     virHashRemoveEntry(priv->blockjobs, job->name);
 
-    qemuDomainSaveStatus(vm);
+    qemuDomainSaveStatusSync(vm);
 }
 
 
@@ -424,7 +424,10 @@ qemuBlockJobStarted(qemuBlockJobData *job,
     if (job->state == QEMU_BLOCKJOB_STATE_NEW)
         job->state = QEMU_BLOCKJOB_STATE_RUNNING;
 
-    qemuDomainSaveStatus(vm);
+    /* the job may have added nodes whose capacity isn't cached yet */
+    qemuDomainBlockNodeCacheInvalidate(vm);
+
+    qemuDomainSaveStatusSync(vm);
 }
 
 
@@ -1538,7 +1541,7 @@ qemuBlockJobEventProcessConcluded(qemuBlockJobData *job,
         job->newstate = QEMU_BLOCKJOB_STATE_CANCELLED;
 
     if (refreshed)
-        qemuDomainSaveStatus(vm);
+        qemuDomainSaveStatusSync(vm);
 
     VIR_DEBUG("handling job '%s' state '%d' newstate '%d'", job->name, job->state, job->newstate);
 
@@ -1572,6 +1575,8 @@ qemuBlockJobEventProcess(virQEMUDriver *driver,
                          virDomainAsyncJob asyncJob)
 
 {
+    qemuDomainBlockNodeCacheInvalidate(vm);
+
     switch ((qemuBlockjobState) job->newstate) {
     case QEMU_BLOCKJOB_STATE_COMPLETED:
     case QEMU_BLOCKJOB_STATE_FAILED:
@@ -1603,7 +1608,7 @@ qemuBlockJobEventProcess(virQEMUDriver *driver,
                 qemuBlockJobEmitEvents(driver, vm, job->disk, job->type, job->newstate);
             }
             job->state = job->newstate;
-            qemuDomainSaveStatus(vm);
+            qemuDomainSaveStatusSync(vm);
         }
         job->newstate = -1;
         break;
@@ -1616,7 +1621,7 @@ qemuBlockJobEventProcess(virQEMUDriver *driver,
             if (job->state == QEMU_BLOCKJOB_STATE_NEW ||
                 job->state == QEMU_BLOCKJOB_STATE_RUNNING) {
                 job->state = job->newstate;
-                qemuDomainSaveStatus(vm);
+                qemuDomainSaveStatusSync(vm);
             }
         }
         job->newstate = -1;
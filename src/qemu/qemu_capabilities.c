@@ -2973,6 +2973,40 @@ virQEMUCapsProbeQMPMachineTypes(virQEMUCaps *qemuCaps,
 }
 
 
+/**
+ * virQEMUCapsCopyMachineTypes:
+ * @dst: capabilities to update
+ * @src: capabilities to copy from
+ * @virtType: virtualization type
+ *
+ * Replaces the architecture and the machine types of @virtType in @dst by
+ * those in @src. This is equivalent to calling virQEMUCapsInitQMPArch and
+ * virQEMUCapsProbeQMPMachineTypes on @dst when @src was probed from the
+ * same QEMU binary.
+ */
+void
+virQEMUCapsCopyMachineTypes(virQEMUCaps *dst,
+                            virQEMUCaps *src,
+                            virDomainVirtType virtType)
+{
+    virQEMUCapsAccel *dstAccel = virQEMUCapsGetAccel(dst, virtType);
+    size_t i;
+
+    for (i = 0; i < dstAccel->nmachineTypes; i++) {
+        g_free(dstAccel->machineTypes[i].name);
+        g_free(dstAccel->machineTypes[i].alias);
+        g_free(dstAccel->machineTypes[i].defaultCPU);
+        g_free(dstAccel->machineTypes[i].defaultRAMid);
+    }
+    g_clear_pointer(&dstAccel->machineTypes, g_free);
+    dstAccel->nmachineTypes = 0;
+
+    dst->arch = src->arch;
+    virQEMUCapsAccelCopyMachineTypes(dstAccel,
+                                     virQEMUCapsGetAccel(src, virtType));
+}
+
+
 bool
 virQEMUCapsIsMachineSupported(virQEMUCaps *qemuCaps,
                               virDomainVirtType virtType,
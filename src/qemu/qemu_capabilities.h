@@ -974,3 +974,8 @@ int
 virQEMUCapsProbeQMPMachineTypes(virQEMUCaps *qemuCaps,
                                 virDomainVirtType virtType,
                                 qemuMonitor *mon);
+
+void
+virQEMUCapsCopyMachineTypes(virQEMUCaps *dst,
+                            virQEMUCaps *src,
+                            virDomainVirtType virtType);
@@ -943,6 +943,36 @@ virQEMUDriverConfigLoadRPCEntry(virQEMUDriverConfig *cfg,
 }
 
 
+static int
+virQEMUDriverConfigLoadStatsEntry(virQEMUDriverConfig *cfg,
+                                  virConf *conf)
+{
+    if (virConfGetValueUInt(conf, "stats_workers", &cfg->statsWorkers) < 0)
+        return -1;
+    if (virConfGetValueUInt(conf, "stats_domain_timeout", &cfg->statsDomainTimeout) < 0)
+        return -1;
+    if (virConfGetValueUInt(conf, "stats_block_cache_timeout", &cfg->statsBlockCacheTimeout) < 0)
+        return -1;
+
+    return 0;
+}
+
+
+static int
+virQEMUDriverConfigLoadStateEntry(virQEMUDriverConfig *cfg,
+                                  virConf *conf)
+{
+    if (virConfGetValueUInt(conf, "reconnect_workers", &cfg->reconnectWorkers) < 0)
+        return -1;
+    if (virConfGetValueBool(conf, "reconnect_defer_refresh", &cfg->reconnectDeferRefresh) < 0)
+        return -1;
+    if (virConfGetValueBool(conf, "status_write_behind", &cfg->statusWriteBehind) < 0)
+        return -1;
+
+    return 0;
+}
+
+
 static int
 virQEMUDriverConfigLoadNetworkEntry(virQEMUDriverConfig *cfg,
                                     virConf *conf,
@@ -1344,6 +1374,12 @@ int virQEMUDriverConfigLoadFile(virQEMUDriverConfig *cfg,
     if (virQEMUDriverConfigLoadRPCEntry(cfg, conf) < 0)
         return -1;
 
+    if (virQEMUDriverConfigLoadStatsEntry(cfg, conf) < 0)
+        return -1;
+
+    if (virQEMUDriverConfigLoadStateEntry(cfg, conf) < 0)
+        return -1;
+
     if (virQEMUDriverConfigLoadNetworkEntry(cfg, conf, filename) < 0)
         return -1;
 
@@ -212,6 +212,14 @@ struct _virQEMUDriverConfig {
 
     unsigned int maxQueuedJobs;
 
+    unsigned int statsWorkers;
+    unsigned int statsDomainTimeout;
+    unsigned int statsBlockCacheTimeout;
+
+    unsigned int reconnectWorkers;
+    bool reconnectDeferRefresh;
+    bool statusWriteBehind;
+
     char **securityDriverNames;
     bool securityDefaultConfined;
     bool securityRequireConfined;
@@ -282,9 +290,21 @@ struct _virQEMUDriver {
     /* Immutable pointer, self-locking APIs */
     virThreadPool *workerPool;
 
+    /* Immutable pointer, self-locking APIs. NULL if statistics of
+     * domains are gathered serially */
+    virThreadPool *statsPool;
+
+    /* Immutable pointer, self-locking APIs. NULL if status XMLs of
+     * domains are written synchronously */
+    virThreadPool *statusPool;
+
     /* Atomic increment only */
     int lastvmid;
 
+    /* Atomic increment only */
+    unsigned int blockNodeCacheHits;
+    unsigned int blockNodeCacheMisses;
+
     /* Immutable values */
     bool privileged;
     char *embeddedRoot;
@@ -414,7 +414,7 @@ virDomainJobObjConfig virQEMUDriverDomainJobConfig = {
         .resetJobPrivate = qemuJobResetPrivate,
         .formatJobPrivate = qemuDomainFormatJobPrivate,
         .parseJobPrivate = qemuDomainParseJobPrivate,
-        .saveStatusPrivate = qemuDomainSaveStatus,
+        .saveStatusPrivate = qemuDomainSaveStatusSync,
     },
     .jobDataPrivateCb = {
         .allocPrivateData = qemuJobDataAllocPrivateData,
@@ -1933,6 +1933,8 @@ qemuDomainObjPrivateDataClear(qemuDomainObjPrivate *priv)
 
     virHashRemoveAll(priv->statsSchema);
 
+    g_clear_pointer(&priv->blockNodeCache, g_hash_table_unref);
+
     g_slist_free_full(g_steal_pointer(&priv->threadContextAliases), g_free);
 
     priv->migrationRecoverSetup = false;
@@ -5034,17 +5036,138 @@ virDomainDefParserConfig virQEMUDriverDomainDefParserConfig = {
 };
 
 
+/**
+ * qemuDomainSaveStatusSync:
+ * @obj: domain object
+ *
+ * Write the status XML of an active domain @obj right away. This must be
+ * used wherever the on-disk state has to be consistent before proceeding
+ * (e.g. before a job phase or a block job is acted upon, on domain startup
+ * or after device hotplug) as it also flushes any write requested by
+ * qemuDomainSaveStatus which is still pending.
+ *
+ * Caller must hold the lock on @obj.
+ *
+ * Returns 0 on success, -1 if the status couldn't be written. Callers
+ * which can't handle the failure may ignore it, a warning is logged.
+ */
+int
+qemuDomainSaveStatusSync(virDomainObj *obj)
+{
+    qemuDomainObjPrivate *priv = obj->privateData;
+    virQEMUDriver *driver = priv->driver;
+    g_autoptr(virQEMUDriverConfig) cfg = NULL;
+
+    priv->statusDirty = false;
+
+    if (!virDomainObjIsActive(obj))
+        return 0;
+
+    cfg = virQEMUDriverGetConfig(driver);
+
+    if (virDomainObjSave(obj, driver->xmlopt, cfg->stateDir) < 0) {
+        VIR_WARN("Failed to save status on vm %s", obj->def->name);
+        return -1;
+    }
+
+    priv->statusWrites++;
+    VIR_DEBUG("Saved status of vm %s (job=%s asyncJob=%s requests=%llu writes=%llu)",
+              obj->def->name,
+              virDomainJobTypeToString(obj->job->active),
+              virDomainAsyncJobTypeToString(obj->job->asyncJob),
+              priv->statusRequests, priv->statusWrites);
+    return 0;
+}
+
+
+/**
+ * qemuDomainSaveStatus:
+ * @obj: domain object
+ *
+ * Request the status XML of @obj to be written. With 'status_write_behind'
+ * enabled in qemu.conf the write is only scheduled in the status worker
+ * pool so that multiple requests made while the domain is locked (e.g.
+ * during a burst of monitor events or a single API call) coalesce into
+ * a single write which doesn't block the caller. Otherwise the status is
+ * written synchronously.
+ *
+ * Caller must hold the lock on @obj.
+ */
 void
 qemuDomainSaveStatus(virDomainObj *obj)
 {
     qemuDomainObjPrivate *priv = obj->privateData;
     virQEMUDriver *driver = priv->driver;
-    g_autoptr(virQEMUDriverConfig) cfg = virQEMUDriverGetConfig(driver);
 
-    if (virDomainObjIsActive(obj)) {
-        if (virDomainObjSave(obj, driver->xmlopt, cfg->stateDir) < 0)
-            VIR_WARN("Failed to save status on vm %s", obj->def->name);
+    if (!virDomainObjIsActive(obj))
+        return;
+
+    priv->statusRequests++;
+
+    if (!driver->statusPool) {
+        qemuDomainSaveStatusSync(obj);
+        return;
     }
+
+    priv->statusDirty = true;
+
+    if (priv->statusFlushScheduled)
+        return;
+
+    if (virThreadPoolSendJob(driver->statusPool, 0, virObjectRef(obj)) < 0) {
+        /* the pool is shutting down, don't lose the update */
+        virObjectUnref(obj);
+        qemuDomainSaveStatusSync(obj);
+        return;
+    }
+
+    priv->statusFlushScheduled = true;
+}
+
+
+/**
+ * qemuDomainSaveStatusWorker:
+ * @jobdata: referenced domain object
+ * @opaque: QEMU driver
+ *
+ * Worker of the status pool writing out a status XML scheduled by
+ * qemuDomainSaveStatus unless it was flushed in the meantime.
+ */
+void
+qemuDomainSaveStatusWorker(void *jobdata,
+                           void *opaque G_GNUC_UNUSED)
+{
+    virDomainObj *vm = jobdata;
+    qemuDomainObjPrivate *priv;
+
+    virObjectLock(vm);
+    priv = vm->privateData;
+
+    priv->statusFlushScheduled = false;
+
+    if (priv->statusDirty)
+        qemuDomainSaveStatusSync(vm);
+
+    virDomainObjEndAPI(&vm);
+}
+
+
+/**
+ * qemuDomainFlushStatus:
+ * @obj: domain object
+ *
+ * Synchronously write the status XML of @obj if there's a pending
+ * write-behind request.
+ *
+ * Caller must hold the lock on @obj.
+ */
+void
+qemuDomainFlushStatus(virDomainObj *obj)
+{
+    qemuDomainObjPrivate *priv = obj->privateData;
+
+    if (priv->statusDirty)
+        qemuDomainSaveStatusSync(obj);
 }
 
 
@@ -10262,6 +10385,7 @@ qemuProcessEventFree(struct qemuProcessEvent *event)
     case QEMU_PROCESS_EVENT_NBDKIT_EXITED:
     case QEMU_PROCESS_EVENT_MONITOR_EOF:
     case QEMU_PROCESS_EVENT_SHUTDOWN_COMPLETED:
+    case QEMU_PROCESS_EVENT_RECONNECT_REFRESH:
     case QEMU_PROCESS_EVENT_LAST:
         break;
     }
@@ -11032,6 +11156,25 @@ qemuDomainRefreshStatsSchema(virDomainObj *dom)
 }
 
 
+/**
+ * qemuDomainBlockNodeCacheInvalidate:
+ * @vm: domain object
+ *
+ * Drop the cached capacity data of block nodes of @vm. Must be called
+ * whenever the block node topology or sizes of images change, e.g.
+ * on block job transitions, disk hotplug, media change, snapshots or
+ * block resize.
+ */
+void
+qemuDomainBlockNodeCacheInvalidate(virDomainObj *vm)
+{
+    qemuDomainObjPrivate *priv = vm->privateData;
+
+    g_clear_pointer(&priv->blockNodeCache, g_hash_table_unref);
+    priv->blockNodeCacheGen++;
+}
+
+
 static void
 syncNicRxFilterMacAddr(char *ifname, virNetDevRxFilter *guestFilter,
                        virNetDevRxFilter *hostFilter)
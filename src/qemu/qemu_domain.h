@@ -63,6 +63,9 @@ typedef void (*qemuDomainCleanupCallback)(virQEMUDriver *driver,
 #define QEMU_DOMAIN_MASTER_KEY_LEN 32  /* 32 bytes for 256 bit random key */
 
 void qemuDomainSaveStatus(virDomainObj *obj);
+int qemuDomainSaveStatusSync(virDomainObj *obj);
+void qemuDomainSaveStatusWorker(void *jobdata, void *opaque);
+void qemuDomainFlushStatus(virDomainObj *obj);
 void qemuDomainSaveConfig(virDomainObj *obj);
 
 
@@ -256,6 +259,12 @@ struct _qemuDomainObjPrivate {
 
     GHashTable *statsSchema; /* (name, data) pair for stats */
 
+    /* node-name -> qemuBlockStats with capacity data as returned by
+     * 'query-named-block-nodes', NULL if not cached */
+    GHashTable *blockNodeCache;
+    unsigned long long blockNodeCacheTime; /* in milliseconds */
+    unsigned int blockNodeCacheGen; /* bumped on every invalidation */
+
     /* Info on dummy process for schedCore. A short lived process used only
      * briefly when starting a guest. Don't save/parse into XML. */
     pid_t schedCoreChildPID;
@@ -267,6 +276,12 @@ struct _qemuDomainObjPrivate {
     GHashTable *fds;
 
     char *memoryBackingDir;
+
+    /* write-behind of the status XML, see qemuDomainSaveStatus() */
+    bool statusDirty; /* a write was requested but not done yet */
+    bool statusFlushScheduled; /* a job is queued in the status pool */
+    unsigned long long statusRequests; /* number of qemuDomainSaveStatus calls */
+    unsigned long long statusWrites; /* number of status XML actually written */
 };
 
 #define QEMU_DOMAIN_PRIVATE(vm) \
@@ -484,6 +499,7 @@ typedef enum {
     QEMU_PROCESS_EVENT_RESET,
     QEMU_PROCESS_EVENT_NBDKIT_EXITED,
     QEMU_PROCESS_EVENT_SHUTDOWN_COMPLETED,
+    QEMU_PROCESS_EVENT_RECONNECT_REFRESH,
 
     QEMU_PROCESS_EVENT_LAST
 } qemuProcessEventType;
@@ -1128,6 +1144,9 @@ qemuDomainObjIsActive(virDomainObj *vm);
 int
 qemuDomainRefreshStatsSchema(virDomainObj *dom);
 
+void
+qemuDomainBlockNodeCacheInvalidate(virDomainObj *vm);
+
 int
 qemuDomainSyncRxFilter(virDomainObj *vm,
                        virDomainNetDef *def,
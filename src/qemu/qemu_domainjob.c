@@ -574,7 +574,7 @@ qemuDomainObjSetJobPhase(virDomainObj *obj,
     }
 
     obj->job->phase = phase;
-    qemuDomainSaveStatus(obj);
+    qemuDomainSaveStatusSync(obj);
 }
 
 
@@ -625,7 +625,7 @@ qemuDomainObjDiscardAsyncJob(virDomainObj *obj)
     if (obj->job->active == VIR_JOB_ASYNC_NESTED)
         virDomainObjResetJob(obj->job);
     virDomainObjResetAsyncJob(obj->job);
-    qemuDomainSaveStatus(obj);
+    qemuDomainSaveStatusSync(obj);
 }
 
 void
@@ -57,6 +57,7 @@
 #include "virlog.h"
 #include "datatypes.h"
 #include "virbuffer.h"
+#include "vircachestats.h"
 #include "virhostcpu.h"
 #include "virhostmem.h"
 #include "virnetdevtap.h"
@@ -142,6 +143,9 @@ VIR_ENUM_IMPL(qemuDumpFormat,
 
 static void qemuProcessEventHandler(void *data, void *opaque);
 
+static void qemuDomainGetStatsParallelWorker(void *jobdata, void *opaque);
+static void qemuDomainGetStatsParallelJobFree(void *jobdata);
+
 static int qemuStateCleanup(void);
 
 static int qemuDomainObjStart(virConnectPtr conn,
@@ -518,6 +522,20 @@ qemuDomainFindMaxID(virDomainObj *vm,
 }
 
 
+static void
+qemuStateGetBlockNodeCacheStats(virTypedParamList *list,
+                                const char *prefix,
+                                void *opaque)
+{
+    virQEMUDriver *driver = opaque;
+
+    virTypedParamListAddULLong(list, g_atomic_int_get(&driver->blockNodeCacheHits),
+                               "%s.hits", prefix);
+    virTypedParamListAddULLong(list, g_atomic_int_get(&driver->blockNodeCacheMisses),
+                               "%s.misses", prefix);
+}
+
+
 /**
  * qemuStateInitialize:
  *
@@ -538,6 +556,7 @@ qemuStateInitialize(bool privileged,
     const char *defsecmodel = NULL;
     g_autoptr(virIdentity) identity = virIdentityGetCurrent();
     virDomainDriverAutoStartConfig autostartCfg;
+    long long loadStart;
 
     qemu_driver = g_new0(virQEMUDriver, 1);
 
@@ -847,12 +866,16 @@ qemuStateInitialize(bool privileged,
         goto error;
 
     /* Get all the running persistent or transient configs first */
-    if (virDomainObjListLoadAllConfigs(qemu_driver->domains,
-                                       cfg->stateDir,
-                                       NULL, true,
-                                       qemu_driver->xmlopt,
-                                       NULL, NULL) < 0)
+    loadStart = g_get_monotonic_time();
+    if (virDomainObjListLoadAllConfigsFull(qemu_driver->domains,
+                                           cfg->stateDir,
+                                           NULL, true,
+                                           cfg->reconnectWorkers,
+                                           qemu_driver->xmlopt,
+                                           NULL, NULL) < 0)
         goto error;
+    VIR_INFO("Loaded status of running domains in %lld ms",
+             (g_get_monotonic_time() - loadStart) / 1000);
 
     /* find the maximum ID from active and transient configs to initialize
      * the driver with. This is to avoid race between autostart and reconnect
@@ -868,12 +891,16 @@ qemuStateInitialize(bool privileged,
                             NULL);
 
     /* Then inactive persistent configs */
-    if (virDomainObjListLoadAllConfigs(qemu_driver->domains,
-                                       cfg->configDir,
-                                       cfg->autostartDir, false,
-                                       qemu_driver->xmlopt,
-                                       NULL, NULL) < 0)
+    loadStart = g_get_monotonic_time();
+    if (virDomainObjListLoadAllConfigsFull(qemu_driver->domains,
+                                           cfg->configDir,
+                                           cfg->autostartDir, false,
+                                           cfg->reconnectWorkers,
+                                           qemu_driver->xmlopt,
+                                           NULL, NULL) < 0)
         goto error;
+    VIR_INFO("Loaded persistent domain configs in %lld ms",
+             (g_get_monotonic_time() - loadStart) / 1000);
 
     virDomainObjListForEach(qemu_driver->domains,
                             false,
@@ -900,6 +927,35 @@ qemuStateInitialize(bool privileged,
     if (!qemu_driver->workerPool)
         goto error;
 
+    if (cfg->statsWorkers > 0) {
+        qemu_driver->statsPool = virThreadPoolNewFull(0, cfg->statsWorkers, 0,
+                                                      qemuDomainGetStatsParallelWorker,
+                                                      "qemu-stats",
+                                                      identity,
+                                                      qemu_driver);
+        if (!qemu_driver->statsPool)
+            goto error;
+
+        virThreadPoolSetJobDataFree(qemu_driver->statsPool,
+                                    qemuDomainGetStatsParallelJobFree);
+    }
+
+    if (cfg->statusWriteBehind) {
+        qemu_driver->statusPool = virThreadPoolNewFull(0, 1, 0,
+                                                       qemuDomainSaveStatusWorker,
+                                                       "qemu-status",
+                                                       identity,
+                                                       qemu_driver);
+        if (!qemu_driver->statusPool)
+            goto error;
+
+        /* domains whose write was discarded are flushed in qemuStateShutdownWait */
+        virThreadPoolSetJobDataFree(qemu_driver->statusPool, virObjectUnref);
+    }
+
+    virCacheStatsRegister("qemu.blocknode", qemuStateGetBlockNodeCacheStats,
+                          qemu_driver);
+
     qemuProcessReconnectAll(qemu_driver);
 
     autostartCfg = (virDomainDriverAutoStartConfig) {
@@ -993,12 +1049,33 @@ qemuDomainObjStopWorkerIter(virDomainObj *vm,
 }
 
 
+static int
+qemuDomainObjFlushStatusIter(virDomainObj *vm,
+                             void *opaque G_GNUC_UNUSED)
+{
+    virObjectLock(vm);
+    QEMU_DOMAIN_PRIVATE(vm)->statusFlushScheduled = false;
+    qemuDomainFlushStatus(vm);
+    virObjectUnlock(vm);
+    return 0;
+}
+
+
 static int
 qemuStateShutdownWait(void)
 {
     virDomainObjListForEach(qemu_driver->domains, false,
                             qemuDomainObjStopWorkerIter, NULL);
     virThreadPoolDrain(qemu_driver->workerPool);
+
+    if (qemu_driver->statusPool) {
+        /* Writes still queued are discarded by draining the pool and
+         * any later request is written synchronously, so flush the
+         * pending ones now. */
+        virThreadPoolDrain(qemu_driver->statusPool);
+        virDomainObjListForEach(qemu_driver->domains, false,
+                                qemuDomainObjFlushStatusIter, NULL);
+    }
     return 0;
 }
 
@@ -1014,7 +1091,10 @@ qemuStateCleanup(void)
     if (!qemu_driver)
         return -1;
 
+    virCacheStatsUnregister("qemu.blocknode");
     virThreadPoolFree(qemu_driver->workerPool);
+    virThreadPoolFree(qemu_driver->statsPool);
+    virThreadPoolFree(qemu_driver->statusPool);
     virObjectUnref(qemu_driver->migrationErrors);
     virLockManagerPluginUnref(qemu_driver->lockManager);
     virSysinfoDefFree(qemu_driver->hostsysinfo);
@@ -1130,6 +1210,9 @@ qemuConnectSupportsFeature(virConnectPtr conn, int feature)
     case VIR_DRV_FEATURE_REMOTE:
     case VIR_DRV_FEATURE_PROGRAM_KEEPALIVE:
     case VIR_DRV_FEATURE_REMOTE_CLOSE_CALLBACK:
+    case VIR_DRV_FEATURE_REMOTE_STREAM_LARGE_PAYLOAD:
+    case VIR_DRV_FEATURE_REMOTE_STREAM_LOCAL_FD:
+    case VIR_DRV_FEATURE_REMOTE_COMPRESSION:
     case VIR_DRV_FEATURE_REMOTE_EVENT_CALLBACK:
     case VIR_DRV_FEATURE_TYPED_PARAM_STRING:
     case VIR_DRV_FEATURE_NETWORK_UPDATE_HAS_CORRECT_ORDER:
@@ -3597,7 +3680,7 @@ processDeviceDeletedEvent(virQEMUDriver *driver,
             goto endjob;
     }
 
-    qemuDomainSaveStatus(vm);
+    qemuDomainSaveStatusSync(vm);
 
  endjob:
     virDomainObjEndJob(vm);
@@ -4061,6 +4144,19 @@ processShutdownCompletedEvent(virDomainObj *vm)
 }
 
 
+static void
+processReconnectRefreshEvent(virDomainObj *vm)
+{
+    if (virDomainObjBeginJob(vm, VIR_JOB_MODIFY) < 0)
+        return;
+
+    if (virDomainObjIsActive(vm))
+        qemuProcessReconnectRefresh(vm);
+
+    virDomainObjEndJob(vm);
+}
+
+
 static void qemuProcessEventHandler(void *data, void *opaque)
 {
     struct qemuProcessEvent *processEvent = data;
@@ -4127,6 +4223,9 @@ static void qemuProcessEventHandler(void *data, void *opaque)
     case QEMU_PROCESS_EVENT_SHUTDOWN_COMPLETED:
         processShutdownCompletedEvent(vm);
         break;
+    case QEMU_PROCESS_EVENT_RECONNECT_REFRESH:
+        processReconnectRefreshEvent(vm);
+        break;
     case QEMU_PROCESS_EVENT_LAST:
         break;
     }
@@ -7383,7 +7482,7 @@ qemuDomainAttachDeviceLiveAndConfig(virDomainObj *vm,
          * changed even if we failed to attach the device. For example,
          * a new controller may be created.
          */
-        qemuDomainSaveStatus(vm);
+        qemuDomainSaveStatusSync(vm);
     }
 
     /* Finally, if no error until here, we can save config. */
@@ -7520,7 +7619,7 @@ qemuDomainUpdateDeviceFlags(virDomainPtr dom,
         if ((ret = qemuDomainUpdateDeviceLive(vm, dev_live, driver, force)) < 0)
             goto endjob;
 
-        qemuDomainSaveStatus(vm);
+        qemuDomainSaveStatusSync(vm);
     }
 
     /* Finally, if no error until here, we can save config. */
@@ -7602,7 +7701,7 @@ qemuDomainDetachDeviceLiveAndConfig(virQEMUDriver *driver,
         if (rc == 0 && qemuDomainUpdateDeviceList(vm, VIR_ASYNC_JOB_NONE) < 0)
             return -1;
 
-        qemuDomainSaveStatus(vm);
+        qemuDomainSaveStatusSync(vm);
     }
 
     /* Finally, if no error until here, we can save config. */
@@ -9554,6 +9653,8 @@ qemuDomainBlockResize(virDomainPtr dom,
             goto endjob;
     }
 
+    qemuDomainBlockNodeCacheInvalidate(vm);
+
     qemuDomainObjEnterMonitor(vm);
     if (qemuMonitorBlockResize(priv->mon, device, nodename, size) < 0) {
         qemuDomainObjExitMonitor(vm);
@@ -17170,6 +17271,38 @@ qemuDomainGetStatsCpu(virQEMUDriver *driver,
 }
 
 
+static void
+qemuDomainGetStatsXML(virQEMUDriver *driver,
+                      virDomainObj *dom,
+                      virTypedParamList *params,
+                      unsigned int privflags G_GNUC_UNUSED)
+{
+    g_autofree char *xml = NULL;
+
+    if (!(xml = qemuDomainFormatXML(driver, dom, 0))) {
+        virResetLastError();
+        return;
+    }
+
+    virDomainDriverStatsAddXML(params, dom, xml);
+}
+
+
+static void
+qemuDomainGetStatsMetadata(virQEMUDriver *driver G_GNUC_UNUSED,
+                           virDomainObj *dom,
+                           virTypedParamList *params,
+                           unsigned int privflags G_GNUC_UNUSED)
+{
+    if (dom->def->title)
+        virTypedParamListAddString(params, dom->def->title,
+                                   VIR_DOMAIN_STATS_METADATA_TITLE);
+    if (dom->def->description)
+        virTypedParamListAddString(params, dom->def->description,
+                                   VIR_DOMAIN_STATS_METADATA_DESCRIPTION);
+}
+
+
 static void
 qemuDomainGetStatsMemory(virQEMUDriver *driver,
                          virDomainObj *dom,
@@ -17720,6 +17853,114 @@ qemuDomainGetStatsBlockExportDisk(virDomainDiskDef *disk,
 }
 
 
+/**
+ * qemuDomainGetStatsBlockCacheLookup:
+ * @dom: domain object
+ * @cfg: driver config
+ *
+ * Returns a reference to the cached capacity data of block nodes of @dom
+ * if it can be used instead of querying QEMU, NULL otherwise. The cache
+ * is replaced rather than modified, so the reference stays valid while
+ * the monitor is entered.
+ */
+static GHashTable *
+qemuDomainGetStatsBlockCacheLookup(virDomainObj *dom,
+                                   virQEMUDriverConfig *cfg)
+{
+    qemuDomainObjPrivate *priv = dom->privateData;
+    unsigned long long now;
+
+    if (cfg->statsBlockCacheTimeout == 0 || !priv->blockNodeCache)
+        return NULL;
+
+    if (virTimeMillisNow(&now) < 0 ||
+        now - priv->blockNodeCacheTime >= cfg->statsBlockCacheTimeout * 1000ULL) {
+        qemuDomainBlockNodeCacheInvalidate(dom);
+        return NULL;
+    }
+
+    return g_hash_table_ref(priv->blockNodeCache);
+}
+
+
+/**
+ * qemuDomainGetStatsBlockCacheCovers:
+ * @cache: cached capacity data
+ * @stats: block stats returned by QEMU
+ *
+ * Returns true if @cache has an entry for each node in @stats. Nodes
+ * which are added e.g. by a block job are not, so their capacity must be
+ * queried.
+ */
+static bool
+qemuDomainGetStatsBlockCacheCovers(GHashTable *cache,
+                                   GHashTable *stats)
+{
+    GHashTableIter iter;
+    const char *nodename;
+
+    g_hash_table_iter_init(&iter, stats);
+    while (g_hash_table_iter_next(&iter, (void **) &nodename, NULL)) {
+        if (!g_hash_table_contains(cache, nodename))
+            return false;
+    }
+
+    return true;
+}
+
+
+static void
+qemuDomainGetStatsBlockCacheStore(virDomainObj *dom,
+                                  GHashTable *stats)
+{
+    qemuDomainObjPrivate *priv = dom->privateData;
+    GHashTableIter iter;
+    const char *nodename;
+    qemuBlockStats *entry;
+
+    if (virTimeMillisNow(&priv->blockNodeCacheTime) < 0)
+        return;
+
+    g_clear_pointer(&priv->blockNodeCache, g_hash_table_unref);
+    priv->blockNodeCache = virHashNew(g_free);
+
+    g_hash_table_iter_init(&iter, stats);
+    while (g_hash_table_iter_next(&iter, (void **) &nodename, (void **) &entry)) {
+        qemuBlockStats *cached = g_new0(qemuBlockStats, 1);
+
+        cached->capacity = entry->capacity;
+        cached->physical = entry->physical;
+        cached->write_threshold = entry->write_threshold;
+
+        g_hash_table_insert(priv->blockNodeCache, g_strdup(nodename), cached);
+    }
+}
+
+
+static void
+qemuDomainGetStatsBlockCacheApply(GHashTable *cache,
+                                  GHashTable *stats)
+{
+    GHashTableIter iter;
+    const char *nodename;
+    qemuBlockStats *cached;
+
+    g_hash_table_iter_init(&iter, cache);
+    while (g_hash_table_iter_next(&iter, (void **) &nodename, (void **) &cached)) {
+        qemuBlockStats *entry;
+
+        if (!(entry = virHashLookup(stats, nodename))) {
+            entry = g_new0(qemuBlockStats, 1);
+            g_hash_table_insert(stats, g_strdup(nodename), entry);
+        }
+
+        entry->capacity = cached->capacity;
+        entry->physical = cached->physical;
+        entry->write_threshold = cached->write_threshold;
+    }
+}
+
+
 static void
 qemuDomainGetStatsBlock(virQEMUDriver *driver,
                         virDomainObj *dom,
@@ -17736,18 +17977,35 @@ qemuDomainGetStatsBlock(virQEMUDriver *driver,
     g_autoptr(virTypedParamList) blockparams = virTypedParamListNew();
 
     if (HAVE_JOB(privflags) && virDomainObjIsActive(dom)) {
+        g_autoptr(GHashTable) cache = qemuDomainGetStatsBlockCacheLookup(dom, cfg);
+        unsigned int cacheGen = priv->blockNodeCacheGen;
+
         qemuDomainObjEnterMonitor(dom);
 
         rc = qemuMonitorGetAllBlockStatsInfo(priv->mon, &stats);
 
-        if (rc >= 0)
+        if (rc >= 0 && cache &&
+            !qemuDomainGetStatsBlockCacheCovers(cache, stats))
+            g_clear_pointer(&cache, g_hash_table_unref);
+
+        if (rc >= 0 && !cache)
             rc = qemuMonitorBlockStatsUpdateCapacityBlockdev(priv->mon, stats);
 
         qemuDomainObjExitMonitor(dom);
 
         /* failure to retrieve stats is fine at this point */
-        if (rc < 0)
+        if (rc < 0) {
             virResetLastError();
+        } else if (cache) {
+            g_atomic_int_inc(&driver->blockNodeCacheHits);
+            qemuDomainGetStatsBlockCacheApply(cache, stats);
+        } else if (cfg->statsBlockCacheTimeout > 0) {
+            g_atomic_int_inc(&driver->blockNodeCacheMisses);
+
+            /* don't store data which might predate an invalidation */
+            if (cacheGen == priv->blockNodeCacheGen)
+                qemuDomainGetStatsBlockCacheStore(dom, stats);
+        }
     }
 
     for (i = 0; i < dom->def->ndisks; i++) {
@@ -17986,6 +18244,8 @@ static struct qemuDomainGetStatsWorker qemuDomainGetStatsWorkers[] = {
     { qemuDomainGetStatsMemory, VIR_DOMAIN_STATS_MEMORY, false, NULL },
     { qemuDomainGetStatsDirtyRate, VIR_DOMAIN_STATS_DIRTYRATE, true, queryDirtyRateRequired },
     { qemuDomainGetStatsVm, VIR_DOMAIN_STATS_VM, true, queryVmRequired },
+    { qemuDomainGetStatsXML, VIR_DOMAIN_STATS_XML, false, NULL },
+    { qemuDomainGetStatsMetadata, VIR_DOMAIN_STATS_METADATA, false, NULL },
     { NULL, 0, false, NULL }
 };
 
@@ -18018,7 +18278,10 @@ qemuDomainGetStatsCheckSupport(unsigned int *stats,
     }
 
     if (*stats == 0) {
-        *stats = supportedstats;
+        /* These are only returned on request so that the default output
+         * doesn't grow by the whole domain XML */
+        *stats = supportedstats & ~(VIR_DOMAIN_STATS_XML |
+                                    VIR_DOMAIN_STATS_METADATA);
         return 0;
     }
 
@@ -18049,6 +18312,22 @@ qemuDomainGetStatsNeedMonitor(unsigned int stats)
 }
 
 
+/* Returns the stats types which require talking to QEMU */
+static unsigned int
+qemuDomainGetStatsMonitorTypes(void)
+{
+    unsigned int ret = 0;
+    size_t i;
+
+    for (i = 0; qemuDomainGetStatsWorkers[i].func; i++) {
+        if (qemuDomainGetStatsWorkers[i].monitor)
+            ret |= qemuDomainGetStatsWorkers[i].stats;
+    }
+
+    return ret;
+}
+
+
 static int
 qemuDomainGetStats(virConnectPtr conn,
                    virDomainObj *dom,
@@ -18082,6 +18361,326 @@ qemuDomainGetStats(virConnectPtr conn,
 }
 
 
+/**
+ * qemuDomainGetStatsOne:
+ * @conn: connection
+ * @vm: domain object, unlocked
+ * @stats: requested stats types
+ * @record: filled with the gathered statistics
+ * @flags: flags of virConnectGetAllDomainStats
+ *
+ * Gather statistics for a single domain, acquiring a job if any of
+ * the requested stats types need to talk to QEMU.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+static int
+qemuDomainGetStatsOne(virConnectPtr conn,
+                      virDomainObj *vm,
+                      unsigned int stats,
+                      virDomainStatsRecordPtr *record,
+                      unsigned int flags)
+{
+    bool enforce = !!(flags & VIR_CONNECT_GET_ALL_DOMAINS_STATS_ENFORCE_STATS);
+    unsigned int privflags = 0;
+    unsigned int requestedStats = stats;
+    unsigned int domflags = 0;
+    VIR_LOCK_GUARD lock = virObjectLockGuard(vm);
+    int rc;
+
+    if (flags & VIR_CONNECT_GET_ALL_DOMAINS_STATS_BACKING)
+        domflags |= QEMU_DOMAIN_STATS_BACKING;
+
+    if (qemuDomainGetStatsCheckSupport(&requestedStats, enforce, vm) < 0)
+        return -1;
+
+    if (qemuDomainGetStatsNeedMonitor(requestedStats))
+        privflags |= QEMU_DOMAIN_STATS_HAVE_JOB;
+
+    if (HAVE_JOB(privflags)) {
+        int rv;
+
+        if (flags & VIR_CONNECT_GET_ALL_DOMAINS_STATS_NOWAIT)
+            rv = virDomainObjBeginJobNowait(vm, VIR_JOB_QUERY);
+        else
+            rv = virDomainObjBeginJob(vm, VIR_JOB_QUERY);
+
+        if (rv == 0)
+            domflags |= QEMU_DOMAIN_STATS_HAVE_JOB;
+    }
+    /* else: without a job it's still possible to gather some data */
+
+    rc = qemuDomainGetStats(conn, vm, requestedStats, record, domflags);
+
+    if (HAVE_JOB(domflags))
+        virDomainObjEndJob(vm);
+
+    return rc;
+}
+
+
+/* State shared by one virConnectGetAllDomainStats call and the stats
+ * pool workers processing its domains. Workers may outlive the call
+ * if they exceed stats_domain_timeout, hence the reference counting. */
+typedef struct _qemuDomainGetStatsParallelData qemuDomainGetStatsParallelData;
+struct _qemuDomainGetStatsParallelData {
+    virMutex lock;
+    virCond cond;
+    unsigned int refs;
+
+    virConnectPtr conn;
+    unsigned int stats;
+    unsigned int flags;
+
+    size_t nvms;
+    size_t pending;
+    bool abandoned;  /* the API call has stopped waiting for results */
+    bool *done;
+    virDomainStatsRecordPtr *records;
+    virErrorPtr error;
+};
+
+typedef struct _qemuDomainGetStatsParallelJob qemuDomainGetStatsParallelJob;
+struct _qemuDomainGetStatsParallelJob {
+    qemuDomainGetStatsParallelData *data;
+    virDomainObj *vm;
+    size_t idx;
+};
+
+
+static void
+qemuDomainGetStatsRecordFree(virDomainStatsRecordPtr record)
+{
+    if (!record)
+        return;
+
+    virTypedParamsFree(record->params, record->nparams);
+    virObjectUnref(record->dom);
+    g_free(record);
+}
+
+
+static void
+qemuDomainGetStatsParallelDataUnref(qemuDomainGetStatsParallelData *data)
+{
+    size_t i;
+
+    VIR_WITH_MUTEX_LOCK_GUARD(&data->lock) {
+        if (--data->refs > 0)
+            return;
+    }
+
+    for (i = 0; i < data->nvms; i++)
+        qemuDomainGetStatsRecordFree(data->records[i]);
+    g_free(data->records);
+    g_free(data->done);
+    virFreeError(data->error);
+    virObjectUnref(data->conn);
+    virCondDestroy(&data->cond);
+    virMutexDestroy(&data->lock);
+    g_free(data);
+}
+
+
+static void
+qemuDomainGetStatsParallelWorker(void *jobdata,
+                                 void *opaque G_GNUC_UNUSED)
+{
+    qemuDomainGetStatsParallelJob *job = jobdata;
+    qemuDomainGetStatsParallelData *data = job->data;
+    virDomainStatsRecordPtr record = NULL;
+    int rc;
+
+    rc = qemuDomainGetStatsOne(data->conn, job->vm, data->stats,
+                               &record, data->flags);
+
+    VIR_WITH_MUTEX_LOCK_GUARD(&data->lock) {
+        if (data->abandoned) {
+            VIR_DEBUG("dropping late statistics of domain '%s'",
+                      job->vm->def->name);
+        } else {
+            if (rc < 0 && !data->error)
+                data->error = virSaveLastError();
+            data->records[job->idx] = g_steal_pointer(&record);
+            data->done[job->idx] = true;
+            data->pending--;
+            virCondSignal(&data->cond);
+        }
+    }
+
+    qemuDomainGetStatsRecordFree(record);
+    virObjectUnref(job->vm);
+    qemuDomainGetStatsParallelDataUnref(data);
+    g_free(job);
+}
+
+
+/**
+ * qemuDomainGetStatsParallelJobFree:
+ * @jobdata: job discarded by the stats pool
+ *
+ * Releases a job which was discarded without being run because the pool
+ * was drained. The domain is then reported with partial statistics.
+ */
+static void
+qemuDomainGetStatsParallelJobFree(void *jobdata)
+{
+    qemuDomainGetStatsParallelJob *job = jobdata;
+    qemuDomainGetStatsParallelData *data = job->data;
+
+    VIR_WITH_MUTEX_LOCK_GUARD(&data->lock) {
+        if (!data->abandoned) {
+            data->pending--;
+            virCondSignal(&data->cond);
+        }
+    }
+
+    virObjectUnref(job->vm);
+    qemuDomainGetStatsParallelDataUnref(data);
+    g_free(job);
+}
+
+
+/**
+ * qemuDomainGetStatsParallel:
+ *
+ * Dispatch gathering of statistics of @vms to the stats worker pool
+ * and wait for the results. If statistics of a domain are not
+ * gathered within stats_domain_timeout, the domain is reported with
+ * just the statistics which don't require a job.
+ *
+ * Returns number of records in @retStats or -1 on error.
+ */
+static int
+qemuDomainGetStatsParallel(virQEMUDriver *driver,
+                           virConnectPtr conn,
+                           virDomainObj **vms,
+                           size_t nvms,
+                           unsigned int stats,
+                           virDomainStatsRecordPtr **retStats,
+                           unsigned int flags)
+{
+    g_autoptr(virQEMUDriverConfig) cfg = virQEMUDriverGetConfig(driver);
+    qemuDomainGetStatsParallelData *data = g_new0(qemuDomainGetStatsParallelData, 1);
+    virDomainStatsRecordPtr *records = NULL;
+    unsigned long long deadline = 0;
+    size_t i;
+    int ret = -1;
+
+    if (virMutexInit(&data->lock) < 0) {
+        g_free(data);
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("cannot initialize mutex"));
+        return -1;
+    }
+    if (virCondInit(&data->cond) < 0) {
+        virMutexDestroy(&data->lock);
+        g_free(data);
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("cannot initialize condition"));
+        return -1;
+    }
+
+    data->refs = 1;
+    data->conn = virObjectRef(conn);
+    data->stats = stats;
+    data->flags = flags;
+    data->nvms = nvms;
+    data->done = g_new0(bool, nvms);
+    data->records = g_new0(virDomainStatsRecordPtr, nvms);
+
+    if (cfg->statsDomainTimeout > 0) {
+        if (virTimeMillisNow(&deadline) < 0)
+            goto cleanup;
+        deadline += cfg->statsDomainTimeout;
+    }
+
+    for (i = 0; i < nvms; i++) {
+        qemuDomainGetStatsParallelJob *job = g_new0(qemuDomainGetStatsParallelJob, 1);
+
+        job->data = data;
+        job->vm = virObjectRef(vms[i]);
+        job->idx = i;
+
+        VIR_WITH_MUTEX_LOCK_GUARD(&data->lock) {
+            data->refs++;
+            data->pending++;
+        }
+
+        if (virThreadPoolSendJob(driver->statsPool, 0, job) < 0) {
+            /* the pool is shutting down, do the work ourselves */
+            virResetLastError();
+            qemuDomainGetStatsParallelWorker(job, driver);
+        }
+    }
+
+    VIR_WITH_MUTEX_LOCK_GUARD(&data->lock) {
+        while (data->pending > 0) {
+            if (deadline == 0) {
+                ignore_value(virCondWait(&data->cond, &data->lock));
+            } else if (virCondWaitUntil(&data->cond, &data->lock, deadline) < 0) {
+                if (errno != ETIMEDOUT)
+                    continue;
+                break;
+            }
+        }
+
+        data->abandoned = true;
+
+        if (data->error) {
+            virSetError(data->error);
+            goto cleanup;
+        }
+
+        /* Keep the order of @vms as the serial code does */
+        records = g_new0(virDomainStatsRecordPtr, nvms + 1);
+        for (i = 0; i < nvms; i++) {
+            if (data->done[i])
+                records[i] = g_steal_pointer(&data->records[i]);
+        }
+    }
+
+    /* Report domains which timed out with whatever is available
+     * without a job in their slot. Worker threads may still be holding a
+     * job on them, but the object lock is not held while talking to
+     * QEMU. */
+    for (i = 0; i < nvms; i++) {
+        if (data->done[i])
+            continue;
+
+        VIR_WITH_OBJECT_LOCK_GUARD(vms[i]) {
+            unsigned int partialStats = stats;
+
+            VIR_DEBUG("statistics of domain '%s' not gathered within %u ms, reporting partial data",
+                      vms[i]->def->name, cfg->statsDomainTimeout);
+
+            ignore_value(qemuDomainGetStatsCheckSupport(&partialStats, false, vms[i]));
+            partialStats &= ~qemuDomainGetStatsMonitorTypes();
+
+            if (qemuDomainGetStats(conn, vms[i], partialStats,
+                                   &records[i], 0) < 0)
+                goto cleanup;
+        }
+    }
+
+    *retStats = g_steal_pointer(&records);
+    ret = nvms;
+
+ cleanup:
+    /* slots of domains not processed yet are empty */
+    if (records) {
+        for (i = 0; i < nvms; i++)
+            qemuDomainGetStatsRecordFree(records[i]);
+        g_free(records);
+    }
+    VIR_WITH_MUTEX_LOCK_GUARD(&data->lock) {
+        data->abandoned = true;
+    }
+    qemuDomainGetStatsParallelDataUnref(data);
+    return ret;
+}
+
+
 static int
 qemuConnectGetAllDomainStats(virConnectPtr conn,
                              virDomainPtr *doms,
@@ -18095,7 +18694,6 @@ qemuConnectGetAllDomainStats(virConnectPtr conn,
     virDomainObj **vms = NULL;
     size_t nvms;
     virDomainStatsRecordPtr *tmpstats = NULL;
-    bool enforce = !!(flags & VIR_CONNECT_GET_ALL_DOMAINS_STATS_ENFORCE_STATS);
     int nstats = 0;
     size_t i;
     int ret = -1;
@@ -18124,53 +18722,21 @@ qemuConnectGetAllDomainStats(virConnectPtr conn,
                                 lflags);
     }
 
-    tmpstats = g_new0(virDomainStatsRecordPtr, nvms + 1);
-
-    for (i = 0; i < nvms; i++) {
-        virDomainObj *vm = vms[i];
-        virDomainStatsRecordPtr tmp = NULL;
-        unsigned int privflags = 0;
-        unsigned int requestedStats = stats;
-        unsigned int domflags = 0;
-        int rc;
-
-        if (flags & VIR_CONNECT_GET_ALL_DOMAINS_STATS_BACKING)
-            domflags |= QEMU_DOMAIN_STATS_BACKING;
-
-        virObjectLock(vm);
-
-        if (qemuDomainGetStatsCheckSupport(&requestedStats, enforce, vm) < 0) {
-            virObjectUnlock(vm);
+    if (driver->statsPool && nvms > 1) {
+        if ((nstats = qemuDomainGetStatsParallel(driver, conn, vms, nvms,
+                                                 stats, &tmpstats, flags)) < 0)
             goto cleanup;
-        }
-
-        if (qemuDomainGetStatsNeedMonitor(requestedStats))
-            privflags |= QEMU_DOMAIN_STATS_HAVE_JOB;
+    } else {
+        tmpstats = g_new0(virDomainStatsRecordPtr, nvms + 1);
 
-        if (HAVE_JOB(privflags)) {
-            int rv;
+        for (i = 0; i < nvms; i++) {
+            virDomainStatsRecordPtr tmp = NULL;
 
-            if (flags & VIR_CONNECT_GET_ALL_DOMAINS_STATS_NOWAIT)
-                rv = virDomainObjBeginJobNowait(vm, VIR_JOB_QUERY);
-            else
-                rv = virDomainObjBeginJob(vm, VIR_JOB_QUERY);
+            if (qemuDomainGetStatsOne(conn, vms[i], stats, &tmp, flags) < 0)
+                goto cleanup;
 
-            if (rv == 0)
-                domflags |= QEMU_DOMAIN_STATS_HAVE_JOB;
+            tmpstats[nstats++] = tmp;
         }
-        /* else: without a job it's still possible to gather some data */
-
-        rc = qemuDomainGetStats(conn, vm, requestedStats, &tmp, domflags);
-
-        if (HAVE_JOB(domflags))
-            virDomainObjEndJob(vm);
-
-        virObjectUnlock(vm);
-
-        if (rc < 0)
-            goto cleanup;
-
-        tmpstats[nstats++] = tmp;
     }
 
     *retStats = g_steal_pointer(&tmpstats);
@@ -18954,6 +19520,8 @@ qemuDomainSetBlockThreshold(virDomainPtr dom,
 
     nodename = g_strdup(qemuBlockStorageSourceGetStorageNodename(src));
 
+    qemuDomainBlockNodeCacheInvalidate(vm);
+
     qemuDomainObjEnterMonitor(vm);
     rc = qemuMonitorSetBlockThreshold(priv->mon, nodename, threshold);
     qemuDomainObjExitMonitor(vm);
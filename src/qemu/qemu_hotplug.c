@@ -529,6 +529,8 @@ qemuDomainChangeMediaBlockdev(virDomainObj *vm,
     g_autofree char *nodename = NULL;
     int rc;
 
+    qemuDomainBlockNodeCacheInvalidate(vm);
+
     if (!virStorageSourceIsEmpty(oldsrc) &&
         !(oldbackend = qemuBlockStorageSourceChainDetachPrepareBlockdev(oldsrc)))
         return -1;
@@ -711,6 +713,8 @@ qemuDomainAttachDiskGeneric(virDomainObj *vm,
     g_autoptr(qemuSnapshotDiskContext) transientDiskSnapshotCtxt = NULL;
     bool origReadonly = disk->src->readonly;
 
+    qemuDomainBlockNodeCacheInvalidate(vm);
+
     if (!virStorageSourceIsEmpty(disk->src)) {
         if (disk->transient)
             disk->src->readonly = true;
@@ -4769,6 +4773,7 @@ qemuDomainRemoveDiskDevice(virQEMUDriver *driver,
     VIR_DEBUG("Removing disk %s from domain %p %s",
               disk->info.alias, vm, vm->def->name);
 
+    qemuDomainBlockNodeCacheInvalidate(vm);
 
     if (virStorageSourceGetActualType(disk->src) == VIR_STORAGE_TYPE_VHOST_USER) {
         char *chardevAlias = qemuDomainGetVhostUserChrAlias(disk->info.alias);
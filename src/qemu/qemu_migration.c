@@ -3411,7 +3411,7 @@ qemuMigrationDstPrepareActive(virQEMUDriver *driver,
         goto error;
 
     /* Save original migration parameters */
-    qemuDomainSaveStatus(vm);
+    qemuDomainSaveStatusSync(vm);
 
     /* Migrations using TLS need to add the "tls-creds-x509" object and
      * set the migration TLS parameters */
@@ -3617,7 +3617,7 @@ qemuMigrationDstPrepareFresh(virQEMUDriver *driver,
         goto stopjob;
 
     /* Domain starts inactive, even if the domain XML had an id field. */
-    vm->def->id = -1;
+    virDomainObjListSetID(driver->domains, vm, -1);
 
     if (!(flags & VIR_MIGRATE_OFFLINE)) {
         if (qemuMigrationDstPrepareActive(driver, vm, dconn, mig, st,
@@ -4245,7 +4245,7 @@ qemuMigrationSrcConfirmPhase(virQEMUDriver *driver,
             qemuDomainSetMaxMemLock(vm, 0, &priv->preMigrationMemlock);
         }
 
-        qemuDomainSaveStatus(vm);
+        qemuDomainSaveStatusSync(vm);
         virErrorRestore(&orig_err);
     }
 
@@ -4824,7 +4824,7 @@ qemuMigrationSrcStart(virDomainObj *vm,
                                         &priv->preMigrationMemlock) < 0)
                 return -1;
             /* Store the original memory locking limit */
-            qemuDomainSaveStatus(vm);
+            qemuDomainSaveStatusSync(vm);
         }
         return qemuMonitorMigrateToHost(priv->mon, migrateFlags,
                                         spec->dest.host.protocol,
@@ -5043,7 +5043,7 @@ qemuMigrationSrcRun(virQEMUDriver *driver,
         goto error;
 
     /* Save original migration parameters */
-    qemuDomainSaveStatus(vm);
+    qemuDomainSaveStatusSync(vm);
 
     if (flags & VIR_MIGRATE_TLS) {
         const char *hostname = NULL;
@@ -5088,7 +5088,7 @@ qemuMigrationSrcRun(virQEMUDriver *driver,
             goto error;
 
         /* Store the original memory locking limit */
-        qemuDomainSaveStatus(vm);
+        qemuDomainSaveStatusSync(vm);
     }
 
     if (storageMigration) {
@@ -6729,7 +6729,7 @@ qemuMigrationDstComplete(virQEMUDriver *driver,
         virObjectEventStateQueue(driver->domainEventState, event);
     }
 
-    qemuDomainSaveStatus(vm);
+    qemuDomainSaveStatusSync(vm);
 
     /* Guest is successfully running, so cancel previous auto destroy. There's
      * nothing to remove when we are resuming post-copy migration.
@@ -219,6 +219,8 @@ qemuMonitorDispose(void *obj)
     virResetError(&mon->lastError);
     virCondDestroy(&mon->notify);
     g_free(mon->buffer);
+    virJSONParserFree(mon->parser);
+    g_free(mon->msgs);
     g_free(mon->balloonpath);
     g_free(mon->domainName);
 }
@@ -257,6 +259,75 @@ qemuMonitorOpenUnix(const char *monitor)
 }
 
 
+/**
+ * qemuMonitorFindReplyMessage:
+ * @mon: monitor object
+ * @id: value of the "id" field of a reply, may be NULL
+ *
+ * Finds the message which a reply from QEMU belongs to. Only messages
+ * which were completely transmitted are considered. QEMU replies to
+ * commands in the order they were received, thus a reply without @id
+ * belongs to the oldest message waiting for a reply.
+ *
+ * Returns the message or NULL if no message is waiting for a reply or
+ * @id doesn't match any of the messages.
+ */
+qemuMonitorMessage *
+qemuMonitorFindReplyMessage(qemuMonitor *mon,
+                            const char *id)
+{
+    size_t i;
+
+    for (i = 0; i < mon->nmsgs; i++) {
+        qemuMonitorMessage *msg = mon->msgs[i];
+
+        if (msg->finished || msg->txOffset < msg->txLength)
+            continue;
+
+        if (!id || STREQ_NULLABLE(msg->id, id))
+            return msg;
+    }
+
+    return NULL;
+}
+
+
+/* Returns the first message which wasn't completely transmitted yet */
+static qemuMonitorMessage *
+qemuMonitorGetTransmitMessage(qemuMonitor *mon)
+{
+    size_t i;
+
+    for (i = 0; i < mon->nmsgs; i++) {
+        qemuMonitorMessage *msg = mon->msgs[i];
+
+        if (!msg->finished && msg->txOffset < msg->txLength)
+            return msg;
+    }
+
+    return NULL;
+}
+
+
+/* Marks all pending messages as finished so that their waiters can pick
+ * up the monitor error. Returns true if there was any such message. */
+static bool
+qemuMonitorFinishMessages(qemuMonitor *mon)
+{
+    bool ret = false;
+    size_t i;
+
+    for (i = 0; i < mon->nmsgs; i++) {
+        if (!mon->msgs[i]->finished) {
+            mon->msgs[i]->finished = true;
+            ret = true;
+        }
+    }
+
+    return ret;
+}
+
+
 /* This method processes data that has been received
  * from the monitor. Looking for async events and
  * replies/errors.
@@ -265,20 +336,12 @@ static int
 qemuMonitorIOProcess(qemuMonitor *mon)
 {
     int len;
-    qemuMonitorMessage *msg = NULL;
-
-    /* See if there's a message & whether its ready for its reply
-     * ie whether its completed writing all its data */
-    if (mon->msg && mon->msg->txOffset == mon->msg->txLength)
-        msg = mon->msg;
-
+    size_t i;
 
     PROBE_QUIET(QEMU_MONITOR_IO_PROCESS, "mon=%p buf=%s len=%zu",
                 mon, mon->buffer, mon->bufferOffset);
 
-    len = qemuMonitorJSONIOProcess(mon,
-                                   mon->buffer, mon->bufferOffset,
-                                   msg);
+    len = qemuMonitorJSONIOProcess(mon, mon->buffer, mon->bufferOffset);
     if (len < 0)
         return -1;
 
@@ -293,10 +356,14 @@ qemuMonitorIOProcess(qemuMonitor *mon)
         mon->bufferOffset = mon->bufferLength = 0;
     }
     /* As the monitor mutex was unlocked in qemuMonitorJSONIOProcess()
-     * while dealing with qemu event, mon->msg could be changed which
-     * means the above 'msg' may be invalid, thus we use 'mon->msg' here */
-    if (mon->msg && mon->msg->finished)
-        virCondBroadcast(&mon->notify);
+     * while dealing with qemu event, mon->msgs could be changed, thus
+     * look for finished messages only now */
+    for (i = 0; i < mon->nmsgs; i++) {
+        if (mon->msgs[i]->finished) {
+            virCondBroadcast(&mon->notify);
+            break;
+        }
+    }
     return len;
 }
 
@@ -321,29 +388,30 @@ qemuMonitorIOWriteWithFD(qemuMonitor *mon,
 static int
 qemuMonitorIOWrite(qemuMonitor *mon)
 {
+    qemuMonitorMessage *msg;
     int done;
     const char *buf;
     size_t len;
 
-    /* If no active message, or fully transmitted, the no-op */
-    if (!mon->msg || mon->msg->txOffset == mon->msg->txLength)
+    /* If no message is waiting to be transmitted, the no-op */
+    if (!(msg = qemuMonitorGetTransmitMessage(mon)))
         return 0;
 
-    buf = mon->msg->txBuffer + mon->msg->txOffset;
-    len = mon->msg->txLength - mon->msg->txOffset;
-    if (mon->msg->txFD == -1)
+    buf = msg->txBuffer + msg->txOffset;
+    len = msg->txLength - msg->txOffset;
+    if (msg->txFD == -1)
         done = write(mon->fd, buf, len); /* sc_avoid_write */
     else
-        done = qemuMonitorIOWriteWithFD(mon, buf, len, mon->msg->txFD);
+        done = qemuMonitorIOWriteWithFD(mon, buf, len, msg->txFD);
 
     PROBE(QEMU_MONITOR_IO_WRITE,
           "mon=%p buf=%s len=%zu ret=%d errno=%d",
           mon, buf, len, done, done < 0 ? errno : 0);
 
-    if (mon->msg->txFD != -1) {
+    if (msg->txFD != -1) {
         PROBE(QEMU_MONITOR_IO_SEND_FD,
               "mon=%p fd=%d ret=%d errno=%d",
-              mon, mon->msg->txFD, done, done < 0 ? errno : 0);
+              mon, msg->txFD, done, done < 0 ? errno : 0);
     }
 
     if (done < 0) {
@@ -354,7 +422,7 @@ qemuMonitorIOWrite(qemuMonitor *mon)
                              _("Unable to write to monitor"));
         return -1;
     }
-    mon->msg->txOffset += done;
+    msg->txOffset += done;
     return done;
 }
 
@@ -372,15 +440,24 @@ qemuMonitorIORead(qemuMonitor *mon)
     int ret = 0;
 
     if (avail < 1024) {
+        size_t grow;
+
         if (mon->bufferLength >= QEMU_MONITOR_MAX_RESPONSE) {
             virReportError(VIR_ERR_INTERNAL_ERROR,
                            _("QEMU monitor reply exceeds buffer size (%1$d bytes)"),
                            QEMU_MONITOR_MAX_RESPONSE);
             return -1;
         }
-        VIR_REALLOC_N(mon->buffer, mon->bufferLength + 1024);
-        mon->bufferLength += 1024;
-        avail += 1024;
+
+        /* Grow the buffer geometrically so that large replies such as
+         * 'query-qmp-schema' don't require a reallocation per kiB read */
+        grow = MAX(1024, mon->bufferLength);
+        if (mon->bufferLength + grow > QEMU_MONITOR_MAX_RESPONSE)
+            grow = QEMU_MONITOR_MAX_RESPONSE - mon->bufferLength;
+
+        VIR_REALLOC_N(mon->buffer, mon->bufferLength + grow);
+        mon->bufferLength += grow;
+        avail += grow;
     }
 
     /* Read as much as we can get into our buffer,
@@ -515,12 +592,10 @@ qemuMonitorIO(GSocket *socket G_GNUC_UNUSED,
 
         VIR_DEBUG("Error on monitor %s mon=%p vm=%p name=%s",
                   NULLSTR(mon->lastError.message), mon, mon->vm, mon->domainName);
-        /* If IO process resulted in an error & we have a message,
-         * then wakeup that waiter */
-        if (mon->msg && !mon->msg->finished) {
-            mon->msg->finished = true;
-            virCondSignal(&mon->notify);
-        }
+        /* If IO process resulted in an error & we have messages,
+         * then wakeup their waiters */
+        if (qemuMonitorFinishMessages(mon))
+            virCondBroadcast(&mon->notify);
     }
 
     qemuMonitorUpdateWatch(mon);
@@ -533,7 +608,7 @@ qemuMonitorIO(GSocket *socket G_GNUC_UNUSED,
         virDomainObj *vm = mon->vm;
 
         /* Make sure anyone waiting wakes up now */
-        virCondSignal(&mon->notify);
+        virCondBroadcast(&mon->notify);
         virObjectUnlock(mon);
         VIR_DEBUG("Triggering EOF callback mon=%p vm=%p name=%s",
                   mon, mon->vm, mon->domainName);
@@ -544,7 +619,7 @@ qemuMonitorIO(GSocket *socket G_GNUC_UNUSED,
         virDomainObj *vm = mon->vm;
 
         /* Make sure anyone waiting wakes up now */
-        virCondSignal(&mon->notify);
+        virCondBroadcast(&mon->notify);
         virObjectUnlock(mon);
         VIR_DEBUG("Triggering error callback mon=%p vm=%p name=%s",
                   mon, mon->vm, mon->domainName);
@@ -596,6 +671,7 @@ qemuMonitorOpenInternal(virDomainObj *vm,
     mon->vm = virObjectRef(vm);
     mon->domainName = g_strdup(NULLSTR(vm->def->name));
     mon->waitGreeting = true;
+    mon->parser = virJSONParserNew();
     mon->cb = cb;
 
     if (priv) {
@@ -710,7 +786,7 @@ qemuMonitorRegister(qemuMonitor *mon)
     if (mon->lastError.code == VIR_ERR_OK) {
         cond |= G_IO_IN;
 
-        if ((mon->msg && mon->msg->txOffset < mon->msg->txLength) &&
+        if (qemuMonitorGetTransmitMessage(mon) &&
             !mon->waitGreeting)
             cond |= G_IO_OUT;
     }
@@ -767,7 +843,7 @@ qemuMonitorClose(qemuMonitor *mon)
     /* In case another thread is waiting for its monitor command to be
      * processed, we need to wake it up with appropriate error set.
      */
-    if (mon->msg) {
+    if (mon->nmsgs > 0) {
         if (mon->lastError.code == VIR_ERR_OK) {
             virErrorPtr err;
 
@@ -781,8 +857,8 @@ qemuMonitorClose(qemuMonitor *mon)
             else
                 virResetLastError();
         }
-        mon->msg->finished = true;
-        virCondSignal(&mon->notify);
+        qemuMonitorFinishMessages(mon);
+        virCondBroadcast(&mon->notify);
     }
 
     /* Propagate existing monitor error in case the current thread has no
@@ -811,11 +887,26 @@ qemuMonitorResetCommandID(qemuMonitor *mon)
 }
 
 
+/**
+ * qemuMonitorSendBatch:
+ * @mon: monitor object
+ * @msgs: messages to send
+ * @nmsgs: number of messages in @msgs
+ *
+ * Queues all of @msgs for transmission at once and waits until all of
+ * them get their reply, so that independent commands need only a single
+ * round trip to QEMU. Commands are executed by QEMU in the order of
+ * @msgs.
+ *
+ * Returns 0 if all replies were received, -1 on monitor error.
+ */
 int
-qemuMonitorSend(qemuMonitor *mon,
-                qemuMonitorMessage *msg)
+qemuMonitorSendBatch(qemuMonitor *mon,
+                     qemuMonitorMessage **msgs,
+                     size_t nmsgs)
 {
     int ret = -1;
+    size_t i;
 
     /* Check whether qemu quit unexpectedly */
     if (mon->lastError.code != VIR_ERR_OK) {
@@ -830,18 +921,22 @@ qemuMonitorSend(qemuMonitor *mon,
         return -1;
     }
 
-    mon->msg = msg;
-    qemuMonitorUpdateWatch(mon);
+    for (i = 0; i < nmsgs; i++) {
+        PROBE(QEMU_MONITOR_SEND_MSG,
+              "mon=%p msg=%s fd=%d",
+              mon, msgs[i]->txBuffer, msgs[i]->txFD);
 
-    PROBE(QEMU_MONITOR_SEND_MSG,
-          "mon=%p msg=%s fd=%d",
-          mon, mon->msg->txBuffer, mon->msg->txFD);
+        VIR_APPEND_ELEMENT_COPY(mon->msgs, mon->nmsgs, msgs[i]);
+    }
+    qemuMonitorUpdateWatch(mon);
 
-    while (!mon->msg->finished) {
-        if (virCondWait(&mon->notify, &mon->parent.lock) < 0) {
-            virReportError(VIR_ERR_INTERNAL_ERROR,
-                           _("Unable to wait on monitor condition (vm='%1$s')"), mon->domainName);
-            goto cleanup;
+    for (i = 0; i < nmsgs; i++) {
+        while (!msgs[i]->finished) {
+            if (virCondWait(&mon->notify, &mon->parent.lock) < 0) {
+                virReportError(VIR_ERR_INTERNAL_ERROR,
+                               _("Unable to wait on monitor condition (vm='%1$s')"), mon->domainName);
+                goto cleanup;
+            }
         }
     }
 
@@ -855,13 +950,30 @@ qemuMonitorSend(qemuMonitor *mon,
     ret = 0;
 
  cleanup:
-    mon->msg = NULL;
+    for (i = 0; i < nmsgs; i++) {
+        size_t j;
+
+        for (j = 0; j < mon->nmsgs; j++) {
+            if (mon->msgs[j] == msgs[i]) {
+                VIR_DELETE_ELEMENT(mon->msgs, j, mon->nmsgs);
+                break;
+            }
+        }
+    }
     qemuMonitorUpdateWatch(mon);
 
     return ret;
 }
 
 
+int
+qemuMonitorSend(qemuMonitor *mon,
+                qemuMonitorMessage *msg)
+{
+    return qemuMonitorSendBatch(mon, &msg, 1);
+}
+
+
 /**
  * This function returns a new virError object; the caller is responsible
  * for freeing it.
@@ -448,6 +448,9 @@ int qemuMonitorSetLink(qemuMonitor *mon,
 char *qemuMonitorNextCommandID(qemuMonitor *mon);
 int qemuMonitorSend(qemuMonitor *mon,
                     qemuMonitorMessage *msg) ATTRIBUTE_MOCKABLE;
+int qemuMonitorSendBatch(qemuMonitor *mon,
+                         qemuMonitorMessage **msgs,
+                         size_t nmsgs) ATTRIBUTE_MOCKABLE;
 int qemuMonitorUpdateVideoMemorySize(qemuMonitor *mon,
                                      virDomainVideoDef *video,
                                      const char *videoName)
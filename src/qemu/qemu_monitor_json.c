@@ -47,7 +47,6 @@
 
 VIR_LOG_INIT("qemu.qemu_monitor_json");
 
-#define LINE_ENDING "\r\n"
 
 static void qemuMonitorJSONHandleShutdown(qemuMonitor *mon, virJSONValue *data);
 static void qemuMonitorJSONHandleReset(qemuMonitor *mon, virJSONValue *data);
@@ -183,18 +182,25 @@ qemuMonitorJSONIOProcessEvent(qemuMonitor *mon,
     return 0;
 }
 
+/**
+ * qemuMonitorJSONIOProcessValue:
+ * @mon: monitor object
+ * @value: parsed message, stolen if it's a reply to a command
+ * @line: text of the message, for debugging and error reporting
+ *
+ * Dispatches one complete message received from QEMU. Replies are matched
+ * to the commands in flight by their "id".
+ */
 int
-qemuMonitorJSONIOProcessLine(qemuMonitor *mon,
-                             const char *line,
-                             qemuMonitorMessage *msg)
+qemuMonitorJSONIOProcessValue(qemuMonitor *mon,
+                              virJSONValue **value,
+                              const char *line)
 {
-    g_autoptr(virJSONValue) obj = NULL;
+    virJSONValue *obj = *value;
+    qemuMonitorMessage *msg;
 
     VIR_DEBUG("Line [%s]", line);
 
-    if (!(obj = virJSONValueFromString(line)))
-        return -1;
-
     if (virJSONValueGetType(obj) != VIR_JSON_TYPE_OBJECT) {
         virReportError(VIR_ERR_INTERNAL_ERROR,
                        _("Parsed JSON reply '%1$s' isn't an object"), line);
@@ -209,12 +215,19 @@ qemuMonitorJSONIOProcessLine(qemuMonitor *mon,
         return qemuMonitorJSONIOProcessEvent(mon, obj);
     } else if (virJSONValueObjectHasKey(obj, "error") ||
                virJSONValueObjectHasKey(obj, "return")) {
+        const char *id = virJSONValueObjectGetString(obj, "id");
+
         PROBE(QEMU_MONITOR_RECV_REPLY,
               "mon=%p reply=%s", mon, line);
+        msg = qemuMonitorFindReplyMessage(mon, id);
         if (msg) {
-            msg->rxObject = g_steal_pointer(&obj);
+            msg->rxObject = g_steal_pointer(value);
             msg->finished = 1;
             return 0;
+        } else if (id) {
+            virReportError(VIR_ERR_INTERNAL_ERROR,
+                           _("JSON reply '%1$s' doesn't match any command"),
+                           line);
         } else {
             virReportError(VIR_ERR_INTERNAL_ERROR,
                            _("Unexpected JSON reply '%1$s'"), line);
@@ -227,33 +240,84 @@ qemuMonitorJSONIOProcessLine(qemuMonitor *mon,
     return -1;
 }
 
+/*
+ * The monitor buffer is fed into the incremental JSON parser as it
+ * arrives, so that a reply spanning many reads is parsed only once rather
+ * than being rescanned for the line ending after every read and then
+ * parsed again as a whole. Messages don't need to be terminated by a
+ * line ending.
+ */
 int qemuMonitorJSONIOProcess(qemuMonitor *mon,
                              const char *data,
-                             size_t len,
-                             qemuMonitorMessage *msg)
+                             size_t len)
 {
-    int used = 0;
+    size_t used = 0;
     /*VIR_DEBUG("Data %d bytes [%s]", len, data);*/
 
-    while (used < len) {
-        char *nl = strstr(data + used, LINE_ENDING);
+    while (mon->bufferParsed < len) {
+        g_autoptr(virJSONValue) obj = NULL;
+        g_autofree char *line = NULL;
+        size_t consumed;
+        int rc;
 
-        if (nl) {
-            int got = nl - (data + used);
-            g_autofree char *line = g_strndup(data + used, got);
+        rc = virJSONParserFeed(mon->parser,
+                               data + mon->bufferParsed,
+                               len - mon->bufferParsed,
+                               &consumed, &obj);
+        mon->bufferParsed += consumed;
 
-            used += got + strlen(LINE_ENDING);
-            line[got] = '\0'; /* kill \n */
-            if (qemuMonitorJSONIOProcessLine(mon, line, msg) < 0)
-                return -1;
-        } else {
+        if (rc < 0)
+            goto error;
+
+        if (rc == 0)
             break;
-        }
+
+        while (used < mon->bufferParsed && g_ascii_isspace(data[used]))
+            used++;
+
+        line = g_strndup(data + used, mon->bufferParsed - used);
+        used = mon->bufferParsed;
+
+        if (qemuMonitorJSONIOProcessValue(mon, &obj, line) < 0)
+            goto error;
     }
 
+    /* the caller drops the processed messages from the buffer */
+    mon->bufferParsed -= used;
+
     return used;
+
+ error:
+    virJSONParserReset(mon->parser);
+    mon->bufferParsed = 0;
+    return -1;
 }
 
+/* Assigns an ID to @cmd and formats it for sending into @buf */
+static int
+qemuMonitorJSONCommandFormat(qemuMonitor *mon,
+                             virJSONValue *cmd,
+                             virBuffer *buf,
+                             char **id)
+{
+    if (virJSONValueObjectHasKey(cmd, "execute")) {
+        *id = qemuMonitorNextCommandID(mon);
+
+        if (virJSONValueObjectAppendString(cmd, "id", *id) < 0) {
+            virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                           _("Unable to append command 'id' string"));
+            return -1;
+        }
+    }
+
+    if (virJSONValueToBuffer(cmd, buf, false) < 0)
+        return -1;
+    virBufferAddLit(buf, "\r\n");
+
+    return 0;
+}
+
+
 static int
 qemuMonitorJSONCommandWithFd(qemuMonitor *mon,
                              virJSONValue *cmd,
@@ -263,23 +327,14 @@ qemuMonitorJSONCommandWithFd(qemuMonitor *mon,
     int ret = -1;
     qemuMonitorMessage msg = { 0 };
     g_auto(virBuffer) cmdbuf = VIR_BUFFER_INITIALIZER;
+    g_autofree char *id = NULL;
 
     *reply = NULL;
 
-    if (virJSONValueObjectHasKey(cmd, "execute")) {
-        g_autofree char *id = qemuMonitorNextCommandID(mon);
-
-        if (virJSONValueObjectAppendString(cmd, "id", id) < 0) {
-            virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
-                           _("Unable to append command 'id' string"));
-            return -1;
-        }
-    }
-
-    if (virJSONValueToBuffer(cmd, &cmdbuf, false) < 0)
+    if (qemuMonitorJSONCommandFormat(mon, cmd, &cmdbuf, &id) < 0)
         return -1;
-    virBufferAddLit(&cmdbuf, "\r\n");
 
+    msg.id = id;
     msg.txLength = virBufferUse(&cmdbuf);
     msg.txBuffer = virBufferCurrentContent(&cmdbuf);
     msg.txFD = scm_fd;
@@ -308,6 +363,77 @@ qemuMonitorJSONCommand(qemuMonitor *mon,
     return qemuMonitorJSONCommandWithFd(mon, cmd, -1, reply);
 }
 
+
+/**
+ * qemuMonitorJSONCommandBatch:
+ * @mon: monitor object
+ * @cmds: commands to execute
+ * @replies: filled with the replies to @cmds
+ * @ncmds: number of commands in @cmds and @replies
+ *
+ * Sends all of @cmds to QEMU at once and waits for all of their replies,
+ * which saves a round trip per command compared to qemuMonitorJSONCommand.
+ * The commands must not depend on each other. As with
+ * qemuMonitorJSONCommand the caller has to check the individual replies
+ * for errors and free them.
+ *
+ * Returns 0 if all replies were received, -1 otherwise.
+ */
+int
+qemuMonitorJSONCommandBatch(qemuMonitor *mon,
+                            virJSONValue **cmds,
+                            virJSONValue **replies,
+                            size_t ncmds)
+{
+    g_autofree qemuMonitorMessage *msgs = g_new0(qemuMonitorMessage, ncmds);
+    g_autofree qemuMonitorMessage **msgptrs = g_new0(qemuMonitorMessage *, ncmds);
+    g_autoptr(GPtrArray) data = g_ptr_array_new_with_free_func(g_free);
+    size_t i;
+
+    for (i = 0; i < ncmds; i++) {
+        g_auto(virBuffer) cmdbuf = VIR_BUFFER_INITIALIZER;
+        g_autofree char *id = NULL;
+
+        replies[i] = NULL;
+
+        if (qemuMonitorJSONCommandFormat(mon, cmds[i], &cmdbuf, &id) < 0)
+            return -1;
+
+        msgs[i].id = id;
+        msgs[i].txLength = virBufferUse(&cmdbuf);
+        msgs[i].txBuffer = virBufferContentAndReset(&cmdbuf);
+        msgs[i].txFD = -1;
+        msgptrs[i] = &msgs[i];
+
+        g_ptr_array_add(data, (char *) msgs[i].txBuffer);
+        g_ptr_array_add(data, g_steal_pointer(&id));
+    }
+
+    if (ncmds == 0)
+        return 0;
+
+    if (qemuMonitorSendBatch(mon, msgptrs, ncmds) < 0)
+        goto error;
+
+    for (i = 0; i < ncmds; i++) {
+        if (!msgs[i].rxObject) {
+            virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                           _("Missing monitor reply object"));
+            goto error;
+        }
+    }
+
+    for (i = 0; i < ncmds; i++)
+        replies[i] = msgs[i].rxObject;
+
+    return 0;
+
+ error:
+    for (i = 0; i < ncmds; i++)
+        virJSONValueFree(msgs[i].rxObject);
+    return -1;
+}
+
 /* Ignoring OOM in this method, since we're already reporting
  * a more important error
  *
@@ -2492,12 +2618,40 @@ qemuMonitorJSONGetAllBlockStatsInfo(qemuMonitor *mon,
     int nstats = 0;
     int rc;
     size_t i;
-    g_autoptr(virJSONValue) blockstatsDevices = NULL;
-    g_autoptr(virJSONValue) blockstatsNodes = NULL;
+    g_autoptr(virJSONValue) cmdDevices = NULL;
+    g_autoptr(virJSONValue) cmdNodes = NULL;
+    g_autoptr(virJSONValue) replyDevices = NULL;
+    g_autoptr(virJSONValue) replyNodes = NULL;
+    virJSONValue *cmds[2];
+    virJSONValue *replies[2];
+    virJSONValue *blockstatsDevices;
+    virJSONValue *blockstatsNodes;
+
+    /* both queries are independent, issue them in a single round trip */
+    if (!(cmdDevices = qemuMonitorJSONMakeCommand("query-blockstats",
+                                                  "B:query-nodes", false,
+                                                  NULL)) ||
+        !(cmdNodes = qemuMonitorJSONMakeCommand("query-blockstats",
+                                                "B:query-nodes", true,
+                                                NULL)))
+        return -1;
+
+    cmds[0] = cmdDevices;
+    cmds[1] = cmdNodes;
 
-    if (!(blockstatsDevices = qemuMonitorJSONQueryBlockstats(mon, false)))
+    if (qemuMonitorJSONCommandBatch(mon, cmds, replies, G_N_ELEMENTS(cmds)) < 0)
         return -1;
 
+    replyDevices = replies[0];
+    replyNodes = replies[1];
+
+    if (qemuMonitorJSONCheckReply(cmdDevices, replyDevices, VIR_JSON_TYPE_ARRAY) < 0 ||
+        qemuMonitorJSONCheckReply(cmdNodes, replyNodes, VIR_JSON_TYPE_ARRAY) < 0)
+        return -1;
+
+    blockstatsDevices = virJSONValueObjectGetArray(replyDevices, "return");
+    blockstatsNodes = virJSONValueObjectGetArray(replyNodes, "return");
+
     for (i = 0; i < virJSONValueArraySize(blockstatsDevices); i++) {
         virJSONValue *dev = virJSONValueArrayGet(blockstatsDevices, i);
         const char *dev_name;
@@ -2522,9 +2676,6 @@ qemuMonitorJSONGetAllBlockStatsInfo(qemuMonitor *mon,
             nstats = rc;
     }
 
-    if (!(blockstatsNodes = qemuMonitorJSONQueryBlockstats(mon, true)))
-        return -1;
-
     for (i = 0; i < virJSONValueArraySize(blockstatsNodes); i++) {
         virJSONValue *dev = virJSONValueArrayGet(blockstatsNodes, i);
 
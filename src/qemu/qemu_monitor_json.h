@@ -28,16 +28,21 @@
 #include "util/virgic.h"
 
 int
-qemuMonitorJSONIOProcessLine(qemuMonitor *mon,
-                             const char *line,
-                             qemuMonitorMessage *msg)
+qemuMonitorJSONIOProcessValue(qemuMonitor *mon,
+                              virJSONValue **value,
+                              const char *line)
     ATTRIBUTE_MOCKABLE;
 
 int
 qemuMonitorJSONIOProcess(qemuMonitor *mon,
                          const char *data,
-                         size_t len,
-                         qemuMonitorMessage *msg);
+                         size_t len);
+
+int
+qemuMonitorJSONCommandBatch(qemuMonitor *mon,
+                            virJSONValue **cmds,
+                            virJSONValue **replies,
+                            size_t ncmds);
 
 int
 qemuMonitorJSONHumanCommand(qemuMonitor *mon,
@@ -28,6 +28,9 @@
 
 
 struct _qemuMonitorMessage {
+    /* ID of the command used to match its reply, may be NULL */
+    const char *id;
+
     int txFD;
 
     const char *txBuffer;
@@ -58,9 +61,11 @@ struct _qemuMonitor {
 
     qemuMonitorCallbacks *cb;
 
-    /* If there's a command being processed this will be
-     * non-NULL */
-    qemuMonitorMessage *msg;
+    /* Commands being processed in the order they were submitted. Multiple
+     * commands may be in flight, their replies are matched by the command
+     * ID */
+    qemuMonitorMessage **msgs;
+    size_t nmsgs;
 
     /* Buffer incoming data ready for Text/QMP monitor
      * code to process & find message boundaries */
@@ -68,6 +73,12 @@ struct _qemuMonitor {
     size_t bufferLength;
     char *buffer;
 
+    /* Incremental parser of QMP messages. The first @bufferParsed bytes
+     * of @buffer were already fed into it but don't form a complete
+     * message yet */
+    virJSONParser *parser;
+    size_t bufferParsed;
+
     /* If anything went wrong, this will be fed back
      * the next monitor msg */
     virError lastError;
@@ -96,6 +107,10 @@ struct _qemuMonitor {
 void
 qemuMonitorResetCommandID(qemuMonitor *mon);
 
+qemuMonitorMessage *
+qemuMonitorFindReplyMessage(qemuMonitor *mon,
+                            const char *id);
+
 int
 qemuMonitorIOWriteWithFD(qemuMonitor *mon,
                          const char *data,
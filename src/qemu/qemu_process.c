@@ -1449,6 +1449,9 @@ qemuProcessHandleBlockThreshold(qemuMonitor *mon G_GNUC_UNUSED,
               "threshold '%llu' exceeded by '%llu'",
               nodename, vm, vm->def->name, threshold, excess);
 
+    /* qemu clears the threshold once it's reached */
+    qemuDomainBlockNodeCacheInvalidate(vm);
+
     if ((disk = qemuDomainDiskLookupByNodename(vm->def, priv->backup, nodename, &src))) {
         if (virStorageSourceIsLocalStorage(src))
             path = src->path;
@@ -1615,7 +1618,7 @@ qemuProcessHandleMigrationStatus(qemuMonitor *mon G_GNUC_UNUSED,
             event = virDomainEventLifecycleNewFromObj(vm,
                                                       VIR_DOMAIN_EVENT_SUSPENDED,
                                                       VIR_DOMAIN_EVENT_SUSPENDED_POSTCOPY);
-            qemuDomainSaveStatus(vm);
+            qemuDomainSaveStatusSync(vm);
         }
         break;
 
@@ -1626,7 +1629,7 @@ qemuProcessHandleMigrationStatus(qemuMonitor *mon G_GNUC_UNUSED,
              * the source as it is just waiting for the Finish phase to end.
              * Thus we need to handle the event here. */
             qemuMigrationSrcPostcopyFailed(vm);
-            qemuDomainSaveStatus(vm);
+            qemuDomainSaveStatusSync(vm);
         }
         break;
 
@@ -5881,7 +5884,7 @@ qemuProcessInit(virQEMUDriver *driver,
             return -1;
         }
     } else {
-        vm->def->id = qemuDriverAllocateID(driver);
+        virDomainObjListSetID(driver->domains, vm, qemuDriverAllocateID(driver));
         qemuDomainSetFakeReboot(vm, false);
         virDomainObjSetState(vm, VIR_DOMAIN_PAUSED, VIR_DOMAIN_PAUSED_STARTING_UP);
 
@@ -8110,7 +8113,7 @@ qemuProcessLaunch(virConnectPtr conn,
     }
 
     VIR_DEBUG("Writing early domain status to disk");
-    if (virDomainObjSave(vm, driver->xmlopt, cfg->stateDir) < 0)
+    if (qemuDomainSaveStatusSync(vm) < 0)
         goto cleanup;
 
     VIR_DEBUG("Waiting for handshake from child");
@@ -8408,8 +8411,6 @@ qemuProcessFinishStartup(virQEMUDriver *driver,
                          bool startCPUs,
                          virDomainPausedReason pausedReason)
 {
-    g_autoptr(virQEMUDriverConfig) cfg = virQEMUDriverGetConfig(driver);
-
     if (startCPUs) {
         VIR_DEBUG("Starting domain CPUs");
         if (qemuProcessStartCPUs(driver, vm,
@@ -8425,7 +8426,7 @@ qemuProcessFinishStartup(virQEMUDriver *driver,
     }
 
     VIR_DEBUG("Writing domain status to disk");
-    if (virDomainObjSave(vm, driver->xmlopt, cfg->stateDir) < 0)
+    if (qemuDomainSaveStatusSync(vm) < 0)
         return -1;
 
     if (qemuProcessStartHook(driver, vm,
@@ -8990,7 +8991,7 @@ qemuProcessStop(virDomainObj *vm,
      * entering the destroy job and this point where the active "flag" is
      * cleared.
      */
-    vm->def->id = -1;
+    virDomainObjListSetID(driver->domains, vm, -1);
     priv->beingDestroyed = false;
 
     /* No unlocking of @vm after this point until whole cleanup is done. */
@@ -9453,18 +9454,192 @@ qemuProcessRefreshCPU(virQEMUDriver *driver,
 }
 
 
+/* Maximum time in seconds to wait for another reconnect thread probing the
+ * machine types of the same QEMU binary before probing them ourselves. */
+#define QEMU_PROCESS_RECONNECT_PROBE_WAIT 30
+
+/* Data shared by all threads reconnecting to running domains on startup */
+typedef struct _qemuProcessReconnectShared qemuProcessReconnectShared;
+struct _qemuProcessReconnectShared {
+    virMutex lock;
+    virCond cond;
+
+    /* QEMU binary identity -> virQEMUCaps with machine types, the value
+     * is NULL while the machine types are being probed */
+    GHashTable *machineTypes;
+
+    size_t refs; /* reconnect threads + the thread starting them */
+    size_t ndomains;
+    long long start;
+};
+
+
+static qemuProcessReconnectShared *
+qemuProcessReconnectSharedNew(void)
+{
+    qemuProcessReconnectShared *shared = g_new0(qemuProcessReconnectShared, 1);
+
+    if (virMutexInit(&shared->lock) < 0) {
+        g_free(shared);
+        return NULL;
+    }
+
+    if (virCondInit(&shared->cond) < 0) {
+        virMutexDestroy(&shared->lock);
+        g_free(shared);
+        return NULL;
+    }
+
+    shared->machineTypes = virHashNew(virObjectUnref);
+    shared->refs = 1;
+    shared->start = g_get_monotonic_time();
+
+    return shared;
+}
+
+
+static void
+qemuProcessReconnectSharedRelease(qemuProcessReconnectShared *shared)
+{
+    if (!shared)
+        return;
+
+    VIR_WITH_MUTEX_LOCK_GUARD(&shared->lock) {
+        if (--shared->refs > 0)
+            return;
+    }
+
+    VIR_INFO("Reconnected to %zu running domains in %lld ms",
+             shared->ndomains,
+             (g_get_monotonic_time() - shared->start) / 1000);
+
+    g_clear_pointer(&shared->machineTypes, g_hash_table_unref);
+    virCondDestroy(&shared->cond);
+    virMutexDestroy(&shared->lock);
+    g_free(shared);
+}
+
+
+/**
+ * qemuProcessReconnectMachineTypesKey:
+ *
+ * Returns a string identifying the QEMU binary running @vm along with the
+ * virt type of @vm, or NULL if the binary can't be identified. Using the
+ * inode of the process' executable rather than the path makes sure
+ * domains started before and after QEMU was upgraded don't share data.
+ */
+static char *
+qemuProcessReconnectMachineTypesKey(virDomainObj *vm)
+{
+    g_autofree char *exe = g_strdup_printf("/proc/%lld/exe", (long long)vm->pid);
+    struct stat sb;
+
+    if (stat(exe, &sb) < 0)
+        return NULL;
+
+    return g_strdup_printf("%llu:%llu:%lld:%s",
+                           (unsigned long long)sb.st_dev,
+                           (unsigned long long)sb.st_ino,
+                           (long long)sb.st_mtime,
+                           virDomainVirtTypeToString(vm->def->virtType));
+}
+
+
+/**
+ * qemuProcessReconnectSharedLookup:
+ *
+ * Copies machine types probed by another reconnect thread for @key into
+ * @qemuCaps and returns true. If they were not probed yet, the caller is
+ * made responsible for probing them and false is returned. The caller then
+ * has to call qemuProcessReconnectSharedStore.
+ */
+static bool
+qemuProcessReconnectSharedLookup(qemuProcessReconnectShared *shared,
+                                 const char *key,
+                                 virQEMUCaps *qemuCaps,
+                                 virDomainVirtType virtType)
+{
+    VIR_LOCK_GUARD lock = virLockGuardLock(&shared->lock);
+    unsigned long long deadline;
+    virQEMUCaps *cached;
+
+    if (virTimeMillisNow(&deadline) < 0)
+        return false;
+    deadline += QEMU_PROCESS_RECONNECT_PROBE_WAIT * 1000ull;
+
+    while (virHashHasEntry(shared->machineTypes, key)) {
+        if ((cached = virHashLookup(shared->machineTypes, key))) {
+            virQEMUCapsCopyMachineTypes(qemuCaps, cached, virtType);
+            return true;
+        }
+
+        /* Another thread is probing the same binary. Don't wait forever
+         * though, its QEMU may not be responding. */
+        if (virCondWaitUntil(&shared->cond, &shared->lock, deadline) < 0)
+            return false;
+    }
+
+    ignore_value(virHashAddEntry(shared->machineTypes, key, NULL));
+    return false;
+}
+
+
+static void
+qemuProcessReconnectSharedStore(qemuProcessReconnectShared *shared,
+                                const char *key,
+                                virQEMUCaps *qemuCaps,
+                                virDomainVirtType virtType,
+                                bool success)
+{
+    VIR_LOCK_GUARD lock = virLockGuardLock(&shared->lock);
+
+    if (success) {
+        g_autoptr(virQEMUCaps) cached = virQEMUCapsNew();
+
+        virQEMUCapsCopyMachineTypes(cached, qemuCaps, virtType);
+        if (virHashUpdateEntry(shared->machineTypes, key, cached) == 0)
+            cached = NULL;
+    } else if (virHashHasEntry(shared->machineTypes, key) &&
+               !virHashLookup(shared->machineTypes, key)) {
+        /* let one of the waiting threads probe instead */
+        virHashRemoveEntry(shared->machineTypes, key);
+    }
+
+    virCondBroadcast(&shared->cond);
+}
+
+
 /**
  * qemuProcessReloadMachineTypes:
  *
  * Reload machine type information into the 'qemuCaps' object from the current
- * qemu.
+ * qemu. When @shared is not NULL the data is probed only once for all domains
+ * running the same QEMU binary.
  */
 static int
-qemuProcessReloadMachineTypes(virDomainObj *vm)
+qemuProcessReloadMachineTypes(virDomainObj *vm,
+                              qemuProcessReconnectShared *shared)
 {
     qemuDomainObjPrivate *priv = vm->privateData;
+    g_autofree char *key = NULL;
     bool fail = false;
 
+    if (shared && (key = qemuProcessReconnectMachineTypesKey(vm))) {
+        bool found;
+
+        /* don't block other threads waiting for the domain while waiting
+         * for the machine types of another one */
+        virObjectUnlock(vm);
+        found = qemuProcessReconnectSharedLookup(shared, key, priv->qemuCaps,
+                                                 vm->def->virtType);
+        virObjectLock(vm);
+
+        if (found) {
+            VIR_DEBUG("Reusing machine types for domain '%s'", vm->def->name);
+            return 0;
+        }
+    }
+
     qemuDomainObjEnterMonitor(vm);
 
     if (virQEMUCapsInitQMPArch(priv->qemuCaps, priv->mon) < 0)
@@ -9478,6 +9653,10 @@ qemuProcessReloadMachineTypes(virDomainObj *vm)
 
     qemuDomainObjExitMonitor(vm);
 
+    if (key)
+        qemuProcessReconnectSharedStore(shared, key, priv->qemuCaps,
+                                        vm->def->virtType, !fail);
+
     if (fail)
         return -1;
 
@@ -9485,9 +9664,32 @@ qemuProcessReloadMachineTypes(virDomainObj *vm)
 }
 
 
+/**
+ * qemuProcessReconnectRefresh:
+ * @vm: domain object
+ *
+ * Refreshes guest state which was not refreshed when reconnecting to @vm
+ * because reconnect_defer_refresh is enabled. The caller must hold a
+ * VIR_JOB_MODIFY job on @vm.
+ */
+void
+qemuProcessReconnectRefresh(virDomainObj *vm)
+{
+    /* If querying of guest's RTC failed, report error, but do not kill the domain. */
+    qemuRefreshRTC(vm);
+
+    if (qemuProcessRefreshBalloonState(vm, VIR_ASYNC_JOB_NONE) < 0)
+        VIR_WARN("Failed to refresh balloon state of domain '%s'",
+                 vm->def->name);
+
+    qemuDomainSaveStatus(vm);
+}
+
+
 struct qemuProcessReconnectData {
     virDomainObj *obj;
     virIdentity *identity;
+    qemuProcessReconnectShared *shared;
 };
 /*
  * Open an existing VM's monitor, re-detect VCPU threads
@@ -9524,6 +9726,10 @@ qemuProcessReconnect(void *opaque)
     unsigned int stopFlags = 0;
     bool jobStarted = false;
     bool tryMonReconn = false;
+    long long start = g_get_monotonic_time();
+    long long monitorTime = 0;
+    long long machineTypesTime = 0;
+    long long then;
 
     virIdentitySetCurrent(data->identity);
     g_clear_object(&data->identity);
@@ -9568,8 +9774,10 @@ qemuProcessReconnect(void *opaque)
     tryMonReconn = true;
 
     /* XXX check PID liveliness & EXE path */
+    then = g_get_monotonic_time();
     if (qemuConnectMonitor(driver, obj, VIR_ASYNC_JOB_NONE, NULL, true) < 0)
         goto error;
+    monitorTime = g_get_monotonic_time() - then;
 
     priv->machineName = qemuDomainGetMachineName(obj);
     if (!priv->machineName)
@@ -9619,8 +9827,10 @@ qemuProcessReconnect(void *opaque)
 
     /* Reload and populate machine type data into 'qemuCaps' as that is not
      * serialized into the status XML. */
-    if (qemuProcessReloadMachineTypes(obj) < 0)
+    then = g_get_monotonic_time();
+    if (qemuProcessReloadMachineTypes(obj, data->shared) < 0)
         goto error;
+    machineTypesTime = g_get_monotonic_time() - then;
 
     if (qemuDomainAssignAddresses(obj->def, priv->qemuCaps,
                                   driver, obj, false) < 0) {
@@ -9692,11 +9902,15 @@ qemuProcessReconnect(void *opaque)
     if (qemuRefreshVirtioChannelState(driver, obj, VIR_ASYNC_JOB_NONE) < 0)
         goto error;
 
-    /* If querying of guest's RTC failed, report error, but do not kill the domain. */
-    qemuRefreshRTC(obj);
+    /* Refreshing the RTC and balloon is not needed to manage the domain,
+     * with reconnect_defer_refresh it is done once the reconnect finished. */
+    if (!cfg->reconnectDeferRefresh) {
+        /* If querying of guest's RTC failed, report error, but do not kill the domain. */
+        qemuRefreshRTC(obj);
 
-    if (qemuProcessRefreshBalloonState(obj, VIR_ASYNC_JOB_NONE) < 0)
-        goto error;
+        if (qemuProcessRefreshBalloonState(obj, VIR_ASYNC_JOB_NONE) < 0)
+            goto error;
+    }
 
     if (qemuProcessRecoverJob(driver, obj, &oldjob, &stopFlags) < 0)
         goto error;
@@ -9765,6 +9979,15 @@ qemuProcessReconnect(void *opaque)
 
     virInhibitorHold(driver->inhibitor);
 
+    if (cfg->reconnectDeferRefresh)
+        qemuProcessEventSubmit(obj, QEMU_PROCESS_EVENT_RECONNECT_REFRESH,
+                               0, 0, NULL);
+
+    VIR_INFO("Reconnected to domain '%s' in %lld ms "
+             "(monitor %lld ms, machine types %lld ms)",
+             obj->def->name, (g_get_monotonic_time() - start) / 1000,
+             monitorTime / 1000, machineTypesTime / 1000);
+
  cleanup:
     if (jobStarted)
         virDomainObjEndJob(obj);
@@ -9772,6 +9995,7 @@ qemuProcessReconnect(void *opaque)
         qemuDomainRemoveInactive(obj, 0, false);
     virDomainObjEndAPI(&obj);
     virIdentitySetCurrent(NULL);
+    qemuProcessReconnectSharedRelease(data->shared);
     return;
 
  error:
@@ -9805,8 +10029,9 @@ qemuProcessReconnect(void *opaque)
 
 static int
 qemuProcessReconnectHelper(virDomainObj *obj,
-                           void *opaque G_GNUC_UNUSED)
+                           void *opaque)
 {
+    qemuProcessReconnectShared *shared = opaque;
     virThread thread;
     struct qemuProcessReconnectData *data;
     g_autofree char *name = NULL;
@@ -9820,6 +10045,14 @@ qemuProcessReconnectHelper(virDomainObj *obj,
     data->obj = obj;
     data->identity = virIdentityGetCurrent();
 
+    if (shared) {
+        VIR_WITH_MUTEX_LOCK_GUARD(&shared->lock) {
+            shared->refs++;
+            shared->ndomains++;
+        }
+        data->shared = shared;
+    }
+
     /* this lock and reference will be eventually transferred to the thread
      * that handles the reconnect */
     virObjectLock(obj);
@@ -9842,6 +10075,7 @@ qemuProcessReconnectHelper(virDomainObj *obj,
 
         virDomainObjEndAPI(&obj);
         g_clear_object(&data->identity);
+        qemuProcessReconnectSharedRelease(data->shared);
         VIR_FREE(data);
         return -1;
     }
@@ -9858,8 +10092,12 @@ qemuProcessReconnectHelper(virDomainObj *obj,
 void
 qemuProcessReconnectAll(virQEMUDriver *driver)
 {
+    qemuProcessReconnectShared *shared = qemuProcessReconnectSharedNew();
+
     virDomainObjListForEach(driver->domains, true,
-                            qemuProcessReconnectHelper, NULL);
+                            qemuProcessReconnectHelper, shared);
+
+    qemuProcessReconnectSharedRelease(shared);
 }
 
 
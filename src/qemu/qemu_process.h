@@ -48,6 +48,8 @@ int qemuProcessDestroyMemoryBackingPath(virDomainObj *vm,
 
 void qemuProcessReconnectAll(virQEMUDriver *driver);
 
+void qemuProcessReconnectRefresh(virDomainObj *vm);
+
 typedef struct _qemuProcessIncomingDef qemuProcessIncomingDef;
 struct _qemuProcessIncomingDef {
     char *address; /* address where QEMU is supposed to listen */
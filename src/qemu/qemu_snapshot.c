@@ -42,6 +42,7 @@
 #include "virdomaincheckpointobjlist.h"
 #include "virqemu.h"
 #include "storage_source.h"
+#include "storage_header_cache.h"
 
 #define VIR_FROM_THIS VIR_FROM_QEMU
 
@@ -207,6 +208,8 @@ qemuSnapshotCreateQcow2Files(virDomainDef *def,
 
     for (i = 0; i < snapdef->ndisks; i++) {
         g_autoptr(virCommand) cmd = NULL;
+        int rc;
+
         snapdisk = &(snapdef->disks[i]);
         defdisk = def->disks[i];
 
@@ -242,7 +245,10 @@ qemuSnapshotCreateQcow2Files(virDomainDef *def,
         if (!virFileExists(snapdisk->src->path))
             ignore_value(virBitmapSetBit(created, i));
 
-        if (virCommandRun(cmd, NULL) < 0)
+        rc = virCommandRun(cmd, NULL);
+        virStorageHeaderCacheInvalidate(snapdisk->src->path);
+
+        if (rc < 0)
             return -1;
     }
 
@@ -256,11 +262,15 @@ qemuSnapshotForEachQcow2One(virStorageSource *src,
                             const char *snapname)
 {
     g_autoptr(virCommand) cmd = NULL;
+    int rc;
 
     cmd = virCommandNewArgList("qemu-img", "snapshot",
                                op, snapname, src->path, NULL);
 
-    if (virCommandRun(cmd, NULL) < 0)
+    rc = virCommandRun(cmd, NULL);
+    virStorageHeaderCacheInvalidate(src->path);
+
+    if (rc < 0)
         return -1;
 
     return 0;
@@ -1497,6 +1507,8 @@ qemuSnapshotDiskCreate(qemuSnapshotDiskContext *snapctxt)
     if (snapctxt->ndd == 0)
         return 0;
 
+    qemuDomainBlockNodeCacheInvalidate(snapctxt->vm);
+
     if (qemuDomainObjEnterMonitorAsync(snapctxt->vm, snapctxt->asyncJob) < 0)
         return -1;
 
@@ -3301,7 +3313,7 @@ qemuSnapshotDeleteExternalPrepare(virDomainObj *vm,
              * job is snapshot delete job. */
             jobPriv->snapshotDelete = true;
 
-            qemuDomainSaveStatus(vm);
+            qemuDomainSaveStatusSync(vm);
         }
     }
 
@@ -3628,6 +3640,7 @@ qemuSnapshotUpdateBackingStore(qemuSnapshotDeleteExternalData *data)
         virCommandSetGID(cmd, backingData->gid);
 
         ignore_value(virCommandRun(cmd, NULL));
+        virStorageHeaderCacheInvalidate(backingData->diskSrc->path);
     }
 }
 
@@ -1018,6 +1018,14 @@ int main(int argc, char **argv) {
         goto cleanup;
     }
 
+    if (virNetServerSetIOThreads(srv, config->io_workers) < 0) {
+        ret = VIR_DAEMON_ERR_INIT;
+        goto cleanup;
+    }
+
+    virNetServerSetMaxClientWorkers(srv, config->max_client_workers);
+    virNetServerSetWorkerIdleTimeout(srv, config->worker_idle_timeout);
+
     if (virNetDaemonAddServer(dmn, srv) < 0) {
         ret = VIR_DAEMON_ERR_INIT;
         goto cleanup;
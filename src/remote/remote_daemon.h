@@ -86,6 +86,14 @@ struct daemonClientPrivate {
     const char *storageURI;
     bool readonly;
 
+    /* Client accepts stream data messages with up to
+     * VIR_NET_MESSAGE_STREAM_PAYLOAD_MAX bytes of payload */
+    bool streamLargePayload;
+
+    /* Client wants to get the data of eligible streams through a socket
+     * passed along with the reply of the call opening the stream */
+    bool streamLocalFD;
+
     daemonClientStream *streams;
 };
 
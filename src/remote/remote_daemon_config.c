@@ -137,6 +137,7 @@ daemonConfigNew(bool privileged G_GNUC_UNUSED)
 
     data->min_workers = 5;
     data->max_workers = 20;
+    data->worker_idle_timeout = 60;
     data->max_clients = 5000;
     data->max_queued_clients = 1000;
     data->max_anonymous_clients = 20;
@@ -321,6 +322,8 @@ daemonConfigLoadOptions(struct daemonConfig *data,
         return -1;
     if (virConfGetValueUInt(conf, "max_workers", &data->max_workers) < 0)
         return -1;
+    if (virConfGetValueUInt(conf, "worker_idle_timeout", &data->worker_idle_timeout) < 0)
+        return -1;
     if (data->max_workers < 1) {
         virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
                        _("'max_workers' must be greater than 0"));
@@ -336,8 +339,13 @@ daemonConfigLoadOptions(struct daemonConfig *data,
     if (virConfGetValueUInt(conf, "prio_workers", &data->prio_workers) < 0)
         return -1;
 
+    if (virConfGetValueUInt(conf, "io_workers", &data->io_workers) < 0)
+        return -1;
+
     if (virConfGetValueUInt(conf, "max_client_requests", &data->max_client_requests) < 0)
         return -1;
+    if (virConfGetValueUInt(conf, "max_client_workers", &data->max_client_workers) < 0)
+        return -1;
 
     if (virConfGetValueUInt(conf, "admin_min_workers", &data->admin_min_workers) < 0)
         return -1;
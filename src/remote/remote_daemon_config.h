@@ -68,13 +68,17 @@ struct daemonConfig {
 
     unsigned int min_workers;
     unsigned int max_workers;
+    unsigned int worker_idle_timeout;
     unsigned int max_clients;
     unsigned int max_queued_clients;
     unsigned int max_anonymous_clients;
 
     unsigned int prio_workers;
 
+    unsigned int io_workers;
+
     unsigned int max_client_requests;
+    unsigned int max_client_workers;
 
     unsigned int log_level;
     char *log_filters;
@@ -5013,7 +5013,7 @@ remoteDispatchDomainMigrateConfirm3(virNetServer *server G_GNUC_UNUSED,
 
 static int remoteDispatchConnectSupportsFeature(virNetServer *server G_GNUC_UNUSED,
                                                 virNetServerClient *client,
-                                                virNetMessage *msg G_GNUC_UNUSED,
+                                                virNetMessage *msg,
                                                 struct virNetMessageError *rerr,
                                                 remote_connect_supports_feature_args *args,
                                                 remote_connect_supports_feature_ret *ret)
@@ -5043,6 +5043,34 @@ static int remoteDispatchConnectSupportsFeature(virNetServer *server G_GNUC_UNUS
     case VIR_DRV_FEATURE_REMOTE_CLOSE_CALLBACK:
         supported = 1;
         break;
+    case VIR_DRV_FEATURE_REMOTE_STREAM_LARGE_PAYLOAD: {
+        daemonClientPrivate *priv = virNetServerClientGetPrivateData(client);
+
+        VIR_WITH_MUTEX_LOCK_GUARD(&priv->lock) {
+            priv->streamLargePayload = true;
+        }
+        supported = 1;
+        break;
+    }
+    case VIR_DRV_FEATURE_REMOTE_STREAM_LOCAL_FD: {
+        daemonClientPrivate *priv = virNetServerClientGetPrivateData(client);
+
+        /* The stream data socket is passed along with the reply which
+         * works only for clients connected over a UNIX socket. Clients ask
+         * only when opening the connection, queries made by applications
+         * are answered by the client's remote driver. */
+        supported = virNetServerClientIsLocal(client);
+        VIR_WITH_MUTEX_LOCK_GUARD(&priv->lock) {
+            priv->streamLocalFD = supported;
+        }
+        break;
+    }
+    case VIR_DRV_FEATURE_REMOTE_COMPRESSION:
+        /* Both directions switch to compression right after this reply.
+         * Clients ask only when opening the connection, queries made by
+         * applications are answered by the client's remote driver. */
+        supported = virNetServerClientSetCompression(client, msg);
+        break;
     case VIR_DRV_FEATURE_MIGRATION_V1:
     case VIR_DRV_FEATURE_REMOTE:
     case VIR_DRV_FEATURE_MIGRATION_V2:
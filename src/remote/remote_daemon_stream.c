@@ -26,6 +26,9 @@
 #include "virlog.h"
 #include "virnetserverclient.h"
 #include "virerror.h"
+#include "virsocket.h"
+#include "virfile.h"
+#include "virutil.h"
 #include "libvirt_internal.h"
 
 #define VIR_FROM_THIS VIR_FROM_STREAMS
@@ -51,6 +54,7 @@ struct daemonClientStream {
     bool tx;
 
     bool allowSkip;
+    bool largePayload; /* Client negotiated VIR_NET_MESSAGE_STREAM_PAYLOAD_MAX */
     size_t dataLen; /* How much data is there remaining until we see a hole */
 
     daemonClientStream *next;
@@ -193,10 +197,13 @@ daemonStreamEvent(virStreamPtr st, int events, void *opaque)
 
 
     /* If we got HANGUP, we need to only send an empty
-     * packet so the client sees an EOF and cleans up
+     * packet so the client sees an EOF and cleans up,
+     * unless the stream failed, e.g. the worker thread
+     * of a redirected stream, which is reported below
      */
     if (!stream->closed && !stream->recvEOF &&
-        (events & VIR_STREAM_EVENT_HANGUP)) {
+        (events & VIR_STREAM_EVENT_HANGUP) &&
+        !(events & VIR_STREAM_EVENT_ERROR)) {
         virNetMessage *msg;
         events &= ~(VIR_STREAM_EVENT_HANGUP);
         stream->tx = false;
@@ -419,6 +426,69 @@ int daemonFreeClientStream(virNetServerClient *client,
 }
 
 
+/*
+ * @client: a locked client object
+ * @stream: a new client stream, not yet added to @client
+ * @msg: the method call which created the stream
+ *
+ * Clients connected over a UNIX socket may ask to get the data of
+ * streams through a socket of their own, bypassing stream data
+ * messages. If the stream can be redirected, one end of a socket
+ * pair is attached to @msg so that it's passed to the client along
+ * with the reply.
+ *
+ * Returns 1 if a socket was attached to @msg, 0 if the stream
+ * keeps using stream data messages, -1 on error
+ */
+int
+daemonStreamOfferLocalFD(virNetServerClient *client,
+                         daemonClientStream *stream,
+                         virNetMessage *msg)
+{
+    daemonClientPrivate *priv = virNetServerClientGetPrivateData(client);
+    int fds[2] = { -1, -1 };
+    VIR_AUTOCLOSE peer = -1;
+    int rc;
+
+    VIR_WITH_MUTEX_LOCK_GUARD(&priv->lock) {
+        if (!priv->streamLocalFD)
+            return 0;
+    }
+
+    /* Holes can't be represented in a plain byte stream */
+    if (stream->allowSkip)
+        return 0;
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+        virReportSystemError(errno, "%s",
+                             _("Unable to create socket pair for stream"));
+        return -1;
+    }
+    peer = fds[1];
+
+    if (virSetCloseExec(fds[0]) < 0) {
+        virReportSystemError(errno, "%s",
+                             _("Unable to set close-on-exec flag"));
+        VIR_FORCE_CLOSE(fds[0]);
+        return -1;
+    }
+
+    /* On success the stream owns fds[0] */
+    if ((rc = virStreamRedirect(stream->st, fds[0])) <= 0) {
+        VIR_FORCE_CLOSE(fds[0]);
+        return rc;
+    }
+
+    VIR_DEBUG("client=%p, proc=%d, serial=%u uses local stream fd",
+              client, stream->procedure, stream->serial);
+
+    if (virNetMessageAddFD(msg, peer) < 0)
+        return -1;
+
+    return 1;
+}
+
+
 /*
  * @client: a locked client to add the stream to
  * @stream: a stream to add
@@ -455,6 +525,7 @@ int daemonAddClientStream(virNetServerClient *client,
         stream->tx = true;
 
     VIR_WITH_MUTEX_LOCK_GUARD(&priv->lock) {
+        stream->largePayload = priv->streamLargePayload;
         stream->next = priv->streams;
         priv->streams = stream;
         daemonStreamUpdateEvents(stream);
@@ -844,7 +915,8 @@ daemonStreamHandleRead(virNetServerClient *client,
     if (!stream->tx)
         return 0;
 
-    buffer = g_new0(char, bufferLen);
+    if (stream->largePayload)
+        bufferLen = VIR_NET_MESSAGE_STREAM_PAYLOAD_MAX;
 
     if (!(msg = virNetMessageNew(false)))
         goto cleanup;
@@ -903,6 +975,14 @@ daemonStreamHandleRead(virNetServerClient *client,
         bufferLen > stream->dataLen)
         bufferLen = stream->dataLen;
 
+    /* Read the data directly into the message which is sent to the client */
+    if (!(buffer = virNetServerProgramReserveStreamData(stream->prog,
+                                                        msg,
+                                                        stream->procedure,
+                                                        stream->serial,
+                                                        bufferLen)))
+        goto cleanup;
+
     rv = virStreamRecv(stream->st, buffer, bufferLen);
     if (rv == -2) {
         /* Should never get this, since we're only called when we know
@@ -927,12 +1007,7 @@ daemonStreamHandleRead(virNetServerClient *client,
         msg->cb = daemonStreamMessageFinished;
         msg->opaque = stream;
         stream->refs++;
-        if (virNetServerProgramSendStreamData(stream->prog,
-                                              client,
-                                              msg,
-                                              stream->procedure,
-                                              stream->serial,
-                                              buffer, rv) < 0)
+        if (virNetServerProgramSendReservedStreamData(client, msg, rv) < 0)
             goto cleanup;
         msg = NULL;
     }
@@ -940,7 +1015,6 @@ daemonStreamHandleRead(virNetServerClient *client,
  done:
     ret = 0;
  cleanup:
-    VIR_FREE(buffer);
     virNetMessageFree(msg);
     return ret;
 }
@@ -32,6 +32,11 @@ daemonCreateClientStream(virNetServerClient *client,
 int daemonFreeClientStream(virNetServerClient *client,
                            daemonClientStream *stream);
 
+int
+daemonStreamOfferLocalFD(virNetServerClient *client,
+                         daemonClientStream *stream,
+                         virNetMessage *msg);
+
 int daemonAddClientStream(virNetServerClient *client,
                           daemonClientStream *stream,
                           bool transmit);
@@ -26,6 +26,7 @@
 #include "virnetclient.h"
 #include "virnetclientprogram.h"
 #include "virnetclientstream.h"
+#include "virnetsocket.h"
 #include "virerror.h"
 #include "virlog.h"
 #include "datatypes.h"
@@ -94,6 +95,9 @@ struct private_data {
     bool serverKeepAlive;       /* Does server support keepalive protocol? */
     bool serverEventFilter;     /* Does server support modern event filtering */
     bool serverCloseCallback;   /* Does server support driver close callback */
+    bool serverStreamLargePayload; /* Does server support large stream messages */
+    bool serverStreamLocalFD;   /* Does server pass sockets for stream data */
+    bool serverCompression;     /* Are messages compressed */
 
     virObjectEventState *eventState;
     virConnectCloseCallbackData *closeCallback;
@@ -134,6 +138,10 @@ static int callFull(virConnectPtr conn, struct private_data *priv,
                     int proc_nr,
                     xdrproc_t args_filter, char *args,
                     xdrproc_t ret_filter, char *ret);
+static int callStream(virConnectPtr conn, struct private_data *priv,
+                      virStreamPtr st, unsigned int flags, int proc_nr,
+                      xdrproc_t args_filter, char *args,
+                      xdrproc_t ret_filter, char *ret);
 static int remoteAuthenticate(virConnectPtr conn, struct private_data *priv,
                               virConnectAuthPtr auth, const char *authtype);
 #if WITH_SASL
@@ -801,6 +809,20 @@ remoteCallOpen(virConnectPtr conn,
         continue; \
     }
 
+#define EXTRACT_URI_ARG_FLAG(ARG_NAME, ARG_VAR) \
+    if (STRCASEEQ(var->name, ARG_NAME)) { \
+        int tmp; \
+        if (virStrToLong_i(var->value, NULL, 10, &tmp) < 0) { \
+            virReportError(VIR_ERR_INVALID_ARG, \
+                           _("Failed to parse value of URI component %1$s"), \
+                           var->name); \
+            return -1; \
+        } \
+        ARG_VAR = tmp != 0; \
+        var->ignore = 1; \
+        continue; \
+    }
+
 static int
 doRemoteOpenExtractURIArgs(virConnectPtr conn,
                            char **name,
@@ -820,7 +842,9 @@ doRemoteOpenExtractURIArgs(virConnectPtr conn,
                            bool *tty,
 #endif
                            bool *sanity,
-                           bool *verify)
+                           bool *verify,
+                           bool *streamLocalFD,
+                           bool *compress)
 {
     size_t i;
 
@@ -846,6 +870,9 @@ doRemoteOpenExtractURIArgs(virConnectPtr conn,
         EXTRACT_URI_ARG_BOOL("no_tty", *tty);
 #endif
 
+        EXTRACT_URI_ARG_FLAG("stream_local_fd", *streamLocalFD);
+        EXTRACT_URI_ARG_FLAG("compress", *compress);
+
         if (STRCASEEQ(var->name, "authfile")) {
             /* Strip this param, used by virauth.c */
             var->ignore = 1;
@@ -861,6 +888,7 @@ doRemoteOpenExtractURIArgs(virConnectPtr conn,
 
 #undef EXTRACT_URI_ARG_STR
 #undef EXTRACT_URI_ARG_BOOL
+#undef EXTRACT_URI_ARG_FLAG
 
 
 /*
@@ -914,6 +942,8 @@ doRemoteOpen(virConnectPtr conn,
 #ifndef WIN32
     bool tty = true;
 #endif
+    bool streamLocalFD = false;
+    bool compress = false;
     int mode;
     int proxy;
 
@@ -960,7 +990,9 @@ doRemoteOpen(virConnectPtr conn,
                                        &tty,
 #endif
                                        &sanity,
-                                       &verify) < 0) {
+                                       &verify,
+                                       &streamLocalFD,
+                                       &compress) < 0) {
             goto error;
         }
 
@@ -1298,6 +1330,37 @@ doRemoteOpen(virConnectPtr conn,
                  "by the remote side.");
     }
 
+    /* Besides checking the server this tells it that we can receive large
+     * stream messages too. */
+    priv->serverStreamLargePayload = remoteConnectSupportsFeatureUnlocked(conn,
+                                        priv, VIR_DRV_FEATURE_REMOTE_STREAM_LARGE_PAYLOAD);
+
+    /* Stream data sockets can be passed only over a direct UNIX socket
+     * connection, so ask for them only in that case */
+    if (streamLocalFD &&
+        transport == REMOTE_DRIVER_TRANSPORT_UNIX &&
+        virNetClientHasPassFD(priv->client)) {
+        priv->serverStreamLocalFD = remoteConnectSupportsFeatureUnlocked(conn,
+                                        priv, VIR_DRV_FEATURE_REMOTE_STREAM_LOCAL_FD);
+        if (!priv->serverStreamLocalFD)
+            VIR_INFO("Local stream sockets aren't supported by the remote side.");
+    }
+
+    /* This must be the last call made while opening the connection as
+     * everything the daemon sends after agreeing to it is compressed and
+     * nothing but the reply may be in flight at that point. The client
+     * switches as soon as the reply is received. */
+    if (compress && virNetSocketCompressionSupported()) {
+        if (virNetClientSetCompression(priv->client, REMOTE_PROGRAM,
+                                       REMOTE_PROC_CONNECT_SUPPORTS_FEATURE) < 0)
+            goto error;
+
+        priv->serverCompression = remoteConnectSupportsFeatureUnlocked(conn,
+                                      priv, VIR_DRV_FEATURE_REMOTE_COMPRESSION);
+        if (!priv->serverCompression)
+            VIR_INFO("Compression isn't supported by the remote side.");
+    }
+
     return VIR_DRV_OPEN_SUCCESS;
 
  error:
@@ -6173,6 +6236,135 @@ call(virConnectPtr conn,
                     ret_filter, ret);
 }
 
+/*
+ * Like call(), but for procedures opening stream @st. If the server
+ * passes a socket carrying the data of the stream along with the
+ * reply, the stream uses it instead of stream data messages.
+ */
+static int
+callStream(virConnectPtr conn,
+           struct private_data *priv,
+           virStreamPtr st,
+           unsigned int flags,
+           int proc_nr,
+           xdrproc_t args_filter, char *args,
+           xdrproc_t ret_filter, char *ret)
+{
+    g_autofree int *fdout = NULL;
+    size_t fdoutlen = 0;
+    size_t i;
+    int rv;
+
+    if (!priv->serverStreamLocalFD)
+        return call(conn, priv, flags, proc_nr,
+                    args_filter, args, ret_filter, ret);
+
+    if ((rv = callFull(conn, priv, flags,
+                       NULL, 0,
+                       &fdout, &fdoutlen,
+                       proc_nr,
+                       args_filter, args,
+                       ret_filter, ret)) < 0)
+        return rv;
+
+    for (i = 1; i < fdoutlen; i++)
+        VIR_FORCE_CLOSE(fdout[i]);
+
+    if (fdoutlen > 0 &&
+        virNetClientStreamSetLocalFD(st->privateData, fdout[0],
+                                     st->flags & VIR_STREAM_NONBLOCK) < 0)
+        return -1;
+
+    return rv;
+}
+
+/*
+ * Like call(), but returns as soon as the call is queued. @func is run
+ * from the event loop once the reply arrives and @ret is filled in, so
+ * both @ret and @opaque must stay valid until then.
+ */
+static int
+callAsync(virConnectPtr conn G_GNUC_UNUSED,
+          struct private_data *priv,
+          int proc_nr,
+          xdrproc_t args_filter, char *args,
+          xdrproc_t ret_filter, char *ret,
+          virNetClientProgramCallFunc func,
+          void *opaque)
+{
+    return virNetClientProgramCallAsync(priv->remoteProgram,
+                                        priv->client,
+                                        priv->counter++,
+                                        proc_nr,
+                                        args_filter, args,
+                                        ret_filter, ret,
+                                        func, opaque);
+}
+
+
+struct remoteDomainGetInfoAsyncData {
+    virDomainPtr domain;
+    virDomainGetInfoCallback cb;
+    void *opaque;
+    virFreeCallback freecb;
+    remote_domain_get_info_ret ret;
+};
+
+static void
+remoteDomainGetInfoAsyncDone(int rv,
+                             void *opaque)
+{
+    struct remoteDomainGetInfoAsyncData *data = opaque;
+    virDomainInfo info = { 0 };
+
+    if (rv == 0) {
+        info.state = data->ret.state;
+        info.maxMem = data->ret.maxMem;
+        info.memory = data->ret.memory;
+        info.nrVirtCpu = data->ret.nrVirtCpu;
+        info.cpuTime = data->ret.cpuTime;
+    }
+
+    data->cb(data->domain, rv, rv == 0 ? &info : NULL, data->opaque);
+
+    if (data->freecb)
+        data->freecb(data->opaque);
+    xdr_free((xdrproc_t) xdr_remote_domain_get_info_ret, (char *) &data->ret);
+    virObjectUnref(data->domain);
+    g_free(data);
+}
+
+static int
+remoteDomainGetInfoAsync(virDomainPtr domain,
+                         virDomainGetInfoCallback cb,
+                         void *opaque,
+                         virFreeCallback freecb)
+{
+    remote_domain_get_info_args args = {0};
+    struct remoteDomainGetInfoAsyncData *data = NULL;
+    struct private_data *priv = domain->conn->privateData;
+    VIR_LOCK_GUARD lock = remoteDriverLock(priv);
+
+    make_nonnull_domain(&args.dom, domain);
+
+    data = g_new0(struct remoteDomainGetInfoAsyncData, 1);
+    data->domain = virObjectRef(domain);
+    data->cb = cb;
+    data->opaque = opaque;
+    data->freecb = freecb;
+
+    if (callAsync(domain->conn, priv, REMOTE_PROC_DOMAIN_GET_INFO,
+                  (xdrproc_t) xdr_remote_domain_get_info_args, (char *) &args,
+                  (xdrproc_t) xdr_remote_domain_get_info_ret, (char *) &data->ret,
+                  remoteDomainGetInfoAsyncDone, data) < 0) {
+        virObjectUnref(data->domain);
+        g_free(data);
+        return -1;
+    }
+
+    return 0;
+}
+
 
 static int
 remoteDomainGetInterfaceParameters(virDomainPtr domain,
@@ -7935,6 +8127,7 @@ static virHypervisorDriver hypervisor_driver = {
     .domainGraphicsReload = remoteDomainGraphicsReload, /* 10.2.0 */
     .domainSetThrottleGroup = remoteDomainSetThrottleGroup, /* 11.2.0 */
     .domainDelThrottleGroup = remoteDomainDelThrottleGroup, /* 11.2.0 */
+    .domainGetInfoAsync = remoteDomainGetInfoAsync, /* 11.9.0 */
 };
 
 static virNetworkDriver network_driver = {
@@ -4032,6 +4032,12 @@ enum remote_procedure {
      *   <paramnumber> specifies at which offset the stream parameter is inserted
      *   in the function parameter list.
      *
+     * - @localfd: 1
+     *
+     *   The stream may carry its data through a socket passed to clients which
+     *   asked for VIR_DRV_FEATURE_REMOTE_STREAM_LOCAL_FD, instead of stream
+     *   data messages.
+     *
      * - @priority: low|high
      *
      *   Each API that might eventually access hypervisor's monitor (and thus
@@ -5499,6 +5505,7 @@ enum remote_procedure {
      * @generate: both
      * @writestream: 1
      * @sparseflag: VIR_STORAGE_VOL_UPLOAD_SPARSE_STREAM
+     * @localfd: 1
      * @acl: storage_vol:data_write
      */
     REMOTE_PROC_STORAGE_VOL_UPLOAD = 208,
@@ -5507,6 +5514,7 @@ enum remote_procedure {
      * @generate: both
      * @readstream: 1
      * @sparseflag: VIR_STORAGE_VOL_DOWNLOAD_SPARSE_STREAM
+     * @localfd: 1
      * @acl: storage_vol:data_read
      */
     REMOTE_PROC_STORAGE_VOL_DOWNLOAD = 209,
@@ -352,6 +352,13 @@ while (<PROTOCOL>) {
             $calls{$name}->{streamflag} = "none";
         }
 
+        if (exists $opts{localfd}) {
+            die "\@localfd requires stream" unless $calls{$name}->{streamflag} ne "none";
+            $calls{$name}->{localfd} = 1;
+        } else {
+            $calls{$name}->{localfd} = 0;
+        }
+
         if (exists $opts{sparseflag}) {
             die "\@sparseflag requires stream" unless $calls{$name}->{streamflag} ne "none";
             $calls{$name}->{sparseflag} = $opts{sparseflag};
@@ -1055,6 +1062,9 @@ elsif ($mode eq "server") {
         if ($call->{streamflag} ne "none") {
             print "    virStreamPtr st = NULL;\n";
             print "    daemonClientStream *stream = NULL;\n";
+            if ($call->{localfd}) {
+                print "    int localfd;\n";
+            }
             if ($call->{sparseflag} ne "none") {
                 print "    const bool sparse = args->flags & $call->{sparseflag};\n"
             } else {
@@ -1166,6 +1176,12 @@ elsif ($mode eq "server") {
             print "\n";
         }
 
+        if ($call->{localfd}) {
+            print "    if ((localfd = daemonStreamOfferLocalFD(client, stream, msg)) < 0)\n";
+            print "        goto cleanup;\n";
+            print "\n";
+        }
+
         if ($call->{streamflag} ne "none") {
             print "    if (daemonAddClientStream(client, stream, ";
 
@@ -1222,7 +1238,13 @@ elsif ($mode eq "server") {
             print "\n";
         }
 
-        print "    rv = 0;\n";
+        if ($call->{localfd}) {
+            # SPECIAL: returning 1 passes the FDs attached to msg along
+            #          with the reply
+            print "    rv = localfd;\n";
+        } else {
+            print "    rv = 0;\n";
+        }
         print "\n";
         print "cleanup:\n";
         print "    if (rv < 0)";
@@ -1830,12 +1852,30 @@ elsif ($mode eq "client") {
         }
 
         if ($call->{ProcName} eq "SupportsFeature") {
-            # SPECIAL: VIR_DRV_FEATURE_REMOTE feature is handled directly
+            # SPECIAL: some VIR_DRV_FEATURE_REMOTE* features are handled directly
             print "\n";
             print "    if (feature == VIR_DRV_FEATURE_REMOTE) {\n";
             print "        rv = 1;\n";
             print "        goto cleanup;\n";
             print "    }\n";
+            print "\n";
+            print "    /* Negotiated when the connection was opened */\n";
+            print "    if (feature == VIR_DRV_FEATURE_REMOTE_STREAM_LARGE_PAYLOAD) {\n";
+            print "        rv = priv->serverStreamLargePayload;\n";
+            print "        goto cleanup;\n";
+            print "    }\n";
+            print "\n";
+            print "    /* Asking the daemon would make it pass stream sockets */\n";
+            print "    if (feature == VIR_DRV_FEATURE_REMOTE_STREAM_LOCAL_FD) {\n";
+            print "        rv = priv->serverStreamLocalFD;\n";
+            print "        goto cleanup;\n";
+            print "    }\n";
+            print "\n";
+            print "    /* Asking the daemon would switch the connection to compression */\n";
+            print "    if (feature == VIR_DRV_FEATURE_REMOTE_COMPRESSION) {\n";
+            print "        rv = priv->serverCompression;\n";
+            print "        goto cleanup;\n";
+            print "    }\n";
         }
 
         foreach my $args_check (@args_check_list) {
@@ -1895,9 +1935,15 @@ elsif ($mode eq "client") {
         }
 
         print "\n";
-        print "    if (call($call_priv, $callflags, $call->{constname},\n";
-        print "             (xdrproc_t)xdr_$argtype, (char *)$call_args,\n";
-        print "             (xdrproc_t)xdr_$rettype, (char *)$call_ret) == -1) {\n";
+        if ($call->{localfd}) {
+            print "    if (callStream($call_priv, st, $callflags, $call->{constname},\n";
+            print "                   (xdrproc_t)xdr_$argtype, (char *)$call_args,\n";
+            print "                   (xdrproc_t)xdr_$rettype, (char *)$call_ret) == -1) {\n";
+        } else {
+            print "    if (call($call_priv, $callflags, $call->{constname},\n";
+            print "             (xdrproc_t)xdr_$argtype, (char *)$call_args,\n";
+            print "             (xdrproc_t)xdr_$rettype, (char *)$call_ret) == -1) {\n";
+        }
 
         if ($call->{streamflag} ne "none") {
             print "        virNetClientRemoveStream(priv->client, netst);\n";
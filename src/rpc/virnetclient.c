@@ -35,6 +35,7 @@
 #include "virerror.h"
 #include "virprobe.h"
 #include "vireventglibwatch.h"
+#include "virevent.h"
 
 #define VIR_FROM_THIS VIR_FROM_RPC
 
@@ -60,6 +61,11 @@ struct _virNetClientCall {
     bool nonBlock;
     bool haveThread;
 
+    /* Completion callback of asynchronous calls, which never
+     * have a thread waiting for them */
+    virNetClientReplyFunc replyFunc;
+    void *replyOpaque;
+
     virCond cond;
 
     virNetClientCall *next;
@@ -84,6 +90,10 @@ struct _virNetClient {
 #if WITH_SASL
     virNetSASLSession *sasl;
 #endif
+    /* Compress data once the reply to this procedure agreed to it */
+    bool compressReply;
+    unsigned compressProg;
+    int compressProc;
 
     GMainLoop *eventLoop;
     GMainContext *eventCtx;
@@ -92,12 +102,18 @@ struct _virNetClient {
      * List of calls currently waiting for dispatch
      * The calls should all have threads waiting for
      * them, except possibly the first call in the list
-     * which might be a partially sent non-blocking call.
+     * which might be a partially sent non-blocking call
+     * and asynchronous calls.
      */
     virNetClientCall *waitDispatch;
     /* True if a thread holds the buck */
     bool haveTheBuck;
 
+    /* Asynchronous calls which are done, their completion callbacks
+     * are run from the event loop using the timer */
+    virNetClientCall *asyncDone;
+    int asyncTimer;
+
     size_t nstreams;
     virNetClientStream **streams;
 
@@ -131,6 +147,7 @@ static int virNetClientQueueNonBlocking(virNetClient *client,
                                         virNetMessage *msg);
 static void virNetClientCloseInternal(virNetClient *client,
                                       int reason);
+static void virNetClientAsyncCollect(virNetClient *client);
 
 
 void virNetClientSetCloseCallback(virNetClient *client,
@@ -302,6 +319,7 @@ static virNetClient *virNetClientNew(virNetSocket *sock,
         goto error;
 
     client->sock = g_steal_pointer(&sock);
+    client->asyncTimer = -1;
 
     client->eventCtx = g_main_context_new();
     client->eventLoop = g_main_loop_new(client->eventCtx, FALSE);
@@ -729,6 +747,32 @@ bool virNetClientHasPassFD(virNetClient *client)
 }
 
 
+/*
+ * Compress the data exchanged with the server once the reply to the next
+ * call of procedure @proc of program @prog is received, provided the call
+ * succeeded and returned true. The switch happens while the reply is
+ * dispatched, so that whatever the server sends after the reply is not
+ * read before.
+ */
+int virNetClientSetCompression(virNetClient *client,
+                               unsigned prog,
+                               int proc)
+{
+    VIR_LOCK_GUARD lock = virObjectLockGuard(client);
+
+    if (!client->sock) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("client socket is closed"));
+        return -1;
+    }
+
+    client->compressReply = true;
+    client->compressProg = prog;
+    client->compressProc = proc;
+    return 0;
+}
+
+
 void virNetClientDispose(void *obj)
 {
     virNetClient *client = obj;
@@ -1127,6 +1171,23 @@ int virNetClientGetTLSKeySize(virNetClient *client)
     return ret;
 }
 
+/* Whether the payload of the reply @msg is a boolean which is true */
+static bool
+virNetClientReplyIsTrue(virNetMessage *msg)
+{
+    XDR xdr;
+    int value = 0;
+
+    xdrmem_create(&xdr, msg->buffer + msg->bufferOffset,
+                  msg->bufferLength - msg->bufferOffset, XDR_DECODE);
+    if (!xdr_int(&xdr, &value))
+        value = 0;
+    xdr_destroy(&xdr);
+
+    return value != 0;
+}
+
+
 static int
 virNetClientCallDispatchReply(virNetClient *client)
 {
@@ -1148,17 +1209,34 @@ virNetClientCallDispatchReply(virNetClient *client)
         return -1;
     }
 
-    VIR_REALLOC_N(thecall->msg->buffer, client->msg.bufferLength);
-
-    memcpy(thecall->msg->buffer, client->msg.buffer, client->msg.bufferLength);
-    memcpy(&thecall->msg->header, &client->msg.header, sizeof(client->msg.header));
+    /* Hand over the buffer with the reply rather than copying it, the
+     * buffer of the call was already released when the call was sent */
+    virNetMessageClearPayload(thecall->msg);
+    thecall->msg->buffer = g_steal_pointer(&client->msg.buffer);
+    thecall->msg->bufferAlloc = client->msg.bufferAlloc;
     thecall->msg->bufferLength = client->msg.bufferLength;
     thecall->msg->bufferOffset = client->msg.bufferOffset;
+    client->msg.bufferAlloc = 0;
+    client->msg.bufferLength = 0;
+    memcpy(&thecall->msg->header, &client->msg.header, sizeof(client->msg.header));
 
     thecall->msg->nfds = client->msg.nfds;
     thecall->msg->fds = g_steal_pointer(&client->msg.fds);
     client->msg.nfds = 0;
 
+    /* The server compresses everything it sends after the reply agreeing
+     * to it, so switch before reading any further */
+    if (client->compressReply &&
+        thecall->msg->header.prog == client->compressProg &&
+        thecall->msg->header.proc == client->compressProc) {
+        client->compressReply = false;
+
+        if (thecall->msg->header.status == VIR_NET_OK &&
+            virNetClientReplyIsTrue(thecall->msg) &&
+            virNetSocketSetCompression(client->sock) < 0)
+            return -1;
+    }
+
     thecall->mode = VIR_NET_CLIENT_MODE_COMPLETE;
 
     return 0;
@@ -1413,10 +1491,8 @@ virNetClientIOReadMessage(virNetClient *client)
     ssize_t ret;
 
     /* Start by reading length word */
-    if (client->msg.bufferLength == 0) {
-        client->msg.bufferLength = 4;
-        client->msg.buffer = g_new0(char, client->msg.bufferLength);
-    }
+    if (client->msg.bufferLength == 0)
+        virNetMessageResizeBuffer(&client->msg, 4);
 
     wantData = client->msg.bufferLength - client->msg.bufferOffset;
 
@@ -1545,6 +1621,10 @@ static bool virNetClientIOEventLoopRemoveDone(virNetClientCall *call,
     if (call->mode != VIR_NET_CLIENT_MODE_COMPLETE)
         return false;
 
+    /* Left for virNetClientAsyncCollect */
+    if (call->replyFunc)
+        return false;
+
     /*
      * ...if the call being removed from the list
      * still has a thread, then wake that thread up,
@@ -1571,6 +1651,85 @@ static bool virNetClientIOEventLoopRemoveDone(virNetClientCall *call,
 }
 
 
+static bool
+virNetClientAsyncCollectOne(virNetClientCall *call,
+                            void *opaque)
+{
+    virNetClient *client = opaque;
+
+    if (!call->replyFunc)
+        return false;
+
+    if (client->sock && call->mode != VIR_NET_CLIENT_MODE_COMPLETE)
+        return false;
+
+    VIR_DEBUG("Queueing completion of asynchronous call %p", call);
+    virNetClientCallQueue(&client->asyncDone, call);
+    return true;
+}
+
+
+/*
+ * Moves asynchronous calls which got their reply, or all of them once
+ * the client is closed, from the dispatch list and schedules running
+ * their completion callbacks. Once the client is closed and no
+ * callbacks are left, the timer is removed.
+ */
+static void
+virNetClientAsyncCollect(virNetClient *client)
+{
+    if (client->asyncTimer < 0)
+        return;
+
+    virNetClientCallRemovePredicate(&client->waitDispatch,
+                                    virNetClientAsyncCollectOne,
+                                    client);
+
+    if (client->asyncDone) {
+        virEventUpdateTimeout(client->asyncTimer, 0);
+    } else if (!client->sock) {
+        virEventRemoveTimeout(client->asyncTimer);
+        client->asyncTimer = -1;
+    } else {
+        virEventUpdateTimeout(client->asyncTimer, -1);
+    }
+}
+
+
+static void
+virNetClientAsyncDispatch(int timer G_GNUC_UNUSED,
+                          void *opaque)
+{
+    virNetClient *client = virObjectRef(opaque);
+    virNetClientCall *calls;
+
+    VIR_WITH_OBJECT_LOCK_GUARD(client) {
+        calls = g_steal_pointer(&client->asyncDone);
+        virNetClientAsyncCollect(client);
+    }
+
+    while (calls) {
+        virNetClientCall *call = calls;
+
+        calls = call->next;
+
+        if (call->mode == VIR_NET_CLIENT_MODE_COMPLETE) {
+            call->replyFunc(client, call->msg, call->replyOpaque);
+        } else {
+            virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                           _("client socket is closed"));
+            call->replyFunc(client, NULL, call->replyOpaque);
+        }
+
+        virCondDestroy(&call->cond);
+        virNetMessageFree(call->msg);
+        VIR_FREE(call);
+    }
+
+    virObjectUnref(client);
+}
+
+
 static void
 virNetClientIODetachNonBlocking(virNetClientCall *call)
 {
@@ -1619,6 +1778,7 @@ virNetClientIOEventLoopPassTheBuck(virNetClient *client,
     VIR_DEBUG("No thread to pass the buck to");
     if (client->wantClose) {
         virNetClientCloseLocked(client);
+        virNetClientAsyncCollect(client);
         virNetClientCallRemovePredicate(&client->waitDispatch,
                                         virNetClientIOEventLoopRemoveAll,
                                         thiscall);
@@ -1791,6 +1951,7 @@ static int virNetClientIOEventLoop(virNetClient *client,
         virNetClientCallRemovePredicate(&client->waitDispatch,
                                         virNetClientIOEventLoopRemoveDone,
                                         thiscall);
+        virNetClientAsyncCollect(client);
 
         /* Now see if *we* are done */
         if (thiscall->mode == VIR_NET_CLIENT_MODE_COMPLETE) {
@@ -1915,6 +2076,9 @@ static gboolean virNetClientIOWakeup(gpointer opaque)
  *   - waitDispatch == NULL,
  *   - waitDispatch != NULL, waitDispatch.nonBlock == true
  *
+ * Asynchronous calls (with replyFunc set) never have threads and
+ * may be anywhere in waitDispatch in any of these states.
+ *
  * The following input states are valid, if n threads are currently
  * executing
  *
@@ -2074,11 +2238,13 @@ void virNetClientIncomingEvent(virNetSocket *sock,
     virNetClientCallRemovePredicate(&client->waitDispatch,
                                     virNetClientIOEventLoopRemoveDone,
                                     NULL);
+    virNetClientAsyncCollect(client);
     virNetClientIOUpdateCallback(client, true);
 
  done:
     if (client->wantClose && !client->haveTheBuck) {
         virNetClientCloseLocked(client);
+        virNetClientAsyncCollect(client);
         virNetClientCallRemovePredicate(&client->waitDispatch,
                                         virNetClientIOEventLoopRemoveAll,
                                         NULL);
@@ -2242,6 +2408,96 @@ int virNetClientSendNonBlock(virNetClient *client,
     return ret;
 }
 
+
+/*
+ * @msg: a message allocated on the heap.
+ * @func: callback to run with the reply
+ * @opaque: data for @func
+ *
+ * Send a message asynchronously and run @func from the event loop once
+ * the reply arrives, with @msg holding the reply, or with NULL and an
+ * error reported if the connection got closed before that. Any number
+ * of such calls can be in flight at the same time, sent and received
+ * by the event loop or by threads waiting for their own replies.
+ *
+ * Requires the client to have async IO registered.
+ *
+ * The caller is responsible for free'ing @msg, *except* if this
+ * method returns 0.
+ *
+ * Returns 0 if the message was queued, -1 on error.
+ */
+int virNetClientSendAsync(virNetClient *client,
+                          virNetMessage *msg,
+                          virNetClientReplyFunc func,
+                          void *opaque)
+{
+    VIR_LOCK_GUARD lock = virObjectLockGuard(client);
+    virNetClientCall *call;
+
+    PROBE(RPC_CLIENT_MSG_TX_QUEUE,
+          "client=%p len=%zu prog=%u vers=%u proc=%u type=%u status=%u serial=%u",
+          client, msg->bufferLength,
+          msg->header.prog, msg->header.vers, msg->header.proc,
+          msg->header.type, msg->header.status, msg->header.serial);
+
+    if (!client->sock || client->wantClose) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("client socket is closed"));
+        return -1;
+    }
+
+    if (!client->asyncIO) {
+        virReportError(VIR_ERR_OPERATION_INVALID, "%s",
+                       _("Unable to send asynchronous calls without async IO support"));
+        return -1;
+    }
+
+    if (client->asyncTimer < 0) {
+        virObjectRef(client);
+        if ((client->asyncTimer = virEventAddTimeout(-1,
+                                                     virNetClientAsyncDispatch,
+                                                     client,
+                                                     virObjectUnref)) < 0) {
+            virObjectUnref(client);
+            virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                           _("Unable to register async call timer"));
+            return -1;
+        }
+    }
+
+    if (!(call = virNetClientCallNew(msg, true, false)))
+        return -1;
+
+    call->replyFunc = func;
+    call->replyOpaque = opaque;
+
+    virNetClientCallQueue(&client->waitDispatch, call);
+
+    if (client->haveTheBuck) {
+        /* Make the thread holding the buck poll for writing our call */
+        g_autoptr(GSource) wakeup = g_idle_source_new();
+        g_source_set_callback(wakeup, virNetClientIOWakeup, client->eventLoop, NULL);
+        g_source_attach(wakeup, client->eventCtx);
+        return 0;
+    }
+
+    /* Send as much as the socket takes right away, the event loop
+     * takes care of the rest */
+    if (virNetClientIOHandleOutput(client) < 0) {
+        virNetClientMarkClose(client, VIR_CONNECT_CLOSE_REASON_ERROR);
+        virNetClientIOEventLoopPassTheBuck(client, NULL);
+        return 0;
+    }
+
+    virNetClientCallRemovePredicate(&client->waitDispatch,
+                                    virNetClientIOEventLoopRemoveDone,
+                                    NULL);
+    virNetClientIOUpdateCallback(client, true);
+
+    return 0;
+}
+
 /*
  * @msg: a message allocated on heap or stack
  *
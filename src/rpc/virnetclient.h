@@ -107,6 +107,10 @@ typedef void (*virNetClientCloseFunc)(virNetClient *client,
                                       int reason,
                                       void *opaque);
 
+typedef void (*virNetClientReplyFunc)(virNetClient *client,
+                                      virNetMessage *msg,
+                                      void *opaque);
+
 void virNetClientSetCloseCallback(virNetClient *client,
                                   virNetClientCloseFunc cb,
                                   void *opaque,
@@ -117,6 +121,10 @@ int virNetClientDupFD(virNetClient *client, bool cloexec);
 
 bool virNetClientHasPassFD(virNetClient *client);
 
+int virNetClientSetCompression(virNetClient *client,
+                               unsigned prog,
+                               int proc);
+
 void virNetClientAddProgram(virNetClient *client,
                             virNetClientProgram *prog);
 
@@ -132,6 +140,11 @@ int virNetClientSendWithReply(virNetClient *client,
 int virNetClientSendNonBlock(virNetClient *client,
                              virNetMessage *msg);
 
+int virNetClientSendAsync(virNetClient *client,
+                          virNetMessage *msg,
+                          virNetClientReplyFunc func,
+                          void *opaque);
+
 int virNetClientSendStream(virNetClient *client,
                            virNetMessage *msg,
                            virNetClientStream *st);
@@ -258,27 +258,19 @@ int virNetClientProgramDispatch(virNetClientProgram *prog,
 }
 
 
-int virNetClientProgramCall(virNetClientProgram *prog,
-                            virNetClient *client,
-                            unsigned serial,
-                            int proc,
-                            size_t noutfds,
-                            int *outfds,
-                            size_t *ninfds,
-                            int **infds,
-                            xdrproc_t args_filter, void *args,
-                            xdrproc_t ret_filter, void *ret)
+static virNetMessage *
+virNetClientProgramCallMessage(virNetClientProgram *prog,
+                               unsigned serial,
+                               int proc,
+                               size_t noutfds,
+                               int *outfds,
+                               xdrproc_t args_filter, void *args)
 {
     virNetMessage *msg;
     size_t i;
 
-    if (infds)
-        *infds = NULL;
-    if (ninfds)
-        *ninfds = 0;
-
     if (!(msg = virNetMessageNew(false)))
-        return -1;
+        return NULL;
 
     msg->header.prog = prog->program;
     msg->header.vers = prog->version;
@@ -315,8 +307,24 @@ int virNetClientProgramCall(virNetClientProgram *prog,
     if (virNetMessageEncodePayload(msg, args_filter, args) < 0)
         goto error;
 
-    if (virNetClientSendWithReply(client, msg) < 0)
-        goto error;
+    return msg;
+
+ error:
+    virNetMessageFree(msg);
+    return NULL;
+}
+
+
+static int
+virNetClientProgramCallReply(virNetClientProgram *prog,
+                             virNetMessage *msg,
+                             unsigned serial,
+                             int proc,
+                             size_t *ninfds,
+                             int **infds,
+                             xdrproc_t ret_filter, void *ret)
+{
+    size_t i;
 
     /* None of these 3 should ever happen here, because
      * virNetClientSend should have validated the reply,
@@ -326,19 +334,19 @@ int virNetClientProgramCall(virNetClientProgram *prog,
         msg->header.type != VIR_NET_REPLY_WITH_FDS) {
         virReportError(VIR_ERR_INTERNAL_ERROR,
                        _("Unexpected message type %1$d"), msg->header.type);
-        goto error;
+        return -1;
     }
     if (msg->header.proc != proc) {
         virReportError(VIR_ERR_INTERNAL_ERROR,
                        _("Unexpected message proc %1$d != %2$d"),
                        msg->header.proc, proc);
-        goto error;
+        return -1;
     }
     if (msg->header.serial != serial) {
         virReportError(VIR_ERR_INTERNAL_ERROR,
                        _("Unexpected message serial %1$d != %2$d"),
                        msg->header.serial, serial);
-        goto error;
+        return -1;
     }
 
     switch (msg->header.status) {
@@ -354,32 +362,67 @@ int virNetClientProgramCall(virNetClientProgram *prog,
                     virReportSystemError(errno,
                                          _("Cannot duplicate FD %1$d"),
                                          msg->fds[i]);
-                    goto error;
+                    return -1;
                 }
                 if (virSetInherit((*infds)[i], false) < 0) {
                     virReportSystemError(errno,
                                          _("Cannot set close-on-exec %1$d"),
                                          (*infds)[i]);
-                    goto error;
+                    return -1;
                 }
             }
 
         }
         if (virNetMessageDecodePayload(msg, ret_filter, ret) < 0)
-            goto error;
+            return -1;
         break;
 
     case VIR_NET_ERROR:
         virNetClientProgramDispatchError(prog, msg);
-        goto error;
+        return -1;
 
     case VIR_NET_CONTINUE:
     default:
         virReportError(VIR_ERR_RPC,
                        _("Unexpected message status %1$d"), msg->header.status);
-        goto error;
+        return -1;
     }
 
+    return 0;
+}
+
+
+int virNetClientProgramCall(virNetClientProgram *prog,
+                            virNetClient *client,
+                            unsigned serial,
+                            int proc,
+                            size_t noutfds,
+                            int *outfds,
+                            size_t *ninfds,
+                            int **infds,
+                            xdrproc_t args_filter, void *args,
+                            xdrproc_t ret_filter, void *ret)
+{
+    virNetMessage *msg;
+    size_t i;
+
+    if (infds)
+        *infds = NULL;
+    if (ninfds)
+        *ninfds = 0;
+
+    if (!(msg = virNetClientProgramCallMessage(prog, serial, proc,
+                                               noutfds, outfds,
+                                               args_filter, args)))
+        return -1;
+
+    if (virNetClientSendWithReply(client, msg) < 0)
+        goto error;
+
+    if (virNetClientProgramCallReply(prog, msg, serial, proc,
+                                     ninfds, infds, ret_filter, ret) < 0)
+        goto error;
+
     virNetMessageFree(msg);
 
     return 0;
@@ -392,3 +435,78 @@ int virNetClientProgramCall(virNetClientProgram *prog,
     }
     return -1;
 }
+
+
+typedef struct _virNetClientProgramAsyncCall virNetClientProgramAsyncCall;
+struct _virNetClientProgramAsyncCall {
+    virNetClientProgram *prog;
+    unsigned serial;
+    int proc;
+    xdrproc_t ret_filter;
+    void *ret;
+    virNetClientProgramCallFunc func;
+    void *opaque;
+};
+
+
+static void
+virNetClientProgramCallAsyncDone(virNetClient *client G_GNUC_UNUSED,
+                                 virNetMessage *msg,
+                                 void *opaque)
+{
+    virNetClientProgramAsyncCall *call = opaque;
+    int rv = -1;
+
+    if (msg &&
+        virNetClientProgramCallReply(call->prog, msg, call->serial, call->proc,
+                                     NULL, NULL, call->ret_filter, call->ret) == 0)
+        rv = 0;
+
+    call->func(rv, call->opaque);
+
+    virObjectUnref(call->prog);
+    g_free(call);
+}
+
+
+/*
+ * Like virNetClientProgramCall, but returns right after the call is
+ * queued. @func is then run from the event loop with 0 once the reply
+ * is decoded into @ret or with -1 and an error set, so @ret must stay
+ * valid until then.
+ */
+int virNetClientProgramCallAsync(virNetClientProgram *prog,
+                                 virNetClient *client,
+                                 unsigned serial,
+                                 int proc,
+                                 xdrproc_t args_filter, void *args,
+                                 xdrproc_t ret_filter, void *ret,
+                                 virNetClientProgramCallFunc func,
+                                 void *opaque)
+{
+    virNetMessage *msg;
+    virNetClientProgramAsyncCall *call;
+
+    if (!(msg = virNetClientProgramCallMessage(prog, serial, proc, 0, NULL,
+                                               args_filter, args)))
+        return -1;
+
+    call = g_new0(virNetClientProgramAsyncCall, 1);
+    call->prog = virObjectRef(prog);
+    call->serial = serial;
+    call->proc = proc;
+    call->ret_filter = ret_filter;
+    call->ret = ret;
+    call->func = func;
+    call->opaque = opaque;
+
+    if (virNetClientSendAsync(client, msg,
+                              virNetClientProgramCallAsyncDone, call) < 0) {
+        virObjectUnref(call->prog);
+        g_free(call);
+        virNetMessageFree(msg);
+        return -1;
+    }
+
+    return 0;
+}
@@ -72,3 +72,15 @@ int virNetClientProgramCall(virNetClientProgram *prog,
                             int **infds,
                             xdrproc_t args_filter, void *args,
                             xdrproc_t ret_filter, void *ret);
+
+typedef void (*virNetClientProgramCallFunc)(int rv,
+                                            void *opaque);
+
+int virNetClientProgramCallAsync(virNetClientProgram *prog,
+                                 virNetClient *client,
+                                 unsigned serial,
+                                 int proc,
+                                 xdrproc_t args_filter, void *args,
+                                 xdrproc_t ret_filter, void *ret,
+                                 virNetClientProgramCallFunc func,
+                                 void *opaque);
@@ -25,9 +25,16 @@
 #include "virerror.h"
 #include "virlog.h"
 #include "virthread.h"
+#include "virfile.h"
+#include "virsocket.h"
+#include "virutil.h"
 
 #define VIR_FROM_THIS VIR_FROM_RPC
 
+#ifndef MSG_NOSIGNAL
+# define MSG_NOSIGNAL 0
+#endif
+
 VIR_LOG_INIT("rpc.netclientstream");
 
 struct _virNetClientStream {
@@ -59,6 +66,12 @@ struct _virNetClientStream {
     int cbEvents;
     int cbTimer;
     int cbDispatch;
+
+    /* Socket passed by the server carrying the stream data instead of
+     * stream data messages, see virNetClientStreamSetLocalFD() */
+    int localFD;
+    int localWatch;
+    bool cbLocal;
 };
 
 
@@ -79,7 +92,8 @@ VIR_ONCE_GLOBAL_INIT(virNetClientStream);
 static void
 virNetClientStreamEventTimerUpdate(virNetClientStream *st)
 {
-    if (!st->cb)
+    /* Events of a local stream come from its socket */
+    if (!st->cb || st->cbLocal)
         return;
 
     VIR_DEBUG("Check timer rx=%p cbEvents=%d", st->rx, st->cbEvents);
@@ -96,6 +110,28 @@ virNetClientStreamEventTimerUpdate(virNetClientStream *st)
 }
 
 
+/* Called with @st locked */
+static void
+virNetClientStreamEventDispatch(virNetClientStream *st,
+                                int events)
+{
+    if (events) {
+        virNetClientStreamEventCallback cb = st->cb;
+        void *cbOpaque = st->cbOpaque;
+        virFreeCallback cbFree = st->cbFree;
+
+        st->cbDispatch = 1;
+        virObjectUnlock(st);
+        (cb)(st, events, cbOpaque);
+        virObjectLock(st);
+        st->cbDispatch = 0;
+
+        if (!st->cb && cbFree)
+            (cbFree)(cbOpaque);
+    }
+}
+
+
 static void
 virNetClientStreamEventTimer(int timer G_GNUC_UNUSED, void *opaque)
 {
@@ -113,20 +149,24 @@ virNetClientStreamEventTimer(int timer G_GNUC_UNUSED, void *opaque)
         events |= VIR_STREAM_EVENT_WRITABLE;
 
     VIR_DEBUG("Got Timer dispatch events=%d cbEvents=%d rx=%p", events, st->cbEvents, st->rx);
-    if (events) {
-        virNetClientStreamEventCallback cb = st->cb;
-        void *cbOpaque = st->cbOpaque;
-        virFreeCallback cbFree = st->cbFree;
+    virNetClientStreamEventDispatch(st, events);
+    virObjectUnlock(st);
+}
 
-        st->cbDispatch = 1;
-        virObjectUnlock(st);
-        (cb)(st, events, cbOpaque);
-        virObjectLock(st);
-        st->cbDispatch = 0;
 
-        if (!st->cb && cbFree)
-            (cbFree)(cbOpaque);
-    }
+static void
+virNetClientStreamEventLocal(int watch G_GNUC_UNUSED,
+                             int fd G_GNUC_UNUSED,
+                             int events,
+                             void *opaque)
+{
+    virNetClientStream *st = opaque;
+
+    virObjectLock(st);
+
+    VIR_DEBUG("Got local stream dispatch events=%d cbEvents=%d", events, st->cbEvents);
+    if (st->cb)
+        virNetClientStreamEventDispatch(st, events);
     virObjectUnlock(st);
 }
 
@@ -148,6 +188,8 @@ virNetClientStream *virNetClientStreamNew(virNetClientProgram *prog,
     st->proc = proc;
     st->serial = serial;
     st->allowSkip = allowSkip;
+    st->localFD = -1;
+    st->localWatch = -1;
 
     return st;
 }
@@ -162,9 +204,192 @@ void virNetClientStreamDispose(void *obj)
         virNetMessageQueueServe(&st->rx);
         virNetMessageFree(msg);
     }
+    VIR_FORCE_CLOSE(st->localFD);
     virObjectUnref(st->prog);
 }
 
+
+/**
+ * virNetClientStreamSetLocalFD:
+ * @st: stream
+ * @fd: socket carrying the stream data
+ * @nonblock: whether the stream is non-blocking
+ *
+ * Makes @st transfer its data through @fd, which the server passed
+ * along with the reply to the call opening the stream, instead of
+ * stream data messages. The stream takes ownership of @fd.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int
+virNetClientStreamSetLocalFD(virNetClientStream *st,
+                             int fd,
+                             bool nonblock)
+{
+    VIR_LOCK_GUARD lock = virObjectLockGuard(st);
+
+    if (nonblock && virSetNonBlock(fd) < 0) {
+        virReportSystemError(errno, "%s",
+                             _("Unable to set non-blocking mode"));
+        VIR_FORCE_CLOSE(fd);
+        return -1;
+    }
+
+    VIR_DEBUG("st=%p fd=%d", st, fd);
+
+    VIR_FORCE_CLOSE(st->localFD);
+    st->localFD = fd;
+    return 0;
+}
+
+
+/* Called with @st locked. The stream socket is used with @st unlocked,
+ * so each user gets a duplicate which stays valid even if the stream
+ * is finished or aborted meanwhile. */
+static int
+virNetClientStreamDupLocalFD(virNetClientStream *st)
+{
+    int fd;
+
+    if ((fd = dup(st->localFD)) < 0)
+        virReportSystemError(errno, "%s",
+                             _("Unable to duplicate stream socket"));
+
+    return fd;
+}
+
+
+/* Called with @st locked */
+static void
+virNetClientStreamCloseLocal(virNetClientStream *st)
+{
+    if (st->localFD < 0)
+        return;
+
+    if (st->localWatch >= 0) {
+        virEventRemoveHandle(st->localWatch);
+        st->localWatch = -1;
+    }
+
+#ifndef WIN32
+    /* Unlike close(), this wakes up threads blocked on duplicates of the
+     * socket and tells the server right away there's no more data. */
+    ignore_value(shutdown(st->localFD, SHUT_RDWR));
+#endif /* !WIN32 */
+    VIR_FORCE_CLOSE(st->localFD);
+}
+
+
+/*
+ * Called with @st locked once the stream socket reached EOF. The server
+ * then follows up with a stream message saying whether the transfer
+ * succeeded, so the stream carries on as a regular one to receive it.
+ */
+static int
+virNetClientStreamLocalEOF(virNetClientStream *st)
+{
+    bool cbLocal = st->cbLocal;
+
+    VIR_DEBUG("st=%p reached EOF of local stream socket", st);
+
+    virNetClientStreamCloseLocal(st);
+
+    if (!cbLocal)
+        return 0;
+
+    st->cbLocal = false;
+
+    virObjectRef(st);
+    if ((st->cbTimer =
+         virEventAddTimeout(-1,
+                            virNetClientStreamEventTimer,
+                            st,
+                            virObjectUnref)) < 0) {
+        virObjectUnref(st);
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("cannot register stream event timer"));
+        return -1;
+    }
+
+    virNetClientStreamEventTimerUpdate(st);
+
+    return 0;
+}
+
+
+#ifndef WIN32
+static int
+virNetClientStreamSendLocal(int fd,
+                            const char *data,
+                            size_t nbytes)
+{
+    ssize_t ret;
+
+ retry:
+    if ((ret = send(fd, data, nbytes, MSG_NOSIGNAL)) < 0) {
+        VIR_WARNINGS_NO_WLOGICALOP_EQUAL_EXPR
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+            return -2;
+        VIR_WARNINGS_RESET
+        if (errno == EINTR)
+            goto retry;
+        /* The server stops reading only when the transfer failed on
+         * its side, the reason is reported by finishing the stream. */
+        if (errno == EPIPE || errno == ECONNRESET) {
+            virReportError(VIR_ERR_RPC, "%s",
+                           _("remote side stopped receiving stream data"));
+            return -1;
+        }
+        virReportSystemError(errno, "%s", _("cannot write to stream"));
+        return -1;
+    }
+
+    return ret;
+}
+
+
+static int
+virNetClientStreamRecvLocal(int fd,
+                            char *data,
+                            size_t nbytes)
+{
+    ssize_t ret;
+
+ retry:
+    if ((ret = recv(fd, data, nbytes, 0)) < 0) {
+        VIR_WARNINGS_NO_WLOGICALOP_EQUAL_EXPR
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+            return -2;
+        VIR_WARNINGS_RESET
+        if (errno == EINTR)
+            goto retry;
+        virReportSystemError(errno, "%s", _("cannot read from stream"));
+        return -1;
+    }
+
+    return ret;
+}
+#else /* WIN32 */
+static int
+virNetClientStreamSendLocal(int fd G_GNUC_UNUSED,
+                            const char *data G_GNUC_UNUSED,
+                            size_t nbytes G_GNUC_UNUSED)
+{
+    virReportSystemError(ENOSYS, "%s", _("cannot write to stream"));
+    return -1;
+}
+
+
+static int
+virNetClientStreamRecvLocal(int fd G_GNUC_UNUSED,
+                            char *data G_GNUC_UNUSED,
+                            size_t nbytes G_GNUC_UNUSED)
+{
+    virReportSystemError(ENOSYS, "%s", _("cannot read from stream"));
+    return -1;
+}
+#endif /* WIN32 */
+
 bool virNetClientStreamMatches(virNetClientStream *st,
                                virNetMessage *msg)
 {
@@ -338,9 +563,10 @@ int virNetClientStreamQueuePacket(virNetClientStream *st,
 
     /* Steal message buffer */
     tmp_msg->buffer = g_steal_pointer(&msg->buffer);
+    tmp_msg->bufferAlloc = msg->bufferAlloc;
     tmp_msg->bufferLength = msg->bufferLength;
     tmp_msg->bufferOffset = msg->bufferOffset;
-    msg->bufferLength = msg->bufferOffset = 0;
+    msg->bufferAlloc = msg->bufferLength = msg->bufferOffset = 0;
 
     virObjectLock(st);
 
@@ -362,8 +588,25 @@ int virNetClientStreamSendPacket(virNetClientStream *st,
                                  size_t nbytes)
 {
     virNetMessage *msg;
+    VIR_AUTOCLOSE localFD = -1;
     VIR_DEBUG("st=%p status=%d data=%p nbytes=%zu", st, status, data, nbytes);
 
+    virObjectLock(st);
+    if (st->localFD >= 0) {
+        if (status != VIR_NET_CONTINUE) {
+            /* Closing the socket tells the server there's no more data,
+             * the stream is then finished or aborted as usual. */
+            virNetClientStreamCloseLocal(st);
+        } else if ((localFD = virNetClientStreamDupLocalFD(st)) < 0) {
+            virObjectUnlock(st);
+            return -1;
+        }
+    }
+    virObjectUnlock(st);
+
+    if (localFD >= 0)
+        return virNetClientStreamSendLocal(localFD, data, nbytes);
+
     if (!(msg = virNetMessageNew(false)))
         return -1;
 
@@ -520,6 +763,31 @@ int virNetClientStreamRecvPacket(virNetClientStream *st,
     if (virNetClientStreamCheckState(st) < 0)
         goto cleanup;
 
+    if (st->localFD >= 0) {
+        VIR_AUTOCLOSE localFD = -1;
+
+        if ((localFD = virNetClientStreamDupLocalFD(st)) < 0)
+            goto cleanup;
+
+        /* Don't block the client's I/O while waiting for data */
+        virObjectUnlock(st);
+        rv = virNetClientStreamRecvLocal(localFD, data, nbytes);
+        virObjectLock(st);
+
+        /* The socket was closed meanwhile by finishing or aborting
+         * the stream from another thread, nothing more to read. */
+        if (rv != 0 || nbytes == 0 || st->localFD < 0)
+            goto cleanup;
+
+        /* EOF on the socket doesn't mean the transfer succeeded, a
+         * failure on the server side closes the socket too. */
+        rv = -1;
+        if (virNetClientStreamLocalEOF(st) < 0)
+            goto cleanup;
+
+        goto reread;
+    }
+
     if (!st->rx && !st->incomingEOF) {
         virNetMessage *msg;
         int ret;
@@ -720,11 +988,22 @@ int virNetClientStreamEventAddCallback(virNetClientStream *st,
     }
 
     virObjectRef(st);
-    if ((st->cbTimer =
-         virEventAddTimeout(-1,
-                            virNetClientStreamEventTimer,
-                            st,
-                            virObjectUnref)) < 0) {
+    if (st->localFD >= 0) {
+        if ((st->localWatch =
+             virEventAddHandle(st->localFD,
+                               events,
+                               virNetClientStreamEventLocal,
+                               st,
+                               virObjectUnref)) < 0) {
+            virObjectUnref(st);
+            goto cleanup;
+        }
+        st->cbLocal = true;
+    } else if ((st->cbTimer =
+                virEventAddTimeout(-1,
+                                   virNetClientStreamEventTimer,
+                                   st,
+                                   virObjectUnref)) < 0) {
         virObjectUnref(st);
         goto cleanup;
     }
@@ -757,7 +1036,12 @@ int virNetClientStreamEventUpdateCallback(virNetClientStream *st,
 
     st->cbEvents = events;
 
-    virNetClientStreamEventTimerUpdate(st);
+    if (st->cbLocal) {
+        if (st->localWatch >= 0)
+            virEventUpdateHandle(st->localWatch, events);
+    } else {
+        virNetClientStreamEventTimerUpdate(st);
+    }
 
     ret = 0;
 
@@ -784,7 +1068,14 @@ int virNetClientStreamEventRemoveCallback(virNetClientStream *st)
     st->cbOpaque = NULL;
     st->cbFree = NULL;
     st->cbEvents = 0;
-    virEventRemoveTimeout(st->cbTimer);
+    if (st->cbLocal) {
+        if (st->localWatch >= 0)
+            virEventRemoveHandle(st->localWatch);
+        st->localWatch = -1;
+        st->cbLocal = false;
+    } else {
+        virEventRemoveTimeout(st->cbTimer);
+    }
 
     ret = 0;
 
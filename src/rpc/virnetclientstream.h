@@ -55,6 +55,10 @@ bool virNetClientStreamMatches(virNetClientStream *st,
 int virNetClientStreamQueuePacket(virNetClientStream *st,
                                   virNetMessage *msg);
 
+int virNetClientStreamSetLocalFD(virNetClientStream *st,
+                                 int fd,
+                                 bool nonblock);
+
 int virNetClientStreamSendPacket(virNetClientStream *st,
                                  virNetClient *client,
                                  int status,
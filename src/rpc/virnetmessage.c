@@ -34,6 +34,179 @@
 
 VIR_LOG_INIT("rpc.netmessage");
 
+/* Message buffers large enough for a whole message are allocated in size
+ * classes of VIR_NET_MESSAGE_INITIAL doubled up to
+ * VIR_NET_MESSAGE_BUFFER_CLASSES times (plus the length word) and kept on
+ * per-class freelists when released, so that the common case of a small
+ * call or reply doesn't need to allocate any memory. Smaller buffers (the
+ * length word being read) and buffers larger than the largest class are
+ * allocated and freed directly. */
+#define VIR_NET_MESSAGE_BUFFER_CLASSES 5
+#define VIR_NET_MESSAGE_BUFFER_CLASS_SIZE(i) \
+    (((size_t)VIR_NET_MESSAGE_INITIAL << (i)) + VIR_NET_MESSAGE_LEN_MAX)
+
+/* Upper limit on memory kept on each freelist */
+#define VIR_NET_MESSAGE_BUFFER_CACHE_MAX (4 * 1024 * 1024)
+
+typedef struct _virNetMessageBufferFree virNetMessageBufferFree;
+struct _virNetMessageBufferFree {
+    virNetMessageBufferFree *next;
+};
+
+static struct {
+    virMutex lock;
+    virNetMessageBufferFree *freelist[VIR_NET_MESSAGE_BUFFER_CLASSES];
+    size_t nfree[VIR_NET_MESSAGE_BUFFER_CLASSES];
+    virNetMessageBufferStats stats;
+} virNetMessageBufferPool = { .lock = VIR_MUTEX_INITIALIZER };
+
+
+static int
+virNetMessageBufferClass(size_t size)
+{
+    size_t i;
+
+    if (size < VIR_NET_MESSAGE_BUFFER_CLASS_SIZE(0) / 2)
+        return -1;
+
+    for (i = 0; i < VIR_NET_MESSAGE_BUFFER_CLASSES; i++) {
+        if (size <= VIR_NET_MESSAGE_BUFFER_CLASS_SIZE(i))
+            return i;
+    }
+
+    return -1;
+}
+
+
+static char *
+virNetMessageBufferAlloc(size_t size,
+                         size_t *alloc)
+{
+    int cls = virNetMessageBufferClass(size);
+    virNetMessageBufferFree *buf = NULL;
+
+    if (cls < 0) {
+        *alloc = size;
+        return g_new0(char, size);
+    }
+
+    *alloc = VIR_NET_MESSAGE_BUFFER_CLASS_SIZE(cls);
+
+    VIR_WITH_MUTEX_LOCK_GUARD(&virNetMessageBufferPool.lock) {
+        virNetMessageBufferStats *stats = &virNetMessageBufferPool.stats;
+
+        if ((buf = virNetMessageBufferPool.freelist[cls])) {
+            virNetMessageBufferPool.freelist[cls] = buf->next;
+            virNetMessageBufferPool.nfree[cls]--;
+            stats->cached--;
+            stats->cachedBytes -= *alloc;
+            stats->hits++;
+        } else {
+            stats->misses++;
+        }
+
+        if (++stats->inUse > stats->peakInUse)
+            stats->peakInUse = stats->inUse;
+    }
+
+    if (buf) {
+        buf->next = NULL;
+        return (char *)buf;
+    }
+
+    return g_new0(char, *alloc);
+}
+
+
+/*
+ * @buffer: message buffer to release
+ * @alloc: allocated size of @buffer
+ * @used: number of bytes of @buffer which may hold data
+ *
+ * Erases the used part of @buffer and either puts it onto a freelist
+ * or frees it.
+ */
+static void
+virNetMessageBufferRelease(char *buffer,
+                           size_t alloc,
+                           size_t used)
+{
+    int cls = virNetMessageBufferClass(alloc);
+
+    virSecureErase(buffer, MIN(used, alloc));
+
+    if (cls < 0 || alloc != VIR_NET_MESSAGE_BUFFER_CLASS_SIZE(cls)) {
+        g_free(buffer);
+        return;
+    }
+
+    VIR_WITH_MUTEX_LOCK_GUARD(&virNetMessageBufferPool.lock) {
+        virNetMessageBufferStats *stats = &virNetMessageBufferPool.stats;
+        virNetMessageBufferFree *buf = (virNetMessageBufferFree *)buffer;
+
+        stats->inUse--;
+
+        if ((virNetMessageBufferPool.nfree[cls] + 1) * alloc <=
+            VIR_NET_MESSAGE_BUFFER_CACHE_MAX) {
+            buf->next = virNetMessageBufferPool.freelist[cls];
+            virNetMessageBufferPool.freelist[cls] = buf;
+            virNetMessageBufferPool.nfree[cls]++;
+            stats->cached++;
+            stats->cachedBytes += alloc;
+            buffer = NULL;
+        }
+    }
+
+    g_free(buffer);
+}
+
+
+/**
+ * virNetMessageResizeBuffer:
+ * @msg: message
+ * @len: new length of the message buffer
+ *
+ * Sets the length of the buffer of @msg to @len, making sure the buffer is
+ * large enough while preserving its contents. Buffers are reused from a
+ * pool shared by all messages whenever possible.
+ */
+void
+virNetMessageResizeBuffer(virNetMessage *msg,
+                          size_t len)
+{
+    if (len > msg->bufferAlloc) {
+        size_t alloc;
+        char *buffer = virNetMessageBufferAlloc(len, &alloc);
+
+        if (msg->buffer) {
+            memcpy(buffer, msg->buffer, MIN(msg->bufferLength, msg->bufferAlloc));
+            virNetMessageBufferRelease(msg->buffer, msg->bufferAlloc,
+                                       msg->bufferLength);
+        }
+
+        msg->buffer = buffer;
+        msg->bufferAlloc = alloc;
+    }
+
+    msg->bufferLength = len;
+}
+
+
+/**
+ * virNetMessageGetBufferStats:
+ * @stats: filled with statistics
+ *
+ * Get usage statistics of the pool of message buffers.
+ */
+void
+virNetMessageGetBufferStats(virNetMessageBufferStats *stats)
+{
+    VIR_LOCK_GUARD lock = virLockGuardLock(&virNetMessageBufferPool.lock);
+
+    *stats = virNetMessageBufferPool.stats;
+}
+
+
 virNetMessage *virNetMessageNew(bool tracked)
 {
     virNetMessage *msg;
@@ -66,10 +239,13 @@ virNetMessageClearPayload(virNetMessage *msg)
 {
     virNetMessageClearFDs(msg);
 
-    virSecureErase(msg->buffer, msg->bufferLength);
+    if (msg->buffer)
+        virNetMessageBufferRelease(msg->buffer, msg->bufferAlloc,
+                                   msg->bufferLength);
+    msg->buffer = NULL;
+    msg->bufferAlloc = 0;
     msg->bufferOffset = 0;
     msg->bufferLength = 0;
-    VIR_FREE(msg->buffer);
 }
 
 
@@ -163,8 +339,7 @@ int virNetMessageDecodeLength(virNetMessage *msg)
 
     /* Extend our declared buffer length and carry
        on reading the header + payload */
-    msg->bufferLength += len;
-    VIR_REALLOC_N(msg->buffer, msg->bufferLength);
+    virNetMessageResizeBuffer(msg, msg->bufferLength + len);
 
     VIR_DEBUG("Got length, now need %zu total (%u more)",
               msg->bufferLength, len);
@@ -239,8 +414,7 @@ int virNetMessageEncodeHeader(virNetMessage *msg)
     int ret = -1;
     unsigned int len = 0;
 
-    msg->bufferLength = VIR_NET_MESSAGE_INITIAL + VIR_NET_MESSAGE_LEN_MAX;
-    VIR_REALLOC_N(msg->buffer, msg->bufferLength);
+    virNetMessageResizeBuffer(msg, VIR_NET_MESSAGE_INITIAL + VIR_NET_MESSAGE_LEN_MAX);
     msg->bufferOffset = 0;
 
     /* Format the header. */
@@ -378,9 +552,7 @@ int virNetMessageEncodePayload(virNetMessage *msg,
 
         xdr_destroy(&xdr);
 
-        msg->bufferLength = newlen + VIR_NET_MESSAGE_LEN_MAX;
-
-        VIR_REALLOC_N(msg->buffer, msg->bufferLength);
+        virNetMessageResizeBuffer(msg, newlen + VIR_NET_MESSAGE_LEN_MAX);
 
         xdrmem_create(&xdr, msg->buffer + msg->bufferOffset,
                       msg->bufferLength - msg->bufferOffset, XDR_ENCODE);
@@ -441,45 +613,55 @@ int virNetMessageDecodePayload(virNetMessage *msg,
 
 
 /**
- * virNetMessageEncodePayloadRaw:
+ * virNetMessageReservePayloadRaw:
  * @msg: message to encode payload into
- * @data: data to encode into @msg
- * @len: length of @data
+ * @len: maximum length of the payload
  *
- * Encodes message payload. If @data is NULL or @len is 0 an empty message is
- * encoded.
+ * Makes sure the buffer of @msg has room for @len bytes of raw payload after
+ * the already encoded header, so that the payload can be produced directly in
+ * the message buffer. The payload is finished by virNetMessageCommitPayloadRaw.
+ *
+ * Returns pointer to the payload area in the buffer of @msg, or NULL on error.
  */
-int virNetMessageEncodePayloadRaw(virNetMessage *msg,
-                                  const char *data,
+char *virNetMessageReservePayloadRaw(virNetMessage *msg,
+                                     size_t len)
+{
+    if ((msg->bufferLength - msg->bufferOffset) < len) {
+        if ((msg->bufferOffset + len) >
+            (VIR_NET_MESSAGE_MAX + VIR_NET_MESSAGE_LEN_MAX)) {
+            virReportError(VIR_ERR_RPC,
+                           _("Stream data too long to send (%1$zu bytes needed, %2$zu bytes available)"),
+                           len,
+                           VIR_NET_MESSAGE_MAX +
+                           VIR_NET_MESSAGE_LEN_MAX -
+                           msg->bufferOffset);
+            return NULL;
+        }
+
+        virNetMessageResizeBuffer(msg, msg->bufferOffset + len);
+
+        VIR_DEBUG("Increased message buffer length = %zu", msg->bufferLength);
+    }
+
+    return msg->buffer + msg->bufferOffset;
+}
+
+
+/**
+ * virNetMessageCommitPayloadRaw:
+ * @msg: message to encode payload into
+ * @len: length of the payload
+ *
+ * Finishes encoding of @len bytes of raw payload which were stored into the
+ * area returned by virNetMessageReservePayloadRaw.
+ */
+int virNetMessageCommitPayloadRaw(virNetMessage *msg,
                                   size_t len)
 {
     XDR xdr;
     unsigned int msglen;
 
-    if (data && len > 0) {
-        /* If the message buffer is too small for the payload increase it accordingly. */
-        if ((msg->bufferLength - msg->bufferOffset) < len) {
-            if ((msg->bufferOffset + len) >
-                (VIR_NET_MESSAGE_MAX + VIR_NET_MESSAGE_LEN_MAX)) {
-                virReportError(VIR_ERR_RPC,
-                               _("Stream data too long to send (%1$zu bytes needed, %2$zu bytes available)"),
-                               len,
-                               VIR_NET_MESSAGE_MAX +
-                               VIR_NET_MESSAGE_LEN_MAX -
-                               msg->bufferOffset);
-                return -1;
-            }
-
-            msg->bufferLength = msg->bufferOffset + len;
-
-            VIR_REALLOC_N(msg->buffer, msg->bufferLength);
-
-            VIR_DEBUG("Increased message buffer length = %zu", msg->bufferLength);
-        }
-
-        memcpy(msg->buffer + msg->bufferOffset, data, len);
-        msg->bufferOffset += len;
-    }
+    msg->bufferOffset += len;
 
     /* Re-encode the length word. */
     VIR_DEBUG("Encode length as %zu", msg->bufferOffset);
@@ -501,6 +683,34 @@ int virNetMessageEncodePayloadRaw(virNetMessage *msg,
 }
 
 
+/**
+ * virNetMessageEncodePayloadRaw:
+ * @msg: message to encode payload into
+ * @data: data to encode into @msg
+ * @len: length of @data
+ *
+ * Encodes message payload. If @data is NULL or @len is 0 an empty message is
+ * encoded.
+ */
+int virNetMessageEncodePayloadRaw(virNetMessage *msg,
+                                  const char *data,
+                                  size_t len)
+{
+    if (data && len > 0) {
+        char *payload;
+
+        if (!(payload = virNetMessageReservePayloadRaw(msg, len)))
+            return -1;
+
+        memcpy(payload, data, len);
+    } else {
+        len = 0;
+    }
+
+    return virNetMessageCommitPayloadRaw(msg, len);
+}
+
+
 void virNetMessageSaveError(struct virNetMessageError *rerr)
 {
     virErrorPtr verr;
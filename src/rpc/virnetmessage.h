@@ -33,6 +33,7 @@ struct _virNetMessage {
                   /* Maximum   VIR_NET_MESSAGE_MAX     + VIR_NET_MESSAGE_LEN_MAX */
     size_t bufferLength;
     size_t bufferOffset;
+    size_t bufferAlloc; /* allocated size of buffer, see virNetMessageResizeBuffer */
 
     virNetMessageHeader header;
 
@@ -47,8 +48,23 @@ struct _virNetMessage {
 };
 
 
+typedef struct _virNetMessageBufferStats virNetMessageBufferStats;
+struct _virNetMessageBufferStats {
+    unsigned long long hits; /* buffers reused from the pool */
+    unsigned long long misses; /* buffers which had to be allocated */
+    size_t inUse; /* pooled buffers currently held by messages */
+    size_t peakInUse;
+    size_t cached; /* buffers kept for reuse */
+    size_t cachedBytes;
+};
+
 virNetMessage *virNetMessageNew(bool tracked);
 
+void virNetMessageResizeBuffer(virNetMessage *msg, size_t len)
+    ATTRIBUTE_NONNULL(1);
+void virNetMessageGetBufferStats(virNetMessageBufferStats *stats)
+    ATTRIBUTE_NONNULL(1);
+
 void virNetMessageClearFDs(virNetMessage *msg);
 void virNetMessageClearPayload(virNetMessage *msg);
 
@@ -81,6 +97,12 @@ int virNetMessageDecodePayload(virNetMessage *msg,
 int virNetMessageEncodeNumFDs(virNetMessage *msg);
 int virNetMessageDecodeNumFDs(virNetMessage *msg);
 
+char *virNetMessageReservePayloadRaw(virNetMessage *msg,
+                                     size_t len)
+    ATTRIBUTE_NONNULL(1) G_GNUC_WARN_UNUSED_RESULT;
+int virNetMessageCommitPayloadRaw(virNetMessage *msg,
+                                  size_t len)
+    ATTRIBUTE_NONNULL(1) G_GNUC_WARN_UNUSED_RESULT;
 int virNetMessageEncodePayloadRaw(virNetMessage *msg,
                                   const char *buf,
                                   size_t len)
@@ -46,6 +46,13 @@ const VIR_NET_MESSAGE_HEADER_MAX = 24;
 /* Size of message payload */
 const VIR_NET_MESSAGE_PAYLOAD_MAX = 33554408;
 
+/* Size of stream data payload sent to peers which advertise
+ * VIR_DRV_FEATURE_REMOTE_STREAM_LARGE_PAYLOAD. Large enough to make the
+ * per-message overhead negligible while keeping the memory used by a
+ * single stream bounded.
+ */
+const VIR_NET_MESSAGE_STREAM_PAYLOAD_MAX = 4194304;
+
 /* Size of message length field. Not counted in VIR_NET_MESSAGE_MAX
  * and VIR_NET_MESSAGE_INITIAL.
  */
@@ -27,6 +27,7 @@
 #include "virerror.h"
 #include "virthread.h"
 #include "virthreadpool.h"
+#include "vireventthread.h"
 #include "virutil.h"
 
 #define VIR_FROM_THIS VIR_FROM_RPC
@@ -49,6 +50,12 @@ struct _virNetServer {
     /* Immutable pointer, self-locking APIs */
     virThreadPool *workers;
 
+    /* Event loop threads the socket I/O of clients is spread across.
+     * Clients are handled by the default event loop if there are none. */
+    size_t niothreads;
+    virEventThread **iothreads;
+    size_t nextIOThread;
+
     size_t nservices;
     virNetServerService **services;
 
@@ -224,7 +231,9 @@ virNetServerDispatchNewMessage(virNetServerClient *client,
             priority = virNetServerProgramGetPriority(prog, msg->header.proc);
         }
 
-        if (virThreadPoolSendJob(srv->workers, priority, job) < 0) {
+        /* Keyed by client so that clients get their calls processed
+         * in turns regardless of how many each of them has queued */
+        if (virThreadPoolSendJobFull(srv->workers, priority, client, job) < 0) {
             virObjectUnref(client);
             VIR_FREE(job);
             virObjectUnref(prog);
@@ -301,6 +310,14 @@ virNetServerAddClient(virNetServer *srv,
 {
     VIR_LOCK_GUARD lock = virObjectLockGuard(srv);
 
+    if (srv->niothreads > 0) {
+        virEventThread *evt = srv->iothreads[srv->nextIOThread++ % srv->niothreads];
+
+        if (virNetServerClientSetEventContext(client,
+                                              virEventThreadGetContext(evt)) < 0)
+            return -1;
+    }
+
     if (virNetServerClientInit(client) < 0)
         return -1;
 
@@ -860,6 +877,10 @@ virNetServerDispose(void *obj)
 
     virThreadPoolFree(srv->workers);
 
+    for (i = 0; i < srv->niothreads; i++)
+        g_object_unref(srv->iothreads[i]);
+    g_free(srv->iothreads);
+
     for (i = 0; i < srv->nservices; i++)
         virObjectUnref(srv->services[i]);
     g_free(srv->services);
@@ -877,12 +898,12 @@ virNetServerDispose(void *obj)
 void
 virNetServerClose(virNetServer *srv)
 {
+    size_t i;
+
     if (!srv)
         return;
 
     VIR_WITH_OBJECT_LOCK_GUARD(srv) {
-        size_t i;
-
         for (i = 0; i < srv->nservices; i++)
             virNetServerServiceClose(srv->services[i]);
 
@@ -891,6 +912,18 @@ virNetServerClose(virNetServer *srv)
 
         virThreadPoolStop(srv->workers);
     }
+
+    /* Not holding the lock as the I/O threads may be waiting for it.
+     * The threads are never changed once started. */
+    for (i = 0; i < srv->niothreads; i++) {
+        GMainContext *context = virEventThreadGetContext(srv->iothreads[i]);
+
+        virEventThreadStop(srv->iothreads[i]);
+
+        /* Release the callbacks of the sockets closed above */
+        while (g_main_context_pending(context))
+            g_main_context_iteration(context, FALSE);
+    }
 }
 
 
@@ -994,6 +1027,47 @@ virNetServerGetThreadPoolParameters(virNetServer *srv,
 }
 
 
+void
+virNetServerGetJobWaitStats(virNetServer *srv,
+                            unsigned long long *buckets)
+{
+    virThreadPoolGetJobWaitStats(srv->workers, buckets);
+}
+
+
+/**
+ * virNetServerSetMaxClientWorkers:
+ * @srv: server object
+ * @maxClientWorkers: maximum number of workers, 0 for no limit
+ *
+ * Limits the number of workers processing calls of a single client at
+ * the same time, so that a client issuing many slow calls can't occupy
+ * all of them.
+ */
+void
+virNetServerSetMaxClientWorkers(virNetServer *srv,
+                                size_t maxClientWorkers)
+{
+    virThreadPoolSetMaxKeyWorkers(srv->workers, maxClientWorkers);
+}
+
+
+/**
+ * virNetServerSetWorkerIdleTimeout:
+ * @srv: server object
+ * @timeout: timeout in seconds, 0 to keep idle workers forever
+ *
+ * Makes workers spawned above the minimal number of workers exit once
+ * they had nothing to do for @timeout seconds.
+ */
+void
+virNetServerSetWorkerIdleTimeout(virNetServer *srv,
+                                 unsigned int timeout)
+{
+    virThreadPoolSetIdleTimeout(srv->workers, timeout);
+}
+
+
 int
 virNetServerSetThreadPoolParameters(virNetServer *srv,
                                     long long int minWorkers,
@@ -1007,6 +1081,56 @@ virNetServerSetThreadPoolParameters(virNetServer *srv,
 }
 
 
+/**
+ * virNetServerSetIOThreads:
+ * @srv: server object
+ * @niothreads: number of threads
+ *
+ * Starts @niothreads threads, each running its own event loop, and
+ * makes the socket I/O of clients added from now on, including TLS
+ * and message decoding, run from them instead of the default event
+ * loop. Clients are assigned to the threads in turns. With zero
+ * threads everything stays in the default event loop. This can be
+ * done only once.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int
+virNetServerSetIOThreads(virNetServer *srv,
+                         size_t niothreads)
+{
+    VIR_LOCK_GUARD lock = virObjectLockGuard(srv);
+    g_autofree char *name = NULL;
+    size_t i;
+
+    if (srv->iothreads) {
+        virReportError(VIR_ERR_OPERATION_INVALID, "%s",
+                       _("I/O threads are already running"));
+        return -1;
+    }
+
+    if (niothreads == 0)
+        return 0;
+
+    name = g_strdup_printf("rpc-io-%s", srv->name);
+    srv->iothreads = g_new0(virEventThread *, niothreads);
+
+    for (i = 0; i < niothreads; i++) {
+        if (!(srv->iothreads[i] = virEventThreadNew(name)))
+            goto error;
+    }
+
+    srv->niothreads = niothreads;
+    return 0;
+
+ error:
+    for (i = 0; i < niothreads; i++)
+        g_clear_object(&srv->iothreads[i]);
+    g_clear_pointer(&srv->iothreads, g_free);
+    return -1;
+}
+
+
 size_t
 virNetServerGetMaxClients(virNetServer *srv)
 {
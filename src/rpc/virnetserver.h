@@ -109,11 +109,23 @@ int virNetServerGetThreadPoolParameters(virNetServer *srv,
                                         size_t *nPrioWorkers,
                                         size_t *jobQueueDepth);
 
+void virNetServerGetJobWaitStats(virNetServer *srv,
+                                 unsigned long long *buckets);
+
+void virNetServerSetMaxClientWorkers(virNetServer *srv,
+                                     size_t maxClientWorkers);
+
+void virNetServerSetWorkerIdleTimeout(virNetServer *srv,
+                                      unsigned int timeout);
+
 int virNetServerSetThreadPoolParameters(virNetServer *srv,
                                         long long int minWorkers,
                                         long long int maxWorkers,
                                         long long int prioWorkers);
 
+int virNetServerSetIOThreads(virNetServer *srv,
+                             size_t niothreads);
+
 unsigned long long virNetServerNextClientID(virNetServer *srv);
 
 virNetServerClient *virNetServerGetClient(virNetServer *srv,
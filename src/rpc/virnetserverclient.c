@@ -73,6 +73,8 @@ struct _virNetServerClient
 #if WITH_SASL
     virNetSASLSession *sasl;
 #endif
+    /* Compress data once the current reply is sent */
+    virNetMessage *compressReply;
     int sockTimer; /* Timer to be fired upon cached data,
                     * so we jump out from poll() immediately */
 
@@ -301,8 +303,7 @@ virNetServerClientCheckAccess(virNetServerClient *client)
      * indicate this (otherwise the socket is abruptly closed).
      * (NB. The '\1' byte is sent in an encrypted record).
      */
-    confirm->bufferLength = 1;
-    confirm->buffer = g_new0(char, confirm->bufferLength);
+    virNetMessageResizeBuffer(confirm, 1);
     confirm->bufferOffset = 0;
     confirm->buffer[0] = '\1';
 
@@ -402,8 +403,7 @@ virNetServerClientNewInternal(unsigned long long id,
     /* Prepare one for packet receive */
     if (!(client->rx = virNetMessageNew(true)))
         goto error;
-    client->rx->bufferLength = VIR_NET_MESSAGE_LEN_MAX;
-    client->rx->buffer = g_new0(char, client->rx->bufferLength);
+    virNetMessageResizeBuffer(client->rx, VIR_NET_MESSAGE_LEN_MAX);
     client->nrequests = 1;
 
     PROBE(RPC_SERVER_CLIENT_NEW,
@@ -840,6 +840,24 @@ bool virNetServerClientIsSecure(virNetServerClient *client)
 }
 
 
+/*
+ * Ask for the data exchanged with @client to be compressed once @msg,
+ * the call being processed, has been sent back as a reply. Returns false
+ * if compression is not supported.
+ */
+bool virNetServerClientSetCompression(virNetServerClient *client,
+                                      virNetMessage *msg)
+{
+    VIR_LOCK_GUARD lock = virObjectLockGuard(client);
+
+    if (!virNetSocketCompressionSupported())
+        return false;
+
+    client->compressReply = msg;
+    return true;
+}
+
+
 #if WITH_SASL
 void virNetServerClientSetSASLSession(virNetServerClient *client,
                                       virNetSASLSession *sasl)
@@ -1054,6 +1072,26 @@ virNetServerClientWantCloseLocked(virNetServerClient *client)
 }
 
 
+/**
+ * virNetServerClientSetEventContext:
+ * @client: client object
+ * @context: GLib main context
+ *
+ * Makes the socket I/O of @client, including the TLS handshake and
+ * message decoding, run from @context instead of the default event
+ * loop. Must be called before virNetServerClientInit().
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int virNetServerClientSetEventContext(virNetServerClient *client,
+                                      GMainContext *context)
+{
+    VIR_LOCK_GUARD lock = virObjectLockGuard(client);
+
+    return virNetSocketSetEventContext(client->sock, context);
+}
+
+
 int virNetServerClientInit(virNetServerClient *client)
 {
     VIR_LOCK_GUARD lock = virObjectLockGuard(client);
@@ -1257,8 +1295,7 @@ static virNetMessage *virNetServerClientDispatchRead(virNetServerClient *client)
         /* Possibly need to create another receive buffer */
         if (client->nrequests < client->nrequests_max) {
             client->rx = virNetMessageNew(true);
-            client->rx->bufferLength = VIR_NET_MESSAGE_LEN_MAX;
-            client->rx->buffer = g_new0(char, client->rx->bufferLength);
+            virNetMessageResizeBuffer(client->rx, VIR_NET_MESSAGE_LEN_MAX);
             client->nrequests++;
         } else if (!client->nrequests_warning &&
                    client->nrequests_max > 1) {
@@ -1352,6 +1389,17 @@ virNetServerClientDispatchWrite(virNetServerClient *client)
             }
 #endif
 
+            /* Likewise, the client expects compressed data only after
+             * the reply agreeing to it, not after an event or keepalive
+             * message queued before it */
+            if (client->compressReply && client->compressReply == client->tx) {
+                if (virNetSocketSetCompression(client->sock) < 0) {
+                    client->wantClose = true;
+                    return;
+                }
+                client->compressReply = NULL;
+            }
+
             /* Get finished msg from head of tx queue */
             msg = virNetMessageQueueServe(&client->tx);
 
@@ -1362,8 +1410,7 @@ virNetServerClientDispatchWrite(virNetServerClient *client)
                     client->nrequests < client->nrequests_max) {
                     /* Ready to recv more messages */
                     virNetMessageClear(msg);
-                    msg->bufferLength = VIR_NET_MESSAGE_LEN_MAX;
-                    msg->buffer = g_new0(char, msg->bufferLength);
+                    virNetMessageResizeBuffer(msg, VIR_NET_MESSAGE_LEN_MAX);
                     client->rx = g_steal_pointer(&msg);
                     client->nrequests++;
                 }
@@ -1413,6 +1460,7 @@ virNetServerClientDispatchEvent(virNetSocket *sock, int events, void *opaque)
 {
     virNetServerClient *client = opaque;
     virNetMessage *msg = NULL;
+    bool wantClose;
 
     VIR_WITH_OBJECT_LOCK_GUARD(client) {
         if (client->sock != sock) {
@@ -1436,8 +1484,15 @@ virNetServerClientDispatchEvent(virNetSocket *sock, int events, void *opaque)
         /* NB, will get HANGUP + READABLE at same time upon disconnect */
         if (events & (VIR_EVENT_HANDLE_ERROR | VIR_EVENT_HANDLE_HANGUP))
             client->wantClose = true;
+
+        wantClose = client->wantClose;
     }
 
+    /* Closed clients are reaped by the daemon's main loop, which needs
+     * waking up if this callback runs from a separate I/O thread. */
+    if (wantClose)
+        g_main_context_wakeup(NULL);
+
     if (msg)
         virNetServerClientDispatchMessage(client, msg);
 }
@@ -105,6 +105,9 @@ bool virNetServerClientHasTLSSession(virNetServerClient *client);
 virNetTLSSession *virNetServerClientGetTLSSession(virNetServerClient *client);
 int virNetServerClientGetTLSKeySize(virNetServerClient *client);
 
+bool virNetServerClientSetCompression(virNetServerClient *client,
+                                      virNetMessage *msg);
+
 #ifdef WITH_SASL
 bool virNetServerClientHasSASLSession(virNetServerClient *client);
 void virNetServerClientSetSASLSession(virNetServerClient *client,
@@ -147,6 +150,9 @@ void virNetServerClientDelayedClose(virNetServerClient *client);
 void virNetServerClientImmediateClose(virNetServerClient *client);
 bool virNetServerClientWantCloseLocked(virNetServerClient *client);
 
+int virNetServerClientSetEventContext(virNetServerClient *client,
+                                      GMainContext *context);
+
 int virNetServerClientInit(virNetServerClient *client);
 
 int virNetServerClientInitKeepAlive(virNetServerClient *client,
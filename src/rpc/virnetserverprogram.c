@@ -520,6 +520,58 @@ int virNetServerProgramSendStreamData(virNetServerProgram *prog,
 }
 
 
+/**
+ * virNetServerProgramReserveStreamData:
+ * @prog: server program
+ * @msg: message to send the data in
+ * @procedure: stream procedure
+ * @serial: stream serial
+ * @len: maximum length of the data
+ *
+ * Prepares @msg for sending up to @len bytes of stream data and returns a
+ * pointer into the message buffer where the data can be read to directly
+ * which avoids copying it. The message is then sent by
+ * virNetServerProgramSendReservedStreamData.
+ *
+ * Returns pointer to store the data at, or NULL on error.
+ */
+char *virNetServerProgramReserveStreamData(virNetServerProgram *prog,
+                                           virNetMessage *msg,
+                                           int procedure,
+                                           unsigned int serial,
+                                           size_t len)
+{
+    VIR_DEBUG("msg=%p len=%zu", msg, len);
+
+    msg->header.prog = prog->program;
+    msg->header.vers = prog->version;
+    msg->header.proc = procedure;
+    msg->header.type = VIR_NET_STREAM;
+    msg->header.serial = serial;
+    msg->header.status = VIR_NET_CONTINUE;
+
+    if (virNetMessageEncodeHeader(msg) < 0)
+        return NULL;
+
+    return virNetMessageReservePayloadRaw(msg, len);
+}
+
+
+int virNetServerProgramSendReservedStreamData(virNetServerClient *client,
+                                              virNetMessage *msg,
+                                              size_t len)
+{
+    VIR_DEBUG("client=%p msg=%p len=%zu", client, msg, len);
+
+    if (virNetMessageCommitPayloadRaw(msg, len) < 0)
+        return -1;
+
+    VIR_DEBUG("Total %zu", msg->bufferLength);
+
+    return virNetServerClientSendMessage(client, msg);
+}
+
+
 int virNetServerProgramSendStreamHole(virNetServerProgram *prog,
                                       virNetServerClient *client,
                                       virNetMessage *msg,
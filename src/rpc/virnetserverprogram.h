@@ -93,6 +93,16 @@ int virNetServerProgramSendStreamData(virNetServerProgram *prog,
                                       const char *data,
                                       size_t len);
 
+char *virNetServerProgramReserveStreamData(virNetServerProgram *prog,
+                                           virNetMessage *msg,
+                                           int procedure,
+                                           unsigned int serial,
+                                           size_t len);
+
+int virNetServerProgramSendReservedStreamData(virNetServerClient *client,
+                                              virNetMessage *msg,
+                                              size_t len);
+
 int virNetServerProgramSendStreamHole(virNetServerProgram *prog,
                                       virNetServerClient *client,
                                       virNetMessage *msg,
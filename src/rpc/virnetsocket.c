@@ -37,6 +37,10 @@
 # include <selinux/selinux.h>
 #endif
 
+#if WITH_ZSTD
+# include <zstd.h>
+#endif
+
 #include "virsocket.h"
 #include "virnetsocket.h"
 #include "virutil.h"
@@ -48,6 +52,8 @@
 #include "virprobe.h"
 #include "virprocess.h"
 #include "virstring.h"
+#include "vireventglib.h"
+#include "vireventglibwatch.h"
 
 #if WITH_SSH2
 # include "virnetsshsession.h"
@@ -61,6 +67,22 @@
 
 VIR_LOG_INIT("rpc.netsocket");
 
+#if WITH_ZSTD
+/* With compression enabled, data is sent in frames starting with a big
+ * endian word holding the length of the frame data, with the top bit
+ * set if the data is compressed. */
+# define VIR_NET_SOCKET_COMPRESS_HEADER_LEN 4
+# define VIR_NET_SOCKET_COMPRESS_FLAG 0x80000000U
+
+/* Largest amount of plain data in a single frame */
+# define VIR_NET_SOCKET_COMPRESS_FRAME_MAX (256 * 1024)
+
+/* Smaller writes don't compress well enough to be worth it */
+# define VIR_NET_SOCKET_COMPRESS_THRESHOLD 1024
+
+# define VIR_NET_SOCKET_COMPRESS_LEVEL 1
+#endif
+
 struct _virNetSocket {
     virObjectLockable parent;
 
@@ -78,6 +100,13 @@ struct _virNetSocket {
     void *opaque;
     virFreeCallback ff;
 
+    /* Set if the event callback is dispatched from @context rather than
+     * the default event loop, in which case @watch is unused */
+    GMainContext *context;
+    GSource *source;
+    int sourceEvents;
+    bool contextWatch;
+
     virSocketAddr localAddr;
     virSocketAddr remoteAddr;
     char *localAddrStrSASL;
@@ -97,6 +126,26 @@ struct _virNetSocket {
     size_t saslEncodedRawLength;
     size_t saslEncodedOffset;
 #endif
+#if WITH_ZSTD
+    ZSTD_CCtx *zstdCompress;
+    ZSTD_DCtx *zstdDecompress;
+
+    unsigned char compressHeader[VIR_NET_SOCKET_COMPRESS_HEADER_LEN];
+    size_t compressHeaderOffset;
+    char *compressFrame;
+    size_t compressFrameLength;
+    size_t compressFrameOffset;
+    bool compressFrameCompressed;
+
+    char *compressDecoded;
+    size_t compressDecodedLength;
+    size_t compressDecodedOffset;
+
+    char *compressEncoded;
+    size_t compressEncodedLength;
+    size_t compressEncodedRawLength;
+    size_t compressEncodedOffset;
+#endif
 #if WITH_SSH2
     virNetSSHSession *sshSession;
 #endif
@@ -1231,6 +1280,13 @@ virJSONValue *virNetSocketPreExecRestart(virNetSocket *sock)
                        _("Unable to save socket state when SASL session is active"));
         goto error;
     }
+#endif
+#if WITH_ZSTD
+    if (sock->zstdCompress) {
+        virReportError(VIR_ERR_OPERATION_INVALID, "%s",
+                       _("Unable to save socket state when compression is active"));
+        goto error;
+    }
 #endif
     if (sock->tlsSession) {
         virReportError(VIR_ERR_OPERATION_INVALID, "%s",
@@ -1289,6 +1345,8 @@ void virNetSocketDispose(void *obj)
         virEventRemoveHandle(sock->watch);
         sock->watch = -1;
     }
+    if (sock->context)
+        g_main_context_unref(sock->context);
 
 #ifndef WIN32
     /* If a server socket, then unlink UNIX path */
@@ -1306,6 +1364,14 @@ void virNetSocketDispose(void *obj)
     virObjectUnref(sock->saslSession);
 #endif
 
+#if WITH_ZSTD
+    ZSTD_freeCCtx(sock->zstdCompress);
+    ZSTD_freeDCtx(sock->zstdDecompress);
+    g_free(sock->compressFrame);
+    g_free(sock->compressDecoded);
+    g_free(sock->compressEncoded);
+#endif
+
 #if WITH_SSH2
     virObjectUnref(sock->sshSession);
 #endif
@@ -1652,6 +1718,46 @@ void virNetSocketSetSASLSession(virNetSocket *sock,
 #endif
 
 
+bool virNetSocketCompressionSupported(void)
+{
+#if WITH_ZSTD
+    return true;
+#else
+    return false;
+#endif
+}
+
+
+/*
+ * Compress all data read from and written to @sock from now on. Both
+ * ends of the connection must switch at the same point of the data
+ * stream, which is up to the protocol on top of the socket.
+ */
+int virNetSocketSetCompression(virNetSocket *sock G_GNUC_UNUSED)
+{
+#if WITH_ZSTD
+    VIR_LOCK_GUARD lock = virObjectLockGuard(sock);
+
+    if (sock->zstdCompress)
+        return 0;
+
+    if (!(sock->zstdCompress = ZSTD_createCCtx()) ||
+        !(sock->zstdDecompress = ZSTD_createDCtx())) {
+        g_clear_pointer(&sock->zstdCompress, ZSTD_freeCCtx);
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("Unable to allocate compression context"));
+        return -1;
+    }
+
+    return 0;
+#else
+    virReportError(VIR_ERR_OPERATION_UNSUPPORTED, "%s",
+                   _("Compression is not supported by this build"));
+    return -1;
+#endif
+}
+
+
 bool virNetSocketHasCachedData(virNetSocket *sock G_GNUC_UNUSED)
 {
     bool hasCached = false;
@@ -1671,6 +1777,11 @@ bool virNetSocketHasCachedData(virNetSocket *sock G_GNUC_UNUSED)
     if (sock->saslDecoded)
         hasCached = true;
 #endif
+
+#if WITH_ZSTD
+    if (sock->compressDecoded)
+        hasCached = true;
+#endif
     virObjectUnlock(sock);
     return hasCached;
 }
@@ -1714,6 +1825,10 @@ bool virNetSocketHasPendingData(virNetSocket *sock G_GNUC_UNUSED)
 #if WITH_SASL
     if (sock->saslEncoded)
         hasPending = true;
+#endif
+#if WITH_ZSTD
+    if (sock->compressEncoded)
+        hasPending = true;
 #endif
     virObjectUnlock(sock);
     return hasPending;
@@ -1934,16 +2049,243 @@ static ssize_t virNetSocketWriteSASL(virNetSocket *sock, const char *buf, size_t
 }
 #endif
 
+static ssize_t virNetSocketReadLayer(virNetSocket *sock, char *buf, size_t len)
+{
+#if WITH_SASL
+    if (sock->saslSession)
+        return virNetSocketReadSASL(sock, buf, len);
+#endif
+    return virNetSocketReadWire(sock, buf, len);
+}
+
+
+static ssize_t virNetSocketWriteLayer(virNetSocket *sock, const char *buf, size_t len)
+{
+#if WITH_SASL
+    if (sock->saslSession)
+        return virNetSocketWriteSASL(sock, buf, len);
+#endif
+    return virNetSocketWriteWire(sock, buf, len);
+}
+
+
+#if WITH_ZSTD
+static int virNetSocketCompressParseHeader(virNetSocket *sock)
+{
+    uint32_t header = ((uint32_t)sock->compressHeader[0] << 24) |
+                      ((uint32_t)sock->compressHeader[1] << 16) |
+                      ((uint32_t)sock->compressHeader[2] << 8) |
+                      sock->compressHeader[3];
+    size_t len = header & ~VIR_NET_SOCKET_COMPRESS_FLAG;
+    size_t max = VIR_NET_SOCKET_COMPRESS_FRAME_MAX;
+
+    sock->compressFrameCompressed = !!(header & VIR_NET_SOCKET_COMPRESS_FLAG);
+    if (sock->compressFrameCompressed)
+        max = ZSTD_compressBound(max);
+
+    if (len == 0 || len > max) {
+        virReportError(VIR_ERR_RPC,
+                       _("Invalid length %1$zu of compressed transport frame"),
+                       len);
+        return -1;
+    }
+
+    sock->compressFrame = g_new(char, len);
+    sock->compressFrameLength = len;
+    sock->compressFrameOffset = 0;
+    return 0;
+}
+
+
+static int virNetSocketCompressDecodeFrame(virNetSocket *sock)
+{
+    g_autofree char *frame = g_steal_pointer(&sock->compressFrame);
+    size_t frameLength = sock->compressFrameLength;
+    g_autofree char *decoded = NULL;
+    unsigned long long len;
+    size_t ret;
+
+    sock->compressHeaderOffset = 0;
+    sock->compressFrameLength = sock->compressFrameOffset = 0;
+
+    if (!sock->compressFrameCompressed) {
+        sock->compressDecoded = g_steal_pointer(&frame);
+        sock->compressDecodedLength = frameLength;
+        sock->compressDecodedOffset = 0;
+        return 0;
+    }
+
+    len = ZSTD_getFrameContentSize(frame, frameLength);
+    if (len == ZSTD_CONTENTSIZE_UNKNOWN ||
+        len == ZSTD_CONTENTSIZE_ERROR ||
+        len == 0 ||
+        len > VIR_NET_SOCKET_COMPRESS_FRAME_MAX) {
+        virReportError(VIR_ERR_RPC, "%s",
+                       _("Malformed compressed transport frame"));
+        return -1;
+    }
+
+    decoded = g_new(char, len);
+    ret = ZSTD_decompressDCtx(sock->zstdDecompress, decoded, len,
+                              frame, frameLength);
+    if (ZSTD_isError(ret)) {
+        virReportError(VIR_ERR_RPC,
+                       _("Unable to decompress transport frame: %1$s"),
+                       ZSTD_getErrorName(ret));
+        return -1;
+    }
+    if (ret != len) {
+        virReportError(VIR_ERR_RPC, "%s",
+                       _("Malformed compressed transport frame"));
+        return -1;
+    }
+
+    sock->compressDecoded = g_steal_pointer(&decoded);
+    sock->compressDecodedLength = len;
+    sock->compressDecodedOffset = 0;
+    return 0;
+}
+
+
+static ssize_t virNetSocketReadCompressed(virNetSocket *sock, char *buf, size_t len)
+{
+    ssize_t got;
+
+    /* Need to read a whole frame off the wire first */
+    while (!sock->compressDecoded) {
+        if (sock->compressHeaderOffset < VIR_NET_SOCKET_COMPRESS_HEADER_LEN) {
+            got = virNetSocketReadLayer(sock,
+                                        (char *)sock->compressHeader + sock->compressHeaderOffset,
+                                        VIR_NET_SOCKET_COMPRESS_HEADER_LEN - sock->compressHeaderOffset);
+            if (got <= 0)
+                return got;
+
+            sock->compressHeaderOffset += got;
+            if (sock->compressHeaderOffset == VIR_NET_SOCKET_COMPRESS_HEADER_LEN &&
+                virNetSocketCompressParseHeader(sock) < 0)
+                return -1;
+            continue;
+        }
+
+        got = virNetSocketReadLayer(sock,
+                                    sock->compressFrame + sock->compressFrameOffset,
+                                    sock->compressFrameLength - sock->compressFrameOffset);
+        if (got <= 0)
+            return got;
+
+        sock->compressFrameOffset += got;
+        if (sock->compressFrameOffset == sock->compressFrameLength &&
+            virNetSocketCompressDecodeFrame(sock) < 0)
+            return -1;
+    }
+
+    /* Some buffered decoded data to return now */
+    got = sock->compressDecodedLength - sock->compressDecodedOffset;
+
+    if (len > got)
+        len = got;
+
+    memcpy(buf, sock->compressDecoded + sock->compressDecodedOffset, len);
+    sock->compressDecodedOffset += len;
+
+    if (sock->compressDecodedOffset == sock->compressDecodedLength) {
+        g_clear_pointer(&sock->compressDecoded, g_free);
+        sock->compressDecodedOffset = sock->compressDecodedLength = 0;
+    }
+
+    return len;
+}
+
+
+static int virNetSocketCompressEncodeFrame(virNetSocket *sock,
+                                           const char *buf,
+                                           size_t len)
+{
+    size_t bound = len >= VIR_NET_SOCKET_COMPRESS_THRESHOLD ?
+        ZSTD_compressBound(len) : len;
+    g_autofree char *frame = g_new(char, VIR_NET_SOCKET_COMPRESS_HEADER_LEN + bound);
+    char *data = frame + VIR_NET_SOCKET_COMPRESS_HEADER_LEN;
+    uint32_t header = len;
+
+    if (len >= VIR_NET_SOCKET_COMPRESS_THRESHOLD) {
+        size_t ret = ZSTD_compressCCtx(sock->zstdCompress, data, bound,
+                                       buf, len,
+                                       VIR_NET_SOCKET_COMPRESS_LEVEL);
+
+        if (ZSTD_isError(ret)) {
+            virReportError(VIR_ERR_INTERNAL_ERROR,
+                           _("Unable to compress transport frame: %1$s"),
+                           ZSTD_getErrorName(ret));
+            return -1;
+        }
+
+        /* Incompressible data is sent as it is */
+        if (ret < len)
+            header = ret | VIR_NET_SOCKET_COMPRESS_FLAG;
+    }
+
+    if (!(header & VIR_NET_SOCKET_COMPRESS_FLAG))
+        memcpy(data, buf, len);
+
+    frame[0] = header >> 24;
+    frame[1] = header >> 16;
+    frame[2] = header >> 8;
+    frame[3] = header;
+
+    sock->compressEncoded = g_steal_pointer(&frame);
+    sock->compressEncodedLength = VIR_NET_SOCKET_COMPRESS_HEADER_LEN +
+        (header & ~VIR_NET_SOCKET_COMPRESS_FLAG);
+    sock->compressEncodedRawLength = len;
+    sock->compressEncodedOffset = 0;
+    return 0;
+}
+
+
+static ssize_t virNetSocketWriteCompressed(virNetSocket *sock, const char *buf, size_t len)
+{
+    ssize_t ret;
+
+    /* Not got any pending encoded data, so we need to encode raw stuff */
+    if (!sock->compressEncoded &&
+        virNetSocketCompressEncodeFrame(sock, buf,
+                                        MIN(len, VIR_NET_SOCKET_COMPRESS_FRAME_MAX)) < 0)
+        return -1;
+
+    ret = virNetSocketWriteLayer(sock,
+                                 sock->compressEncoded + sock->compressEncodedOffset,
+                                 sock->compressEncodedLength - sock->compressEncodedOffset);
+
+    if (ret <= 0)
+        return ret; /* -1 error, 0 == egain */
+
+    sock->compressEncodedOffset += ret;
+
+    /* Like with SASL, report the raw data as sent only once the whole
+     * frame is out, the caller retries with the same buffer until then */
+    if (sock->compressEncodedOffset == sock->compressEncodedLength) {
+        ssize_t done = sock->compressEncodedRawLength;
+
+        g_clear_pointer(&sock->compressEncoded, g_free);
+        sock->compressEncodedOffset = sock->compressEncodedLength = 0;
+        sock->compressEncodedRawLength = 0;
+        return done;
+    }
+
+    return 0;
+}
+#endif
+
+
 ssize_t virNetSocketRead(virNetSocket *sock, char *buf, size_t len)
 {
     ssize_t ret;
     virObjectLock(sock);
-#if WITH_SASL
-    if (sock->saslSession)
-        ret = virNetSocketReadSASL(sock, buf, len);
+#if WITH_ZSTD
+    if (sock->zstdDecompress)
+        ret = virNetSocketReadCompressed(sock, buf, len);
     else
 #endif
-        ret = virNetSocketReadWire(sock, buf, len);
+        ret = virNetSocketReadLayer(sock, buf, len);
     virObjectUnlock(sock);
     return ret;
 }
@@ -1953,12 +2295,12 @@ ssize_t virNetSocketWrite(virNetSocket *sock, const char *buf, size_t len)
     ssize_t ret;
 
     virObjectLock(sock);
-#if WITH_SASL
-    if (sock->saslSession)
-        ret = virNetSocketWriteSASL(sock, buf, len);
+#if WITH_ZSTD
+    if (sock->zstdCompress)
+        ret = virNetSocketWriteCompressed(sock, buf, len);
     else
 #endif
-        ret = virNetSocketWriteWire(sock, buf, len);
+        ret = virNetSocketWriteLayer(sock, buf, len);
     virObjectUnlock(sock);
     return ret;
 }
@@ -2140,6 +2482,88 @@ static void virNetSocketEventFree(void *opaque)
         ff(eopaque);
 }
 
+/**
+ * virNetSocketSetEventContext:
+ * @sock: socket object
+ * @context: GLib main context
+ *
+ * Makes the I/O callback of @sock be dispatched from @context instead
+ * of the default event loop. This must be called before the callback
+ * is registered, and the thread iterating @context is expected to run
+ * for as long as the callback is.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int virNetSocketSetEventContext(virNetSocket *sock,
+                                GMainContext *context)
+{
+    VIR_LOCK_GUARD lock = virObjectLockGuard(sock);
+
+    if (sock->watch >= 0 || sock->contextWatch) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("Cannot change event context of a watched socket"));
+        return -1;
+    }
+
+    if (sock->context)
+        g_main_context_unref(sock->context);
+    sock->context = context ? g_main_context_ref(context) : NULL;
+
+    return 0;
+}
+
+
+static gboolean
+virNetSocketEventContextDispatch(int fd,
+                                 GIOCondition condition,
+                                 gpointer opaque)
+{
+    virNetSocketEventHandle(-1, fd,
+                            virEventGLibConditionToEvents(condition),
+                            opaque);
+    return G_SOURCE_CONTINUE;
+}
+
+
+static gboolean
+virNetSocketEventContextFree(gpointer opaque)
+{
+    virNetSocketEventFree(opaque);
+    return G_SOURCE_REMOVE;
+}
+
+
+/*
+ * Replaces the source watching @sock in its event context with one
+ * for @events. GLib can't change the condition of an existing source.
+ *
+ * @sock must be locked.
+ */
+static void
+virNetSocketEventContextUpdate(virNetSocket *sock,
+                               int events)
+{
+    if (sock->source) {
+        if (events == sock->sourceEvents)
+            return;
+
+        g_source_destroy(sock->source);
+        g_clear_pointer(&sock->source, g_source_unref);
+    }
+
+    sock->sourceEvents = events;
+    if (events == 0)
+        return;
+
+    sock->source = virEventGLibAddSocketWatch(sock->fd,
+                                              virEventGLibEventsToCondition(events),
+                                              sock->context,
+                                              virNetSocketEventContextDispatch,
+                                              virObjectRef(sock),
+                                              virObjectUnref);
+}
+
+
 int virNetSocketAddIOCallback(virNetSocket *sock,
                               int events,
                               virNetSocketIOFunc func,
@@ -2150,16 +2574,19 @@ int virNetSocketAddIOCallback(virNetSocket *sock,
 
     virObjectRef(sock);
     virObjectLock(sock);
-    if (sock->watch >= 0) {
+    if (sock->watch >= 0 || sock->contextWatch) {
         VIR_DEBUG("Watch already registered on socket %p", sock);
         goto cleanup;
     }
 
-    if ((sock->watch = virEventAddHandle(sock->fd,
-                                         events,
-                                         virNetSocketEventHandle,
-                                         sock,
-                                         virNetSocketEventFree)) < 0) {
+    if (sock->context) {
+        virNetSocketEventContextUpdate(sock, events);
+        sock->contextWatch = true;
+    } else if ((sock->watch = virEventAddHandle(sock->fd,
+                                                events,
+                                                virNetSocketEventHandle,
+                                                sock,
+                                                virNetSocketEventFree)) < 0) {
         VIR_DEBUG("Failed to register watch on socket %p", sock);
         goto cleanup;
     }
@@ -2180,6 +2607,12 @@ void virNetSocketUpdateIOCallback(virNetSocket *sock,
                                   int events)
 {
     virObjectLock(sock);
+    if (sock->contextWatch) {
+        virNetSocketEventContextUpdate(sock, events);
+        virObjectUnlock(sock);
+        return;
+    }
+
     if (sock->watch < 0) {
         VIR_DEBUG("Watch not registered on socket %p", sock);
         virObjectUnlock(sock);
@@ -2195,6 +2628,22 @@ void virNetSocketRemoveIOCallback(virNetSocket *sock)
 {
     virObjectLock(sock);
 
+    if (sock->contextWatch) {
+        g_autoptr(GSource) idle = g_idle_source_new();
+
+        virNetSocketEventContextUpdate(sock, 0);
+        sock->contextWatch = false;
+
+        /* Like the default event loop, release the callback data only
+         * once a dispatch possibly running in the context has finished.
+         * Don't unref @sock, it's done via the idle callback. */
+        g_source_set_callback(idle, virNetSocketEventContextFree, sock, NULL);
+        g_source_attach(idle, sock->context);
+
+        virObjectUnlock(sock);
+        return;
+    }
+
     if (sock->watch < 0) {
         VIR_DEBUG("Watch not registered on socket %p", sock);
         virObjectUnlock(sock);
@@ -155,6 +155,8 @@ void virNetSocketSetTLSSession(virNetSocket *sock,
 void virNetSocketSetSASLSession(virNetSocket *sock,
                                 virNetSASLSession *sess);
 #endif
+bool virNetSocketCompressionSupported(void);
+int virNetSocketSetCompression(virNetSocket *sock);
 bool virNetSocketHasCachedData(virNetSocket *sock);
 bool virNetSocketHasPendingData(virNetSocket *sock);
 
@@ -166,6 +168,9 @@ int virNetSocketListen(virNetSocket *sock, int backlog);
 int virNetSocketAccept(virNetSocket *sock,
                        virNetSocket **clientsock);
 
+int virNetSocketSetEventContext(virNetSocket *sock,
+                                GMainContext *context);
+
 int virNetSocketAddIOCallback(virNetSocket *sock,
                               int events,
                               virNetSocketIOFunc func,
@@ -43,15 +43,32 @@
 
 VIR_LOG_INIT("rpc.nettlscontext");
 
+/* How long a successful validation of a peer certificate chain is
+ * trusted for before it is checked again, in seconds */
+#define VIR_NET_TLS_CERT_CACHE_TTL 300
+#define VIR_NET_TLS_CERT_CACHE_MAX 1024
+
+/* Number of servers a client keeps session resumption data for */
+#define VIR_NET_TLS_SESSION_CACHE_MAX 64
+
 struct _virNetTLSContext {
     virObjectLockable parent;
 
     gnutls_certificate_credentials_t x509cred;
+    gnutls_datum_t ticketKey;
 
     bool isServer;
     bool requireValidCert;
     const char *const *x509dnACL;
     char *priority;
+
+    /* Identifies client contexts with the same credentials and
+     * priority, which may thus resume each other's sessions */
+    char *sessionCacheKey;
+
+    /* Peer certificate chains which passed validation recently, keyed
+     * by a digest of the chain */
+    GHashTable *certCache;
 };
 
 struct _virNetTLSSession {
@@ -61,6 +78,7 @@ struct _virNetTLSSession {
 
     bool isServer;
     char *hostname;
+    char *cacheKey;
     gnutls_session_t session;
     virNetTLSSessionWriteFunc writeFunc;
     virNetTLSSessionReadFunc readFunc;
@@ -68,11 +86,50 @@ struct _virNetTLSSession {
     char *x509dname;
 };
 
+typedef struct _virNetTLSCertCacheEntry virNetTLSCertCacheEntry;
+struct _virNetTLSCertCacheEntry {
+    char *dname;
+    time_t expires;
+};
+
+typedef struct _virNetTLSSessionCacheEntry virNetTLSSessionCacheEntry;
+struct _virNetTLSSessionCacheEntry {
+    gnutls_datum_t data;
+    gint64 stamp;
+};
+
 static virClass *virNetTLSContextClass;
 static virClass *virNetTLSSessionClass;
 static void virNetTLSContextDispose(void *obj);
 static void virNetTLSSessionDispose(void *obj);
 
+/* Session resumption data of client sessions, shared by all client
+ * contexts since those are usually created for every connection */
+static virMutex virNetTLSSessionCacheLock = VIR_MUTEX_INITIALIZER;
+static GHashTable *virNetTLSSessionCache;
+
+
+static void
+virNetTLSCertCacheEntryFree(void *opaque)
+{
+    virNetTLSCertCacheEntry *entry = opaque;
+
+    g_free(entry->dname);
+    g_free(entry);
+}
+
+
+static void
+virNetTLSSessionCacheEntryFree(void *opaque)
+{
+    virNetTLSSessionCacheEntry *entry = opaque;
+
+    gnutls_free(entry->data.data);
+    g_free(entry);
+}
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(virNetTLSSessionCacheEntry, virNetTLSSessionCacheEntryFree);
+
 
 static int virNetTLSContextOnceInit(void)
 {
@@ -82,6 +139,10 @@ static int virNetTLSContextOnceInit(void)
     if (!VIR_CLASS_NEW(virNetTLSSession, virClassForObjectLockable()))
         return -1;
 
+    virNetTLSSessionCache = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                  g_free,
+                                                  virNetTLSSessionCacheEntryFree);
+
     return 0;
 }
 
@@ -230,6 +291,25 @@ static virNetTLSContext *virNetTLSContextNew(const char *cacert,
     if (virNetTLSContextLoadCredentials(ctxt, isServer, cacert, cacrl, cert, key) < 0)
         goto error;
 
+    if (isServer) {
+        if ((err = gnutls_session_ticket_key_generate(&ctxt->ticketKey)) < 0) {
+            virReportError(VIR_ERR_SYSTEM_ERROR,
+                           _("Unable to generate TLS session ticket key: %1$s"),
+                           gnutls_strerror(err));
+            goto error;
+        }
+
+        ctxt->certCache = g_hash_table_new_full(g_bytes_hash, g_bytes_equal,
+                                                (GDestroyNotify)g_bytes_unref,
+                                                virNetTLSCertCacheEntryFree);
+    } else {
+        ctxt->sessionCacheKey = g_strdup_printf("%s\n%s\n%s\n%s",
+                                                NULLSTR_EMPTY(cacert),
+                                                NULLSTR_EMPTY(cert),
+                                                NULLSTR_EMPTY(key),
+                                                NULLSTR_EMPTY(priority));
+    }
+
     ctxt->requireValidCert = requireValidCert;
     ctxt->x509dnACL = x509dnACL;
     ctxt->isServer = isServer;
@@ -390,6 +470,11 @@ int virNetTLSContextReloadForServer(virNetTLSContext *ctxt,
 
     gnutls_certificate_free_credentials(x509credBak);
 
+    /* The CA or the revocation list may have changed */
+    VIR_WITH_OBJECT_LOCK_GUARD(ctxt) {
+        g_hash_table_remove_all(ctxt->certCache);
+    }
+
     return 0;
 
  error:
@@ -413,6 +498,101 @@ virNetTLSContext *virNetTLSContextNewClient(const char *cacert,
 }
 
 
+static GBytes *
+virNetTLSContextCertCacheKey(const gnutls_datum_t *certs,
+                             unsigned int nCerts)
+{
+    gnutls_hash_hd_t hash;
+    unsigned char digest[32];
+    size_t i;
+
+    if (gnutls_hash_init(&hash, GNUTLS_DIG_SHA256) < 0)
+        return NULL;
+
+    for (i = 0; i < nCerts; i++)
+        gnutls_hash(hash, certs[i].data, certs[i].size);
+
+    gnutls_hash_deinit(hash, digest);
+
+    return g_bytes_new(digest, sizeof(digest));
+}
+
+
+/*
+ * Look up the certificate chain presented by the peer of @sess among
+ * those which passed validation recently. On success, @key is filled
+ * in with the key of the chain so that it can be added to the cache
+ * after a full validation.
+ *
+ * Returns the cached entry or NULL if the chain has to be validated.
+ */
+static virNetTLSCertCacheEntry *
+virNetTLSContextCertCacheLookup(virNetTLSContext *ctxt,
+                                virNetTLSSession *sess,
+                                GBytes **key)
+{
+    virNetTLSCertCacheEntry *entry;
+    const gnutls_datum_t *certs;
+    unsigned int nCerts;
+
+    if (!ctxt->certCache ||
+        gnutls_certificate_type_get(sess->session) != GNUTLS_CRT_X509 ||
+        !(certs = gnutls_certificate_get_peers(sess->session, &nCerts)) ||
+        !(*key = virNetTLSContextCertCacheKey(certs, nCerts)))
+        return NULL;
+
+    if (!(entry = g_hash_table_lookup(ctxt->certCache, *key)))
+        return NULL;
+
+    if (entry->expires <= time(NULL)) {
+        g_hash_table_remove(ctxt->certCache, *key);
+        return NULL;
+    }
+
+    return entry;
+}
+
+
+static gboolean
+virNetTLSContextCertCacheExpired(void *key G_GNUC_UNUSED,
+                                 void *value,
+                                 void *opaque)
+{
+    virNetTLSCertCacheEntry *entry = value;
+    time_t *now = opaque;
+
+    return entry->expires <= *now;
+}
+
+
+static void
+virNetTLSContextCertCacheAdd(virNetTLSContext *ctxt,
+                             GBytes *key,
+                             const char *dname,
+                             time_t expires)
+{
+    virNetTLSCertCacheEntry *entry;
+    time_t now = time(NULL);
+
+    if (!ctxt->certCache || !key || expires <= now)
+        return;
+
+    if (g_hash_table_size(ctxt->certCache) >= VIR_NET_TLS_CERT_CACHE_MAX) {
+        g_hash_table_foreach_remove(ctxt->certCache,
+                                    virNetTLSContextCertCacheExpired, &now);
+
+        if (g_hash_table_size(ctxt->certCache) >= VIR_NET_TLS_CERT_CACHE_MAX)
+            g_hash_table_remove_all(ctxt->certCache);
+    }
+
+    entry = g_new0(virNetTLSCertCacheEntry, 1);
+    entry->dname = g_strdup(dname);
+    entry->expires = expires;
+
+    g_hash_table_insert(ctxt->certCache, g_bytes_ref(key), entry);
+}
+
+
 static int virNetTLSContextValidCertificate(virNetTLSContext *ctxt,
                                             virNetTLSSession *sess)
 {
@@ -424,6 +604,16 @@ static int virNetTLSContextValidCertificate(virNetTLSContext *ctxt,
     size_t dnamesize = 256;
     g_autofree char *dname = g_new0(char, dnamesize);
     char *dnameptr = dname;
+    g_autoptr(GBytes) cacheKey = NULL;
+    virNetTLSCertCacheEntry *cached;
+    time_t expires = time(NULL) + VIR_NET_TLS_CERT_CACHE_TTL;
+
+    if ((cached = virNetTLSContextCertCacheLookup(ctxt, sess, &cacheKey))) {
+        VIR_DEBUG("Peer certificate chain of sess=%p was validated recently",
+                  sess);
+        sess->x509dname = g_strdup(cached->dname);
+        goto allow;
+    }
 
     if ((ret = gnutls_certificate_verify_peers2(sess->session, &status)) < 0) {
         virReportError(VIR_ERR_SYSTEM_ERROR,
@@ -497,9 +687,14 @@ static int virNetTLSContextValidCertificate(virNetTLSContext *ctxt,
             }
         }
 
+        expires = MIN(expires, gnutls_x509_crt_get_expiration_time(cert));
+
         gnutls_x509_crt_deinit(cert);
     }
 
+    virNetTLSContextCertCacheAdd(ctxt, cacheKey, sess->x509dname, expires);
+
+ allow:
     PROBE(RPC_TLS_CONTEXT_SESSION_ALLOW,
           "ctxt=%p sess=%p dname=%s",
           ctxt, sess, dnameptr);
@@ -556,10 +751,112 @@ void virNetTLSContextDispose(void *obj)
           "ctxt=%p", ctxt);
 
     g_free(ctxt->priority);
+    g_free(ctxt->sessionCacheKey);
+    g_clear_pointer(&ctxt->certCache, g_hash_table_unref);
+    if (ctxt->ticketKey.data) {
+        gnutls_memset(ctxt->ticketKey.data, 0, ctxt->ticketKey.size);
+        gnutls_free(ctxt->ticketKey.data);
+    }
     gnutls_certificate_free_credentials(ctxt->x509cred);
 }
 
 
+/* Must be called with virNetTLSSessionCacheLock held */
+static void
+virNetTLSSessionCacheEvictOldest(void)
+{
+    GHashTableIter iter;
+    void *key;
+    void *value;
+    const char *oldestKey = NULL;
+    gint64 oldest = G_MAXINT64;
+
+    g_hash_table_iter_init(&iter, virNetTLSSessionCache);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        virNetTLSSessionCacheEntry *entry = value;
+
+        if (entry->stamp < oldest) {
+            oldest = entry->stamp;
+            oldestKey = key;
+        }
+    }
+
+    if (oldestKey)
+        g_hash_table_remove(virNetTLSSessionCache, oldestKey);
+}
+
+
+/*
+ * Remember the data needed to resume the session @sess when
+ * connecting to the same server again.
+ */
+static void
+virNetTLSSessionCacheStore(virNetTLSSession *sess)
+{
+    g_autoptr(virNetTLSSessionCacheEntry) entry = g_new0(virNetTLSSessionCacheEntry, 1);
+    int err;
+
+    if (!sess->cacheKey)
+        return;
+
+    if ((err = gnutls_session_get_data2(sess->session, &entry->data)) < 0) {
+        VIR_DEBUG("Unable to get TLS session data: %s", gnutls_strerror(err));
+        return;
+    }
+    entry->stamp = g_get_monotonic_time();
+
+    VIR_WITH_MUTEX_LOCK_GUARD(&virNetTLSSessionCacheLock) {
+        if (g_hash_table_size(virNetTLSSessionCache) >= VIR_NET_TLS_SESSION_CACHE_MAX &&
+            !g_hash_table_contains(virNetTLSSessionCache, sess->cacheKey))
+            virNetTLSSessionCacheEvictOldest();
+
+        g_hash_table_replace(virNetTLSSessionCache, g_strdup(sess->cacheKey),
+                             g_steal_pointer(&entry));
+    }
+}
+
+
+/*
+ * Offer the server to resume a previous session with it. TLS 1.3
+ * tickets are not supposed to be reused, so the data is dropped from
+ * the cache. The server will send a new ticket on the resumed session.
+ */
+static void
+virNetTLSSessionCacheLoad(virNetTLSSession *sess)
+{
+    g_autoptr(virNetTLSSessionCacheEntry) entry = NULL;
+    int err;
+
+    VIR_WITH_MUTEX_LOCK_GUARD(&virNetTLSSessionCacheLock) {
+        if (!g_hash_table_steal_extended(virNetTLSSessionCache, sess->cacheKey,
+                                         NULL, (void **)&entry))
+            return;
+    }
+
+    if ((err = gnutls_session_set_data(sess->session, entry->data.data,
+                                       entry->data.size)) < 0)
+        VIR_DEBUG("Unable to set TLS session data: %s", gnutls_strerror(err));
+}
+
+
+static int
+virNetTLSSessionTicketHook(gnutls_session_t session,
+                           unsigned int htype G_GNUC_UNUSED,
+                           unsigned int when G_GNUC_UNUSED,
+                           unsigned int incoming,
+                           const gnutls_datum_t *msg G_GNUC_UNUSED)
+{
+    /* Tickets of older protocol versions arrive during the handshake and
+     * the session data is only complete once it finishes */
+    if (!incoming ||
+        gnutls_protocol_get_version(session) <= GNUTLS_TLS1_2)
+        return 0;
+
+    virNetTLSSessionCacheStore(gnutls_transport_get_ptr(session));
+    return 0;
+}
+
+
 static ssize_t
 virNetTLSSessionPush(void *opaque, const void *buf, size_t len)
 {
@@ -602,6 +899,9 @@ virNetTLSSession *virNetTLSSessionNew(virNetTLSContext *ctxt,
         return NULL;
 
     sess->hostname = g_strdup(hostname);
+    if (!ctxt->isServer && hostname)
+        sess->cacheKey = g_strdup_printf("%s\n%s",
+                                         ctxt->sessionCacheKey, hostname);
 
     if ((err = gnutls_init(&sess->session,
                            ctxt->isServer ? GNUTLS_SERVER : GNUTLS_CLIENT)) != 0) {
@@ -638,6 +938,21 @@ virNetTLSSession *virNetTLSSessionNew(virNetTLSContext *ctxt,
      */
     if (ctxt->isServer) {
         gnutls_certificate_server_set_request(sess->session, GNUTLS_CERT_REQUEST);
+
+        /* let clients resume sessions without a full handshake */
+        if ((err = gnutls_session_ticket_enable_server(sess->session,
+                                                       &ctxt->ticketKey)) < 0) {
+            virReportError(VIR_ERR_SYSTEM_ERROR,
+                           _("Failed to enable TLS session tickets: %1$s"),
+                           gnutls_strerror(err));
+            goto error;
+        }
+    } else if (sess->cacheKey) {
+        gnutls_handshake_set_hook_function(sess->session,
+                                           GNUTLS_HANDSHAKE_NEW_SESSION_TICKET,
+                                           GNUTLS_HOOK_POST,
+                                           virNetTLSSessionTicketHook);
+        virNetTLSSessionCacheLoad(sess);
     }
 
     gnutls_transport_set_ptr(sess->session, sess);
@@ -745,7 +1060,11 @@ int virNetTLSSessionHandshake(virNetTLSSession *sess)
     VIR_DEBUG("Ret=%d", ret);
     if (ret == 0) {
         sess->handshakeComplete = true;
-        VIR_DEBUG("Handshake is complete");
+        VIR_DEBUG("Handshake is complete, resumed=%d",
+                  gnutls_session_is_resumed(sess->session));
+        if (!sess->isServer &&
+            gnutls_protocol_get_version(sess->session) <= GNUTLS_TLS1_2)
+            virNetTLSSessionCacheStore(sess);
         goto cleanup;
     }
     if (ret == GNUTLS_E_INTERRUPTED || ret == GNUTLS_E_AGAIN) {
@@ -801,6 +1120,17 @@ int virNetTLSSessionGetKeySize(virNetTLSSession *sess)
     return ssf;
 }
 
+bool virNetTLSSessionIsResumed(virNetTLSSession *sess)
+{
+    bool ret;
+
+    virObjectLock(sess);
+    ret = gnutls_session_is_resumed(sess->session) != 0;
+    virObjectUnlock(sess);
+
+    return ret;
+}
+
 const char *virNetTLSSessionGetX509DName(virNetTLSSession *sess)
 {
     const char *ret = NULL;
@@ -823,6 +1153,7 @@ void virNetTLSSessionDispose(void *obj)
 
     g_free(sess->x509dname);
     g_free(sess->hostname);
+    g_free(sess->cacheKey);
     gnutls_deinit(sess->session);
 }
 
@@ -24,8 +24,10 @@
 #include "virobject.h"
 
 typedef struct _virNetTLSContext virNetTLSContext;
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(virNetTLSContext, virObjectUnref);
 
 typedef struct _virNetTLSSession virNetTLSSession;
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(virNetTLSSession, virObjectUnref);
 
 
 void virNetTLSInit(void);
@@ -98,4 +100,6 @@ virNetTLSSessionGetHandshakeStatus(virNetTLSSession *sess);
 
 int virNetTLSSessionGetKeySize(virNetTLSSession *sess);
 
+bool virNetTLSSessionIsResumed(virNetTLSSession *sess);
+
 const char *virNetTLSSessionGetX509DName(virNetTLSSession *sess);
@@ -104,6 +104,9 @@ struct _virStorageBackend {
     virStorageBackendStartPool startPool;
     virStorageBackendBuildPool buildPool;
     virStorageBackendRefreshPool refreshPool; /* Must be non-NULL */
+    /* refreshPool updates the volumes found by the previous refresh rather
+     * than expecting an empty list */
+    bool incrementalRefresh;
     virStorageBackendStopPool stopPool;
     virStorageBackendDeletePool deletePool;
 
@@ -47,6 +47,7 @@
 #include "configmake.h"
 #include "viraccessapicheck.h"
 #include "storage_util.h"
+#include "storage_header_cache.h"
 #include "virutil.h"
 
 #define VIR_FROM_THIS VIR_FROM_STORAGE
@@ -86,7 +87,9 @@ storagePoolRefreshImpl(virStorageBackend *backend,
                        virStoragePoolObj *obj,
                        const char *stateFile)
 {
-    virStoragePoolObjClearVols(obj);
+    if (!backend->incrementalRefresh)
+        virStoragePoolObjClearVols(obj);
+
     if (backend->refreshPool(obj) < 0) {
         storagePoolRefreshFailCleanup(backend, obj, stateFile);
         return -1;
@@ -1764,6 +1767,8 @@ storageVolDeleteInternal(virStorageBackend *backend,
     if (backend->deleteVol(obj, voldef, flags) < 0)
         return -1;
 
+    virStorageHeaderCacheInvalidate(voldef->target.path);
+
     /* The disk backend updated the pool data including removing the
      * voldef from the pool (for both the deleteVol and the createVol
      * failure path. */
@@ -1956,6 +1961,7 @@ storageVolCreateXML(virStoragePoolPtr pool,
 
         buildFlags &= ~VIR_STORAGE_VOL_CREATE_VALIDATE;
         buildret = backend->buildVol(obj, buildvoldef, buildFlags);
+        virStorageHeaderCacheInvalidate(buildvoldef->target.path);
 
         VIR_FREE(buildvoldef);
 
@@ -2153,6 +2159,7 @@ storageVolCreateXMLFrom(virStoragePoolPtr pool,
     }
 
     buildret = backend->buildVolFrom(obj, shadowvol, voldefsrc, flags);
+    virStorageHeaderCacheInvalidate(shadowvol->target.path);
 
     virObjectLock(obj);
     if (objsrc)
@@ -2421,6 +2428,10 @@ storageVolUpload(virStorageVolPtr vol,
     voldef->in_use++;
     virObjectUnlock(obj);
 
+    /* The data is written only after this returns, but that is going to
+     * update the timestamps of the volume */
+    virStorageHeaderCacheInvalidate(voldef->target.path);
+
     rc = backend->uploadVol(obj, voldef, stream, offset, length, flags);
 
     virObjectLock(obj);
@@ -2524,6 +2535,8 @@ storageVolResize(virStorageVolPtr vol,
     if (backend->resizeVol(obj, voldef, abs_capacity, flags) < 0)
         goto cleanup;
 
+    virStorageHeaderCacheInvalidate(voldef->target.path);
+
     voldef->target.capacity = abs_capacity;
     /* Only update the allocation and pool values if we actually did the
      * allocation; otherwise, this is akin to a create operation with a
@@ -2597,6 +2610,7 @@ storageVolWipePattern(virStorageVolPtr vol,
     virObjectUnlock(obj);
 
     rc = backend->wipeVol(obj, voldef, algorithm, flags);
+    virStorageHeaderCacheInvalidate(voldef->target.path);
 
     virObjectLock(obj);
     voldef->in_use--;
@@ -51,6 +51,7 @@
 #include "viruuid.h"
 #include "virstoragefile.h"
 #include "storage_file_probe.h"
+#include "storage_header_cache.h"
 #include "storage_util.h"
 #include "storage_source.h"
 #include "storage_source_conf.h"
@@ -63,6 +64,8 @@
 #include "virfdstream.h"
 #include "virutil.h"
 #include "virsecureerase.h"
+#include "virthread.h"
+#include "virzero.h"
 
 #define VIR_FROM_THIS VIR_FROM_STORAGE
 
@@ -114,29 +117,340 @@ reflinkCloneFile(int dest_fd G_GNUC_UNUSED,
 #endif
 
 
-static int ATTRIBUTE_NONNULL(2)
-virStorageBackendCopyToFD(virStorageVolDef *vol,
-                          virStorageVolDef *inputvol,
+/* Amount of data handed to a copy worker at once by default */
+#define COPY_SEGMENT_SIZE_DEFAULT (64 * 1024 * 1024)
+#define COPY_WORKERS_DEFAULT 4
+
+typedef struct _virStorageBackendCopySegment virStorageBackendCopySegment;
+struct _virStorageBackendCopySegment {
+    off_t offset;
+    off_t length;
+};
+
+typedef struct _virStorageBackendCopyJob virStorageBackendCopyJob;
+struct _virStorageBackendCopyJob {
+    int inputfd;
+    int fd;
+    bool want_sparse;
+    size_t wbytes;
+    size_t segmentSize;
+    int useCopyRange; /* atomic, cleared once copy_file_range is refused */
+
+    virStorageBackendCopySegment *segments;
+    size_t nsegments;
+
+    virMutex lock;
+    size_t next;       /* first segment not taken by a worker yet */
+    int error;         /* errno of the first failure */
+    bool writeFailed;  /* whether the failure was in writing */
+};
+
+
+static void
+storageBackendCopyFail(virStorageBackendCopyJob *job,
+                       int error,
+                       bool writeFailed)
+{
+    VIR_WITH_MUTEX_LOCK_GUARD(&job->lock) {
+        if (!job->error) {
+            job->error = error;
+            job->writeFailed = writeFailed;
+        }
+    }
+}
+
+
+static int
+storageBackendCopyWrite(virStorageBackendCopyJob *job,
+                        const char *buf,
+                        size_t len,
+                        off_t offset)
+{
+    while (len > 0) {
+        ssize_t written = pwrite(job->fd, buf, len, offset);
+
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+
+        buf += written;
+        len -= written;
+        offset += written;
+    }
+
+    return 0;
+}
+
+
+/*
+ * Lets the kernel copy as much of the segment as it can, possibly by
+ * sharing the blocks or offloading the copy to the storage. Returns the
+ * offset where it stopped, which is the end of the segment unless the
+ * kernel refused the copy, or -1 on error.
+ */
+static off_t
+storageBackendCopySegmentRange(virStorageBackendCopyJob *job G_GNUC_UNUSED,
+                               off_t offset,
+                               off_t end)
+{
+#if WITH_COPY_FILE_RANGE
+    while (offset < end && g_atomic_int_get(&job->useCopyRange)) {
+        loff_t in = offset;
+        loff_t out = offset;
+        ssize_t copied = copy_file_range(job->inputfd, &in, job->fd, &out,
+                                         end - offset, 0);
+
+        if (copied < 0) {
+            if (errno == EINTR)
+                continue;
+
+            if (errno == ENOSYS || errno == EXDEV || errno == EINVAL ||
+                errno == EOPNOTSUPP || errno == ENOTSUP || errno == EBADF) {
+                VIR_DEBUG("copy_file_range not usable, falling back to read/write: %s",
+                          g_strerror(errno));
+                g_atomic_int_set(&job->useCopyRange, 0);
+                break;
+            }
+
+            storageBackendCopyFail(job, errno, true);
+            return -1;
+        }
+
+        /* The input is shorter than expected */
+        if (copied == 0)
+            return end;
+
+        offset += copied;
+    }
+#endif /* WITH_COPY_FILE_RANGE */
+
+    return offset;
+}
+
+
+/*
+ * Writes the @len bytes of @buf read from @offset, leaving out the blocks
+ * of zeroes if the target is sparse. Consecutive blocks with data are
+ * written at once.
+ */
+static int
+storageBackendCopyBuffer(virStorageBackendCopyJob *job,
+                         const char *buf,
+                         size_t len,
+                         off_t offset)
+{
+    size_t i = 0;
+
+    while (i < len) {
+        size_t start;
+
+        if (job->want_sparse) {
+            size_t skip = virFindNonZero(buf + i, len - i);
+
+            if (skip == len - i)
+                break;
+
+            i += skip - skip % job->wbytes;
+        }
+
+        /* The block at @start is known to contain data */
+        start = i;
+        i += MIN(job->wbytes, len - i);
+
+        while (i < len) {
+            size_t interval = MIN(job->wbytes, len - i);
+
+            if (job->want_sparse && virIsZero(buf + i, interval))
+                break;
+
+            i += interval;
+        }
+
+        if (storageBackendCopyWrite(job, buf + start, i - start,
+                                    offset + start) < 0) {
+            storageBackendCopyFail(job, errno, true);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+
+static int
+storageBackendCopySegment(virStorageBackendCopyJob *job,
+                          virStorageBackendCopySegment *segment,
+                          char *buf)
+{
+    off_t end = segment->offset + segment->length;
+    off_t offset = segment->offset;
+
+    if ((offset = storageBackendCopySegmentRange(job, offset, end)) < 0)
+        return -1;
+
+    while (offset < end) {
+        size_t rbytes = MIN(end - offset, READ_BLOCK_SIZE_DEFAULT);
+        ssize_t amtread;
+
+        if ((amtread = pread(job->inputfd, buf, rbytes, offset)) < 0) {
+            if (errno == EINTR)
+                continue;
+            storageBackendCopyFail(job, errno, false);
+            return -1;
+        }
+
+        if (amtread == 0)
+            break;
+
+        if (storageBackendCopyBuffer(job, buf, amtread, offset) < 0)
+            return -1;
+
+        offset += amtread;
+    }
+
+    return 0;
+}
+
+
+static void
+storageBackendCopyWorker(void *opaque)
+{
+    virStorageBackendCopyJob *job = opaque;
+    g_autofree char *buf = g_new0(char, READ_BLOCK_SIZE_DEFAULT);
+
+    while (true) {
+        virStorageBackendCopySegment *segment = NULL;
+
+        VIR_WITH_MUTEX_LOCK_GUARD(&job->lock) {
+            if (!job->error && job->next < job->nsegments)
+                segment = &job->segments[job->next++];
+        }
+
+        if (!segment ||
+            storageBackendCopySegment(job, segment, buf) < 0)
+            return;
+    }
+}
+
+
+static void
+storageBackendCopyAddSegments(virStorageBackendCopyJob *job,
+                              off_t offset,
+                              off_t end)
+{
+    while (offset < end) {
+        off_t length = MIN(end - offset, job->segmentSize);
+        virStorageBackendCopySegment segment = { offset, length };
+
+        VIR_APPEND_ELEMENT(job->segments, job->nsegments, segment);
+        offset += length;
+    }
+}
+
+
+/*
+ * Splits the first @len bytes of @inputfd into segments to copy. With a
+ * sparse target only the extents holding data are copied, the target
+ * reads as zeroes elsewhere already.
+ */
+static void
+storageBackendCopyFindSegments(virStorageBackendCopyJob *job,
+                               off_t len)
+{
+    off_t offset = 0;
+
+#if WITH_DECL_SEEK_HOLE
+    struct stat st;
+
+    if (job->want_sparse &&
+        fstat(job->inputfd, &st) == 0 && S_ISREG(st.st_mode)) {
+        while (offset < len) {
+            off_t data = lseek(job->inputfd, offset, SEEK_DATA);
+            off_t hole;
+
+            /* Nothing but a trailing hole left */
+            if (data < 0 && errno == ENXIO)
+                return;
+
+            if (data < 0 ||
+                (hole = lseek(job->inputfd, data, SEEK_HOLE)) < 0) {
+                VIR_DEBUG("Unable to look up data extents: %s",
+                          g_strerror(errno));
+                break;
+            }
+
+            if (data >= len)
+                return;
+
+            storageBackendCopyAddSegments(job, data, MIN(hole, len));
+            offset = hole;
+        }
+    }
+#endif /* WITH_DECL_SEEK_HOLE */
+
+    storageBackendCopyAddSegments(job, offset, len);
+}
+
+
+/**
+ * virStorageBackendCopyData:
+ * @inputfd: file descriptor to copy from
+ * @inputpath: path of @inputfd for error reporting
+ * @fd: file descriptor to copy to
+ * @path: path of @fd for error reporting
+ * @total: in: maximum number of bytes to copy, out: bytes not copied
+ * @want_sparse: whether blocks of zeroes can be skipped
+ * @copy_range: whether the kernel may copy the data by itself
+ * @nworkers: number of threads copying at once, 0 for the default
+ * @segment_size: amount of data copied by a thread at once, 0 for the default
+ *
+ * Copies the data from the beginning of @inputfd to the same offsets in
+ * @fd. Large inputs are copied by several threads at once and holes in the
+ * input and blocks of zeroes are skipped if @want_sparse is true.
+ *
+ * If @copy_range is true, copy_file_range() is used when the kernel
+ * supports it for the files. As the kernel may then share the blocks with
+ * @inputfd like a reflink does, it must be false if the blocks of @fd were
+ * preallocated.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int
+virStorageBackendCopyData(int inputfd,
+                          const char *inputpath,
                           int fd,
+                          const char *path,
                           unsigned long long *total,
                           bool want_sparse,
-                          bool reflink_copy)
+                          bool copy_range,
+                          unsigned int nworkers,
+                          size_t segment_size)
 {
-    int amtread = -1;
-    size_t rbytes = READ_BLOCK_SIZE_DEFAULT;
+    virStorageBackendCopyJob job = {
+        .inputfd = inputfd,
+        .fd = fd,
+        .want_sparse = want_sparse,
+        .segmentSize = segment_size,
+        .useCopyRange = copy_range,
+    };
+    g_autofree virThread *threads = NULL;
+    size_t nthreads = 0;
     int wbytes = 0;
-    int interval;
     struct stat st;
-    g_autofree char *zerobuf = NULL;
-    g_autofree char *buf = NULL;
-    VIR_AUTOCLOSE inputfd = -1;
+    off_t len;
+    size_t i;
+    int ret = -1;
 
-    if ((inputfd = open(inputvol->target.path, O_RDONLY)) < 0) {
+    if ((len = lseek(inputfd, 0, SEEK_END)) < 0) {
         virReportSystemError(errno,
-                             _("could not open input path '%1$s'"),
-                             inputvol->target.path);
+                             _("failed reading from file '%1$s'"),
+                             inputpath);
         return -1;
     }
+    if (len > *total)
+        len = *total;
 
 #ifdef __linux__
     if (ioctl(fd, BLKBSZGET, &wbytes) < 0)
@@ -146,67 +460,108 @@ virStorageBackendCopyToFD(virStorageVolDef *vol,
         wbytes = st.st_blksize;
     if (wbytes < WRITE_BLOCK_SIZE_DEFAULT)
         wbytes = WRITE_BLOCK_SIZE_DEFAULT;
+    job.wbytes = wbytes;
 
-    zerobuf = g_new0(char, wbytes);
+    if (job.segmentSize == 0)
+        job.segmentSize = COPY_SEGMENT_SIZE_DEFAULT;
 
-    buf = g_new0(char, rbytes);
+    if (virMutexInit(&job.lock) < 0)
+        return -1;
 
-    if (reflink_copy) {
-        if (reflinkCloneFile(fd, inputfd) < 0) {
-            virReportSystemError(errno,
-                                 _("failed to clone files from '%1$s'"),
-                                 inputvol->target.path);
-            return -1;
-        } else {
-            VIR_DEBUG("btrfs clone finished.");
-            return 0;
-        }
-    }
+    storageBackendCopyFindSegments(&job, len);
 
-    while (amtread != 0) {
-        int amtleft;
+    if (nworkers == 0)
+        nworkers = COPY_WORKERS_DEFAULT;
+    nworkers = MIN(nworkers, job.nsegments);
 
-        if (*total < rbytes)
-            rbytes = *total;
+    VIR_DEBUG("Copying %lld bytes in %zu segments with %u workers",
+              (long long) len, job.nsegments, nworkers);
 
-        if ((amtread = saferead(inputfd, buf, rbytes)) < 0) {
-            virReportSystemError(errno,
-                                 _("failed reading from file '%1$s'"),
-                                 inputvol->target.path);
-            return -1;
+    /* The calling thread is a worker too, failing to start the others
+     * only makes the copy slower */
+    if (nworkers > 1)
+        threads = g_new0(virThread, nworkers - 1);
+    for (nthreads = 0; nthreads + 1 < nworkers; nthreads++) {
+        if (virThreadCreateFull(&threads[nthreads], true,
+                                storageBackendCopyWorker,
+                                "storage-copy", false, &job) < 0) {
+            VIR_WARN("Unable to create copy thread: %s", g_strerror(errno));
+            break;
         }
-        *total -= amtread;
+    }
 
-        /* Loop over amt read in 512 byte increments, looking for sparse
-         * blocks */
-        amtleft = amtread;
-        do {
-            int offset = amtread - amtleft;
-            interval = ((wbytes > amtleft) ? amtleft : wbytes);
+    storageBackendCopyWorker(&job);
 
-            if (want_sparse && memcmp(buf+offset, zerobuf, interval) == 0) {
-                if (lseek(fd, interval, SEEK_CUR) < 0) {
-                    virReportSystemError(errno,
-                                         _("cannot extend file '%1$s'"),
-                                         vol->target.path);
-                    return -1;
-                }
-            } else if (safewrite(fd, buf+offset, interval) < 0) {
-                virReportSystemError(errno,
-                                     _("failed writing to file '%1$s'"),
-                                     vol->target.path);
-                return -1;
+    for (i = 0; i < nthreads; i++)
+        virThreadJoin(&threads[i]);
 
-            }
-        } while ((amtleft -= interval) > 0);
+    if (job.error) {
+        if (job.writeFailed)
+            virReportSystemError(job.error,
+                                 _("failed writing to file '%1$s'"),
+                                 path);
+        else
+            virReportSystemError(job.error,
+                                 _("failed reading from file '%1$s'"),
+                                 inputpath);
+        goto cleanup;
     }
 
+    *total -= len;
+
     if (virFileDataSync(fd) < 0) {
         virReportSystemError(errno, _("cannot sync data to file '%1$s'"),
-                             vol->target.path);
+                             path);
+        goto cleanup;
+    }
+
+    ret = 0;
+
+ cleanup:
+    virMutexDestroy(&job.lock);
+    g_free(job.segments);
+    return ret;
+}
+
+
+static int ATTRIBUTE_NONNULL(2)
+virStorageBackendCopyToFD(virStorageVolDef *vol,
+                          virStorageVolDef *inputvol,
+                          int fd,
+                          unsigned long long *total,
+                          bool want_sparse,
+                          bool preallocated,
+                          bool reflink_copy)
+{
+    VIR_AUTOCLOSE inputfd = -1;
+
+    if ((inputfd = open(inputvol->target.path, O_RDONLY)) < 0) {
+        virReportSystemError(errno,
+                             _("could not open input path '%1$s'"),
+                             inputvol->target.path);
         return -1;
     }
 
+    if (reflink_copy) {
+        if (reflinkCloneFile(fd, inputfd) < 0) {
+            virReportSystemError(errno,
+                                 _("failed to clone files from '%1$s'"),
+                                 inputvol->target.path);
+            return -1;
+        } else {
+            VIR_DEBUG("btrfs clone finished.");
+            return 0;
+        }
+    }
+
+    /* Letting the kernel share the blocks with the input would undo the
+     * preallocation */
+    if (virStorageBackendCopyData(inputfd, inputvol->target.path,
+                                  fd, vol->target.path,
+                                  total, want_sparse, !preallocated,
+                                  0, 0) < 0)
+        return -1;
+
     if (VIR_CLOSE(inputfd) < 0) {
         virReportSystemError(errno,
                              _("cannot close file '%1$s'"),
@@ -255,7 +610,7 @@ storageBackendCreateBlockFrom(virStoragePoolObj *pool G_GNUC_UNUSED,
 
     if (inputvol) {
         if (virStorageBackendCopyToFD(vol, inputvol, fd, &remain,
-                                      false, reflink_copy) < 0)
+                                      false, false, reflink_copy) < 0)
             return -1;
     }
 
@@ -301,6 +656,7 @@ createRawFile(int fd, virStorageVolDef *vol,
               bool reflink_copy)
 {
     bool need_alloc = true;
+    bool preallocated;
     unsigned long long pos = 0;
 
     /* If the new allocation is lower than the capacity of the original file,
@@ -309,6 +665,8 @@ createRawFile(int fd, virStorageVolDef *vol,
         vol->target.allocation < inputvol->target.capacity)
         need_alloc = false;
 
+    preallocated = need_alloc && vol->target.allocation > 0;
+
     /* Seek to the final size, so the capacity is available upfront
      * for progress reporting */
     if (ftruncate(fd, vol->target.capacity) < 0) {
@@ -345,7 +703,8 @@ createRawFile(int fd, virStorageVolDef *vol,
          * allocation (allocation < capacity) or we have already
          * been able to allocate the required space. */
         if (virStorageBackendCopyToFD(vol, inputvol, fd, &remain,
-                                      !need_alloc, reflink_copy) < 0)
+                                      !need_alloc, preallocated,
+                                      reflink_copy) < 0)
             return -1;
 
         /* If the new allocation is greater than the original capacity,
@@ -1778,7 +2137,7 @@ storageBackendUpdateVolTargetInfo(virStorageVolType voltype,
 {
     int rc;
     struct stat sb;
-    ssize_t len = VIR_STORAGE_MAX_HEADER;
+    ssize_t len;
     g_autofree char *buf = NULL;
     VIR_AUTOCLOSE fd = -1;
 
@@ -1807,7 +2166,7 @@ storageBackendUpdateVolTargetInfo(virStorageVolType voltype,
             return -1;
         }
 
-        if ((len = virFileReadHeaderFD(fd, len, &buf)) < 0) {
+        if ((len = virStorageHeaderCacheReadFD(target->path, fd, &sb, &buf)) < 0) {
             if (readflags & VIR_STORAGE_VOL_READ_NOERROR) {
                 VIR_WARN("ignoring failed header read for '%s'",
                          target->path);
@@ -1867,6 +2226,28 @@ virStorageBackendUpdateVolInfo(virStorageVolDef *vol,
     return 0;
 }
 
+static void
+storageBackendGetTimestamps(virStorageTimestamps *timestamps,
+                            const struct stat *sb)
+{
+#ifdef __APPLE__
+    timestamps->atime = sb->st_atimespec;
+    timestamps->btime = sb->st_birthtimespec;
+    timestamps->ctime = sb->st_ctimespec;
+    timestamps->mtime = sb->st_mtimespec;
+#else /* ! __APPLE__ */
+    timestamps->atime = sb->st_atim;
+# ifdef __linux__
+    timestamps->btime = (struct timespec){0, 0};
+# else /* ! __linux__ */
+    timestamps->btime = sb->st_birthtim;
+# endif /* ! __linux__ */
+    timestamps->ctime = sb->st_ctim;
+    timestamps->mtime = sb->st_mtim;
+#endif /* ! __APPLE__ */
+}
+
+
 /*
  * virStorageBackendUpdateVolTargetInfoFD:
  * @target: target definition ptr of volume to update
@@ -1896,21 +2277,7 @@ virStorageBackendUpdateVolTargetInfoFD(virStorageSource *target,
     if (!target->timestamps)
         target->timestamps = g_new0(virStorageTimestamps, 1);
 
-#ifdef __APPLE__
-    target->timestamps->atime = sb->st_atimespec;
-    target->timestamps->btime = sb->st_birthtimespec;
-    target->timestamps->ctime = sb->st_ctimespec;
-    target->timestamps->mtime = sb->st_mtimespec;
-#else /* ! __APPLE__ */
-    target->timestamps->atime = sb->st_atim;
-# ifdef __linux__
-    target->timestamps->btime = (struct timespec){0, 0};
-# else /* ! __linux__ */
-    target->timestamps->btime = sb->st_birthtim;
-# endif /* ! __linux__ */
-    target->timestamps->ctime = sb->st_ctim;
-    target->timestamps->mtime = sb->st_mtim;
-#endif /* ! __APPLE__ */
+    storageBackendGetTimestamps(target->timestamps, sb);
 
     target->type = VIR_STORAGE_TYPE_FILE;
 
@@ -3519,9 +3886,74 @@ virStorageBackendRefreshVolTargetUpdate(virStorageVolDef *vol)
 }
 
 
+/* Files modified less than this long before they were probed could have
+ * been modified again since without their timestamps showing it */
+#define VIR_STORAGE_REFRESH_MIN_AGE_US (1000 * 1000)
+
+static long long
+storageBackendTimespecToUs(const struct timespec *ts)
+{
+    return ts->tv_sec * 1000000LL + ts->tv_nsec / 1000;
+}
+
+
+/*
+ * storageBackendRefreshVolUnchanged:
+ * @vol: volume found by a previous refresh of the pool
+ *
+ * Checks whether the file of @vol is the same as when it was probed, so
+ * that probing it again can be skipped. Writing the file updates its
+ * modification time while changing its owner, mode or security label
+ * updates its change time. Volumes with a backing store are always probed
+ * again as the backing image might have changed.
+ *
+ * Returns true if @vol is still up to date.
+ */
+static bool
+storageBackendRefreshVolUnchanged(virStorageVolDef *vol)
+{
+    virStorageTimestamps *old = vol->target.timestamps;
+    virStorageTimestamps cur;
+    struct stat sb;
+
+    if (vol->type != VIR_STORAGE_VOL_FILE ||
+        !old ||
+        vol->probeTime == 0 ||
+        virStorageSourceHasBacking(&vol->target))
+        return false;
+
+    if (stat(vol->target.path, &sb) < 0 ||
+        !S_ISREG(sb.st_mode) ||
+        (unsigned long long)sb.st_size != vol->target.physical)
+        return false;
+
+    storageBackendGetTimestamps(&cur, &sb);
+
+    if (storageBackendTimespecToUs(&cur.mtime) !=
+        storageBackendTimespecToUs(&old->mtime) ||
+        storageBackendTimespecToUs(&cur.ctime) !=
+        storageBackendTimespecToUs(&old->ctime))
+        return false;
+
+    if (vol->probeTime - storageBackendTimespecToUs(&cur.mtime) <
+        VIR_STORAGE_REFRESH_MIN_AGE_US ||
+        vol->probeTime - storageBackendTimespecToUs(&cur.ctime) <
+        VIR_STORAGE_REFRESH_MIN_AGE_US)
+        return false;
+
+    old->atime = cur.atime;
+
+    return true;
+}
+
+
 /**
  * Iterate over the pool's directory and enumerate all disk images
  * within it. This is non-recursive.
+ *
+ * Volumes already known from a previous refresh are kept as they are
+ * unless their file changed, which makes refreshing pools holding many
+ * images cheap. Volumes whose files are gone are removed.
  */
 int
 virStorageBackendRefreshLocal(virStoragePoolObj *pool)
@@ -3535,11 +3967,16 @@ virStorageBackendRefreshLocal(virStoragePoolObj *pool)
     g_autoptr(virStorageVolDef) vol = NULL;
     VIR_AUTOCLOSE fd = -1;
     g_autoptr(virStorageSource) target = NULL;
+    g_autoptr(GHashTable) found = virHashNew(NULL);
+    g_auto(GStrv) names = NULL;
+    int nnames;
+    size_t i;
 
     if (virDirOpen(&dir, def->target.path) < 0)
         return -1;
 
     while ((direrr = virDirRead(dir, &ent, def->target.path)) > 0) {
+        virStorageVolDef *oldvol;
         int err;
 
         if (virStringHasControlChars(ent->d_name)) {
@@ -3548,6 +3985,15 @@ virStorageBackendRefreshLocal(virStoragePoolObj *pool)
             continue;
         }
 
+        if ((oldvol = virStorageVolDefFindByName(pool, ent->d_name))) {
+            if (storageBackendRefreshVolUnchanged(oldvol)) {
+                g_hash_table_insert(found, g_strdup(ent->d_name), NULL);
+                continue;
+            }
+
+            virStoragePoolObjRemoveVol(pool, oldvol);
+        }
+
         vol = g_new0(virStorageVolDef, 1);
 
         vol->name = g_strdup(ent->d_name);
@@ -3556,6 +4002,7 @@ virStorageBackendRefreshLocal(virStoragePoolObj *pool)
         vol->target.path = g_strdup_printf("%s/%s", def->target.path, vol->name);
 
         vol->key = g_strdup(vol->target.path);
+        vol->probeTime = g_get_real_time();
 
         if ((err = virStorageBackendRefreshVolTargetUpdate(vol)) < 0) {
             if (err == -2) {
@@ -3567,6 +4014,8 @@ virStorageBackendRefreshLocal(virStoragePoolObj *pool)
             return -1;
         }
 
+        g_hash_table_insert(found, g_strdup(vol->name), NULL);
+
         if (virStoragePoolObjAddVol(pool, vol) < 0)
             return -1;
         vol = NULL;
@@ -3574,6 +4023,23 @@ virStorageBackendRefreshLocal(virStoragePoolObj *pool)
     if (direrr < 0)
         return -1;
 
+    /* Drop volumes left over from the previous refresh whose files are gone */
+    nnames = virStoragePoolObjGetVolumesCount(pool);
+    names = g_new0(char *, nnames + 1);
+    if ((nnames = virStoragePoolObjVolumeGetNames(pool, NULL, NULL,
+                                                  names, nnames)) < 0)
+        return -1;
+
+    for (i = 0; i < nnames; i++) {
+        virStorageVolDef *oldvol;
+
+        if (g_hash_table_contains(found, names[i]))
+            continue;
+
+        if ((oldvol = virStorageVolDefFindByName(pool, names[i])))
+            virStoragePoolObjRemoveVol(pool, oldvol);
+    }
+
     target = virStorageSourceNew();
 
     if ((fd = open(def->target.path, O_RDONLY)) < 0) {
@@ -49,6 +49,16 @@ virStorageBackendBuildVolFrom
 virStorageBackendGetBuildVolFromFunction(virStorageVolDef *vol,
                                          virStorageVolDef *inputvol);
 
+int virStorageBackendCopyData(int inputfd,
+                              const char *inputpath,
+                              int fd,
+                              const char *path,
+                              unsigned long long *total,
+                              bool want_sparse,
+                              bool copy_range,
+                              unsigned int nworkers,
+                              size_t segment_size);
+
 int virStorageBackendVolCreateLocal(virStoragePoolObj *pool,
                                     virStorageVolDef *vol);
 
@@ -0,0 +1,447 @@
+/*
+ * storage_header_cache.c: cache of image headers used for probing
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include "storage_header_cache.h"
+#include "storage_file_probe.h"
+#include "vircachestats.h"
+#include "virerror.h"
+#include "virfile.h"
+#include "virhash.h"
+#include "virlog.h"
+#include "virthread.h"
+
+#define VIR_FROM_THIS VIR_FROM_STORAGE
+
+VIR_LOG_INIT("storage_file.storage_header_cache");
+
+/*
+ * Probing the metadata of every image of a backing chain means opening and
+ * reading the header of each of them, which happens on every domain start,
+ * block job completion and pool refresh. The headers of regular files are
+ * therefore kept around, keyed by the device and inode of the file and
+ * validated against its size and modification time, so that an image
+ * modified behind our back is read again. The change time is deliberately
+ * ignored as labelling the images on domain startup changes it without
+ * touching the contents.
+ *
+ * Files on shared filesystems are never cached: their attributes returned
+ * by stat() may be cached by the client for a while and their timestamps
+ * come from the clock of another host, so neither can tell that the image
+ * was not modified.
+ *
+ * The cache is private to the process. With modular daemons the QEMU and
+ * storage drivers run in separate processes, therefore images modified
+ * through the storage driver are not invalidated in the cache of the QEMU
+ * driver and vice versa and only the validation against the attributes of
+ * the file applies there.
+ */
+
+/* Upper limit of memory taken by the cached headers */
+#define VIR_STORAGE_HEADER_CACHE_MAX_BYTES (32 * 1024 * 1024)
+
+/* Files modified less than this long ago are not cached, as a further
+ * modification within the granularity of the timestamps would go
+ * unnoticed */
+#define VIR_STORAGE_HEADER_CACHE_MIN_AGE_NS (1000LL * 1000 * 1000)
+
+typedef struct _virStorageHeaderCacheEntry virStorageHeaderCacheEntry;
+struct _virStorageHeaderCacheEntry {
+    char *path;
+
+    /* attributes which change when the file is modified */
+    long long size;
+    long long mtime;
+
+    char *header;
+    size_t len;
+
+    unsigned long long lastUsed;
+};
+
+static virMutex virStorageHeaderCacheLock;
+static GHashTable *virStorageHeaderCacheTable;
+static virStorageHeaderCacheStats virStorageHeaderCacheCounters;
+static unsigned long long virStorageHeaderCacheClock;
+
+
+static void
+virStorageHeaderCacheEntryFree(void *opaque)
+{
+    virStorageHeaderCacheEntry *entry = opaque;
+
+    if (!entry)
+        return;
+
+    g_free(entry->path);
+    g_free(entry->header);
+    g_free(entry);
+}
+
+
+static void
+virStorageHeaderCacheReportStats(virTypedParamList *list,
+                                 const char *prefix,
+                                 void *opaque G_GNUC_UNUSED)
+{
+    virStorageHeaderCacheStats stats;
+
+    VIR_WITH_MUTEX_LOCK_GUARD(&virStorageHeaderCacheLock) {
+        stats = virStorageHeaderCacheCounters;
+        stats.entries = virHashSize(virStorageHeaderCacheTable);
+    }
+
+    virTypedParamListAddULLong(list, stats.hits, "%s.hits", prefix);
+    virTypedParamListAddULLong(list, stats.misses, "%s.misses", prefix);
+    virTypedParamListAddULLong(list, stats.stale, "%s.stale", prefix);
+    virTypedParamListAddULLong(list, stats.evictions, "%s.evictions", prefix);
+    virTypedParamListAddULLong(list, stats.invalidations,
+                               "%s.invalidations", prefix);
+    virTypedParamListAddULLong(list, stats.entries, "%s.entries", prefix);
+    virTypedParamListAddULLong(list, stats.bytes, "%s.bytes", prefix);
+}
+
+
+static int
+virStorageHeaderCacheOnceInit(void)
+{
+    if (virMutexInit(&virStorageHeaderCacheLock) < 0) {
+        virReportSystemError(errno, "%s",
+                             _("unable to initialize header cache mutex"));
+        return -1;
+    }
+
+    virStorageHeaderCacheTable = virHashNew(virStorageHeaderCacheEntryFree);
+
+    virCacheStatsRegister("storage.header", virStorageHeaderCacheReportStats,
+                          NULL);
+
+    return 0;
+}
+
+VIR_ONCE_GLOBAL_INIT(virStorageHeaderCache);
+
+
+static char *
+virStorageHeaderCacheKey(const struct stat *sb)
+{
+    return g_strdup_printf("%llu:%llu",
+                           (unsigned long long)sb->st_dev,
+                           (unsigned long long)sb->st_ino);
+}
+
+
+static long long
+virStorageHeaderCacheGetMtime(const struct stat *sb)
+{
+#ifdef WITH_STRUCT_STAT_ST_MTIM
+    return sb->st_mtim.tv_sec * 1000000000LL + sb->st_mtim.tv_nsec;
+#else
+    return sb->st_mtime * 1000000000LL;
+#endif
+}
+
+
+static void
+virStorageHeaderCacheRemoveLocked(const char *key)
+{
+    virStorageHeaderCacheEntry *entry;
+
+    if (!(entry = virHashLookup(virStorageHeaderCacheTable, key)))
+        return;
+
+    virStorageHeaderCacheCounters.bytes -= entry->len;
+    virHashRemoveEntry(virStorageHeaderCacheTable, key);
+}
+
+
+static void
+virStorageHeaderCacheEvictLocked(size_t len)
+{
+    while (virStorageHeaderCacheCounters.bytes + len >
+           VIR_STORAGE_HEADER_CACHE_MAX_BYTES) {
+        GHashTableIter iter;
+        const char *key;
+        virStorageHeaderCacheEntry *entry;
+        const char *lruKey = NULL;
+        virStorageHeaderCacheEntry *lru = NULL;
+
+        g_hash_table_iter_init(&iter, virStorageHeaderCacheTable);
+        while (g_hash_table_iter_next(&iter, (void **)&key, (void **)&entry)) {
+            if (!lru || entry->lastUsed < lru->lastUsed) {
+                lruKey = key;
+                lru = entry;
+            }
+        }
+
+        if (!lru)
+            return;
+
+        VIR_DEBUG("evicting header of '%s'", lru->path);
+        virStorageHeaderCacheRemoveLocked(lruKey);
+        virStorageHeaderCacheCounters.evictions++;
+    }
+}
+
+
+/**
+ * virStorageHeaderCacheLookup:
+ * @path: path of the image, for debugging
+ * @sb: current stat data of the image
+ * @buf: filled with a copy of the cached header
+ *
+ * Looks up the header of the image described by @sb. Entries found to be
+ * outdated are dropped.
+ *
+ * Returns the length of the header stored into @buf or -1 if there is no
+ * usable cached header. No error is reported.
+ */
+ssize_t
+virStorageHeaderCacheLookup(const char *path,
+                            const struct stat *sb,
+                            char **buf)
+{
+    g_autofree char *key = NULL;
+    long long mtime;
+
+    if (!S_ISREG(sb->st_mode))
+        return -1;
+
+    if (virStorageHeaderCacheInitialize() < 0) {
+        virResetLastError();
+        return -1;
+    }
+
+    key = virStorageHeaderCacheKey(sb);
+    mtime = virStorageHeaderCacheGetMtime(sb);
+
+    VIR_WITH_MUTEX_LOCK_GUARD(&virStorageHeaderCacheLock) {
+        virStorageHeaderCacheEntry *entry;
+
+        entry = virHashLookup(virStorageHeaderCacheTable, key);
+
+        if (entry &&
+            (entry->size != sb->st_size ||
+             entry->mtime != mtime)) {
+            VIR_DEBUG("cached header of '%s' is outdated", path);
+            virStorageHeaderCacheRemoveLocked(key);
+            virStorageHeaderCacheCounters.stale++;
+            entry = NULL;
+        }
+
+        if (!entry) {
+            virStorageHeaderCacheCounters.misses++;
+            return -1;
+        }
+
+        entry->lastUsed = ++virStorageHeaderCacheClock;
+        virStorageHeaderCacheCounters.hits++;
+
+        *buf = g_memdup2(entry->header, entry->len);
+        return entry->len;
+    }
+
+    return -1;
+}
+
+
+/**
+ * virStorageHeaderCacheStore:
+ * @path: path of the image
+ * @sb: stat data of the image taken before @buf was read
+ * @buf: header of the image
+ * @len: length of @buf
+ *
+ * Stores a copy of the header of the image described by @sb, possibly
+ * evicting the least recently used entries. Only regular files which are
+ * not on a shared filesystem are cached.
+ */
+void
+virStorageHeaderCacheStore(const char *path,
+                           const struct stat *sb,
+                           const char *buf,
+                           size_t len)
+{
+    g_autofree char *key = NULL;
+    virStorageHeaderCacheEntry *entry;
+    long long mtime;
+
+    if (!S_ISREG(sb->st_mode) ||
+        len > VIR_STORAGE_HEADER_CACHE_MAX_BYTES)
+        return;
+
+    mtime = virStorageHeaderCacheGetMtime(sb);
+
+    if (g_get_real_time() * 1000LL - mtime <
+        VIR_STORAGE_HEADER_CACHE_MIN_AGE_NS) {
+        VIR_DEBUG("not caching header of recently modified '%s'", path);
+        return;
+    }
+
+    if (virFileIsSharedFS(path, NULL) != 0) {
+        virResetLastError();
+        return;
+    }
+
+    if (virStorageHeaderCacheInitialize() < 0) {
+        virResetLastError();
+        return;
+    }
+
+    key = virStorageHeaderCacheKey(sb);
+
+    entry = g_new0(virStorageHeaderCacheEntry, 1);
+    entry->path = g_strdup(path);
+    entry->size = sb->st_size;
+    entry->mtime = mtime;
+    entry->header = g_memdup2(buf, len);
+    entry->len = len;
+
+    VIR_WITH_MUTEX_LOCK_GUARD(&virStorageHeaderCacheLock) {
+        virStorageHeaderCacheRemoveLocked(key);
+        virStorageHeaderCacheEvictLocked(len);
+
+        entry->lastUsed = ++virStorageHeaderCacheClock;
+        virStorageHeaderCacheCounters.bytes += len;
+        g_hash_table_insert(virStorageHeaderCacheTable,
+                            g_steal_pointer(&key), entry);
+    }
+}
+
+
+/**
+ * virStorageHeaderCacheReadFD:
+ * @path: path of the image
+ * @fd: file descriptor of the image positioned at its start
+ * @sb: stat data of @fd
+ * @buf: filled with the header
+ *
+ * Reads the header of the image open as @fd unless it's cached already,
+ * see virFileReadHeaderFD.
+ *
+ * Returns the length of the header or -1 with errno set on error.
+ */
+ssize_t
+virStorageHeaderCacheReadFD(const char *path,
+                            int fd,
+                            const struct stat *sb,
+                            char **buf)
+{
+    ssize_t len;
+
+    if ((len = virStorageHeaderCacheLookup(path, sb, buf)) >= 0)
+        return len;
+
+    if ((len = virFileReadHeaderFD(fd, VIR_STORAGE_MAX_HEADER, buf)) < 0)
+        return -1;
+
+    virStorageHeaderCacheStore(path, sb, *buf, len);
+
+    return len;
+}
+
+
+/**
+ * virStorageHeaderCacheInvalidate:
+ * @path: path of the image
+ *
+ * Forgets the header of the image at @path. To be called whenever libvirt
+ * itself modifies or removes an image, so that a modification which
+ * doesn't show in the timestamps of the file isn't missed.
+ */
+void
+virStorageHeaderCacheInvalidate(const char *path)
+{
+    g_autofree char *key = NULL;
+    struct stat sb;
+
+    if (!path)
+        return;
+
+    if (virStorageHeaderCacheInitialize() < 0) {
+        virResetLastError();
+        return;
+    }
+
+    /* The same image can be reached by more paths */
+    if (stat(path, &sb) == 0)
+        key = virStorageHeaderCacheKey(&sb);
+
+    VIR_WITH_MUTEX_LOCK_GUARD(&virStorageHeaderCacheLock) {
+        GHashTableIter iter;
+        const char *name;
+        virStorageHeaderCacheEntry *entry;
+
+        g_hash_table_iter_init(&iter, virStorageHeaderCacheTable);
+        while (g_hash_table_iter_next(&iter, (void **)&name, (void **)&entry)) {
+            if (STRNEQ(entry->path, path) && STRNEQ_NULLABLE(name, key))
+                continue;
+
+            VIR_DEBUG("invalidating cached header of '%s'", entry->path);
+            virStorageHeaderCacheCounters.bytes -= entry->len;
+            virStorageHeaderCacheCounters.invalidations++;
+            g_hash_table_iter_remove(&iter);
+        }
+    }
+}
+
+
+/**
+ * virStorageHeaderCacheClear:
+ *
+ * Drops all cached headers and resets the statistics.
+ */
+void
+virStorageHeaderCacheClear(void)
+{
+    if (virStorageHeaderCacheInitialize() < 0) {
+        virResetLastError();
+        return;
+    }
+
+    VIR_WITH_MUTEX_LOCK_GUARD(&virStorageHeaderCacheLock) {
+        virHashRemoveAll(virStorageHeaderCacheTable);
+        memset(&virStorageHeaderCacheCounters, 0,
+               sizeof(virStorageHeaderCacheCounters));
+    }
+}
+
+
+/**
+ * virStorageHeaderCacheGetStats:
+ * @stats: filled with the statistics
+ *
+ * Reports how effective the cache is since the daemon started or the cache
+ * was last cleared.
+ */
+void
+virStorageHeaderCacheGetStats(virStorageHeaderCacheStats *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+
+    if (virStorageHeaderCacheInitialize() < 0) {
+        virResetLastError();
+        return;
+    }
+
+    VIR_WITH_MUTEX_LOCK_GUARD(&virStorageHeaderCacheLock) {
+        *stats = virStorageHeaderCacheCounters;
+        stats->entries = virHashSize(virStorageHeaderCacheTable);
+    }
+}
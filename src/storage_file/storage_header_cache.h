@@ -0,0 +1,64 @@
+/*
+ * storage_header_cache.h: cache of image headers used for probing
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <sys/stat.h>
+
+#include "internal.h"
+
+typedef struct _virStorageHeaderCacheStats virStorageHeaderCacheStats;
+struct _virStorageHeaderCacheStats {
+    unsigned long long hits;
+    unsigned long long misses; /* including stale entries */
+    unsigned long long stale; /* entries found outdated on lookup */
+    unsigned long long evictions;
+    unsigned long long invalidations;
+    size_t entries;
+    size_t bytes;
+};
+
+ssize_t
+virStorageHeaderCacheLookup(const char *path,
+                            const struct stat *sb,
+                            char **buf)
+    ATTRIBUTE_NONNULL(1) ATTRIBUTE_NONNULL(2) ATTRIBUTE_NONNULL(3);
+
+void
+virStorageHeaderCacheStore(const char *path,
+                           const struct stat *sb,
+                           const char *buf,
+                           size_t len)
+    ATTRIBUTE_NONNULL(1) ATTRIBUTE_NONNULL(2) ATTRIBUTE_NONNULL(3);
+
+ssize_t
+virStorageHeaderCacheReadFD(const char *path,
+                            int fd,
+                            const struct stat *sb,
+                            char **buf)
+    ATTRIBUTE_NONNULL(1) ATTRIBUTE_NONNULL(3) ATTRIBUTE_NONNULL(4);
+
+void
+virStorageHeaderCacheInvalidate(const char *path);
+
+void
+virStorageHeaderCacheClear(void);
+
+void
+virStorageHeaderCacheGetStats(virStorageHeaderCacheStats *stats)
+    ATTRIBUTE_NONNULL(1);
@@ -27,6 +27,7 @@
 #include "internal.h"
 #include "storage_file_backend.h"
 #include "storage_file_probe.h"
+#include "storage_header_cache.h"
 #include "storage_source.h"
 #include "storage_source_backingstore.h"
 #include "viralloc.h"
@@ -152,7 +153,7 @@ virStorageSourceGetMetadataFromFD(const char *path,
                                   int format)
 
 {
-    ssize_t len = VIR_STORAGE_MAX_HEADER;
+    ssize_t len;
     struct stat sb;
     g_autofree char *buf = NULL;
     g_autoptr(virStorageSource) meta = NULL;
@@ -179,7 +180,7 @@ virStorageSourceGetMetadataFromFD(const char *path,
         return NULL;
     }
 
-    if ((len = virFileReadHeaderFD(fd, len, &buf)) < 0) {
+    if ((len = virStorageHeaderCacheReadFD(meta->path, fd, &sb, &buf)) < 0) {
         virReportSystemError(errno, _("cannot read header '%1$s'"), meta->path);
         return NULL;
     }
@@ -1341,6 +1342,8 @@ virStorageSourceGetMetadataRecurseReadHeader(virStorageSource *src,
 {
     int ret = -1;
     ssize_t len;
+    struct stat sb;
+    bool cacheable = false;
 
     if (virStorageSourceIsFD(src)) {
         if (!src->fdtuple) {
@@ -1365,9 +1368,25 @@ virStorageSourceGetMetadataRecurseReadHeader(virStorageSource *src,
         goto cleanup;
     }
 
+    /* Images on network storage have no identity which could tell us they
+     * are unmodified, so only local files use the cache */
+    if (virStorageSourceGetActualType(src) == VIR_STORAGE_TYPE_FILE &&
+        virStorageSourceStat(src, &sb) == 0) {
+        cacheable = true;
+
+        if ((len = virStorageHeaderCacheLookup(src->path, &sb, buf)) >= 0) {
+            *headerLen = len;
+            ret = 0;
+            goto cleanup;
+        }
+    }
+
     if ((len = virStorageSourceRead(src, 0, VIR_STORAGE_MAX_HEADER, buf)) < 0)
         goto cleanup;
 
+    if (cacheable)
+        virStorageHeaderCacheStore(src->path, &sb, *buf, len);
+
     *headerLen = len;
     ret = 0;
 
@@ -46,6 +46,7 @@
 #include "network_event.h"
 #include "snapshot_conf.h"
 #include "virfdstream.h"
+#include "virevent.h"
 #include "storage_conf.h"
 #include "virstorageobj.h"
 #include "storage_event.h"
@@ -757,7 +758,8 @@ testDomainStartState(testDriver *privconn,
     int ret = -1;
 
     virDomainObjSetState(dom, VIR_DOMAIN_RUNNING, reason);
-    dom->def->id = g_atomic_int_add(&privconn->nextDomID, 1);
+    virDomainObjListSetID(privconn->domains, dom,
+                          g_atomic_int_add(&privconn->nextDomID, 1));
 
     if (virDomainObjSetDefTransient(privconn->xmlopt,
                                     dom, NULL) < 0) {
@@ -1678,6 +1680,9 @@ testConnectSupportsFeature(virConnectPtr conn G_GNUC_UNUSED,
     case VIR_DRV_FEATURE_PROGRAM_KEEPALIVE:
     case VIR_DRV_FEATURE_REMOTE:
     case VIR_DRV_FEATURE_REMOTE_CLOSE_CALLBACK:
+    case VIR_DRV_FEATURE_REMOTE_STREAM_LARGE_PAYLOAD:
+    case VIR_DRV_FEATURE_REMOTE_STREAM_LOCAL_FD:
+    case VIR_DRV_FEATURE_REMOTE_COMPRESSION:
     case VIR_DRV_FEATURE_REMOTE_EVENT_CALLBACK:
     default:
         return 0;
@@ -2134,6 +2139,77 @@ static int testDomainGetInfo(virDomainPtr domain,
     return 0;
 }
 
+typedef struct _testDomainGetInfoAsyncData testDomainGetInfoAsyncData;
+struct _testDomainGetInfoAsyncData {
+    virDomainPtr domain;
+    virDomainGetInfoCallback cb;
+    void *opaque;
+    virFreeCallback freecb;
+    int ret;
+    virDomainInfo info;
+    virErrorPtr err;
+};
+
+static void
+testDomainGetInfoAsyncFree(void *opaque)
+{
+    testDomainGetInfoAsyncData *data = opaque;
+
+    if (data->freecb)
+        data->freecb(data->opaque);
+    virFreeError(data->err);
+    virObjectUnref(data->domain);
+    g_free(data);
+}
+
+static void
+testDomainGetInfoAsyncDone(int timer,
+                           void *opaque)
+{
+    testDomainGetInfoAsyncData *data = opaque;
+
+    virEventRemoveTimeout(timer);
+
+    if (data->ret < 0)
+        virErrorRestore(&data->err);
+
+    data->cb(data->domain, data->ret,
+             data->ret == 0 ? &data->info : NULL, data->opaque);
+}
+
+/* The information is gathered right away, but like with the remote
+ * driver the callback is run from the event loop. */
+static int
+testDomainGetInfoAsync(virDomainPtr domain,
+                       virDomainGetInfoCallback cb,
+                       void *opaque,
+                       virFreeCallback freecb)
+{
+    testDomainGetInfoAsyncData *data = g_new0(testDomainGetInfoAsyncData, 1);
+
+    /* the error is reported to the callback, not to the caller */
+    if ((data->ret = testDomainGetInfo(domain, &data->info)) < 0) {
+        virErrorPreserveLast(&data->err);
+        virResetLastError();
+    }
+
+    data->domain = virObjectRef(domain);
+    data->cb = cb;
+    data->opaque = opaque;
+    data->freecb = freecb;
+
+    if (virEventAddTimeout(0, testDomainGetInfoAsyncDone, data,
+                           testDomainGetInfoAsyncFree) < 0) {
+        virReportError(VIR_ERR_OPERATION_FAILED, "%s",
+                       _("an event loop is required for asynchronous calls"));
+        data->freecb = NULL;
+        testDomainGetInfoAsyncFree(data);
+        return -1;
+    }
+
+    return 0;
+}
+
 static int
 testDomainGetState(virDomainPtr domain,
                    int *state,
@@ -9845,7 +9921,8 @@ testDomainSetIOThreadParams(virDomainPtr dom,
 }
 
 static int
-testDomainGetStatsState(virDomainObj *dom,
+testDomainGetStatsState(testDriver *driver G_GNUC_UNUSED,
+                        virDomainObj *dom,
                         virTypedParamList *params)
 {
     virTypedParamListAddInt(params, dom->state.state, "state.state");
@@ -9855,7 +9932,8 @@ testDomainGetStatsState(virDomainObj *dom,
 }
 
 static int
-testDomainGetStatsIOThread(virDomainObj *dom,
+testDomainGetStatsIOThread(testDriver *driver G_GNUC_UNUSED,
+                           virDomainObj *dom,
                            virTypedParamList *params)
 {
     testDomainObjPrivate *priv = dom->privateData;
@@ -9887,8 +9965,39 @@ testDomainGetStatsIOThread(virDomainObj *dom,
     return 0;
 }
 
+static int
+testDomainGetStatsXML(testDriver *driver,
+                      virDomainObj *dom,
+                      virTypedParamList *params)
+{
+    g_autofree char *xml = NULL;
+
+    if (!(xml = virDomainDefFormat(dom->def, driver->xmlopt, 0)))
+        return -1;
+
+    virDomainDriverStatsAddXML(params, dom, xml);
+
+    return 0;
+}
+
+static int
+testDomainGetStatsMetadata(testDriver *driver G_GNUC_UNUSED,
+                           virDomainObj *dom,
+                           virTypedParamList *params)
+{
+    if (dom->def->title)
+        virTypedParamListAddString(params, dom->def->title,
+                                   VIR_DOMAIN_STATS_METADATA_TITLE);
+    if (dom->def->description)
+        virTypedParamListAddString(params, dom->def->description,
+                                   VIR_DOMAIN_STATS_METADATA_DESCRIPTION);
+
+    return 0;
+}
+
 typedef int
-(*testDomainGetStatsFunc)(virDomainObj *dom,
+(*testDomainGetStatsFunc)(testDriver *driver,
+                          virDomainObj *dom,
                           virTypedParamList *list);
 
 struct testDomainGetStatsWorker {
@@ -9899,6 +10008,8 @@ struct testDomainGetStatsWorker {
 static struct testDomainGetStatsWorker testDomainGetStatsWorkers[] = {
     { testDomainGetStatsState, VIR_DOMAIN_STATS_STATE },
     { testDomainGetStatsIOThread, VIR_DOMAIN_STATS_IOTHREAD },
+    { testDomainGetStatsXML, VIR_DOMAIN_STATS_XML },
+    { testDomainGetStatsMetadata, VIR_DOMAIN_STATS_METADATA },
     { NULL, 0 }
 };
 
@@ -9908,6 +10019,7 @@ testDomainGetStats(virConnectPtr conn,
                    unsigned int stats,
                    virDomainStatsRecordPtr *record)
 {
+    testDriver *driver = conn->privateData;
     g_autofree virDomainStatsRecordPtr tmp = NULL;
     g_autoptr(virTypedParamList) params = NULL;
     size_t i;
@@ -9916,7 +10028,7 @@ testDomainGetStats(virConnectPtr conn,
 
     for (i = 0; testDomainGetStatsWorkers[i].func; i++) {
         if (stats & testDomainGetStatsWorkers[i].stats) {
-            if (testDomainGetStatsWorkers[i].func(dom, params) < 0)
+            if (testDomainGetStatsWorkers[i].func(driver, dom, params) < 0)
                 return -1;
         }
     }
@@ -9948,7 +10060,9 @@ testConnectGetAllDomainStats(virConnectPtr conn,
                                    VIR_CONNECT_LIST_DOMAINS_FILTERS_STATE);
 
     unsigned int supported = VIR_DOMAIN_STATS_STATE |
-                             VIR_DOMAIN_STATS_IOTHREAD;
+                             VIR_DOMAIN_STATS_IOTHREAD |
+                             VIR_DOMAIN_STATS_XML |
+                             VIR_DOMAIN_STATS_METADATA;
     virDomainObj **vms = NULL;
     size_t nvms;
     virDomainStatsRecordPtr *tmpstats = NULL;
@@ -9964,7 +10078,8 @@ testConnectGetAllDomainStats(virConnectPtr conn,
                   VIR_CONNECT_GET_ALL_DOMAINS_STATS_ENFORCE_STATS, -1);
 
     if (!stats) {
-        stats = supported;
+        stats = supported & ~(VIR_DOMAIN_STATS_XML |
+                              VIR_DOMAIN_STATS_METADATA);
     } else if ((flags & VIR_CONNECT_GET_ALL_DOMAINS_STATS_ENFORCE_STATS) &&
                (stats & ~supported)) {
         virReportError(VIR_ERR_ARGUMENT_UNSUPPORTED,
@@ -11186,6 +11301,7 @@ static virHypervisorDriver testHypervisorDriver = {
     .domainSetMemoryFlags = testDomainSetMemoryFlags, /* 5.6.0 */
     .domainGetHostname = testDomainGetHostname, /* 5.5.0 */
     .domainGetInfo = testDomainGetInfo, /* 0.1.1 */
+    .domainGetInfoAsync = testDomainGetInfoAsync, /* 11.9.0 */
     .domainGetState = testDomainGetState, /* 0.9.2 */
     .domainGetControlInfo = testDomainGetControlInfo, /* 7.6.0 */
     .domainGetTime = testDomainGetTime, /* 5.4.0 */
@@ -166,6 +166,37 @@ virBufferAdd(virBuffer *buf, const char *str, int len)
         g_string_append_len(buf->str, str, len);
 }
 
+/**
+ * virBufferReserve:
+ * @buf: the buffer
+ * @size: expected size of the content of @buf
+ *
+ * Preallocates memory for @size bytes of content so that formatting a
+ * large document into @buf doesn't need to reallocate and copy the content
+ * repeatedly as it grows. The content of @buf is not modified.
+ */
+void
+virBufferReserve(virBuffer *buf, size_t size)
+{
+    size_t len;
+
+    if (!buf)
+        return;
+
+    if (!buf->str) {
+        buf->str = g_string_sized_new(size);
+        return;
+    }
+
+    if (buf->str->allocated_len > size)
+        return;
+
+    len = buf->str->len;
+    g_string_set_size(buf->str, size);
+    g_string_truncate(buf->str, len);
+}
+
+
 /**
  * virBufferAddBuffer:
  * @buf: the buffer to append to
@@ -325,6 +356,108 @@ virBufferVasprintf(virBuffer *buf, const char *format, va_list argptr)
 }
 
 
+/**
+ * virBufferXMLNeedsEscape:
+ * @c: character
+ *
+ * Returns true if @c has to be escaped in XML or can't be represented in
+ * XML at all and thus has to be dropped.
+ */
+static inline bool
+virBufferXMLNeedsEscape(unsigned char c)
+{
+    return (c < 0x20 && c != '\t' && c != '\n' && c != '\r') ||
+           c == '"' || c == '&' || c == '\'' || c == '<' || c == '>';
+}
+
+
+/**
+ * virBufferXMLSafeLength:
+ * @str: string to check
+ * @len: length of @str
+ *
+ * Returns the length of the prefix of @str which can be used in XML
+ * unmodified.
+ */
+static size_t
+virBufferXMLSafeLength(const char *str,
+                       size_t len)
+{
+    size_t i = 0;
+
+    /* Check whole blocks first. There are no data dependent branches within
+     * a block which allows the compiler to vectorize the inner loop. */
+    for (; i + 16 <= len; i += 16) {
+        bool escape = false;
+        size_t j;
+
+        for (j = 0; j < 16; j++)
+            escape |= virBufferXMLNeedsEscape(str[i + j]);
+
+        if (escape)
+            break;
+    }
+
+    for (; i < len; i++) {
+        if (virBufferXMLNeedsEscape(str[i]))
+            break;
+    }
+
+    return i;
+}
+
+
+/**
+ * virBufferXMLEscapeAppend:
+ * @out: string to append to
+ * @str: string to escape
+ * @len: length of @str
+ *
+ * Appends @str escaped for use in XML to @out. Control characters which
+ * can't be represented in XML are silently dropped.
+ */
+static void
+virBufferXMLEscapeAppend(GString *out,
+                         const char *str,
+                         size_t len)
+{
+    while (len > 0) {
+        size_t safe = virBufferXMLSafeLength(str, len);
+
+        g_string_append_len(out, str, safe);
+        str += safe;
+        len -= safe;
+
+        if (len == 0)
+            break;
+
+        switch (*str) {
+        case '<':
+            g_string_append_len(out, "&lt;", 4);
+            break;
+        case '>':
+            g_string_append_len(out, "&gt;", 4);
+            break;
+        case '&':
+            g_string_append_len(out, "&amp;", 5);
+            break;
+        case '"':
+            g_string_append_len(out, "&quot;", 6);
+            break;
+        case '\'':
+            g_string_append_len(out, "&apos;", 6);
+            break;
+        default:
+            /* silently ignore control characters */
+            break;
+        }
+
+        str++;
+        len--;
+    }
+}
+
+
 /**
  * virBufferEscapeString:
  * @buf: the buffer to append to
@@ -339,78 +472,38 @@ virBufferVasprintf(virBuffer *buf, const char *format, va_list argptr)
 void
 virBufferEscapeString(virBuffer *buf, const char *format, const char *str)
 {
-    int len;
-    g_autofree char *escaped = NULL;
-    char *out;
-    const char *cur;
-    const char forbidden_characters[] = {
-        0x01,   0x02,   0x03,   0x04,   0x05,   0x06,   0x07,   0x08,
-        /*\t*/  /*\n*/  0x0B,   0x0C,   /*\r*/  0x0E,   0x0F,   0x10,
-        0x11,   0x12,   0x13,   0x14,   0x15,   0x16,   0x17,   0x18,
-        0x19,   '"',    '&',    '\'',   '<',    '>',
-        '\0'
-    };
+    g_autoptr(GString) escaped = NULL;
+    const char *arg;
+    size_t len;
 
     if ((format == NULL) || (buf == NULL) || (str == NULL))
         return;
 
     len = strlen(str);
-    if (strcspn(str, forbidden_characters) == len) {
-        virBufferAsprintf(buf, format, str);
+
+    /* Formats consisting of just a prefix, '%s' and a suffix, which is how
+     * this function is used almost everywhere, are formatted directly into
+     * @buf without the need for any temporary copies. */
+    if ((arg = strchr(format, '%')) && arg[1] == 's' &&
+        !strchr(arg + 2, '%')) {
+        virBufferInitialize(buf);
+        virBufferApplyIndent(buf);
+
+        g_string_append_len(buf->str, format, arg - format);
+        virBufferXMLEscapeAppend(buf->str, str, len);
+        g_string_append(buf->str, arg + 2);
         return;
     }
 
-    escaped = g_malloc0_n(len + 1, 6);
-
-    cur = str;
-    out = escaped;
-    while (*cur != 0) {
-        if (*cur == '<') {
-            *out++ = '&';
-            *out++ = 'l';
-            *out++ = 't';
-            *out++ = ';';
-        } else if (*cur == '>') {
-            *out++ = '&';
-            *out++ = 'g';
-            *out++ = 't';
-            *out++ = ';';
-        } else if (*cur == '&') {
-            *out++ = '&';
-            *out++ = 'a';
-            *out++ = 'm';
-            *out++ = 'p';
-            *out++ = ';';
-        } else if (*cur == '"') {
-            *out++ = '&';
-            *out++ = 'q';
-            *out++ = 'u';
-            *out++ = 'o';
-            *out++ = 't';
-            *out++ = ';';
-        } else if (*cur == '\'') {
-            *out++ = '&';
-            *out++ = 'a';
-            *out++ = 'p';
-            *out++ = 'o';
-            *out++ = 's';
-            *out++ = ';';
-        } else if (!strchr(forbidden_characters, *cur)) {
-            /*
-             * default case, just copy !
-             * Note that character over 0x80 are likely to give problem
-             * with UTF-8 XML, but since our string don't have an encoding
-             * it's hard to handle properly we have to assume it's UTF-8 too
-             */
-            *out++ = *cur;
-        } else {
-            /* silently ignore control characters */
-        }
-        cur++;
+    if (virBufferXMLSafeLength(str, len) == len) {
+        virBufferAsprintf(buf, format, str);
+        return;
     }
-    *out = 0;
 
-    virBufferAsprintf(buf, format, escaped);
+    escaped = g_string_sized_new(len + 32);
+    virBufferXMLEscapeAppend(escaped, str, len);
+
+    virBufferAsprintf(buf, format, escaped->str);
 }
 
 /**
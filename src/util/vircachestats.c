@@ -0,0 +1,100 @@
+/*
+ * vircachestats.c: statistics of caches kept by the daemon
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include "vircachestats.h"
+#include "viralloc.h"
+#include "virthread.h"
+
+typedef struct _virCacheStatsSource virCacheStatsSource;
+struct _virCacheStatsSource {
+    char *prefix;
+    virCacheStatsFunc func;
+    void *opaque;
+};
+
+/* Sources are called with the lock held so that none of them runs
+ * once virCacheStatsUnregister returned. */
+static virMutex virCacheStatsLock = VIR_MUTEX_INITIALIZER;
+static virCacheStatsSource *virCacheStatsSources;
+static size_t virCacheStatsNSources;
+
+
+/**
+ * virCacheStatsRegister:
+ * @prefix: name of the cache
+ * @func: callback reporting the statistics of the cache
+ * @opaque: data passed to @func
+ *
+ * Registers a cache whose statistics are reported by
+ * virCacheStatsCollect, e.g. to the admin interface of the daemon.
+ */
+void
+virCacheStatsRegister(const char *prefix,
+                      virCacheStatsFunc func,
+                      void *opaque)
+{
+    virCacheStatsSource source = { .prefix = g_strdup(prefix),
+                                   .func = func,
+                                   .opaque = opaque };
+    VIR_LOCK_GUARD lock = virLockGuardLock(&virCacheStatsLock);
+
+    VIR_APPEND_ELEMENT(virCacheStatsSources, virCacheStatsNSources, source);
+}
+
+
+/**
+ * virCacheStatsUnregister:
+ * @prefix: name the cache was registered with
+ *
+ * Removes the cache registered as @prefix. Its callback is not called
+ * anymore once this function returns.
+ */
+void
+virCacheStatsUnregister(const char *prefix)
+{
+    VIR_LOCK_GUARD lock = virLockGuardLock(&virCacheStatsLock);
+    size_t i;
+
+    for (i = 0; i < virCacheStatsNSources; i++) {
+        if (STREQ(virCacheStatsSources[i].prefix, prefix)) {
+            g_free(virCacheStatsSources[i].prefix);
+            VIR_DELETE_ELEMENT(virCacheStatsSources, i, virCacheStatsNSources);
+            return;
+        }
+    }
+}
+
+
+/**
+ * virCacheStatsCollect:
+ * @list: list to add the statistics to
+ *
+ * Adds the statistics of all registered caches to @list.
+ */
+void
+virCacheStatsCollect(virTypedParamList *list)
+{
+    VIR_LOCK_GUARD lock = virLockGuardLock(&virCacheStatsLock);
+    size_t i;
+
+    for (i = 0; i < virCacheStatsNSources; i++)
+        virCacheStatsSources[i].func(list, virCacheStatsSources[i].prefix,
+                                     virCacheStatsSources[i].opaque);
+}
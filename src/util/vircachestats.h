@@ -0,0 +1,48 @@
+/*
+ * vircachestats.h: statistics of caches kept by the daemon
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "virtypedparam.h"
+
+/**
+ * virCacheStatsFunc:
+ * @list: list to add the statistics to
+ * @prefix: name the source was registered with
+ * @opaque: data passed to virCacheStatsRegister
+ *
+ * Adds the statistics of a cache to @list, each of them named
+ * "@prefix.<statistic>".
+ */
+typedef void (*virCacheStatsFunc)(virTypedParamList *list,
+                                  const char *prefix,
+                                  void *opaque);
+
+void
+virCacheStatsRegister(const char *prefix,
+                      virCacheStatsFunc func,
+                      void *opaque)
+    ATTRIBUTE_NONNULL(1) ATTRIBUTE_NONNULL(2);
+
+void
+virCacheStatsUnregister(const char *prefix)
+    ATTRIBUTE_NONNULL(1);
+
+void
+virCacheStatsCollect(virTypedParamList *list)
+    ATTRIBUTE_NONNULL(1);
@@ -69,7 +69,7 @@ static GPtrArray *handles;
 static int nexttimer = 1;
 static GPtrArray *timeouts;
 
-static GIOCondition
+GIOCondition
 virEventGLibEventsToCondition(int events)
 {
     GIOCondition cond = 0;
@@ -84,7 +84,7 @@ virEventGLibEventsToCondition(int events)
     return cond;
 }
 
-static int
+int
 virEventGLibConditionToEvents(GIOCondition cond)
 {
     int events = 0;
@@ -26,3 +26,7 @@
 void virEventGLibRegister(void);
 
 int virEventGLibRunOnce(void);
+
+GIOCondition virEventGLibEventsToCondition(int events);
+
+int virEventGLibConditionToEvents(GIOCondition cond);
@@ -26,8 +26,12 @@
 #include <fcntl.h>
 #include <unistd.h>
 #ifndef WIN32
+# include <poll.h>
 # include <termios.h>
 #endif
+#ifdef WITH_SYS_SENDFILE_H
+# include <sys/sendfile.h>
+#endif
 
 #include "virfdstream.h"
 #include "virerror.h"
@@ -40,6 +44,7 @@
 #include "virstring.h"
 #include "virtime.h"
 #include "virsocket.h"
+#include "virzero.h"
 
 #define VIR_FROM_THIS VIR_FROM_STREAMS
 
@@ -105,7 +110,13 @@ struct virFDStreamData {
     bool threadQuit;
     bool threadAbort;
     bool threadDoRead;
+    bool threadSparse;
     virFDStreamMsg *msg;
+
+    /* The thread moves the data between the file and this FD on its
+     * own, see virFDStreamRedirect() */
+    int redirectFD;
+    bool redirected;
 };
 
 static virClass *virFDStreamDataClass;
@@ -122,6 +133,7 @@ virFDStreamDataDispose(void *obj)
     virFDStreamDataDisposed = true;
     virFreeError(fdst->threadErr);
     virFDStreamMsgQueueFree(&fdst->msg);
+    VIR_FORCE_CLOSE(fdst->redirectFD);
 }
 
 static int virFDStreamDataOnceInit(void)
@@ -482,7 +494,8 @@ virFDStreamThreadDoRead(virFDStreamData *fdst,
             buflen > *dataLen)
             buflen = *dataLen;
 
-        buf = g_new0(char, buflen);
+        /* Only the part filled by the read is ever used */
+        buf = g_new(char, buflen);
 
         if ((got = saferead(fdin, buf, buflen)) < 0) {
             virReportSystemError(errno,
@@ -491,11 +504,20 @@ virFDStreamThreadDoRead(virFDStreamData *fdst,
             return -1;
         }
 
-        msg->type = VIR_FDSTREAM_MSG_TYPE_DATA;
-        msg->stream.data.buf = g_steal_pointer(&buf);
-        msg->stream.data.len = got;
         if (sparse)
             *dataLen -= got;
+
+        /* Data sections may still be full of zeroes, especially on block
+         * devices which have no holes at all. Pass those on as holes so
+         * that the other side doesn't have to transfer and write them. */
+        if (sparse && got > 0 && virIsZero(buf, got)) {
+            msg->type = VIR_FDSTREAM_MSG_TYPE_HOLE;
+            msg->stream.hole.len = got;
+        } else {
+            msg->type = VIR_FDSTREAM_MSG_TYPE_DATA;
+            msg->stream.data.buf = g_steal_pointer(&buf);
+            msg->stream.data.len = got;
+        }
     }
 
     virFDStreamMsgQueuePush(fdst, &msg, fdout, fdoutname);
@@ -599,6 +621,374 @@ virFDStreamThreadDoWrite(virFDStreamData *fdst,
 }
 
 
+/* How much data a redirected stream moves in one step */
+#define VIR_FDSTREAM_REDIRECT_CHUNK (1024 * 1024)
+
+/* How often a redirected stream waiting for its peer checks for abort */
+#define VIR_FDSTREAM_REDIRECT_POLL_MS 500
+
+/*
+ * Waits until @fd is ready for @events. The peer of a redirected stream
+ * is expected to close its end before finishing the stream, so a finish
+ * request while @fd is still not ready is an error.
+ */
+static int
+virFDStreamThreadRedirectWait(virFDStreamData *fdst,
+                              int fd,
+                              short events)
+{
+    struct pollfd pfd = { .fd = fd, .events = events };
+
+    while (1) {
+        bool quit;
+        int rc;
+
+        VIR_WITH_OBJECT_LOCK_GUARD(fdst) {
+            if (fdst->threadAbort) {
+                virReportError(VIR_ERR_OPERATION_ABORTED, "%s",
+                               _("stream aborted"));
+                return -1;
+            }
+            quit = fdst->threadQuit;
+        }
+
+        rc = poll(&pfd, 1, quit ? 0 : VIR_FDSTREAM_REDIRECT_POLL_MS);
+        if (rc < 0) {
+            if (errno == EINTR)
+                continue;
+            virReportSystemError(errno, "%s",
+                                 _("Unable to poll redirected stream"));
+            return -1;
+        }
+
+        if (rc > 0)
+            return 0;
+
+        if (quit) {
+            virReportError(VIR_ERR_OPERATION_FAILED, "%s",
+                           _("redirected stream was finished prematurely"));
+            return -1;
+        }
+    }
+}
+
+
+static int
+virFDStreamThreadRedirectWriteAll(virFDStreamData *fdst,
+                                  int fd,
+                                  const char *buf,
+                                  size_t len)
+{
+    while (len) {
+        ssize_t done = write(fd, buf, len); /* sc_avoid_write */
+
+        if (done < 0) {
+            VIR_WARNINGS_NO_WLOGICALOP_EQUAL_EXPR
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            VIR_WARNINGS_RESET
+                if (virFDStreamThreadRedirectWait(fdst, fd, POLLOUT) < 0)
+                    return -1;
+                continue;
+            }
+            if (errno == EINTR)
+                continue;
+            virReportSystemError(errno, "%s",
+                                 _("Unable to write to redirected stream"));
+            return -1;
+        }
+
+        buf += done;
+        len -= done;
+    }
+
+    return 0;
+}
+
+
+/*
+ * Moves data from the file @fdin to the redirect socket @fd. Uses
+ * sendfile() where possible so that the data doesn't have to be copied
+ * through userspace.
+ */
+static int
+virFDStreamThreadRedirectRead(virFDStreamData *fdst,
+                              int fd,
+                              int fdin,
+                              const char *fdinname,
+                              size_t length,
+                              size_t total)
+{
+    g_autofree char *buf = NULL;
+#ifdef WITH_SYS_SENDFILE_H
+    bool useSendfile = true;
+#endif
+
+    while (!length || total < length) {
+        size_t want = VIR_FDSTREAM_REDIRECT_CHUNK;
+        ssize_t got;
+
+        if (length && want > length - total)
+            want = length - total;
+
+        if (virFDStreamThreadRedirectWait(fdst, fd, POLLOUT) < 0)
+            return -1;
+
+#ifdef WITH_SYS_SENDFILE_H
+        if (useSendfile) {
+            got = sendfile(fd, fdin, NULL, want);
+
+            if (got >= 0) {
+                if (got == 0)
+                    return 0;
+                total += got;
+                continue;
+            }
+
+            VIR_WARNINGS_NO_WLOGICALOP_EQUAL_EXPR
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+                continue;
+            VIR_WARNINGS_RESET
+
+            if (errno != EINVAL && errno != ENOSYS) {
+                virReportSystemError(errno, _("Unable to send %1$s"),
+                                     fdinname);
+                return -1;
+            }
+
+            VIR_DEBUG("sendfile() not usable for %s, falling back to read()",
+                      fdinname);
+            useSendfile = false;
+        }
+#endif /* WITH_SYS_SENDFILE_H */
+
+        if (!buf)
+            buf = g_new(char, VIR_FDSTREAM_REDIRECT_CHUNK);
+
+        if ((got = saferead(fdin, buf, want)) < 0) {
+            virReportSystemError(errno, _("Unable to read %1$s"), fdinname);
+            return -1;
+        }
+
+        if (got == 0)
+            return 0;
+
+        if (virFDStreamThreadRedirectWriteAll(fdst, fd, buf, got) < 0)
+            return -1;
+
+        total += got;
+    }
+
+    return 0;
+}
+
+
+#ifdef WITH_SPLICE
+/*
+ * Moves @len bytes sitting in the pipe @pipefd to @fdout. Falls back to
+ * read()/write() if @fdout can't be spliced to, in which case @useSplice
+ * is cleared for the rest of the transfer.
+ */
+static int
+virFDStreamThreadRedirectDrainPipe(int pipefd,
+                                   int fdout,
+                                   const char *fdoutname,
+                                   size_t len,
+                                   char **buf,
+                                   bool *useSplice)
+{
+    while (len) {
+        ssize_t done;
+
+        if (*useSplice) {
+            done = splice(pipefd, NULL, fdout, NULL, len, SPLICE_F_MOVE);
+
+            if (done < 0 && errno == EINVAL) {
+                VIR_DEBUG("splice() not usable for %s, falling back to write()",
+                          fdoutname);
+                *useSplice = false;
+                continue;
+            }
+        } else {
+            if (!*buf)
+                *buf = g_new(char, VIR_FDSTREAM_REDIRECT_CHUNK);
+
+            if ((done = saferead(pipefd, *buf,
+                                 MIN(len, VIR_FDSTREAM_REDIRECT_CHUNK))) > 0 &&
+                safewrite(fdout, *buf, done) < 0)
+                done = -1;
+        }
+
+        if (done < 0) {
+            if (errno == EINTR)
+                continue;
+            virReportSystemError(errno, _("Unable to write %1$s"), fdoutname);
+            return -1;
+        }
+
+        len -= done;
+    }
+
+    return 0;
+}
+#endif /* WITH_SPLICE */
+
+
+/*
+ * Moves data from the redirect socket @fd to the file @fdout. On Linux
+ * the data is spliced through a pipe so that it doesn't have to be
+ * copied through userspace.
+ */
+static int
+virFDStreamThreadRedirectWrite(virFDStreamData *fdst,
+                               int fd,
+                               int fdout,
+                               const char *fdoutname,
+                               size_t length,
+                               size_t total)
+{
+    g_autofree char *buf = NULL;
+#ifdef WITH_SPLICE
+    int pipefds[2] = { -1, -1 };
+    VIR_AUTOCLOSE piperd = -1;
+    VIR_AUTOCLOSE pipewr = -1;
+    bool useSplice = false;
+
+    if (virPipeQuiet(pipefds) == 0) {
+        piperd = pipefds[0];
+        pipewr = pipefds[1];
+        useSplice = true;
+# ifdef F_SETPIPE_SZ
+        /* Best effort, the default pipe size limits each step to 64KiB */
+        ignore_value(fcntl(pipewr, F_SETPIPE_SZ, VIR_FDSTREAM_REDIRECT_CHUNK));
+# endif
+    }
+#endif /* WITH_SPLICE */
+
+    while (!length || total < length) {
+        size_t want = VIR_FDSTREAM_REDIRECT_CHUNK;
+        ssize_t got;
+
+        if (length && want > length - total)
+            want = length - total;
+
+        if (virFDStreamThreadRedirectWait(fdst, fd, POLLIN) < 0)
+            return -1;
+
+#ifdef WITH_SPLICE
+        if (useSplice) {
+            got = splice(fd, NULL, pipewr, NULL, want,
+                         SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+
+            if (got >= 0) {
+                if (got == 0)
+                    return 0;
+                if (virFDStreamThreadRedirectDrainPipe(piperd, fdout, fdoutname,
+                                                       got, &buf, &useSplice) < 0)
+                    return -1;
+                total += got;
+                continue;
+            }
+
+            VIR_WARNINGS_NO_WLOGICALOP_EQUAL_EXPR
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+                continue;
+            VIR_WARNINGS_RESET
+
+            if (errno != EINVAL) {
+                virReportSystemError(errno, "%s",
+                                     _("Unable to read from redirected stream"));
+                return -1;
+            }
+
+            VIR_DEBUG("splice() not usable, falling back to read()");
+            useSplice = false;
+        }
+#endif /* WITH_SPLICE */
+
+        if (!buf)
+            buf = g_new(char, VIR_FDSTREAM_REDIRECT_CHUNK);
+
+        if ((got = read(fd, buf, want)) < 0) {
+            VIR_WARNINGS_NO_WLOGICALOP_EQUAL_EXPR
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+                continue;
+            VIR_WARNINGS_RESET
+
+            virReportSystemError(errno, "%s",
+                                 _("Unable to read from redirected stream"));
+            return -1;
+        }
+
+        if (got == 0)
+            return 0;
+
+        if (safewrite(fdout, buf, got) < 0) {
+            virReportSystemError(errno, _("Unable to write %1$s"), fdoutname);
+            return -1;
+        }
+
+        total += got;
+    }
+
+    return 0;
+}
+
+
+/*
+ * Transfers the rest of the stream through the redirect FD. Called and
+ * returns with @fdst locked, but doesn't hold the lock while moving data.
+ */
+static int
+virFDStreamThreadRedirect(virFDStreamData *fdst,
+                          bool doRead,
+                          int fdin,
+                          int fdout,
+                          const char *fdinname,
+                          const char *fdoutname,
+                          size_t length,
+                          size_t total)
+{
+    g_autoptr(virFDStreamMsg) msg = NULL;
+    int fd = fdst->redirectFD;
+    int ret = 0;
+
+    VIR_DEBUG("Redirecting stream %s -> %s through fd=%d",
+              fdinname, fdoutname, fd);
+
+    /* Data read ahead before the stream was redirected goes first */
+    if (doRead && fdst->msg) {
+        msg = fdst->msg;
+        if (!virFDStreamMsgQueuePop(fdst, fdst->fd, "pipe"))
+            return -1;
+    }
+
+    virObjectUnlock(fdst);
+
+    if (msg && msg->type == VIR_FDSTREAM_MSG_TYPE_DATA)
+        ret = virFDStreamThreadRedirectWriteAll(fdst, fd,
+                                                msg->stream.data.buf +
+                                                msg->stream.data.offset,
+                                                msg->stream.data.len -
+                                                msg->stream.data.offset);
+
+    if (ret == 0) {
+        if (doRead)
+            ret = virFDStreamThreadRedirectRead(fdst, fd, fdin, fdinname,
+                                                length, total);
+        else
+            ret = virFDStreamThreadRedirectWrite(fdst, fd, fdout, fdoutname,
+                                                 length, total);
+    }
+
+    virObjectLock(fdst);
+
+    /* Let the peer know there's nothing more to come */
+    VIR_FORCE_CLOSE(fdst->redirectFD);
+
+    return ret;
+}
+
+
 static void
 virFDStreamThread(void *opaque)
 {
@@ -613,7 +1003,9 @@ virFDStreamThread(void *opaque)
     char *fdoutname = data->fdoutname;
     virFDStreamData *fdst = st->privateData;
     bool doRead = fdst->threadDoRead;
-    size_t buflen = 256 * 1024;
+    /* Large enough to fill the biggest stream data message of the RPC
+     * protocol in one go. */
+    size_t buflen = 4 * 1024 * 1024; /* 4MiB */
     size_t total = 0;
     size_t dataLen = 0;
 
@@ -624,7 +1016,8 @@ virFDStreamThread(void *opaque)
         ssize_t got;
 
         while (doRead == (fdst->msg != NULL) &&
-               !fdst->threadQuit) {
+               !fdst->threadQuit &&
+               !fdst->redirected) {
             if (virCondWait(&fdst->threadCond, &fdst->parent.lock)) {
                 virReportSystemError(errno, "%s",
                                      _("failed to wait on condition"));
@@ -632,6 +1025,23 @@ virFDStreamThread(void *opaque)
             }
         }
 
+        if (fdst->redirected && !fdst->threadAbort) {
+            g_autoptr(virFDStreamMsg) eof = NULL;
+
+            if (virFDStreamThreadRedirect(fdst, doRead, fdin, fdout,
+                                          fdinname, fdoutname,
+                                          length, total) < 0)
+                goto error;
+
+            if (doRead) {
+                /* Readers of the stream see just the EOF */
+                eof = g_new0(virFDStreamMsg, 1);
+                eof->type = VIR_FDSTREAM_MSG_TYPE_DATA;
+                virFDStreamMsgQueuePush(fdst, &eof, fdout, fdoutname);
+            }
+            break;
+        }
+
         if (fdst->threadQuit) {
             /* If stream abort was requested, quit early. */
             if (fdst->threadAbort)
@@ -697,6 +1107,7 @@ virFDStreamJoinWorker(virFDStreamData *fdst,
 
     if (fdst->threadErr && !streamAbort) {
         /* errors are expected on streamAbort */
+        virSetError(fdst->threadErr);
         goto cleanup;
     }
 
@@ -750,13 +1161,14 @@ virFDStreamCloseInt(virStreamPtr st, bool streamAbort)
         fdst->abortCallbackDispatching = false;
     }
 
-    if (virFDStreamJoinWorker(fdst, streamAbort) < 0)
-        ret = -1;
+    ret = virFDStreamJoinWorker(fdst, streamAbort);
 
     /* mutex locked */
-    if ((ret = VIR_CLOSE(fdst->fd)) < 0)
+    if (VIR_CLOSE(fdst->fd) < 0) {
         virReportSystemError(errno, "%s",
                              _("Unable to close"));
+        ret = -1;
+    }
 
     st->privateData = NULL;
 
@@ -826,7 +1238,7 @@ static int virFDStreamWrite(virStreamPtr st, const char *bytes, size_t nbytes)
     if (fdst->thread) {
         char *buf;
 
-        if (fdst->threadQuit || fdst->threadErr) {
+        if (fdst->threadQuit || fdst->threadErr || fdst->redirected) {
 
             /* virStreamSend will virResetLastError possibly set
              * by virFDStreamEvent */
@@ -906,6 +1318,14 @@ static int virFDStreamRead(virStreamPtr st, char *bytes, size_t nbytes)
     if (fdst->thread) {
         virFDStreamMsg *msg = NULL;
 
+        /* The data goes through the redirect FD, all that's left to
+         * read here is the EOF once the thread is done. */
+        if (fdst->redirected && !fdst->msg &&
+            !fdst->threadQuit && !fdst->threadErr) {
+            ret = -2;
+            goto cleanup;
+        }
+
         while (!(msg = fdst->msg)) {
             if (fdst->threadQuit || fdst->threadErr) {
                 if (nbytes) {
@@ -1108,6 +1528,48 @@ virFDStreamInData(virStreamPtr st,
 }
 
 
+static int
+virFDStreamRedirect(virStreamPtr st,
+                    int fd)
+{
+    virFDStreamData *fdst = st->privateData;
+    VIR_LOCK_GUARD lock = { NULL };
+
+    if (!fdst) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       "%s", _("stream is not open"));
+        return -1;
+    }
+
+    lock = virObjectLockGuard(fdst);
+
+    /* Only the helper thread can move the data on its own, holes can't
+     * be represented in a plain byte stream and any data already passed
+     * through the stream API would get out of order. */
+    if (!fdst->thread ||
+        fdst->threadSparse ||
+        fdst->threadQuit ||
+        fdst->threadErr ||
+        fdst->redirected ||
+        fdst->offset ||
+        (!fdst->threadDoRead && fdst->msg))
+        return 0;
+
+    if (virSetNonBlock(fd) < 0) {
+        virReportSystemError(errno, "%s", _("Unable to set non-blocking mode"));
+        return -1;
+    }
+
+    VIR_DEBUG("Redirecting stream %p to fd=%d", st, fd);
+
+    fdst->redirectFD = fd;
+    fdst->redirected = true;
+    virCondSignal(&fdst->threadCond);
+
+    return 1;
+}
+
+
 static virStreamDriver virFDStreamDrv = {
     .streamSend = virFDStreamWrite,
     .streamRecv = virFDStreamRead,
@@ -1117,7 +1579,8 @@ static virStreamDriver virFDStreamDrv = {
     .streamInData = virFDStreamInData,
     .streamEventAddCallback = virFDStreamAddCallback,
     .streamEventUpdateCallback = virFDStreamUpdateCallback,
-    .streamEventRemoveCallback = virFDStreamRemoveCallback
+    .streamEventRemoveCallback = virFDStreamRemoveCallback,
+    .streamRedirect = virFDStreamRedirect,
 };
 
 static int virFDStreamOpenInternal(virStreamPtr st,
@@ -1144,12 +1607,14 @@ static int virFDStreamOpenInternal(virStreamPtr st,
 
     fdst->fd = fd;
     fdst->length = length;
+    fdst->redirectFD = -1;
 
     st->driver = &virFDStreamDrv;
     st->privateData = fdst;
 
     if (threadData) {
         fdst->threadDoRead = threadData->doRead;
+        fdst->threadSparse = threadData->sparse;
 
         /* Create the thread after fdst and st were initialized.
          * The thread worker expects them to be that way. */
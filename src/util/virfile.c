@@ -59,6 +59,9 @@
 #if WITH_LIBACL
 # include <sys/acl.h>
 #endif
+#if WITH_LIBURING
+# include <liburing.h>
+#endif
 #include <sys/file.h>
 
 #ifdef __linux__
@@ -4850,6 +4853,12 @@ virFileSetCOW(const char *path,
 }
 
 #ifndef WIN32
+/* Defaults for virFileDiskCopy */
+# define VIR_FILE_DISK_COPY_BUFFER_SIZE (1024 * 1024)
+# define VIR_FILE_DISK_COPY_QUEUE_DEPTH 8
+/* Buffers are aligned so that they can be used with O_DIRECT */
+# define VIR_FILE_DISK_COPY_ALIGN (64 * 1024)
+
 struct runIOParams {
     bool isBlockDev;
     bool isDirect;
@@ -4858,36 +4867,50 @@ struct runIOParams {
     const char *fdinname;
     int fdout;
     const char *fdoutname;
+    size_t buflen;
+    unsigned int queueDepth;
 };
 
 /**
- * runIOCopy: execute the IO copy based on the passed parameters
+ * runIOAllocBuffer:
+ * @len: size of the buffer
+ * @base: filled with the location to be freed
+ *
+ * Returns: a buffer of @len bytes within @base suitable for O_DIRECT.
+ */
+static char *
+runIOAllocBuffer(size_t len,
+                 void **base)
+{
+    intptr_t alignMask = VIR_FILE_DISK_COPY_ALIGN - 1;
+
+# if WITH_POSIX_MEMALIGN
+    if (posix_memalign(base, alignMask + 1, len))
+        abort();
+    return *base;
+# else
+    *base = g_new0(char, len + alignMask);
+    return (char *) (((intptr_t) *base + alignMask) & ~alignMask);
+# endif
+}
+
+/**
+ * runIOCopyLoop: execute the IO copy based on the passed parameters
  * @p: the IO parameters
  *
- * Execute the copy based on the passed parameters.
+ * Execute the copy one buffer at a time using read() and write().
  *
  * Returns: size transferred, or < 0 on error.
  */
-
 static off_t
-runIOCopy(const struct runIOParams p)
+runIOCopyLoop(const struct runIOParams p)
 {
     g_autofree void *base = NULL; /* Location to be freed */
-    char *buf = NULL; /* Aligned location within base */
-    size_t buflen = 1024*1024;
-    intptr_t alignMask = 64*1024 - 1;
+    size_t buflen = p.buflen;
+    char *buf = runIOAllocBuffer(buflen, &base); /* Aligned location within base */
+    intptr_t alignMask = VIR_FILE_DISK_COPY_ALIGN - 1;
     off_t total = 0;
 
-# if WITH_POSIX_MEMALIGN
-    if (posix_memalign(&base, alignMask + 1, buflen))
-        abort();
-    buf = base;
-# else
-    buf = g_new0(char, buflen + alignMask);
-    base = buf;
-    buf = (char *) (((intptr_t) base + alignMask) & ~alignMask);
-# endif
-
     while (1) {
         ssize_t got;
 
@@ -4941,14 +4964,419 @@ runIOCopy(const struct runIOParams p)
     return total;
 }
 
+# if WITH_LIBURING
+struct runIOUringSlot {
+    char *buf;
+    off_t offset;
+    size_t len;  /* bytes to transfer */
+    size_t done; /* bytes transferred so far */
+    bool busy;
+};
+
+struct runIOUring {
+    struct io_uring ring;
+    struct runIOUringSlot *slots;
+    size_t nslots;
+    size_t inflight;
+    int fd; /* the disk, or its index if registered */
+    bool fixedFile;
+    bool fixedBufs;
+    bool isWrite;
+    bool isDirect;
+    int error; /* errno of the first failed request */
+};
+
+
+static int
+runIOUringSubmit(struct runIOUring *ctx,
+                 struct runIOUringSlot *slot)
+{
+    struct io_uring_sqe *sqe = io_uring_get_sqe(&ctx->ring);
+    char *buf = slot->buf + slot->done;
+    size_t len = slot->len - slot->done;
+    off_t offset = slot->offset + slot->done;
+    int idx = slot - ctx->slots;
+    int ret;
+
+    /* There are never more requests in flight than slots, nor slots than
+     * entries in the submission queue */
+    if (!sqe)
+        abort();
+
+    if (ctx->isWrite) {
+        if (ctx->fixedBufs)
+            io_uring_prep_write_fixed(sqe, ctx->fd, buf, len, offset, idx);
+        else
+            io_uring_prep_write(sqe, ctx->fd, buf, len, offset);
+    } else {
+        if (ctx->fixedBufs)
+            io_uring_prep_read_fixed(sqe, ctx->fd, buf, len, offset, idx);
+        else
+            io_uring_prep_read(sqe, ctx->fd, buf, len, offset);
+    }
+
+    if (ctx->fixedFile)
+        io_uring_sqe_set_flags(sqe, IOSQE_FIXED_FILE);
+    io_uring_sqe_set_data(sqe, slot);
+
+    while ((ret = io_uring_submit(&ctx->ring)) == -EINTR)
+        ;
+    if (ret < 0) {
+        ctx->error = -ret;
+        return -1;
+    }
+
+    slot->busy = true;
+    ctx->inflight++;
+    return 0;
+}
+
+
+/*
+ * Waits for a request to finish and accounts its result to its slot,
+ * resubmitting the rest of a short transfer if needed.
+ */
+static void
+runIOUringReap(struct runIOUring *ctx)
+{
+    struct io_uring_cqe *cqe;
+    struct runIOUringSlot *slot;
+    int res;
+    int ret;
+
+    while ((ret = io_uring_wait_cqe(&ctx->ring, &cqe)) == -EINTR)
+        ;
+    if (ret < 0) {
+        /* Not expected to happen with requests in flight, there's no
+         * point in trying to wait for them again */
+        abort();
+    }
+
+    slot = io_uring_cqe_get_data(cqe);
+    res = cqe->res;
+    io_uring_cqe_seen(&ctx->ring, cqe);
+
+    slot->busy = false;
+    ctx->inflight--;
+
+    if (res < 0) {
+        if (!ctx->error)
+            ctx->error = -res;
+        return;
+    }
+
+    if (res == 0) {
+        /* End of file when reading, nothing written is an error */
+        if (ctx->isWrite && !ctx->error)
+            ctx->error = EIO;
+        return;
+    }
+
+    slot->done += res;
+    if (slot->done == slot->len || ctx->error)
+        return;
+
+    /* A short read ending unaligned with O_DIRECT can only mean the end
+     * of the file and can't be continued anyway */
+    if (!ctx->isWrite && ctx->isDirect &&
+        (slot->offset + slot->done) % VIR_FILE_DISK_COPY_ALIGN)
+        return;
+
+    ignore_value(runIOUringSubmit(ctx, slot));
+}
+
+
+/*
+ * Reads the disk with up to as many requests in flight as there are
+ * slots, writing the data out in order as it comes.
+ */
+static off_t
+runIOUringCopyFromDisk(struct runIOUring *ctx,
+                       const struct runIOParams *p,
+                       off_t offset)
+{
+    off_t total = 0;
+    size_t head = 0;
+    bool eof = false;
+    size_t i;
+    int ret = 0;
+
+    for (i = 0; i < ctx->nslots; i++) {
+        ctx->slots[i].offset = offset;
+        ctx->slots[i].len = p->buflen;
+        ctx->slots[i].done = 0;
+        offset += p->buflen;
+
+        if (runIOUringSubmit(ctx, &ctx->slots[i]) < 0)
+            break;
+    }
+
+    while (ctx->inflight > 0) {
+        struct runIOUringSlot *slot = &ctx->slots[head];
+
+        while (slot->busy)
+            runIOUringReap(ctx);
+
+        head = (head + 1) % ctx->nslots;
+
+        if (eof || ctx->error || ret < 0)
+            continue;
+
+        if (slot->done > 0 &&
+            safewrite(p->fdout, slot->buf, slot->done) < 0) {
+            virReportSystemError(errno, _("Unable to write %1$s"), p->fdoutname);
+            ret = -3;
+            continue;
+        }
+        total += slot->done;
+
+        if (slot->done < slot->len) {
+            eof = true;
+            continue;
+        }
+
+        slot->offset = offset;
+        slot->done = 0;
+        offset += p->buflen;
+
+        ignore_value(runIOUringSubmit(ctx, slot));
+    }
+
+    if (ret < 0)
+        return ret;
+
+    if (ctx->error) {
+        virReportSystemError(ctx->error, _("Unable to read %1$s"), p->fdinname);
+        return -2;
+    }
+
+    return total;
+}
+
+
+/*
+ * Fills the slots with data read in order and writes them to the disk
+ * with up to as many requests in flight as there are slots.
+ */
+static off_t
+runIOUringCopyToDisk(struct runIOUring *ctx,
+                     const struct runIOParams *p,
+                     off_t offset)
+{
+    off_t start = offset;
+    off_t total = 0;
+    size_t next = 0;
+    bool padded = false;
+    int ret = 0;
+
+    while (!padded) {
+        struct runIOUringSlot *slot = &ctx->slots[next];
+        ssize_t got;
+
+        while (slot->busy)
+            runIOUringReap(ctx);
+
+        if (ctx->error)
+            break;
+
+        /* saferead fills the whole buffer unless the input ends, which
+         * keeps the writes aligned */
+        if ((got = saferead(p->fdin, slot->buf, p->buflen)) < 0) {
+            virReportSystemError(errno, _("Unable to read %1$s"), p->fdinname);
+            ret = -2;
+            break;
+        }
+        if (got == 0)
+            break;
+
+        total += got;
+        slot->offset = offset;
+        slot->len = got;
+        slot->done = 0;
+
+        /* handle last write size align in direct case */
+        if (got < p->buflen && p->isDirect) {
+            slot->len = VIR_ROUND_UP(got, VIR_FILE_DISK_COPY_ALIGN);
+            memset(slot->buf + got, 0, slot->len - got);
+            padded = true;
+        }
+
+        if (runIOUringSubmit(ctx, slot) < 0)
+            break;
+
+        offset += slot->len;
+        next = (next + 1) % ctx->nslots;
+    }
+
+    while (ctx->inflight > 0)
+        runIOUringReap(ctx);
+
+    if (ret < 0)
+        return ret;
+
+    if (ctx->error) {
+        virReportSystemError(ctx->error, _("Unable to write %1$s"), p->fdoutname);
+        return -3;
+    }
+
+    if (padded && !p->isBlockDev && ftruncate(p->fdout, start + total) < 0) {
+        virReportSystemError(errno, _("Unable to truncate %1$s"), p->fdoutname);
+        return -4;
+    }
+
+    return total;
+}
+
+
+/*
+ * Checks that the kernel knows the opcodes used for the copy. Plain
+ * IORING_OP_READ and IORING_OP_WRITE, used when the buffers can't be
+ * registered, appeared in the same kernel as the probe itself, while
+ * io_uring_queue_init already succeeds with older kernels.
+ */
+static bool
+runIOUringSupported(struct io_uring *ring,
+                    bool isWrite)
+{
+    struct io_uring_probe *probe;
+    bool ret;
+
+    if (!(probe = io_uring_get_probe_ring(ring)))
+        return false;
+
+    if (isWrite)
+        ret = io_uring_opcode_supported(probe, IORING_OP_WRITE) &&
+              io_uring_opcode_supported(probe, IORING_OP_WRITE_FIXED);
+    else
+        ret = io_uring_opcode_supported(probe, IORING_OP_READ) &&
+              io_uring_opcode_supported(probe, IORING_OP_READ_FIXED);
+
+    io_uring_free_probe(probe);
+    return ret;
+}
+
+
 /**
- * virFileDiskCopy: run IO to copy data between storage and a pipe or socket.
+ * runIOCopyUring: execute the IO copy based on the passed parameters
+ * @p: the IO parameters
+ *
+ * Execute the copy keeping up to @p.queueDepth disk requests in flight
+ * using io_uring, while the pipe or socket side is still read or written
+ * in order.
+ *
+ * Returns: size transferred, -1 without an error reported if io_uring
+ * can't be used, or < -1 on error.
+ */
+static off_t
+runIOCopyUring(const struct runIOParams p)
+{
+    struct runIOUring ctx = { 0 };
+    g_autofree void *base = NULL;
+    g_autofree struct iovec *iov = NULL;
+    char *buf;
+    int disk = p.isWrite ? p.fdout : p.fdin;
+    int flags;
+    off_t offset;
+    off_t total;
+    size_t i;
+    int ret;
+
+    /* Requests carry their own offset which wouldn't work for
+     * appending nor for anything not seekable */
+    if ((flags = fcntl(disk, F_GETFL)) < 0 || (flags & O_APPEND) ||
+        (offset = lseek(disk, 0, SEEK_CUR)) < 0)
+        return -1;
+
+    if ((ret = io_uring_queue_init(p.queueDepth, &ctx.ring, 0)) < 0) {
+        VIR_DEBUG("io_uring is not available: %s", g_strerror(-ret));
+        return -1;
+    }
+
+    if (!runIOUringSupported(&ctx.ring, p.isWrite)) {
+        VIR_DEBUG("io_uring doesn't support the needed operations");
+        io_uring_queue_exit(&ctx.ring);
+        return -1;
+    }
+
+    ctx.nslots = p.queueDepth;
+    ctx.slots = g_new0(struct runIOUringSlot, ctx.nslots);
+    ctx.isWrite = p.isWrite;
+    ctx.isDirect = p.isDirect;
+
+    buf = runIOAllocBuffer(p.buflen * ctx.nslots, &base);
+    iov = g_new0(struct iovec, ctx.nslots);
+    for (i = 0; i < ctx.nslots; i++) {
+        ctx.slots[i].buf = buf + i * p.buflen;
+        iov[i].iov_base = ctx.slots[i].buf;
+        iov[i].iov_len = p.buflen;
+    }
+
+    /* Registering the disk and the buffers saves looking them up for
+     * every request, but the copy works without them, e.g. when the
+     * buffers exceed RLIMIT_MEMLOCK */
+    if (io_uring_register_files(&ctx.ring, &disk, 1) == 0) {
+        ctx.fd = 0;
+        ctx.fixedFile = true;
+    } else {
+        ctx.fd = disk;
+    }
+    ctx.fixedBufs = io_uring_register_buffers(&ctx.ring, iov, ctx.nslots) == 0;
+
+    VIR_DEBUG("Copying with io_uring, depth=%zu buflen=%zu fixedFile=%d fixedBufs=%d",
+              ctx.nslots, p.buflen, ctx.fixedFile, ctx.fixedBufs);
+
+    if (p.isWrite)
+        total = runIOUringCopyToDisk(&ctx, &p, offset);
+    else
+        total = runIOUringCopyFromDisk(&ctx, &p, offset);
+
+    io_uring_queue_exit(&ctx.ring);
+    g_free(ctx.slots);
+    return total;
+}
+# endif /* WITH_LIBURING */
+
+
+/**
+ * runIOCopy: execute the IO copy based on the passed parameters
+ * @p: the IO parameters
+ *
+ * Execute the copy based on the passed parameters.
+ *
+ * Returns: size transferred, or < 0 on error.
+ */
+static off_t
+runIOCopy(const struct runIOParams p)
+{
+# if WITH_LIBURING
+    if (p.queueDepth > 1) {
+        off_t total = runIOCopyUring(p);
+
+        if (total != -1)
+            return total;
+    }
+# endif /* WITH_LIBURING */
+
+    return runIOCopyLoop(p);
+}
+
+/**
+ * virFileDiskCopyFull: run IO to copy data between storage and a pipe or socket.
  *
  * @disk_fd:     the already open regular file or block device
  * @disk_path:   the pathname corresponding to disk_fd (for error reporting)
  * @remote_fd:   the pipe or socket
  *               Use -1 to auto-choose between STDIN or STDOUT.
  * @remote_path: the pathname corresponding to remote_fd (for error reporting)
+ * @buflen:      size of the buffers, 0 for the default
+ * @queueDepth:  maximum number of requests on @disk_fd in flight at once,
+ *               0 for the default. With 1, or when io_uring is not
+ *               available, data is copied one buffer at a time.
+ *
+ * The copy starts at the current offset of @disk_fd. When copying with
+ * io_uring the requests carry explicit offsets, so the file offset is not
+ * advanced, which matters only if the open file description is shared
+ * with another process.
  *
  * Note that the direction of the transfer is detected based on the @disk_fd
  * file access mode (man 2 open). Therefore @disk_fd must be opened with
@@ -4961,7 +5389,12 @@ runIOCopy(const struct runIOParams p)
  */
 
 off_t
-virFileDiskCopy(int disk_fd, const char *disk_path, int remote_fd, const char *remote_path)
+virFileDiskCopyFull(int disk_fd,
+                    const char *disk_path,
+                    int remote_fd,
+                    const char *remote_path,
+                    size_t buflen,
+                    unsigned int queueDepth)
 {
     int ret = -1;
     off_t total = 0;
@@ -4969,6 +5402,14 @@ virFileDiskCopy(int disk_fd, const char *disk_path, int remote_fd, const char *r
     struct runIOParams p;
     int oflags = -1;
 
+    if (buflen == 0)
+        buflen = VIR_FILE_DISK_COPY_BUFFER_SIZE;
+    if (queueDepth == 0)
+        queueDepth = VIR_FILE_DISK_COPY_QUEUE_DEPTH;
+
+    p.buflen = VIR_ROUND_UP(buflen, VIR_FILE_DISK_COPY_ALIGN);
+    p.queueDepth = queueDepth;
+
     oflags = fcntl(disk_fd, F_GETFL);
 
     if (oflags < 0) {
@@ -5053,13 +5494,27 @@ virFileDiskCopy(int disk_fd, const char *disk_path, int remote_fd, const char *r
 #else /* WIN32 */
 
 off_t
-virFileDiskCopy(int disk_fd G_GNUC_UNUSED,
-                const char *disk_path G_GNUC_UNUSED,
-                int remote_fd G_GNUC_UNUSED,
-                const char *remote_path G_GNUC_UNUSED)
+virFileDiskCopyFull(int disk_fd G_GNUC_UNUSED,
+                    const char *disk_path G_GNUC_UNUSED,
+                    int remote_fd G_GNUC_UNUSED,
+                    const char *remote_path G_GNUC_UNUSED,
+                    size_t buflen G_GNUC_UNUSED,
+                    unsigned int queueDepth G_GNUC_UNUSED)
 {
     virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
                    _("virFileDiskCopy unsupported on this platform"));
     return -1;
 }
 #endif /* WIN32 */
+
+
+/**
+ * virFileDiskCopy:
+ *
+ * Like virFileDiskCopyFull, using the default buffer size and queue depth.
+ */
+off_t
+virFileDiskCopy(int disk_fd, const char *disk_path, int remote_fd, const char *remote_path)
+{
+    return virFileDiskCopyFull(disk_fd, disk_path, remote_fd, remote_path, 0, 0);
+}
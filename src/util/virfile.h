@@ -398,3 +398,9 @@ int virFileSetCOW(const char *path,
                   virTristateBool state);
 
 off_t virFileDiskCopy(int disk_fd, const char *disk_path, int remote_fd, const char *remote_path);
+off_t virFileDiskCopyFull(int disk_fd,
+                          const char *disk_path,
+                          int remote_fd,
+                          const char *remote_path,
+                          size_t buflen,
+                          unsigned int queueDepth);
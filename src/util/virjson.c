@@ -76,18 +76,52 @@ struct _virJSONValue {
 };
 
 
+/* Maximum nesting of arrays/objects accepted by virJSONParser */
+#define VIR_JSON_PARSER_MAX_DEPTH 1024
+
+/* Objects with at least this many members look up duplicate keys in a
+ * hash table rather than by walking the members */
+#define VIR_JSON_PARSER_HASH_KEYS 16
+
+typedef enum {
+    VIR_JSON_PARSER_EXPECT_VALUE,
+    VIR_JSON_PARSER_EXPECT_VALUE_OR_END,  /* after '[' */
+    VIR_JSON_PARSER_EXPECT_KEY,           /* after ',' in an object */
+    VIR_JSON_PARSER_EXPECT_KEY_OR_END,    /* after '{' */
+    VIR_JSON_PARSER_EXPECT_COLON,
+    VIR_JSON_PARSER_EXPECT_COMMA_OR_END,
+} virJSONParserExpect;
+
+typedef enum {
+    VIR_JSON_PARSER_TOKEN_NONE,
+    VIR_JSON_PARSER_TOKEN_STRING,
+    VIR_JSON_PARSER_TOKEN_NUMBER,
+    VIR_JSON_PARSER_TOKEN_LITERAL,
+} virJSONParserToken;
+
 typedef struct _virJSONParserState virJSONParserState;
 struct _virJSONParserState {
-    virJSONValue *value;
-    char *key;
+    virJSONValue *value; /* object or array being filled */
+    char *key; /* key of the next member if @value is an object */
+    GHashTable *keys; /* member index + 1 by key of large objects */
 };
 
-typedef struct _virJSONParser virJSONParser;
 struct _virJSONParser {
-    virJSONValue *head;
     virJSONParserState *state;
     size_t nstate;
-    int wrap;
+    size_t nstate_max;
+
+    virJSONParserExpect expect;
+
+    /* token being currently read */
+    virJSONParserToken token;
+    GString *buf;
+    bool tokenIsKey;
+    bool escape;         /* previous character was a backslash */
+    unsigned int nhex;   /* 1 + number of hex digits of \u escape read,
+                          * 0 if not in \u escape */
+    gunichar hex;
+    gunichar surrogate;  /* pending high surrogate of a \u escape pair */
 };
 
 
@@ -1388,6 +1422,565 @@ virJSONValueCopy(const virJSONValue *in)
 }
 
 
+/**
+ * virJSONParserNew:
+ *
+ * Creates a new incremental JSON parser. Unlike virJSONValueFromString the
+ * parser builds the virJSONValue tree directly and can be fed arbitrary
+ * pieces of the input as they arrive, see virJSONParserFeed.
+ */
+virJSONParser *
+virJSONParserNew(void)
+{
+    virJSONParser *parser = g_new0(virJSONParser, 1);
+
+    parser->buf = g_string_new(NULL);
+
+    return parser;
+}
+
+
+/**
+ * virJSONParserReset:
+ * @parser: JSON parser
+ *
+ * Drops any partially parsed value so that @parser can be used to parse
+ * a new document, e.g. after an error.
+ */
+void
+virJSONParserReset(virJSONParser *parser)
+{
+    size_t i;
+
+    for (i = 0; i < parser->nstate; i++) {
+        virJSONValueFree(parser->state[i].value);
+        g_free(parser->state[i].key);
+        g_clear_pointer(&parser->state[i].keys, g_hash_table_unref);
+    }
+    parser->nstate = 0;
+
+    parser->expect = VIR_JSON_PARSER_EXPECT_VALUE;
+    parser->token = VIR_JSON_PARSER_TOKEN_NONE;
+    g_string_truncate(parser->buf, 0);
+    parser->tokenIsKey = false;
+    parser->escape = false;
+    parser->nhex = 0;
+    parser->hex = 0;
+    parser->surrogate = 0;
+}
+
+
+void
+virJSONParserFree(virJSONParser *parser)
+{
+    if (!parser)
+        return;
+
+    virJSONParserReset(parser);
+    g_free(parser->state);
+    g_string_free(parser->buf, TRUE);
+    g_free(parser);
+}
+
+
+/**
+ * virJSONParserIsIdle:
+ * @parser: JSON parser
+ *
+ * Returns true if @parser doesn't hold any partially parsed value.
+ */
+bool
+virJSONParserIsIdle(virJSONParser *parser)
+{
+    return parser->nstate == 0 &&
+           parser->token == VIR_JSON_PARSER_TOKEN_NONE;
+}
+
+
+static int
+virJSONParserError(const char *msg)
+{
+    virReportError(VIR_ERR_INTERNAL_ERROR,
+                   _("failed to parse JSON: %1$s"), msg);
+    return -1;
+}
+
+
+/* Validates @str against the JSON number grammar:
+ *   -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)? */
+static bool
+virJSONParserNumberIsValid(const char *str)
+{
+    const char *cur = str;
+
+    if (*cur == '-')
+        cur++;
+
+    if (*cur == '0') {
+        cur++;
+    } else if (g_ascii_isdigit(*cur)) {
+        while (g_ascii_isdigit(*cur))
+            cur++;
+    } else {
+        return false;
+    }
+
+    if (*cur == '.') {
+        cur++;
+        if (!g_ascii_isdigit(*cur))
+            return false;
+        while (g_ascii_isdigit(*cur))
+            cur++;
+    }
+
+    if (*cur == 'e' || *cur == 'E') {
+        cur++;
+        if (*cur == '+' || *cur == '-')
+            cur++;
+        if (!g_ascii_isdigit(*cur))
+            return false;
+        while (g_ascii_isdigit(*cur))
+            cur++;
+    }
+
+    return *cur == '\0';
+}
+
+
+/**
+ * virJSONParserAddValue:
+ * @parser: JSON parser
+ * @value: completely parsed value
+ * @result: filled with @value if it's the top level value
+ *
+ * Stores @value into the container which is being parsed. Objects and
+ * arrays are stored only once they are complete.
+ */
+static int
+virJSONParserAddValue(virJSONParser *parser,
+                      virJSONValue **value,
+                      virJSONValue **result)
+{
+    virJSONParserState *top;
+    virJSONObjectPair pair;
+    virJSONObjectPair *pairs;
+    size_t npairs;
+    size_t i;
+
+    if (parser->nstate == 0) {
+        *result = g_steal_pointer(value);
+        parser->expect = VIR_JSON_PARSER_EXPECT_VALUE;
+        return 0;
+    }
+
+    top = &parser->state[parser->nstate - 1];
+    parser->expect = VIR_JSON_PARSER_EXPECT_COMMA_OR_END;
+
+    if (top->value->type == VIR_JSON_TYPE_ARRAY)
+        return virJSONValueArrayAppend(top->value, value);
+
+    /* Like json-c, the last of duplicate keys wins */
+    pairs = top->value->data.object.pairs;
+    npairs = top->value->data.object.npairs;
+
+    if (top->keys) {
+        i = GPOINTER_TO_SIZE(g_hash_table_lookup(top->keys, top->key));
+        if (i > 0)
+            i--;
+        else
+            i = npairs;
+    } else {
+        for (i = 0; i < npairs; i++) {
+            if (STREQ(pairs[i].key, top->key))
+                break;
+        }
+    }
+
+    if (i < npairs) {
+        virJSONValueFree(pairs[i].value);
+        pairs[i].value = g_steal_pointer(value);
+        g_clear_pointer(&top->key, g_free);
+        return 0;
+    }
+
+    pair.key = g_steal_pointer(&top->key);
+    pair.value = g_steal_pointer(value);
+    VIR_APPEND_ELEMENT(top->value->data.object.pairs,
+                       top->value->data.object.npairs, pair);
+
+    /* The keys are owned by the members, which stay in place */
+    pairs = top->value->data.object.pairs;
+    npairs = top->value->data.object.npairs;
+
+    if (top->keys) {
+        g_hash_table_insert(top->keys, pairs[npairs - 1].key,
+                            GSIZE_TO_POINTER(npairs));
+    } else if (npairs >= VIR_JSON_PARSER_HASH_KEYS) {
+        top->keys = g_hash_table_new(g_str_hash, g_str_equal);
+        for (i = 0; i < npairs; i++)
+            g_hash_table_insert(top->keys, pairs[i].key,
+                                GSIZE_TO_POINTER(i + 1));
+    }
+
+    return 0;
+}
+
+
+static int
+virJSONParserPush(virJSONParser *parser,
+                  virJSONValue *value)
+{
+    if (parser->nstate >= VIR_JSON_PARSER_MAX_DEPTH) {
+        virJSONValueFree(value);
+        return virJSONParserError(_("nesting too deep"));
+    }
+
+    VIR_RESIZE_N(parser->state, parser->nstate_max, parser->nstate, 1);
+    parser->state[parser->nstate].value = value;
+    parser->state[parser->nstate].key = NULL;
+    parser->state[parser->nstate].keys = NULL;
+    parser->nstate++;
+
+    return 0;
+}
+
+
+static int
+virJSONParserPop(virJSONParser *parser,
+                 virJSONType type,
+                 virJSONValue **result)
+{
+    g_autoptr(virJSONValue) value = NULL;
+
+    if (parser->nstate == 0 ||
+        parser->state[parser->nstate - 1].value->type != type)
+        return virJSONParserError(_("unexpected end of container"));
+
+    parser->nstate--;
+    value = parser->state[parser->nstate].value;
+    g_free(parser->state[parser->nstate].key);
+    g_clear_pointer(&parser->state[parser->nstate].keys, g_hash_table_unref);
+
+    return virJSONParserAddValue(parser, &value, result);
+}
+
+
+/* Finishes the current string, number or literal token */
+static int
+virJSONParserFinishToken(virJSONParser *parser,
+                         virJSONValue **result)
+{
+    g_autoptr(virJSONValue) value = NULL;
+    g_autofree char *str = NULL;
+    virJSONParserToken token = parser->token;
+
+    parser->token = VIR_JSON_PARSER_TOKEN_NONE;
+    str = g_strndup(parser->buf->str, parser->buf->len);
+    g_string_truncate(parser->buf, 0);
+
+    switch (token) {
+    case VIR_JSON_PARSER_TOKEN_STRING:
+        if (!g_utf8_validate(str, -1, NULL))
+            return virJSONParserError(_("invalid UTF-8 in string"));
+
+        if (parser->tokenIsKey) {
+            parser->state[parser->nstate - 1].key = g_steal_pointer(&str);
+            parser->expect = VIR_JSON_PARSER_EXPECT_COLON;
+            return 0;
+        }
+        value = virJSONValueNewString(g_steal_pointer(&str));
+        break;
+
+    case VIR_JSON_PARSER_TOKEN_NUMBER:
+        if (!virJSONParserNumberIsValid(str))
+            return virJSONParserError(_("invalid number"));
+        value = virJSONValueNewNumber(g_steal_pointer(&str));
+        break;
+
+    case VIR_JSON_PARSER_TOKEN_LITERAL:
+        if (STREQ(str, "true"))
+            value = virJSONValueNewBoolean(true);
+        else if (STREQ(str, "false"))
+            value = virJSONValueNewBoolean(false);
+        else if (STREQ(str, "null"))
+            value = virJSONValueNewNull();
+        else
+            return virJSONParserError(_("invalid literal"));
+        break;
+
+    case VIR_JSON_PARSER_TOKEN_NONE:
+        return 0;
+    }
+
+    return virJSONParserAddValue(parser, &value, result);
+}
+
+
+/* Handles a character following a backslash in a string */
+static int
+virJSONParserStringEscape(virJSONParser *parser,
+                          char c)
+{
+    if (parser->nhex > 0) {
+        int digit = g_ascii_xdigit_value(c);
+
+        if (digit < 0)
+            return virJSONParserError(_("invalid \\u escape"));
+
+        parser->hex = (parser->hex << 4) | digit;
+        if (parser->nhex++ < 4)
+            return 0;
+
+        parser->nhex = 0;
+        parser->escape = false;
+
+        if (parser->hex >= 0xD800 && parser->hex <= 0xDBFF) {
+            if (parser->surrogate)
+                return virJSONParserError(_("invalid surrogate pair"));
+            parser->surrogate = parser->hex;
+            return 0;
+        }
+
+        if (parser->hex >= 0xDC00 && parser->hex <= 0xDFFF) {
+            if (!parser->surrogate)
+                return virJSONParserError(_("invalid surrogate pair"));
+            parser->hex = 0x10000 + ((parser->surrogate - 0xD800) << 10) +
+                          (parser->hex - 0xDC00);
+            parser->surrogate = 0;
+        } else if (parser->surrogate) {
+            return virJSONParserError(_("invalid surrogate pair"));
+        }
+
+        /* json-c accepts an escaped NUL character, the string then ends
+         * there for anyone treating it as a C string */
+        g_string_append_unichar(parser->buf, parser->hex);
+        return 0;
+    }
+
+    if (parser->surrogate && c != 'u')
+        return virJSONParserError(_("invalid surrogate pair"));
+
+    switch (c) {
+    case '"':
+    case '\\':
+    case '/':
+        g_string_append_c(parser->buf, c);
+        break;
+    case 'b':
+        g_string_append_c(parser->buf, '\b');
+        break;
+    case 'f':
+        g_string_append_c(parser->buf, '\f');
+        break;
+    case 'n':
+        g_string_append_c(parser->buf, '\n');
+        break;
+    case 'r':
+        g_string_append_c(parser->buf, '\r');
+        break;
+    case 't':
+        g_string_append_c(parser->buf, '\t');
+        break;
+    case 'u':
+        parser->nhex = 1;
+        parser->hex = 0;
+        return 0;
+    default:
+        return virJSONParserError(_("invalid escape sequence"));
+    }
+
+    parser->escape = false;
+    return 0;
+}
+
+
+/**
+ * virJSONParserFeed:
+ * @parser: JSON parser
+ * @data: next piece of the input
+ * @len: length of @data
+ * @consumed: filled with the number of bytes of @data which were processed
+ * @value: filled with the parsed value once it is complete
+ *
+ * Feeds @data into @parser. The parser stops right after a complete top
+ * level value was parsed, so that the caller can process it and feed the
+ * rest of @data later on. Whitespace between top level values is skipped.
+ * A top level number or literal is only complete once it is followed by
+ * another character.
+ *
+ * Returns 1 if a value was parsed and stored in @value,
+ *         0 if all of @data was consumed without completing a value,
+ *        -1 on error (with @parser needing to be reset).
+ */
+int
+virJSONParserFeed(virJSONParser *parser,
+                  const char *data,
+                  size_t len,
+                  size_t *consumed,
+                  virJSONValue **value)
+{
+    virJSONValue *result = NULL;
+    size_t i;
+
+    *value = NULL;
+    *consumed = 0;
+
+    for (i = 0; i < len && !result; i++) {
+        char c = data[i];
+
+        switch (parser->token) {
+        case VIR_JSON_PARSER_TOKEN_STRING:
+            if (parser->escape) {
+                if (virJSONParserStringEscape(parser, c) < 0)
+                    return -1;
+                continue;
+            }
+
+            /* scan for the end of the run of plain characters */
+            if (c != '"' && c != '\\' && !parser->surrogate) {
+                size_t end = i;
+
+                while (end < len && data[end] != '"' && data[end] != '\\') {
+                    if ((unsigned char) data[end] < 0x20)
+                        return virJSONParserError(_("control character in string"));
+                    end++;
+                }
+
+                g_string_append_len(parser->buf, data + i, end - i);
+                i = end - 1;
+                continue;
+            }
+
+            if (c == '\\') {
+                parser->escape = true;
+            } else if (c == '"' && !parser->surrogate) {
+                if (virJSONParserFinishToken(parser, &result) < 0)
+                    return -1;
+            } else {
+                return virJSONParserError(_("invalid surrogate pair"));
+            }
+            continue;
+
+        case VIR_JSON_PARSER_TOKEN_NUMBER:
+            if (g_ascii_isdigit(c) || (c && strchr("+-.eE", c))) {
+                g_string_append_c(parser->buf, c);
+                continue;
+            }
+            if (virJSONParserFinishToken(parser, &result) < 0)
+                return -1;
+            if (result) {
+                /* the delimiter was not consumed */
+                *consumed = i;
+                *value = result;
+                return 1;
+            }
+            break;
+
+        case VIR_JSON_PARSER_TOKEN_LITERAL:
+            if (g_ascii_isalpha(c)) {
+                g_string_append_c(parser->buf, c);
+                continue;
+            }
+            if (virJSONParserFinishToken(parser, &result) < 0)
+                return -1;
+            if (result) {
+                *consumed = i;
+                *value = result;
+                return 1;
+            }
+            break;
+
+        case VIR_JSON_PARSER_TOKEN_NONE:
+            break;
+        }
+
+        if (g_ascii_isspace(c))
+            continue;
+
+        switch (parser->expect) {
+        case VIR_JSON_PARSER_EXPECT_VALUE_OR_END:
+            if (c == ']') {
+                if (virJSONParserPop(parser, VIR_JSON_TYPE_ARRAY, &result) < 0)
+                    return -1;
+                continue;
+            }
+            G_GNUC_FALLTHROUGH;
+
+        case VIR_JSON_PARSER_EXPECT_VALUE:
+            if (c == '{') {
+                if (virJSONParserPush(parser, virJSONValueNewObject()) < 0)
+                    return -1;
+                parser->expect = VIR_JSON_PARSER_EXPECT_KEY_OR_END;
+            } else if (c == '[') {
+                if (virJSONParserPush(parser, virJSONValueNewArray()) < 0)
+                    return -1;
+                parser->expect = VIR_JSON_PARSER_EXPECT_VALUE_OR_END;
+            } else if (c == '"') {
+                parser->token = VIR_JSON_PARSER_TOKEN_STRING;
+                parser->tokenIsKey = false;
+            } else if (c == '-' || g_ascii_isdigit(c)) {
+                parser->token = VIR_JSON_PARSER_TOKEN_NUMBER;
+                g_string_append_c(parser->buf, c);
+            } else if (c == 't' || c == 'f' || c == 'n') {
+                parser->token = VIR_JSON_PARSER_TOKEN_LITERAL;
+                g_string_append_c(parser->buf, c);
+            } else {
+                return virJSONParserError(_("unexpected character"));
+            }
+            break;
+
+        case VIR_JSON_PARSER_EXPECT_KEY_OR_END:
+            if (c == '}') {
+                if (virJSONParserPop(parser, VIR_JSON_TYPE_OBJECT, &result) < 0)
+                    return -1;
+                continue;
+            }
+            G_GNUC_FALLTHROUGH;
+
+        case VIR_JSON_PARSER_EXPECT_KEY:
+            if (c != '"')
+                return virJSONParserError(_("expected object key"));
+            parser->token = VIR_JSON_PARSER_TOKEN_STRING;
+            parser->tokenIsKey = true;
+            break;
+
+        case VIR_JSON_PARSER_EXPECT_COLON:
+            if (c != ':')
+                return virJSONParserError(_("expected ':'"));
+            parser->expect = VIR_JSON_PARSER_EXPECT_VALUE;
+            break;
+
+        case VIR_JSON_PARSER_EXPECT_COMMA_OR_END: {
+            virJSONType type = parser->state[parser->nstate - 1].value->type;
+
+            if (c == ',') {
+                if (type == VIR_JSON_TYPE_OBJECT)
+                    parser->expect = VIR_JSON_PARSER_EXPECT_KEY;
+                else
+                    parser->expect = VIR_JSON_PARSER_EXPECT_VALUE;
+            } else if (c == '}') {
+                if (virJSONParserPop(parser, VIR_JSON_TYPE_OBJECT, &result) < 0)
+                    return -1;
+            } else if (c == ']') {
+                if (virJSONParserPop(parser, VIR_JSON_TYPE_ARRAY, &result) < 0)
+                    return -1;
+            } else {
+                return virJSONParserError(_("expected ',' or end of container"));
+            }
+            break;
+        }
+        }
+    }
+
+    *consumed = i;
+    if (!result)
+        return 0;
+
+    *value = result;
+    return 1;
+}
+
+
 #if WITH_JSON_C
 static virJSONValue *
 virJSONValueFromJsonC(json_object *jobj)
@@ -278,3 +278,23 @@ virJSONValue *
 virJSONValueObjectDeflatten(virJSONValue *json);
 
 G_DEFINE_AUTOPTR_CLEANUP_FUNC(virJSONValue, virJSONValueFree);
+
+typedef struct _virJSONParser virJSONParser;
+
+virJSONParser *
+virJSONParserNew(void);
+void
+virJSONParserFree(virJSONParser *parser);
+void
+virJSONParserReset(virJSONParser *parser);
+bool
+virJSONParserIsIdle(virJSONParser *parser);
+int
+virJSONParserFeed(virJSONParser *parser,
+                  const char *data,
+                  size_t len,
+                  size_t *consumed,
+                  virJSONValue **value)
+    ATTRIBUTE_NONNULL(1) ATTRIBUTE_NONNULL(4) ATTRIBUTE_NONNULL(5);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(virJSONParser, virJSONParserFree);
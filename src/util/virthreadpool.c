@@ -26,18 +26,41 @@
 #include "viralloc.h"
 #include "virthread.h"
 #include "virerror.h"
+#include "virtime.h"
 
 #define VIR_FROM_THIS VIR_FROM_NONE
 
+typedef struct _virThreadPoolJobKey virThreadPoolJobKey;
+
 typedef struct _virThreadPoolJob virThreadPoolJob;
 struct _virThreadPoolJob {
     virThreadPoolJob *prev;
     virThreadPoolJob *next;
     unsigned int priority;
 
+    /* Queue of jobs sharing the key */
+    virThreadPoolJobKey *key;
+    virThreadPoolJob *keyPrev;
+    virThreadPoolJob *keyNext;
+
+    gint64 queued; /* monotonic time of submission */
+
     void *data;
 };
 
+/* Jobs submitted under the same key, e.g. on behalf of one client */
+struct _virThreadPoolJobKey {
+    const void *key;
+
+    virThreadPoolJob *head;
+    virThreadPoolJob *tail;
+    size_t running; /* jobs taken by a worker and not finished yet */
+
+    /* Ring of keys with queued jobs which workers serve in turns */
+    virThreadPoolJobKey *prev;
+    virThreadPoolJobKey *next;
+};
+
 typedef struct _virThreadPoolJobList virThreadPoolJobList;
 struct _virThreadPoolJobList {
     virThreadPoolJob *head;
@@ -50,11 +73,18 @@ struct _virThreadPool {
     bool quit;
 
     virThreadPoolJobFunc jobFunc;
+    virFreeCallback jobDataFree; /* frees data of jobs which are not run */
     char *jobName;
     void *jobOpaque;
     virThreadPoolJobList jobList;
     size_t jobQueueDepth;
 
+    GHashTable *keys; /* key -> virThreadPoolJobKey */
+    virThreadPoolJobKey *nextKey; /* next key in the ring to take a job from */
+    size_t maxKeyWorkers;
+
+    unsigned long long jobWait[VIR_THREAD_POOL_JOB_WAIT_BUCKETS];
+
     virIdentity *identity;
 
     virMutex mutex;
@@ -65,7 +95,9 @@ struct _virThreadPool {
     size_t minWorkers;
     size_t freeWorkers;
     size_t nWorkers;
+    size_t startingWorkers; /* created but not waiting for jobs yet */
     virThread *workers;
+    unsigned int idleTimeout; /* seconds, 0 to keep idle workers forever */
 
     size_t maxPrioWorkers;
     size_t nPrioWorkers;
@@ -87,6 +119,148 @@ static bool virThreadPoolWorkerQuitHelper(size_t count, size_t limit)
     return count > limit;
 }
 
+/* Upper bounds of the buckets of the job wait time histogram, in
+ * microseconds. The last bucket is unbounded. */
+static const gint64 virThreadPoolJobWaitLimits[VIR_THREAD_POOL_JOB_WAIT_BUCKETS - 1] = {
+    1000, 10000, 100000, 1000000, 10000000,
+};
+
+
+static void
+virThreadPoolKeyRingAdd(virThreadPool *pool,
+                        virThreadPoolJobKey *key)
+{
+    if (!pool->nextKey) {
+        key->prev = key->next = key;
+        pool->nextKey = key;
+        return;
+    }
+
+    /* Queue the key behind all others */
+    key->next = pool->nextKey;
+    key->prev = pool->nextKey->prev;
+    key->prev->next = key;
+    pool->nextKey->prev = key;
+}
+
+
+static void
+virThreadPoolKeyRingRemove(virThreadPool *pool,
+                           virThreadPoolJobKey *key)
+{
+    if (key->next == key) {
+        pool->nextKey = NULL;
+    } else {
+        key->prev->next = key->next;
+        key->next->prev = key->prev;
+        if (pool->nextKey == key)
+            pool->nextKey = key->next;
+    }
+
+    key->prev = key->next = NULL;
+}
+
+
+/*
+ * Finds the job a worker should run next: the oldest priority job for
+ * priority workers, otherwise the oldest job of the next key in turn
+ * which doesn't have the maximum number of jobs running already.
+ */
+static virThreadPoolJob *
+virThreadPoolFindJob(virThreadPool *pool,
+                     bool priority)
+{
+    virThreadPoolJobKey *key = pool->nextKey;
+
+    if (priority)
+        return pool->jobList.firstPrio;
+
+    if (!key)
+        return NULL;
+
+    do {
+        if (pool->maxKeyWorkers == 0 ||
+            key->running < pool->maxKeyWorkers)
+            return key->head;
+
+        key = key->next;
+    } while (key != pool->nextKey);
+
+    return NULL;
+}
+
+
+/*
+ * Removes @job from all queues and accounts it as running.
+ */
+static void
+virThreadPoolTakeJob(virThreadPool *pool,
+                     virThreadPoolJob *job)
+{
+    virThreadPoolJobKey *key = job->key;
+    gint64 wait = g_get_monotonic_time() - job->queued;
+    size_t i;
+
+    if (job == pool->jobList.firstPrio) {
+        virThreadPoolJob *tmp = job->next;
+        while (tmp) {
+            if (tmp->priority)
+                break;
+            tmp = tmp->next;
+        }
+        pool->jobList.firstPrio = tmp;
+    }
+
+    if (job->prev)
+        job->prev->next = job->next;
+    else
+        pool->jobList.head = job->next;
+    if (job->next)
+        job->next->prev = job->prev;
+    else
+        pool->jobList.tail = job->prev;
+
+    if (job->keyPrev)
+        job->keyPrev->keyNext = job->keyNext;
+    else
+        key->head = job->keyNext;
+    if (job->keyNext)
+        job->keyNext->keyPrev = job->keyPrev;
+    else
+        key->tail = job->keyPrev;
+
+    /* The next job comes from another key, if there is any */
+    pool->nextKey = key->next;
+    if (!key->head)
+        virThreadPoolKeyRingRemove(pool, key);
+
+    key->running++;
+    pool->jobQueueDepth--;
+
+    for (i = 0; i < G_N_ELEMENTS(virThreadPoolJobWaitLimits); i++) {
+        if (wait < virThreadPoolJobWaitLimits[i])
+            break;
+    }
+    pool->jobWait[i]++;
+}
+
+
+static void
+virThreadPoolFinishJob(virThreadPool *pool,
+                       virThreadPoolJobKey *key)
+{
+    key->running--;
+
+    if (key->head) {
+        /* A worker may be waiting for the key to drop below the limit */
+        if (pool->maxKeyWorkers > 0)
+            virCondSignal(&pool->cond);
+    } else if (key->running == 0) {
+        g_hash_table_remove(pool->keys, key->key);
+    }
+}
+
+
 static void virThreadPoolWorker(void *opaque)
 {
     struct virThreadPoolWorkerData *data = opaque;
@@ -101,6 +275,9 @@ static void virThreadPoolWorker(void *opaque)
 
     virMutexLock(&pool->mutex);
 
+    if (!priority)
+        pool->startingWorkers--;
+
     if (pool->identity)
         virIdentitySetCurrent(pool->identity);
 
@@ -114,18 +291,35 @@ static void virThreadPoolWorker(void *opaque)
         if (virThreadPoolWorkerQuitHelper(*curWorkers, *maxLimit))
             goto out;
         while (!pool->quit &&
-               ((!priority && !pool->jobList.head) ||
-                (priority && !pool->jobList.firstPrio))) {
+               !virThreadPoolFindJob(pool, priority)) {
+            unsigned long long deadline = 0;
+            int rc;
+
+            /* Workers beyond the minimum go away when there's no work
+             * for them for a while */
+            if (!priority && pool->idleTimeout > 0 &&
+                pool->nWorkers > pool->minWorkers &&
+                virTimeMillisNow(&deadline) == 0)
+                deadline += pool->idleTimeout * 1000ull;
+
             if (!priority)
                 pool->freeWorkers++;
-            if (virCondWait(cond, &pool->mutex) < 0) {
-                if (!priority)
-                    pool->freeWorkers--;
-                goto out;
-            }
+            if (deadline)
+                rc = virCondWaitUntil(cond, &pool->mutex, deadline);
+            else
+                rc = virCondWait(cond, &pool->mutex);
             if (!priority)
                 pool->freeWorkers--;
 
+            if (rc < 0) {
+                if (errno != ETIMEDOUT)
+                    goto out;
+
+                if (pool->nWorkers > pool->minWorkers &&
+                    !virThreadPoolFindJob(pool, false))
+                    goto out;
+            }
+
             if (virThreadPoolWorkerQuitHelper(*curWorkers, *maxLimit))
                 goto out;
         }
@@ -133,37 +327,15 @@ static void virThreadPoolWorker(void *opaque)
         if (pool->quit)
             break;
 
-        if (priority) {
-            job = pool->jobList.firstPrio;
-        } else {
-            job = pool->jobList.head;
-        }
-
-        if (job == pool->jobList.firstPrio) {
-            virThreadPoolJob *tmp = job->next;
-            while (tmp) {
-                if (tmp->priority)
-                    break;
-                tmp = tmp->next;
-            }
-            pool->jobList.firstPrio = tmp;
-        }
-
-        if (job->prev)
-            job->prev->next = job->next;
-        else
-            pool->jobList.head = job->next;
-        if (job->next)
-            job->next->prev = job->prev;
-        else
-            pool->jobList.tail = job->prev;
-
-        pool->jobQueueDepth--;
+        job = virThreadPoolFindJob(pool, priority);
+        virThreadPoolTakeJob(pool, job);
 
         virMutexUnlock(&pool->mutex);
         (pool->jobFunc)(job->data, pool->jobOpaque);
-        VIR_FREE(job);
         virMutexLock(&pool->mutex);
+
+        virThreadPoolFinishJob(pool, job->key);
+        VIR_FREE(job);
     }
 
  out:
@@ -211,6 +383,8 @@ virThreadPoolExpand(virThreadPool *pool, size_t gain, bool priority)
         }
 
         (*curWorkers)++;
+        if (!priority)
+            pool->startingWorkers++;
     }
 
     return 0;
@@ -233,6 +407,8 @@ virThreadPoolNewFull(size_t minWorkers,
     pool = g_new0(virThreadPool, 1);
 
     pool->jobList.tail = pool->jobList.head = NULL;
+    pool->keys = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+                                       NULL, g_free);
 
     pool->jobFunc = func;
     pool->jobName = g_strdup(name);
@@ -295,8 +471,15 @@ virThreadPoolDrainLocked(virThreadPool *pool)
 
     while ((job = pool->jobList.head)) {
         pool->jobList.head = pool->jobList.head->next;
+        if (pool->jobDataFree)
+            pool->jobDataFree(job->data);
         VIR_FREE(job);
     }
+    pool->jobList.tail = pool->jobList.firstPrio = NULL;
+    pool->jobQueueDepth = 0;
+
+    pool->nextKey = NULL;
+    g_hash_table_remove_all(pool->keys);
 }
 
 void virThreadPoolFree(virThreadPool *pool)
@@ -316,6 +499,7 @@ void virThreadPoolFree(virThreadPool *pool)
     virCondDestroy(&pool->cond);
     g_free(pool->prioWorkers);
     virCondDestroy(&pool->prioCond);
+    g_hash_table_unref(pool->keys);
     g_free(pool);
 }
 
@@ -362,6 +546,23 @@ size_t virThreadPoolGetJobQueueDepth(virThreadPool *pool)
     return pool->jobQueueDepth;
 }
 
+/**
+ * virThreadPoolGetJobWaitStats:
+ * @pool: thread pool
+ * @buckets: filled with VIR_THREAD_POOL_JOB_WAIT_BUCKETS counters
+ *
+ * Get a histogram of how long jobs waited in the queue before a worker
+ * took them. The buckets count jobs which waited less than 1ms, 10ms,
+ * 100ms, 1s, 10s and longer respectively.
+ */
+void virThreadPoolGetJobWaitStats(virThreadPool *pool,
+                                  unsigned long long *buckets)
+{
+    VIR_LOCK_GUARD lock = virLockGuardLock(&pool->mutex);
+
+    memcpy(buckets, pool->jobWait, sizeof(pool->jobWait));
+}
+
 /*
  * @priority - job priority
  * Return: 0 on success, -1 otherwise
@@ -369,22 +570,73 @@ size_t virThreadPoolGetJobQueueDepth(virThreadPool *pool)
 int virThreadPoolSendJob(virThreadPool *pool,
                          unsigned int priority,
                          void *jobData)
+{
+    return virThreadPoolSendJobFull(pool, priority, NULL, jobData);
+}
+
+/**
+ * virThreadPoolSendJobFull:
+ * @pool: thread pool
+ * @priority: job priority
+ * @key: identifies the submitter of the job, e.g. a client
+ * @jobData: job data passed to the job function
+ *
+ * Queues a job. Workers take jobs of different @key values in turns,
+ * so a submitter queueing many jobs doesn't delay the jobs of others
+ * until all of its jobs are done. Jobs with the same @key are started
+ * in the order they were queued.
+ *
+ * Return: 0 on success, -1 otherwise
+ */
+int virThreadPoolSendJobFull(virThreadPool *pool,
+                             unsigned int priority,
+                             const void *key,
+                             void *jobData)
 {
     VIR_LOCK_GUARD lock = virLockGuardLock(&pool->mutex);
+    virThreadPoolJobKey *jobKey;
     virThreadPoolJob *job;
 
     if (pool->quit)
         return -1;
 
-    if (pool->freeWorkers - pool->jobQueueDepth <= 0 &&
-        pool->nWorkers < pool->maxWorkers &&
-        virThreadPoolExpand(pool, 1, false) < 0)
-        return -1;
+    /* Make sure every queued job including this one has a worker
+     * available, counting the workers which are still starting up.
+     * A burst of jobs thus spawns the workers it needs right away
+     * rather than one by one. */
+    if (pool->nWorkers < pool->maxWorkers &&
+        pool->jobQueueDepth + 1 > pool->freeWorkers + pool->startingWorkers) {
+        size_t gain = pool->jobQueueDepth + 1 -
+                      pool->freeWorkers - pool->startingWorkers;
+
+        gain = MIN(gain, pool->maxWorkers - pool->nWorkers);
+
+        if (virThreadPoolExpand(pool, gain, false) < 0)
+            return -1;
+    }
+
+    if (!(jobKey = g_hash_table_lookup(pool->keys, key))) {
+        jobKey = g_new0(virThreadPoolJobKey, 1);
+        jobKey->key = key;
+        g_hash_table_insert(pool->keys, (void *)key, jobKey);
+    }
 
     job = g_new0(virThreadPoolJob, 1);
 
     job->data = jobData;
     job->priority = priority;
+    job->key = jobKey;
+    job->queued = g_get_monotonic_time();
+
+    job->keyPrev = jobKey->tail;
+    if (jobKey->tail)
+        jobKey->tail->keyNext = job;
+    else
+        virThreadPoolKeyRingAdd(pool, jobKey);
+    jobKey->tail = job;
+
+    if (!jobKey->head)
+        jobKey->head = job;
 
     job->prev = pool->jobList.tail;
     if (pool->jobList.tail)
@@ -457,6 +709,61 @@ virThreadPoolSetParameters(virThreadPool *pool,
     return 0;
 }
 
+/**
+ * virThreadPoolSetIdleTimeout:
+ * @pool: thread pool
+ * @timeout: timeout in seconds, 0 to disable
+ *
+ * Makes workers exceeding the minimal number of workers of @pool exit
+ * after they've had no job to run for @timeout seconds.
+ */
+void
+virThreadPoolSetIdleTimeout(virThreadPool *pool,
+                            unsigned int timeout)
+{
+    VIR_LOCK_GUARD lock = virLockGuardLock(&pool->mutex);
+
+    pool->idleTimeout = timeout;
+    virCondBroadcast(&pool->cond);
+}
+
+/**
+ * virThreadPoolSetMaxKeyWorkers:
+ * @pool: thread pool
+ * @maxKeyWorkers: maximum number of workers, 0 for no limit
+ *
+ * Limits the number of normal workers running jobs queued with the same
+ * key at the same time, see virThreadPoolSendJobFull(). Priority workers
+ * don't observe the limit.
+ */
+void
+virThreadPoolSetMaxKeyWorkers(virThreadPool *pool,
+                              size_t maxKeyWorkers)
+{
+    VIR_LOCK_GUARD lock = virLockGuardLock(&pool->mutex);
+
+    pool->maxKeyWorkers = maxKeyWorkers;
+    virCondBroadcast(&pool->cond);
+}
+
+/**
+ * virThreadPoolSetJobDataFree:
+ * @pool: thread pool
+ * @jobDataFree: callback freeing data of a job
+ *
+ * Sets the callback used to free data of jobs which are discarded
+ * without being run when @pool is drained or freed. The callback is
+ * called with the pool locked and thus must not use @pool.
+ */
+void
+virThreadPoolSetJobDataFree(virThreadPool *pool,
+                            virFreeCallback jobDataFree)
+{
+    VIR_LOCK_GUARD lock = virLockGuardLock(&pool->mutex);
+
+    pool->jobDataFree = jobDataFree;
+}
+
 void
 virThreadPoolStop(virThreadPool *pool)
 {
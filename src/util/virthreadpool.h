@@ -26,6 +26,8 @@
 
 typedef struct _virThreadPool virThreadPool;
 
+#define VIR_THREAD_POOL_JOB_WAIT_BUCKETS 6
+
 typedef void (*virThreadPoolJobFunc)(void *jobdata, void *opaque);
 
 virThreadPool *virThreadPoolNewFull(size_t minWorkers,
@@ -42,6 +44,8 @@ size_t virThreadPoolGetPriorityWorkers(virThreadPool *pool);
 size_t virThreadPoolGetCurrentWorkers(virThreadPool *pool);
 size_t virThreadPoolGetFreeWorkers(virThreadPool *pool);
 size_t virThreadPoolGetJobQueueDepth(virThreadPool *pool);
+void virThreadPoolGetJobWaitStats(virThreadPool *pool,
+                                  unsigned long long *buckets);
 
 void virThreadPoolFree(virThreadPool *pool);
 
@@ -50,10 +54,25 @@ int virThreadPoolSendJob(virThreadPool *pool,
                          void *jobdata) ATTRIBUTE_NONNULL(1)
                                         G_GNUC_WARN_UNUSED_RESULT;
 
+int virThreadPoolSendJobFull(virThreadPool *pool,
+                             unsigned int priority,
+                             const void *key,
+                             void *jobdata) ATTRIBUTE_NONNULL(1)
+                                            G_GNUC_WARN_UNUSED_RESULT;
+
 int virThreadPoolSetParameters(virThreadPool *pool,
                                long long int minWorkers,
                                long long int maxWorkers,
                                long long int prioWorkers);
 
+void virThreadPoolSetIdleTimeout(virThreadPool *pool,
+                                 unsigned int timeout);
+
+void virThreadPoolSetMaxKeyWorkers(virThreadPool *pool,
+                                   size_t maxKeyWorkers);
+
+void virThreadPoolSetJobDataFree(virThreadPool *pool,
+                                 virFreeCallback jobDataFree);
+
 void virThreadPoolStop(virThreadPool *pool);
 void virThreadPoolDrain(virThreadPool *pool);
@@ -0,0 +1,232 @@
+/*
+ * virzero.c: detection of zeroed memory
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#ifdef __x86_64__
+# include <immintrin.h>
+#endif
+
+#define LIBVIRT_VIRZEROPRIV_H_ALLOW
+#include "virzeropriv.h"
+#include "virerror.h"
+#include "virthread.h"
+
+#define VIR_FROM_THIS VIR_FROM_NONE
+
+
+typedef size_t (*virFindNonZeroFunc)(const unsigned char *buf, size_t len);
+
+
+static size_t
+virFindNonZeroScalar(const unsigned char *buf,
+                     size_t len)
+{
+    size_t i = 0;
+
+    while (i < len && (uintptr_t)(buf + i) % sizeof(unsigned long) != 0) {
+        if (buf[i])
+            return i;
+        i++;
+    }
+
+    for (; i + sizeof(unsigned long) <= len; i += sizeof(unsigned long)) {
+        unsigned long word;
+
+        memcpy(&word, buf + i, sizeof(word));
+        if (word)
+            break;
+    }
+
+    for (; i < len; i++) {
+        if (buf[i])
+            return i;
+    }
+
+    return len;
+}
+
+
+#ifdef __x86_64__
+/* SSE2 is part of the x86_64 baseline, so this needs no runtime check */
+static size_t
+virFindNonZeroSSE2(const unsigned char *buf,
+                   size_t len)
+{
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+
+    /* Look at 64 bytes at once and narrow the search down only once
+     * there is something */
+    for (; i + 64 <= len; i += 64) {
+        const __m128i *p = (const __m128i *)(buf + i);
+        __m128i v = _mm_or_si128(_mm_or_si128(_mm_loadu_si128(p),
+                                              _mm_loadu_si128(p + 1)),
+                                 _mm_or_si128(_mm_loadu_si128(p + 2),
+                                              _mm_loadu_si128(p + 3)));
+
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(v, zero)) != 0xffff)
+            break;
+    }
+
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(buf + i));
+        unsigned int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, zero));
+
+        if (mask != 0xffff)
+            return i + __builtin_ctz(~mask);
+    }
+
+    return i + virFindNonZeroScalar(buf + i, len - i);
+}
+
+
+__attribute__((target("avx2")))
+static size_t
+virFindNonZeroAVX2(const unsigned char *buf,
+                   size_t len)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    size_t i = 0;
+
+    for (; i + 128 <= len; i += 128) {
+        const __m256i *p = (const __m256i *)(buf + i);
+        __m256i v = _mm256_or_si256(_mm256_or_si256(_mm256_loadu_si256(p),
+                                                    _mm256_loadu_si256(p + 1)),
+                                    _mm256_or_si256(_mm256_loadu_si256(p + 2),
+                                                    _mm256_loadu_si256(p + 3)));
+
+        if (!_mm256_testz_si256(v, v))
+            break;
+    }
+
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(buf + i));
+        unsigned int mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, zero));
+
+        if (mask != 0xffffffff)
+            return i + __builtin_ctz(~mask);
+    }
+
+    return i + virFindNonZeroSSE2(buf + i, len - i);
+}
+#endif /* __x86_64__ */
+
+
+static virFindNonZeroFunc virFindNonZeroImpl = virFindNonZeroScalar;
+
+
+static int
+virZeroOnceInit(void)
+{
+#ifdef __x86_64__
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx2"))
+        virFindNonZeroImpl = virFindNonZeroAVX2;
+    else
+        virFindNonZeroImpl = virFindNonZeroSSE2;
+#endif /* __x86_64__ */
+
+    return 0;
+}
+
+VIR_ONCE_GLOBAL_INIT(virZero);
+
+
+/**
+ * virZeroSetImpl:
+ * @impl: implementation to use
+ *
+ * Overrides the implementation picked according to the host CPU. Meant
+ * for tests only.
+ *
+ * Returns 0 on success, -1 if @impl is not supported on this host.
+ */
+int
+virZeroSetImpl(virZeroImpl impl)
+{
+    if (virZeroInitialize() < 0)
+        return -1;
+
+    switch (impl) {
+    case VIR_ZERO_IMPL_SCALAR:
+        virFindNonZeroImpl = virFindNonZeroScalar;
+        return 0;
+
+    case VIR_ZERO_IMPL_SSE2:
+#ifdef __x86_64__
+        virFindNonZeroImpl = virFindNonZeroSSE2;
+        return 0;
+#else
+        return -1;
+#endif
+
+    case VIR_ZERO_IMPL_AVX2:
+#ifdef __x86_64__
+        if (!__builtin_cpu_supports("avx2"))
+            return -1;
+        virFindNonZeroImpl = virFindNonZeroAVX2;
+        return 0;
+#else
+        return -1;
+#endif
+
+    case VIR_ZERO_IMPL_LAST:
+    default:
+        break;
+    }
+
+    return -1;
+}
+
+
+/**
+ * virFindNonZero:
+ * @buf: memory to look at
+ * @len: size of @buf
+ *
+ * Looks for the first non-zero byte in @buf using the widest vector
+ * instructions the host CPU supports.
+ *
+ * Returns the offset of the first non-zero byte or @len if @buf
+ * contains zeroes only.
+ */
+size_t
+virFindNonZero(const void *buf,
+               size_t len)
+{
+    ignore_value(virZeroInitialize());
+
+    return virFindNonZeroImpl(buf, len);
+}
+
+
+/**
+ * virIsZero:
+ * @buf: memory to look at
+ * @len: size of @buf
+ *
+ * Returns true if @buf contains zeroes only.
+ */
+bool
+virIsZero(const void *buf,
+          size_t len)
+{
+    return virFindNonZero(buf, len) == len;
+}
@@ -0,0 +1,35 @@
+/*
+ * virzeropriv.h: functions for testing virzero APIs
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBVIRT_VIRZEROPRIV_H_ALLOW
+# error "virzeropriv.h may only be included by virzero.c or test suites"
+#endif /* LIBVIRT_VIRZEROPRIV_H_ALLOW */
+
+#pragma once
+
+#include "virzero.h"
+
+typedef enum {
+    VIR_ZERO_IMPL_SCALAR,
+    VIR_ZERO_IMPL_SSE2,
+    VIR_ZERO_IMPL_AVX2,
+
+    VIR_ZERO_IMPL_LAST
+} virZeroImpl;
+
+int virZeroSetImpl(virZeroImpl impl);
@@ -124,6 +124,7 @@ vmwareLoadDomains(struct vmware_driver *driver)
     char *str;
     char *saveptr = NULL;
     g_autoptr(virCommand) cmd = NULL;
+    int pid;
 
     ctx.parseFileName = vmwareParseVMXFileName;
     ctx.formatFileName = NULL;
@@ -163,8 +164,9 @@ vmwareLoadDomains(struct vmware_driver *driver)
 
         vmwareDomainConfigDisplay(pDomain, vm->def);
 
-        if ((vm->def->id = vmwareExtractPid(vmxPath)) < 0)
+        if ((pid = vmwareExtractPid(vmxPath)) < 0)
             goto cleanup;
+        virDomainObjListSetID(driver->domains, vm, pid);
         /* vmrun list only reports running vms */
         virDomainObjSetState(vm, VIR_DOMAIN_RUNNING,
                              VIR_DOMAIN_RUNNING_UNKNOWN);
@@ -1313,16 +1313,18 @@ prlsdkAddVNCInfo(PRL_HANDLE sdkdom, virDomainDef *def)
 }
 
 static void
-prlsdkConvertDomainState(VIRTUAL_MACHINE_STATE domainState,
+prlsdkConvertDomainState(virDomainObjList *doms,
+                         VIRTUAL_MACHINE_STATE domainState,
                          PRL_UINT32 envId,
                          virDomainObj *dom)
 {
+    int id = -1;
+
     switch (domainState) {
     case VMS_STOPPED:
     case VMS_MOUNTED:
         virDomainObjSetState(dom, VIR_DOMAIN_SHUTOFF,
                              VIR_DOMAIN_SHUTOFF_SHUTDOWN);
-        dom->def->id = -1;
         break;
     case VMS_STARTING:
     case VMS_COMPACTING:
@@ -1332,62 +1334,62 @@ prlsdkConvertDomainState(VIRTUAL_MACHINE_STATE domainState,
     case VMS_RUNNING:
         virDomainObjSetState(dom, VIR_DOMAIN_RUNNING,
                              VIR_DOMAIN_RUNNING_BOOTED);
-        dom->def->id = envId;
+        id = envId;
         break;
     case VMS_PAUSED:
         virDomainObjSetState(dom, VIR_DOMAIN_PAUSED,
                              VIR_DOMAIN_PAUSED_USER);
-        dom->def->id = envId;
+        id = envId;
         break;
     case VMS_SUSPENDED:
     case VMS_DELETING_STATE:
     case VMS_SUSPENDING_SYNC:
         virDomainObjSetState(dom, VIR_DOMAIN_SHUTOFF,
                              VIR_DOMAIN_SHUTOFF_SAVED);
-        dom->def->id = -1;
         break;
     case VMS_STOPPING:
         virDomainObjSetState(dom, VIR_DOMAIN_SHUTDOWN,
                              VIR_DOMAIN_SHUTDOWN_USER);
-        dom->def->id = envId;
+        id = envId;
         break;
     case VMS_SNAPSHOTING:
         virDomainObjSetState(dom, VIR_DOMAIN_PAUSED,
                              VIR_DOMAIN_PAUSED_SNAPSHOT);
-        dom->def->id = envId;
+        id = envId;
         break;
     case VMS_MIGRATING:
         virDomainObjSetState(dom, VIR_DOMAIN_PAUSED,
                              VIR_DOMAIN_PAUSED_MIGRATION);
-        dom->def->id = envId;
+        id = envId;
         break;
     case VMS_SUSPENDING:
         virDomainObjSetState(dom, VIR_DOMAIN_PAUSED,
                              VIR_DOMAIN_PAUSED_SAVE);
-        dom->def->id = envId;
+        id = envId;
         break;
     case VMS_RESTORING:
         virDomainObjSetState(dom, VIR_DOMAIN_RUNNING,
                              VIR_DOMAIN_RUNNING_RESTORED);
-        dom->def->id = envId;
+        id = envId;
         break;
     case VMS_CONTINUING:
         virDomainObjSetState(dom, VIR_DOMAIN_RUNNING,
                              VIR_DOMAIN_RUNNING_UNPAUSED);
-        dom->def->id = envId;
+        id = envId;
         break;
     case VMS_RESUMING:
         virDomainObjSetState(dom, VIR_DOMAIN_RUNNING,
                              VIR_DOMAIN_RUNNING_RESTORED);
-        dom->def->id = envId;
+        id = envId;
         break;
     case VMS_UNKNOWN:
     default:
         virDomainObjSetState(dom, VIR_DOMAIN_NOSTATE,
                              VIR_DOMAIN_NOSTATE_UNKNOWN);
-        dom->def->id = -1;
         break;
     }
+
+    virDomainObjListSetID(doms, dom, id);
 }
 
 static int
@@ -1877,7 +1879,9 @@ prlsdkLoadDomain(struct _vzDriver *driver,
     } else {
         /* assign new virDomainDef without any checks
          * we can't use virDomainObjAssignDef, because it checks
-         * for state and domain name */
+         * for state and domain name. The ID is set below, which
+         * needs to know the one the domain is indexed under */
+        def->id = dom->def->id;
         virDomainDefFree(dom->def);
         dom->def = g_steal_pointer(&def);
     }
@@ -1885,7 +1889,7 @@ prlsdkLoadDomain(struct _vzDriver *driver,
     pdom = dom->privateData;
     pdom->id = envId;
 
-    prlsdkConvertDomainState(domainState, envId, dom);
+    prlsdkConvertDomainState(driver->domains, domainState, envId, dom);
 
     if (autostart == PAO_VM_START_ON_LOAD)
         dom->autostart = 1;
@@ -2051,7 +2055,7 @@ prlsdkHandleVmStateEvent(struct _vzDriver *driver,
 
     pdom = dom->privateData;
 
-    prlsdkConvertDomainState(domainState, pdom->id, dom);
+    prlsdkConvertDomainState(driver->domains, domainState, pdom->id, dom);
 
     prlsdkNewStateToEvent(domainState,
                           &lvEventType,
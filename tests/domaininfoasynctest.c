@@ -0,0 +1,264 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library;  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include <unistd.h>
+
+#include "testutils.h"
+
+#define VIR_FROM_THIS VIR_FROM_NONE
+
+#define NREQUESTS 16
+
+static const char domainDef[] =
+"<domain type='test'>"
+"  <name>test-async</name>"
+"  <memory>8388608</memory>"
+"  <currentMemory>2097152</currentMemory>"
+"  <vcpu>2</vcpu>"
+"  <os>"
+"    <type>hvm</type>"
+"  </os>"
+"</domain>";
+
+typedef struct {
+    virDomainPtr dom;
+    size_t done;
+    size_t freed;
+    size_t failed;
+    int lastErrorCode;
+    virDomainInfo info;
+} testAsyncData;
+
+static virConnectPtr conn;
+
+
+static void
+testGetInfoCallback(virDomainPtr dom,
+                    int ret,
+                    virDomainInfoPtr info,
+                    void *opaque)
+{
+    testAsyncData *data = opaque;
+
+    /* the callback must be run at most once before the data is freed */
+    if (data->freed > 0 || dom != data->dom) {
+        data->failed++;
+        return;
+    }
+
+    data->done++;
+
+    if (ret < 0) {
+        virErrorPtr err = virGetLastError();
+
+        if (info)
+            data->failed++;
+
+        data->lastErrorCode = err ? err->code : VIR_ERR_OK;
+        return;
+    }
+
+    if (!info) {
+        data->failed++;
+        return;
+    }
+
+    data->info = *info;
+}
+
+
+static void
+testGetInfoFree(void *opaque)
+{
+    testAsyncData *data = opaque;
+
+    data->freed++;
+}
+
+
+static int
+testGetInfoWait(testAsyncData *data,
+                size_t n)
+{
+    while (data->freed < n) {
+        if (virEventRunDefaultImpl() < 0)
+            return -1;
+    }
+
+    if (data->failed > 0 || data->done != n) {
+        fprintf(stderr, "%zu callbacks run, %zu invalid, %zu expected\n",
+                data->done, data->failed, n);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+static int
+testGetInfo(const void *opaque G_GNUC_UNUSED)
+{
+    virDomainPtr dom;
+    testAsyncData data = { 0 };
+    virDomainInfo info;
+    size_t i;
+    int ret = -1;
+
+    if (!(dom = virDomainLookupByName(conn, "test")))
+        return -1;
+
+    data.dom = dom;
+
+    if (virDomainGetInfo(dom, &info) < 0)
+        goto cleanup;
+
+    for (i = 0; i < NREQUESTS; i++) {
+        if (virDomainGetInfoAsync(dom, testGetInfoCallback,
+                                  &data, testGetInfoFree) < 0)
+            goto cleanup;
+    }
+
+    /* nothing is run until the event loop gets to it */
+    if (data.done != 0 || data.freed != 0) {
+        fprintf(stderr, "callback run before entering the event loop\n");
+        goto cleanup;
+    }
+
+    if (testGetInfoWait(&data, NREQUESTS) < 0)
+        goto cleanup;
+
+    if (data.info.state != info.state ||
+        data.info.maxMem != info.maxMem ||
+        data.info.memory != info.memory ||
+        data.info.nrVirtCpu != info.nrVirtCpu) {
+        fprintf(stderr, "information differs from virDomainGetInfo\n");
+        goto cleanup;
+    }
+
+    ret = 0;
+
+ cleanup:
+    virDomainFree(dom);
+    return ret;
+}
+
+
+static int
+testGetInfoError(const void *opaque G_GNUC_UNUSED)
+{
+    virDomainPtr dom;
+    testAsyncData data = { 0 };
+    int ret = -1;
+
+    if (!(dom = virDomainCreateXML(conn, domainDef, 0)))
+        return -1;
+
+    data.dom = dom;
+
+    /* the domain is transient and goes away when destroyed */
+    if (virDomainDestroy(dom) < 0)
+        goto cleanup;
+
+    if (virDomainGetInfoAsync(dom, testGetInfoCallback,
+                              &data, testGetInfoFree) < 0)
+        goto cleanup;
+
+    if (testGetInfoWait(&data, 1) < 0)
+        goto cleanup;
+
+    if (data.lastErrorCode != VIR_ERR_NO_DOMAIN) {
+        fprintf(stderr, "unexpected error code %d\n", data.lastErrorCode);
+        goto cleanup;
+    }
+
+    ret = 0;
+
+ cleanup:
+    virDomainFree(dom);
+    return ret;
+}
+
+
+static int
+testGetInfoNoCallback(const void *opaque G_GNUC_UNUSED)
+{
+    virDomainPtr dom;
+    testAsyncData data = { 0 };
+    int ret = -1;
+
+    if (!(dom = virDomainLookupByName(conn, "test")))
+        return -1;
+
+    if (virDomainGetInfoAsync(dom, NULL, &data, testGetInfoFree) == 0) {
+        fprintf(stderr, "request without callback accepted\n");
+        goto cleanup;
+    }
+
+    if (data.freed != 0) {
+        fprintf(stderr, "data freed after a failed request\n");
+        goto cleanup;
+    }
+
+    ret = 0;
+
+ cleanup:
+    virDomainFree(dom);
+    return ret;
+}
+
+
+static void
+timeout(int id G_GNUC_UNUSED, void *opaque G_GNUC_UNUSED)
+{
+    fputs("test taking too long; giving up", stderr);
+    _exit(EXIT_FAILURE);
+}
+
+
+static int
+mymain(void)
+{
+    int ret = 0;
+    int timer;
+
+    virEventRegisterDefaultImpl();
+
+    /* Set up a timer to abort this test if it takes 10 seconds.  */
+    if ((timer = virEventAddTimeout(10 * 1000, timeout, NULL, NULL)) < 0)
+        return EXIT_FAILURE;
+
+    if (!(conn = virConnectOpen("test:///default")))
+        return EXIT_FAILURE;
+
+    virTestQuiesceLibvirtErrors(false);
+
+    if (virTestRun("Domain info", testGetInfo, NULL) < 0)
+        ret = -1;
+    if (virTestRun("Domain info error", testGetInfoError, NULL) < 0)
+        ret = -1;
+    if (virTestRun("Domain info without callback",
+                   testGetInfoNoCallback, NULL) < 0)
+        ret = -1;
+
+    virEventRemoveTimeout(timer);
+    virConnectClose(conn);
+
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+VIR_TEST_MAIN(mymain)
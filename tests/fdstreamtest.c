@@ -19,6 +19,10 @@
 #include <config.h>
 
 #include <fcntl.h>
+#ifndef WIN32
+# include <signal.h>
+# include <sys/resource.h>
+#endif
 
 #include "testutils.h"
 
@@ -26,6 +30,7 @@
 #include "datatypes.h"
 #include "virlog.h"
 #include "virfile.h"
+#include "virsocket.h"
 
 #define VIR_FROM_THIS VIR_FROM_NONE
 
@@ -297,6 +302,467 @@ static int testFDStreamWriteNonblock(const void *data)
     return testFDStreamWriteCommon(data, false);
 }
 
+
+#define BENCHMARK_FILE_SIZE (256 * 1024 * 1024)
+
+struct testFDStreamBenchmarkData {
+    const char *scratchdir;
+    size_t chunk;
+};
+
+/* Measures throughput of reading a file through a stream in chunks of the
+ * size used by virStreamRecvAll for old and new peers */
+static int testFDStreamBenchmark(const void *opaque)
+{
+    const struct testFDStreamBenchmarkData *data = opaque;
+    VIR_AUTOCLOSE fd = -1;
+    g_autofree char *file = NULL;
+    g_autofree char *buf = NULL;
+    virStreamPtr st = NULL;
+    virConnectPtr conn = NULL;
+    unsigned long long total = 0;
+    long long start;
+    double elapsed;
+    int ret = -1;
+
+    if (!(conn = virConnectOpen("test:///default")))
+        goto cleanup;
+
+    file = g_strdup_printf("%s/benchmark.data", data->scratchdir);
+
+    if ((fd = open(file, O_CREAT|O_WRONLY|O_TRUNC, 0600)) < 0 ||
+        ftruncate(fd, BENCHMARK_FILE_SIZE) < 0 ||
+        VIR_CLOSE(fd) < 0)
+        goto cleanup;
+
+    if (!(st = virStreamNew(conn, 0)))
+        goto cleanup;
+
+    if (virFDStreamOpenFile(st, file, 0, 0, O_RDONLY) < 0)
+        goto cleanup;
+
+    buf = g_new(char, data->chunk);
+
+    start = g_get_monotonic_time();
+
+    while (true) {
+        int got = st->driver->streamRecv(st, buf, data->chunk);
+
+        if (got < 0) {
+            fprintf(stderr, "Failed to read stream: %s\n",
+                    virGetLastErrorMessage());
+            goto cleanup;
+        }
+
+        if (got == 0)
+            break;
+
+        total += got;
+    }
+
+    elapsed = (g_get_monotonic_time() - start) / 1000000.0;
+
+    if (total != BENCHMARK_FILE_SIZE) {
+        fprintf(stderr, "Read %llu bytes, expected %d\n",
+                total, BENCHMARK_FILE_SIZE);
+        goto cleanup;
+    }
+
+    VIR_TEST_DEBUG("%zu byte chunks: %llu MiB in %.3fs (%.0f MiB/s)",
+                   data->chunk, total / (1024 * 1024), elapsed,
+                   total / (1024 * 1024) / elapsed);
+
+    if (st->driver->streamFinish(st) != 0) {
+        fprintf(stderr, "Failed to finish stream: %s\n",
+                virGetLastErrorMessage());
+        goto cleanup;
+    }
+
+    ret = 0;
+ cleanup:
+    if (st)
+        virStreamFree(st);
+    if (file != NULL)
+        unlink(file);
+    if (conn)
+        virConnectClose(conn);
+    return ret;
+}
+
+#ifndef WIN32
+/* Measures throughput of reading the same file when the stream has
+ * been redirected to a local socket, as done for local RPC clients */
+static int testFDStreamBenchmarkLocalFD(const void *opaque)
+{
+    const char *scratchdir = opaque;
+    VIR_AUTOCLOSE fd = -1;
+    VIR_AUTOCLOSE peer = -1;
+    g_autofree char *file = NULL;
+    g_autofree char *buf = NULL;
+    virStreamPtr st = NULL;
+    virConnectPtr conn = NULL;
+    unsigned long long total = 0;
+    int fds[2] = { -1, -1 };
+    long long start;
+    double elapsed;
+    int ret = -1;
+
+    if (!(conn = virConnectOpen("test:///default")))
+        goto cleanup;
+
+    file = g_strdup_printf("%s/benchmark.data", scratchdir);
+
+    if ((fd = open(file, O_CREAT|O_WRONLY|O_TRUNC, 0600)) < 0 ||
+        ftruncate(fd, BENCHMARK_FILE_SIZE) < 0 ||
+        VIR_CLOSE(fd) < 0)
+        goto cleanup;
+
+    if (!(st = virStreamNew(conn, 0)))
+        goto cleanup;
+
+    if (virFDStreamOpenFile(st, file, 0, 0, O_RDONLY) < 0)
+        goto cleanup;
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+        fprintf(stderr, "Failed to create socket pair\n");
+        goto cleanup;
+    }
+    peer = fds[1];
+
+    if (virStreamRedirect(st, fds[0]) != 1) {
+        fprintf(stderr, "Failed to redirect stream: %s\n",
+                virGetLastErrorMessage());
+        VIR_FORCE_CLOSE(fds[0]);
+        goto cleanup;
+    }
+
+    buf = g_new(char, 4194304);
+
+    start = g_get_monotonic_time();
+
+    while (true) {
+        ssize_t got = saferead(peer, buf, 4194304);
+
+        if (got < 0) {
+            fprintf(stderr, "Failed to read socket: %s\n",
+                    g_strerror(errno));
+            goto cleanup;
+        }
+
+        if (got == 0)
+            break;
+
+        total += got;
+    }
+
+    elapsed = (g_get_monotonic_time() - start) / 1000000.0;
+
+    if (total != BENCHMARK_FILE_SIZE) {
+        fprintf(stderr, "Read %llu bytes, expected %d\n",
+                total, BENCHMARK_FILE_SIZE);
+        goto cleanup;
+    }
+
+    VIR_TEST_DEBUG("local fd: %llu MiB in %.3fs (%.0f MiB/s)",
+                   total / (1024 * 1024), elapsed,
+                   total / (1024 * 1024) / elapsed);
+
+    if (st->driver->streamFinish(st) != 0) {
+        fprintf(stderr, "Failed to finish stream: %s\n",
+                virGetLastErrorMessage());
+        goto cleanup;
+    }
+
+    ret = 0;
+ cleanup:
+    if (st)
+        virStreamFree(st);
+    if (file != NULL)
+        unlink(file);
+    if (conn)
+        virConnectClose(conn);
+    return ret;
+}
+#endif /* !WIN32 */
+
+#ifndef WIN32
+/* Spans several steps of the redirect thread and ends mid-page */
+# define REDIRECT_DATA_LEN (3 * 1024 * 1024 + 4321)
+
+struct testFDStreamRedirectData {
+    const char *scratchdir;
+    bool upload;
+    bool fallback; /* make the kernel refuse sendfile() and splice() */
+};
+
+static char *
+testFDStreamRedirectPattern(void)
+{
+    char *pattern = g_new(char, REDIRECT_DATA_LEN);
+    size_t i;
+
+    for (i = 0; i < REDIRECT_DATA_LEN; i++)
+        pattern[i] = (i * 31) + (i / 4096);
+
+    return pattern;
+}
+
+
+static int
+testFDStreamRedirectOpen(virStreamPtr st,
+                         int *peer,
+                         bool append)
+{
+    int fds[2] = { -1, -1 };
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+        fprintf(stderr, "Failed to create socket pair\n");
+        return -1;
+    }
+    *peer = fds[1];
+
+    if (append &&
+        fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_APPEND) < 0) {
+        fprintf(stderr, "Failed to set O_APPEND on socket\n");
+        VIR_FORCE_CLOSE(fds[0]);
+        return -1;
+    }
+
+    if (virStreamRedirect(st, fds[0]) != 1) {
+        fprintf(stderr, "Failed to redirect stream: %s\n",
+                virGetLastErrorMessage());
+        VIR_FORCE_CLOSE(fds[0]);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/* Download: the file is sent to the socket by the stream */
+static int
+testFDStreamRedirectRead(const struct testFDStreamRedirectData *data,
+                         virStreamPtr st,
+                         const char *file,
+                         const char *pattern)
+{
+    VIR_AUTOCLOSE peer = -1;
+    g_autofree char *buf = g_new0(char, REDIRECT_DATA_LEN + 1);
+    size_t total = 0;
+    char c;
+    int got;
+
+    if ((peer = open(file, O_CREAT | O_WRONLY | O_TRUNC, 0600)) < 0 ||
+        safewrite(peer, pattern, REDIRECT_DATA_LEN) != REDIRECT_DATA_LEN ||
+        VIR_CLOSE(peer) < 0)
+        return -1;
+
+    if (virFDStreamOpenFile(st, file, 0, 0, O_RDONLY) < 0)
+        return -1;
+
+    /* sendfile() refuses to write to O_APPEND files */
+    if (testFDStreamRedirectOpen(st, &peer, data->fallback) < 0)
+        return -1;
+
+    while (total <= REDIRECT_DATA_LEN) {
+        ssize_t n = saferead(peer, buf + total, REDIRECT_DATA_LEN + 1 - total);
+
+        if (n < 0) {
+            fprintf(stderr, "Failed to read socket: %s\n", g_strerror(errno));
+            return -1;
+        }
+
+        if (n == 0)
+            break;
+
+        total += n;
+    }
+
+    if (total != REDIRECT_DATA_LEN ||
+        memcmp(buf, pattern, REDIRECT_DATA_LEN) != 0) {
+        fprintf(stderr, "Mismatched data, got %zu bytes\n", total);
+        return -1;
+    }
+
+    /* Readers of the stream see just the EOF once the thread is done */
+    while ((got = st->driver->streamRecv(st, &c, 1)) == -2)
+        g_usleep(20 * 1000);
+
+    if (got != 0) {
+        fprintf(stderr, "Expected EOF from stream, got %d: %s\n",
+                got, virGetLastErrorMessage());
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/* Upload: the data sent to the socket is written to the file */
+static int
+testFDStreamRedirectWrite(const struct testFDStreamRedirectData *data,
+                          virStreamPtr st,
+                          const char *file,
+                          const char *pattern)
+{
+    VIR_AUTOCLOSE peer = -1;
+    g_autofree char *buf = NULL;
+    int len;
+
+    /* splice() refuses to write to O_APPEND files */
+    if (virFDStreamCreateFile(st, file, 0, 0,
+                              O_WRONLY | (data->fallback ? O_APPEND : 0),
+                              0600) < 0)
+        return -1;
+
+    if (testFDStreamRedirectOpen(st, &peer, false) < 0)
+        return -1;
+
+    if (safewrite(peer, pattern, REDIRECT_DATA_LEN) != REDIRECT_DATA_LEN) {
+        fprintf(stderr, "Failed to write socket: %s\n", g_strerror(errno));
+        return -1;
+    }
+
+    /* Closing the socket ends the data */
+    if (VIR_CLOSE(peer) < 0)
+        return -1;
+
+    if (st->driver->streamFinish(st) != 0) {
+        fprintf(stderr, "Failed to finish stream: %s\n",
+                virGetLastErrorMessage());
+        return -1;
+    }
+
+    if ((len = virFileReadAll(file, REDIRECT_DATA_LEN + 1, &buf)) < 0)
+        return -1;
+
+    if (len != REDIRECT_DATA_LEN ||
+        memcmp(buf, pattern, REDIRECT_DATA_LEN) != 0) {
+        fprintf(stderr, "Mismatched data, got %d bytes\n", len);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+static int testFDStreamRedirect(const void *opaque)
+{
+    const struct testFDStreamRedirectData *data = opaque;
+    g_autofree char *file = NULL;
+    g_autofree char *pattern = testFDStreamRedirectPattern();
+    virStreamPtr st = NULL;
+    virConnectPtr conn = NULL;
+    int ret = -1;
+
+    if (!(conn = virConnectOpen("test:///default")))
+        goto cleanup;
+
+    file = g_strdup_printf("%s/redirect.data", data->scratchdir);
+
+    if (!(st = virStreamNew(conn, 0)))
+        goto cleanup;
+
+    if (data->upload) {
+        if (testFDStreamRedirectWrite(data, st, file, pattern) < 0)
+            goto cleanup;
+    } else {
+        if (testFDStreamRedirectRead(data, st, file, pattern) < 0)
+            goto cleanup;
+
+        if (st->driver->streamFinish(st) != 0) {
+            fprintf(stderr, "Failed to finish stream: %s\n",
+                    virGetLastErrorMessage());
+            goto cleanup;
+        }
+    }
+
+    ret = 0;
+ cleanup:
+    if (st)
+        virStreamFree(st);
+    if (file != NULL)
+        unlink(file);
+    if (conn)
+        virConnectClose(conn);
+    return ret;
+}
+
+
+/* A failure of the thread in the middle of an upload must close the
+ * socket and be reported when finishing the stream */
+static int testFDStreamRedirectWriteError(const void *opaque)
+{
+    const char *scratchdir = opaque;
+    VIR_AUTOCLOSE peer = -1;
+    g_autofree char *file = NULL;
+    g_autofree char *pattern = testFDStreamRedirectPattern();
+    virStreamPtr st = NULL;
+    virConnectPtr conn = NULL;
+    struct rlimit orig;
+    struct rlimit limit;
+    virErrorPtr err;
+    bool restore = false;
+    int ret = -1;
+
+    if (!(conn = virConnectOpen("test:///default")))
+        goto cleanup;
+
+    file = g_strdup_printf("%s/redirect.data", scratchdir);
+
+    if (!(st = virStreamNew(conn, 0)))
+        goto cleanup;
+
+    if (virFDStreamCreateFile(st, file, 0, 0, O_WRONLY, 0600) < 0)
+        goto cleanup;
+
+    if (testFDStreamRedirectOpen(st, &peer, false) < 0)
+        goto cleanup;
+
+    /* Writes past the limit fail with EFBIG */
+    if (getrlimit(RLIMIT_FSIZE, &orig) < 0)
+        goto cleanup;
+    limit = orig;
+    limit.rlim_cur = 1024 * 1024;
+    if (setrlimit(RLIMIT_FSIZE, &limit) < 0)
+        goto cleanup;
+    restore = true;
+
+    /* The thread stops reading once it fails */
+    if (safewrite(peer, pattern, REDIRECT_DATA_LEN) == REDIRECT_DATA_LEN) {
+        fprintf(stderr, "All data was accepted\n");
+        goto cleanup;
+    }
+
+    if (VIR_CLOSE(peer) < 0)
+        goto cleanup;
+
+    if (st->driver->streamFinish(st) == 0) {
+        fprintf(stderr, "Finishing the stream didn't fail\n");
+        goto cleanup;
+    }
+
+    if (!(err = virGetLastError()) ||
+        err->code != VIR_ERR_SYSTEM_ERROR ||
+        err->int1 != EFBIG) {
+        fprintf(stderr, "Unexpected error: %s\n", virGetLastErrorMessage());
+        goto cleanup;
+    }
+
+    ret = 0;
+ cleanup:
+    if (restore)
+        ignore_value(setrlimit(RLIMIT_FSIZE, &orig));
+    if (st)
+        virStreamFree(st);
+    if (file != NULL)
+        unlink(file);
+    if (conn)
+        virConnectClose(conn);
+    return ret;
+}
+#endif /* !WIN32 */
+
 #define SCRATCHDIRTEMPLATE abs_builddir "/fdstreamdir-XXXXXX"
 
 static int
@@ -319,6 +785,45 @@ mymain(void)
     if (virTestRun("Stream write non-blocking ", testFDStreamWriteNonblock, scratchdir) < 0)
         ret = -1;
 
+#ifndef WIN32
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGXFSZ, SIG_IGN);
+
+# define DO_TEST_REDIRECT(name, upload, fallback) \
+    do { \
+        struct testFDStreamRedirectData data = { scratchdir, upload, fallback }; \
+        if (virTestRun("Stream redirect " name, \
+                       testFDStreamRedirect, &data) < 0) \
+            ret = -1; \
+    } while (0)
+
+    DO_TEST_REDIRECT("read sendfile", false, false);
+    DO_TEST_REDIRECT("read fallback", false, true);
+    DO_TEST_REDIRECT("write splice", true, false);
+    DO_TEST_REDIRECT("write fallback", true, true);
+
+    if (virTestRun("Stream redirect write error",
+                   testFDStreamRedirectWriteError, scratchdir) < 0)
+        ret = -1;
+#endif /* !WIN32 */
+
+    if (virTestGetExpensive()) {
+        struct testFDStreamBenchmarkData legacy = { scratchdir, 262120 };
+        struct testFDStreamBenchmarkData large = { scratchdir, 4194304 };
+
+        if (virTestRun("Stream read benchmark legacy chunks",
+                       testFDStreamBenchmark, &legacy) < 0)
+            ret = -1;
+        if (virTestRun("Stream read benchmark large chunks",
+                       testFDStreamBenchmark, &large) < 0)
+            ret = -1;
+#ifndef WIN32
+        if (virTestRun("Stream read benchmark local fd",
+                       testFDStreamBenchmarkLocalFD, scratchdir) < 0)
+            ret = -1;
+#endif /* !WIN32 */
+    }
+
     if (getenv("LIBVIRT_SKIP_CLEANUP") == NULL)
         virFileDeleteTree(scratchdir);
 
@@ -8,6 +8,7 @@
 #include "testutils.h"
 #include "internal.h"
 #include "conf/backup_conf.h"
+#include "virfile.h"
 
 #define VIR_FROM_THIS VIR_FROM_NONE
 
@@ -124,6 +125,74 @@ testCompareBackupXML(const void *opaque)
 }
 
 
+#define TEST_FORMAT_BENCH_ITERATIONS 20
+
+/*
+ * Formats the domain XMLs used by the qemu driver tests repeatedly to
+ * measure the performance of virDomainDefFormat. Files which can't be
+ * parsed without the qemu driver's callbacks are skipped.
+ */
+static int
+testFormatBenchmark(const void *opaque G_GNUC_UNUSED)
+{
+    const char *dirname = abs_srcdir "/qemuxmlconfdata";
+    g_autoptr(DIR) dir = NULL;
+    g_autoptr(GPtrArray) defs = g_ptr_array_new_with_free_func((GDestroyNotify) virDomainDefFree);
+    struct dirent *ent;
+    unsigned long long bytes = 0;
+    long long start;
+    size_t i;
+    size_t j;
+    int rc;
+
+    if (virDirOpen(&dir, dirname) < 0)
+        return -1;
+
+    while ((rc = virDirRead(dir, &ent, dirname)) > 0) {
+        g_autofree char *path = NULL;
+        virDomainDef *def;
+
+        if (!virStringHasSuffix(ent->d_name, ".xml"))
+            continue;
+
+        path = g_strdup_printf("%s/%s", dirname, ent->d_name);
+
+        if (!(def = virDomainDefParseFile(path, xmlopt, NULL,
+                                          VIR_DOMAIN_DEF_PARSE_INACTIVE |
+                                          VIR_DOMAIN_DEF_PARSE_SKIP_VALIDATE))) {
+            virResetLastError();
+            continue;
+        }
+
+        g_ptr_array_add(defs, def);
+    }
+
+    if (rc < 0)
+        return -1;
+
+    start = g_get_monotonic_time();
+
+    for (i = 0; i < TEST_FORMAT_BENCH_ITERATIONS; i++) {
+        for (j = 0; j < defs->len; j++) {
+            g_autofree char *xml = NULL;
+
+            if (!(xml = virDomainDefFormat(g_ptr_array_index(defs, j), xmlopt,
+                                           VIR_DOMAIN_DEF_FORMAT_SECURE)))
+                return -1;
+
+            bytes += strlen(xml);
+        }
+    }
+
+    VIR_TEST_DEBUG("formatted %u domains %d times: %.3f ms, %.1f MiB",
+                   defs->len, TEST_FORMAT_BENCH_ITERATIONS,
+                   (double)(g_get_monotonic_time() - start) / 1000,
+                   (double)bytes / (1024 * 1024));
+
+    return 0;
+}
+
+
 static int
 mymain(void)
 {
@@ -263,6 +332,11 @@ mymain(void)
 
     DO_TEST("iothreadids");
 
+    /* run with VIR_TEST_EXPENSIVE=1 and VIR_TEST_DEBUG=1 to see the timing */
+    if (virTestGetExpensive() &&
+        virTestRun("Format benchmark", testFormatBenchmark, NULL) < 0)
+        ret = -1;
+
     virObjectUnref(caps);
     virObjectUnref(xmlopt);
 
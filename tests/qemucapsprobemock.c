@@ -75,59 +75,74 @@ printLineSkipEmpty(const char *line,
 }
 
 
-static int (*realQemuMonitorSend)(qemuMonitor *mon,
-                                  qemuMonitorMessage *msg);
+static int (*realQemuMonitorSendBatch)(qemuMonitor *mon,
+                                       qemuMonitorMessage **msgs,
+                                       size_t nmsgs);
 
+/* qemuMonitorSend goes through this one as well. Commands of a batch are
+ * sent one by one so that each is followed by its reply in the output. */
 int
-qemuMonitorSend(qemuMonitor *mon,
-                qemuMonitorMessage *msg)
+qemuMonitorSendBatch(qemuMonitor *mon,
+                     qemuMonitorMessage **msgs,
+                     size_t nmsgs)
 {
-    g_autofree char *reformatted = NULL;
+    size_t i;
 
-    REAL_SYM(realQemuMonitorSend);
+    REAL_SYM(realQemuMonitorSendBatch);
 
-    if (!(reformatted = virJSONStringReformat(msg->txBuffer, true))) {
-        fprintf(stderr, "Failed to reformat command string '%s'\n", msg->txBuffer);
-        abort();
-    }
+    for (i = 0; i < nmsgs; i++) {
+        g_autofree char *reformatted = NULL;
+
+        if (!(reformatted = virJSONStringReformat(msgs[i]->txBuffer, true))) {
+            fprintf(stderr, "Failed to reformat command string '%s'\n",
+                    msgs[i]->txBuffer);
+            abort();
+        }
+
+        if (first)
+            first = false;
+        else
+            printLineSkipEmpty("\n", stdout);
 
-    if (first)
-        first = false;
-    else
-        printLineSkipEmpty("\n", stdout);
+        printLineSkipEmpty(reformatted, stdout);
 
-    printLineSkipEmpty(reformatted, stdout);
+        if (realQemuMonitorSendBatch(mon, msgs + i, 1) < 0)
+            return -1;
+    }
 
-    return realQemuMonitorSend(mon, msg);
+    return 0;
 }
 
 
-static int (*realQemuMonitorJSONIOProcessLine)(qemuMonitor *mon,
-                                               const char *line,
-                                               qemuMonitorMessage *msg);
+static int (*realQemuMonitorJSONIOProcessValue)(qemuMonitor *mon,
+                                                virJSONValue **value,
+                                                const char *line);
 
 int
-qemuMonitorJSONIOProcessLine(qemuMonitor *mon,
-                             const char *line,
-                             qemuMonitorMessage *msg)
+qemuMonitorJSONIOProcessValue(qemuMonitor *mon,
+                              virJSONValue **value,
+                              const char *line)
 {
-    g_autoptr(virJSONValue) value = NULL;
     g_autofree char *json = NULL;
+    bool greeting = false;
     int ret;
 
-    REAL_SYM(realQemuMonitorJSONIOProcessLine);
+    REAL_SYM(realQemuMonitorJSONIOProcessValue);
 
-    ret = realQemuMonitorJSONIOProcessLine(mon, line, msg);
+    /* the real function steals @value if it's a reply */
+    if (!(json = virJSONValueToString(*value, true))) {
+        fprintf(stderr, "Failed to reformat reply string '%s'\n", line);
+        abort();
+    }
 
-    if (ret == 0) {
-        if (!(value = virJSONValueFromString(line)) ||
-            !(json = virJSONValueToString(value, true))) {
-            fprintf(stderr, "Failed to reformat reply string '%s'\n", line);
-            abort();
-        }
+    if (virJSONValueGetType(*value) == VIR_JSON_TYPE_OBJECT)
+        greeting = virJSONValueObjectHasKey(*value, "QMP");
 
+    ret = realQemuMonitorJSONIOProcessValue(mon, value, line);
+
+    if (ret == 0) {
         /* Ignore QMP greeting */
-        if (virJSONValueObjectHasKey(value, "QMP"))
+        if (greeting)
             return 0;
 
         if (first)
@@ -306,6 +306,55 @@ testBufEscapeStr(const void *opaque)
 }
 
 
+static int
+testBufEscapeStrFormat(const void *opaque G_GNUC_UNUSED)
+{
+    g_auto(virBuffer) buf = VIR_BUFFER_INITIALIZER;
+    g_autofree char *actual = NULL;
+    const char *expected =
+        "<a b='x&apos;y'/>\n"
+        "  %&lt;&gt;%\n"
+        "  <c>5%</c>\n";
+
+    virBufferEscapeString(&buf, "<a b='%s'/>\n", "x'y");
+    virBufferAdjustIndent(&buf, 2);
+    /* formats with other conversions than '%s' use the generic path */
+    virBufferEscapeString(&buf, "%%%s%%\n", "<>");
+    virBufferEscapeString(&buf, "<c>%s%%</c>\n", "5");
+    virBufferEscapeString(&buf, "<d>%s</d>\n", NULL);
+
+    actual = virBufferContentAndReset(&buf);
+
+    return virTestCompareToString(expected, actual);
+}
+
+
+static int
+testBufReserve(const void *opaque G_GNUC_UNUSED)
+{
+    g_auto(virBuffer) buf = VIR_BUFFER_INITIALIZER;
+    g_autofree char *actual = NULL;
+
+    virBufferReserve(&buf, 4096);
+    if (virBufferUse(&buf) != 0) {
+        VIR_TEST_DEBUG("reserving space added content");
+        return -1;
+    }
+
+    virBufferAddLit(&buf, "<a>\n");
+    virBufferAdjustIndent(&buf, 2);
+    virBufferReserve(&buf, 1 << 20);
+    virBufferAddLit(&buf, "<b/>\n");
+    virBufferAdjustIndent(&buf, -2);
+    virBufferReserve(&buf, 1);
+    virBufferAddLit(&buf, "</a>\n");
+
+    actual = virBufferContentAndReset(&buf);
+
+    return virTestCompareToString("<a>\n  <b/>\n</a>\n", actual);
+}
+
+
 static int
 testBufEscapeRegex(const void *opaque)
 {
@@ -379,6 +428,8 @@ mymain(void)
     DO_TEST("AddBuffer", testBufAddBuffer);
     DO_TEST("set indent", testBufSetIndent);
     DO_TEST("autoclean", testBufferAutoclean);
+    DO_TEST("EscapeString format", testBufEscapeStrFormat);
+    DO_TEST("Reserve", testBufReserve);
 
 #define DO_TEST_ADD_STR(_data, _expect) \
     do { \
@@ -407,6 +458,14 @@ mymain(void)
                    "<c>\n  <el>,,&apos;..&apos;,,</el>\n</c>");
     DO_TEST_ESCAPE("\x01\x01\x02\x03\x05\x08",
                    "<c>\n  <el></el>\n</c>");
+    DO_TEST_ESCAPE("/var/lib/libvirt/images/guest-disk.qcow2",
+                   "<c>\n  <el>/var/lib/libvirt/images/guest-disk.qcow2</el>\n</c>");
+    DO_TEST_ESCAPE("0123456789abcdef0123456789abcdef<",
+                   "<c>\n  <el>0123456789abcdef0123456789abcdef&lt;</el>\n</c>");
+    DO_TEST_ESCAPE("0123456789a&cdef0123456789abcdef\x01tab\tand\nnewline",
+                   "<c>\n  <el>0123456789a&amp;cdef0123456789abcdeftab\tand\nnewline</el>\n</c>");
+    DO_TEST_ESCAPE("\xc3\xa9l\xc3\xa8ve 'quoted' \xe2\x82\xac",
+                   "<c>\n  <el>\xc3\xa9l\xc3\xa8ve &apos;quoted&apos; \xe2\x82\xac</el>\n</c>");
 
 #define DO_TEST_ESCAPE_REGEX(_data, _expect) \
     do { \
@@ -0,0 +1,468 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include "testutils.h"
+#include "virlog.h"
+
+#include "virdomainobjlist.h"
+#include "viruuid.h"
+#include "virthread.h"
+#include "virfile.h"
+
+#define VIR_FROM_THIS VIR_FROM_NONE
+
+VIR_LOG_INIT("tests.virdomainobjlisttest");
+
+static virDomainXMLOption *xmlopt;
+
+struct testFindByIDData {
+    size_t ndoms;
+};
+
+
+static int
+testDomainObjListPopulate(virDomainObjList *doms,
+                          size_t ndoms)
+{
+    size_t i;
+
+    for (i = 0; i < ndoms; i++) {
+        g_autoptr(virDomainDef) def = NULL;
+        g_autofree char *uuidstr = NULL;
+        virDomainObj *vm;
+
+        if (!(def = virDomainDefNew(xmlopt)))
+            return -1;
+
+        def->virtType = VIR_DOMAIN_VIRT_TEST;
+        def->name = g_strdup_printf("dom%zu", i);
+        uuidstr = g_strdup_printf("%08zx-0000-0000-0000-000000000000", i);
+        if (virUUIDParse(uuidstr, def->uuid) < 0)
+            return -1;
+
+        if (!(vm = virDomainObjListAdd(doms, &def, xmlopt, 0, NULL)))
+            return -1;
+
+        /* Odd domains get their ID through the list so that the index
+         * is kept up to date, even ones behave like drivers which set
+         * the ID directly and have to be found by the fallback path. */
+        if (i % 2)
+            virDomainObjListSetID(doms, vm, i + 1);
+        else
+            vm->def->id = i + 1;
+
+        virDomainObjEndAPI(&vm);
+    }
+
+    return 0;
+}
+
+
+static int
+testFindByIDLookup(virDomainObjList *doms,
+                   size_t ndoms)
+{
+    size_t i;
+
+    for (i = 0; i < ndoms; i++) {
+        g_autofree char *name = g_strdup_printf("dom%zu", i);
+        virDomainObj *vm;
+
+        if (!(vm = virDomainObjListFindByID(doms, i + 1))) {
+            fprintf(stderr, "domain with ID %zu not found\n", i + 1);
+            return -1;
+        }
+
+        if (STRNEQ(vm->def->name, name)) {
+            fprintf(stderr, "ID %zu: expected '%s' got '%s'\n",
+                    i + 1, name, vm->def->name);
+            virDomainObjEndAPI(&vm);
+            return -1;
+        }
+
+        virDomainObjEndAPI(&vm);
+    }
+
+    return 0;
+}
+
+
+static int
+testFindByIDRun(virDomainObjList *doms,
+                const struct testFindByIDData *data)
+{
+    virDomainObj *vm;
+    long long start;
+    size_t i;
+
+    if (testDomainObjListPopulate(doms, data->ndoms) < 0)
+        return -1;
+
+    /* first pass may need to populate the index */
+    if (testFindByIDLookup(doms, data->ndoms) < 0)
+        return -1;
+
+    start = g_get_monotonic_time();
+    for (i = 0; i < 10; i++) {
+        if (testFindByIDLookup(doms, data->ndoms) < 0)
+            return -1;
+    }
+    VIR_TEST_DEBUG("%zu domains: %.3f us per lookup", data->ndoms,
+                   (double)(g_get_monotonic_time() - start) / (10 * data->ndoms));
+
+    if ((vm = virDomainObjListFindByID(doms, data->ndoms + 1))) {
+        fprintf(stderr, "unexpected domain '%s' for unused ID\n", vm->def->name);
+        virDomainObjEndAPI(&vm);
+        return -1;
+    }
+
+    /* stop every domain and make sure stale index entries are ignored */
+    for (i = 0; i < data->ndoms; i++) {
+        g_autofree char *name = g_strdup_printf("dom%zu", i);
+
+        if (!(vm = virDomainObjListFindByName(doms, name)))
+            return -1;
+
+        if (i % 2)
+            virDomainObjListSetID(doms, vm, -1);
+        else
+            vm->def->id = -1;
+
+        virDomainObjEndAPI(&vm);
+    }
+
+    for (i = 0; i < data->ndoms; i++) {
+        if ((vm = virDomainObjListFindByID(doms, i + 1))) {
+            fprintf(stderr, "unexpected domain '%s' for ID %zu of stopped domain\n",
+                    vm->def->name, i + 1);
+            virDomainObjEndAPI(&vm);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+
+static int
+testFindByID(const void *opaque)
+{
+    virDomainObjList *doms;
+    int ret;
+
+    if (!(doms = virDomainObjListNew()))
+        return -1;
+
+    ret = testFindByIDRun(doms, opaque);
+    virObjectUnref(doms);
+    return ret;
+}
+
+
+#define TEST_COLLECT_READERS 8
+#define TEST_COLLECT_ITERATIONS 200
+
+struct testCollectData {
+    virDomainObjList *doms;
+    size_t ndoms;
+    int readerFailed;
+};
+
+
+static void
+testCollectReader(void *opaque)
+{
+    struct testCollectData *data = opaque;
+    size_t i;
+
+    for (i = 0; i < TEST_COLLECT_ITERATIONS; i++) {
+        virDomainObj **vms = NULL;
+        size_t nvms = 0;
+
+        virDomainObjListCollect(data->doms, NULL, &vms, &nvms, NULL, 0);
+
+        /* the writer toggles at most one extra domain */
+        if (nvms < data->ndoms || nvms > data->ndoms + 1)
+            g_atomic_int_set(&data->readerFailed, 1);
+
+        virObjectListFreeCount(vms, nvms);
+    }
+}
+
+
+static int
+testCollectContention(const void *opaque)
+{
+    struct testCollectData data = { 0 };
+    virThread readers[TEST_COLLECT_READERS];
+    size_t nreaders = 0;
+    long long start;
+    int ret = -1;
+    size_t i;
+
+    data.ndoms = *(const size_t *)opaque;
+
+    if (!(data.doms = virDomainObjListNew()))
+        return -1;
+
+    if (testDomainObjListPopulate(data.doms, data.ndoms) < 0)
+        goto cleanup;
+
+    start = g_get_monotonic_time();
+
+    for (nreaders = 0; nreaders < TEST_COLLECT_READERS; nreaders++) {
+        if (virThreadCreate(&readers[nreaders], true,
+                            testCollectReader, &data) < 0)
+            goto join;
+    }
+
+    /* define and undefine a domain while readers are collecting */
+    for (i = 0; i < TEST_COLLECT_ITERATIONS; i++) {
+        g_autoptr(virDomainDef) def = NULL;
+        virDomainObj *vm;
+
+        if (!(def = virDomainDefNew(xmlopt)))
+            goto join;
+
+        def->virtType = VIR_DOMAIN_VIRT_TEST;
+        def->name = g_strdup("writer");
+        if (virUUIDParse("ffffffff-0000-0000-0000-000000000000", def->uuid) < 0)
+            goto join;
+
+        if (!(vm = virDomainObjListAdd(data.doms, &def, xmlopt, 0, NULL)))
+            goto join;
+
+        virDomainObjListRemove(data.doms, vm);
+        virDomainObjEndAPI(&vm);
+    }
+
+    ret = 0;
+
+ join:
+    for (i = 0; i < nreaders; i++)
+        virThreadJoin(&readers[i]);
+
+    VIR_TEST_DEBUG("%zu domains, %d readers: %.3f ms",
+                   data.ndoms, TEST_COLLECT_READERS,
+                   (double)(g_get_monotonic_time() - start) / 1000);
+
+    if (g_atomic_int_get(&data.readerFailed)) {
+        fprintf(stderr, "reader collected unexpected number of domains\n");
+        ret = -1;
+    }
+
+ cleanup:
+    virObjectUnref(data.doms);
+    return ret;
+}
+
+
+struct testLoadAllData {
+    const char *dir;
+    size_t ndoms;
+    unsigned int nworkers;
+};
+
+
+static int
+testLoadAllConfigsPrepare(const char *dir,
+                          size_t ndoms)
+{
+    g_autofree char *broken = g_strdup_printf("%s/broken.xml", dir);
+    size_t i;
+
+    for (i = 0; i < ndoms; i++) {
+        g_autofree char *path = g_strdup_printf("%s/dom%zu.xml", dir, i);
+        g_autofree char *xml = NULL;
+
+        xml = g_strdup_printf("<domain type='qemu'>\n"
+                              "  <name>dom%zu</name>\n"
+                              "  <uuid>%08zx-0000-0000-0000-000000000000</uuid>\n"
+                              "  <memory unit='KiB'>219136</memory>\n"
+                              "  <vcpu placement='static'>1</vcpu>\n"
+                              "  <os>\n"
+                              "    <type arch='x86_64'>hvm</type>\n"
+                              "  </os>\n"
+                              "</domain>\n", i, i);
+
+        if (virFileWriteStr(path, xml, 0600) < 0)
+            return -1;
+    }
+
+    /* a broken config must not prevent loading of the others */
+    if (virFileWriteStr(broken, "<domain", 0600) < 0)
+        return -1;
+
+    return 0;
+}
+
+
+static int
+testLoadAllConfigs(const void *opaque)
+{
+    const struct testLoadAllData *data = opaque;
+    virDomainObjList *doms;
+    long long start;
+    int ret = -1;
+    size_t i;
+
+    if (!(doms = virDomainObjListNew()))
+        return -1;
+
+    start = g_get_monotonic_time();
+
+    if (virDomainObjListLoadAllConfigsFull(doms, data->dir, data->dir, false,
+                                           data->nworkers, xmlopt,
+                                           NULL, NULL) < 0)
+        goto cleanup;
+
+    VIR_TEST_DEBUG("%zu domains, %u workers: %.3f ms",
+                   data->ndoms, data->nworkers,
+                   (double)(g_get_monotonic_time() - start) / 1000);
+
+    if (virDomainObjListNumOfDomains(doms, false, NULL, NULL) != data->ndoms) {
+        fprintf(stderr, "expected %zu loaded domains\n", data->ndoms);
+        goto cleanup;
+    }
+
+    for (i = 0; i < data->ndoms; i++) {
+        g_autofree char *name = g_strdup_printf("dom%zu", i);
+        virDomainObj *vm;
+
+        if (!(vm = virDomainObjListFindByName(doms, name))) {
+            fprintf(stderr, "domain '%s' not loaded\n", name);
+            goto cleanup;
+        }
+
+        if (!vm->persistent) {
+            fprintf(stderr, "domain '%s' not persistent\n", name);
+            virDomainObjEndAPI(&vm);
+            goto cleanup;
+        }
+
+        virDomainObjEndAPI(&vm);
+    }
+
+    ret = 0;
+
+ cleanup:
+    virObjectUnref(doms);
+    return ret;
+}
+
+
+#define SCRATCHDIRTEMPLATE abs_builddir "/virdomainobjlistdir-XXXXXX"
+#define TEST_LOAD_DOMAINS 200
+
+static int
+mymain(void)
+{
+    char scratchdir[] = SCRATCHDIRTEMPLATE;
+    int ret = 0;
+
+    if (!(xmlopt = virTestGenericDomainXMLConfInit()))
+        return EXIT_FAILURE;
+
+#define DO_TEST_FIND_BY_ID(count) \
+    do { \
+        struct testFindByIDData data = { .ndoms = count }; \
+        if (virTestRun("Find by ID " #count, testFindByID, &data) < 0) \
+            ret = -1; \
+    } while (0)
+
+    DO_TEST_FIND_BY_ID(10);
+
+    /* Lookups of unused IDs and of stopped domains scan the whole
+     * list, which takes long with many domains */
+    if (virTestGetExpensive()) {
+        DO_TEST_FIND_BY_ID(1000);
+        DO_TEST_FIND_BY_ID(10000);
+    }
+
+#define DO_TEST_COLLECT(count) \
+    do { \
+        size_t ndoms = count; \
+        if (virTestRun("Collect contention " #count, \
+                       testCollectContention, &ndoms) < 0) \
+            ret = -1; \
+    } while (0)
+
+    DO_TEST_COLLECT(10);
+    DO_TEST_COLLECT(1000);
+
+    if (!g_mkdtemp(scratchdir)) {
+        fprintf(stderr, "Cannot create virdomainobjlistdir");
+        abort();
+    }
+
+    if (testLoadAllConfigsPrepare(scratchdir, TEST_LOAD_DOMAINS) < 0)
+        ret = -1;
+
+#define DO_TEST_LOAD(workers) \
+    do { \
+        struct testLoadAllData data = { .dir = scratchdir, \
+                                        .ndoms = TEST_LOAD_DOMAINS, \
+                                        .nworkers = workers }; \
+        if (virTestRun("Load all configs " #workers, \
+                       testLoadAllConfigs, &data) < 0) \
+            ret = -1; \
+    } while (0)
+
+    DO_TEST_LOAD(0);
+    DO_TEST_LOAD(1);
+    DO_TEST_LOAD(4);
+
+#define DO_TEST_LOAD_BENCH(path, count, workers) \
+    do { \
+        struct testLoadAllData data = { .dir = path, \
+                                        .ndoms = count, \
+                                        .nworkers = workers }; \
+        if (virTestRun("Load " #count " configs " #workers, \
+                       testLoadAllConfigs, &data) < 0) \
+            ret = -1; \
+    } while (0)
+
+    /* Daemon startup with thousands of definitions. Run with
+     * VIR_TEST_DEBUG=1 to see the timing. */
+    if (virTestGetExpensive()) {
+        g_autofree char *dir1k = g_strdup_printf("%s/1k", scratchdir);
+        g_autofree char *dir5k = g_strdup_printf("%s/5k", scratchdir);
+
+        if (g_mkdir_with_parents(dir1k, 0777) < 0 ||
+            g_mkdir_with_parents(dir5k, 0777) < 0 ||
+            testLoadAllConfigsPrepare(dir1k, 1000) < 0 ||
+            testLoadAllConfigsPrepare(dir5k, 5000) < 0) {
+            fprintf(stderr, "Cannot prepare configs for the load benchmark\n");
+            ret = -1;
+        } else {
+            DO_TEST_LOAD_BENCH(dir1k, 1000, 1);
+            DO_TEST_LOAD_BENCH(dir1k, 1000, 4);
+            DO_TEST_LOAD_BENCH(dir5k, 5000, 1);
+            DO_TEST_LOAD_BENCH(dir5k, 5000, 4);
+        }
+    }
+
+    if (getenv("LIBVIRT_SKIP_CLEANUP") == NULL)
+        virFileDeleteTree(scratchdir);
+
+    virObjectUnref(xmlopt);
+
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+VIR_TEST_MAIN(mymain)
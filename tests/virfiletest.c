@@ -19,10 +19,12 @@
 #include <config.h>
 
 #include <fcntl.h>
+#include <signal.h>
 #include <unistd.h>
 
 #include "testutils.h"
 #include "virfile.h"
+#include "virthread.h"
 
 #ifdef __linux__
 # include <linux/falloc.h>
@@ -329,6 +331,215 @@ testFileIsSharedFSType(const void *opaque G_GNUC_UNUSED)
 }
 
 
+#ifndef WIN32
+/* Not a multiple of any buffer size on purpose */
+# define TEST_DISK_COPY_PATTERN_LEN (1024 * 1024 + 17)
+
+struct testFileDiskCopyStream {
+    int fd;
+    const char *pattern;
+    unsigned long long size;
+    bool feed;
+    bool closeFd; /* when done feeding, to signal the end of the data */
+    int ret;
+};
+
+/* Writes @size bytes of the repeated pattern to @fd, or reads them and
+ * checks they match it when not feeding */
+static void
+testFileDiskCopyStreamFunc(void *opaque)
+{
+    struct testFileDiskCopyStream *data = opaque;
+    g_autofree char *buf = g_new0(char, 64 * 1024);
+    unsigned long long done = 0;
+
+    data->ret = -1;
+
+    if (data->feed) {
+        while (done < data->size) {
+            size_t offset = done % TEST_DISK_COPY_PATTERN_LEN;
+            size_t len = MIN(data->size - done, TEST_DISK_COPY_PATTERN_LEN - offset);
+
+            if (safewrite(data->fd, data->pattern + offset, len) < 0) {
+                fprintf(stderr, "Unable to write data (errno=%d)\n", errno);
+                break;
+            }
+            done += len;
+        }
+
+        if (data->closeFd)
+            VIR_FORCE_CLOSE(data->fd);
+        if (done != data->size)
+            return;
+    } else {
+        ssize_t got;
+
+        while ((got = saferead(data->fd, buf, 64 * 1024)) > 0) {
+            ssize_t i;
+
+            for (i = 0; i < got; i++) {
+                if (buf[i] != data->pattern[(done + i) % TEST_DISK_COPY_PATTERN_LEN]) {
+                    fprintf(stderr, "Unexpected data at offset %llu\n", done + i);
+                    return;
+                }
+            }
+            done += got;
+        }
+
+        if (got < 0) {
+            fprintf(stderr, "Unable to read data (errno=%d)\n", errno);
+            return;
+        }
+        if (done != data->size) {
+            fprintf(stderr, "Expected %llu bytes, got %llu\n", data->size, done);
+            return;
+        }
+    }
+
+    data->ret = 0;
+}
+
+
+struct testFileDiskCopyData {
+    bool toDisk;
+    unsigned long long size;
+    size_t buflen;
+    unsigned int queueDepth;
+    bool direct; /* open the file with O_DIRECT */
+};
+
+/*
+ * Copies data between a file and a pipe, in the direction used when
+ * saving a domain (toDisk) or when restoring it. With O_DIRECT the last
+ * read of an unaligned file is short and the last write is padded and
+ * then truncated to the size of the data, which the content check
+ * verifies.
+ */
+static int
+testFileDiskCopy(const void *opaque)
+{
+    const struct testFileDiskCopyData *data = opaque;
+    char path[] = abs_builddir "/virfiletest-diskcopy.XXXXXX";
+    g_autofree char *pattern = g_new0(char, TEST_DISK_COPY_PATTERN_LEN);
+    g_autoptr(GRand) rand = g_rand_new_with_seed(42);
+    struct testFileDiskCopyStream stream = { -1, pattern, data->size, false, false, -1 };
+    VIR_AUTOCLOSE fd = -1;
+    int fds[2] = { -1, -1 };
+    int directFlag = 0;
+    virThread thread;
+    bool threadRunning = false;
+    gint64 start;
+    double elapsed;
+    size_t i;
+    int ret = -1;
+
+    if (data->direct) {
+# ifdef O_DIRECT
+        directFlag = O_DIRECT;
+# else
+        return EXIT_AM_SKIP;
+# endif
+    }
+
+    for (i = 0; i < TEST_DISK_COPY_PATTERN_LEN; i++)
+        pattern[i] = g_rand_int(rand);
+
+    if ((fd = g_mkstemp_full(path, O_RDWR | O_CLOEXEC, S_IRUSR | S_IWUSR)) < 0)
+        return -1;
+
+    if (virPipe(fds) < 0)
+        goto cleanup;
+
+    if (!data->toDisk) {
+        stream.fd = fd;
+        stream.feed = true;
+        testFileDiskCopyStreamFunc(&stream);
+        if (stream.ret < 0)
+            goto cleanup;
+        VIR_FORCE_CLOSE(fd);
+
+        if ((fd = open(path, O_RDONLY | O_CLOEXEC | directFlag)) < 0) {
+            /* The filesystem of the build directory may not support it */
+            if (data->direct && errno == EINVAL)
+                ret = EXIT_AM_SKIP;
+            goto cleanup;
+        }
+
+        stream.fd = fds[0];
+        stream.feed = false;
+    } else {
+        VIR_FORCE_CLOSE(fd);
+
+        if ((fd = open(path, O_WRONLY | O_CLOEXEC | directFlag)) < 0) {
+            if (data->direct && errno == EINVAL)
+                ret = EXIT_AM_SKIP;
+            goto cleanup;
+        }
+
+        /* Owned by the thread from now on */
+        stream.fd = fds[1];
+        fds[1] = -1;
+        stream.feed = true;
+        stream.closeFd = true;
+    }
+
+    if (virThreadCreate(&thread, true, testFileDiskCopyStreamFunc, &stream) < 0)
+        goto cleanup;
+    threadRunning = true;
+
+    start = g_get_monotonic_time();
+
+    /* This always closes the file */
+    if (virFileDiskCopyFull(fd, path, data->toDisk ? fds[0] : fds[1], "pipe",
+                            data->buflen, data->queueDepth) < 0) {
+        fd = -1;
+        goto cleanup;
+    }
+    fd = -1;
+
+    elapsed = (g_get_monotonic_time() - start) / 1000000.0;
+
+    /* Let the reading side see the end of the data */
+    if (!data->toDisk)
+        VIR_FORCE_CLOSE(fds[1]);
+
+    virThreadJoin(&thread);
+    threadRunning = false;
+    if (stream.ret < 0)
+        goto cleanup;
+
+    VIR_TEST_DEBUG("%s %llu MiB with depth %u%s: %.2f GB/s",
+                   data->toDisk ? "saved" : "restored", data->size / 1024 / 1024,
+                   data->queueDepth, data->direct ? " and O_DIRECT" : "",
+                   data->size / elapsed / 1e9);
+
+    if (data->toDisk) {
+        if ((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0)
+            goto cleanup;
+
+        stream.fd = fd;
+        stream.feed = false;
+        stream.closeFd = false;
+        testFileDiskCopyStreamFunc(&stream);
+        if (stream.ret < 0)
+            goto cleanup;
+    }
+
+    ret = 0;
+
+ cleanup:
+    /* Closing our end unblocks the thread in case the copy failed midway */
+    VIR_FORCE_CLOSE(fds[data->toDisk ? 0 : 1]);
+    if (threadRunning)
+        virThreadJoin(&thread);
+    VIR_FORCE_CLOSE(fds[0]);
+    VIR_FORCE_CLOSE(fds[1]);
+    unlink(path);
+    return ret;
+}
+#endif /* WIN32 */
+
+
 static int
 mymain(void)
 {
@@ -439,6 +650,61 @@ mymain(void)
     DO_TEST_FILE_IS_SHARED_FS_TYPE("mounts3.txt", "/gpfs/data", true);
     DO_TEST_FILE_IS_SHARED_FS_TYPE("mounts3.txt", "/quobyte", true);
 
+#ifndef WIN32
+# define DO_TEST_DISK_COPY_FULL(toDisk, size, buflen, queueDepth, direct) \
+    do { \
+        struct testFileDiskCopyData data = { toDisk, size, buflen, queueDepth, \
+                                             direct }; \
+        if (virTestRun(virTestCounterNext(), testFileDiskCopy, &data) < 0) \
+            ret = -1; \
+    } while (0)
+
+# define DO_TEST_DISK_COPY(toDisk, size, buflen, queueDepth) \
+    DO_TEST_DISK_COPY_FULL(toDisk, size, buflen, queueDepth, false)
+
+# define DO_TEST_DISK_COPY_DIRECT(toDisk, size, buflen, queueDepth) \
+    DO_TEST_DISK_COPY_FULL(toDisk, size, buflen, queueDepth, true)
+
+    /* A failed copy leaves the thread feeding a closed pipe */
+    signal(SIGPIPE, SIG_IGN);
+
+    virTestCounterReset("testFileDiskCopy ");
+    DO_TEST_DISK_COPY(true, 0, 0, 1);
+    DO_TEST_DISK_COPY(false, 0, 0, 0);
+    DO_TEST_DISK_COPY(true, 5 * 1024 * 1024 + 123, 0, 1);
+    DO_TEST_DISK_COPY(false, 5 * 1024 * 1024 + 123, 0, 1);
+    DO_TEST_DISK_COPY(true, 5 * 1024 * 1024 + 123, 0, 0);
+    DO_TEST_DISK_COPY(false, 5 * 1024 * 1024 + 123, 0, 0);
+    DO_TEST_DISK_COPY(true, 3 * 1024 * 1024, 64 * 1024, 4);
+    DO_TEST_DISK_COPY(false, 3 * 1024 * 1024, 64 * 1024, 4);
+
+    /* Sizes not aligned to the buffers end with a short read or a padded
+     * write which has to be truncated */
+    virTestCounterReset("testFileDiskCopyDirect ");
+    DO_TEST_DISK_COPY_DIRECT(true, 0, 0, 1);
+    DO_TEST_DISK_COPY_DIRECT(false, 0, 0, 0);
+    DO_TEST_DISK_COPY_DIRECT(true, 5 * 1024 * 1024 + 123, 0, 1);
+    DO_TEST_DISK_COPY_DIRECT(false, 5 * 1024 * 1024 + 123, 0, 1);
+    DO_TEST_DISK_COPY_DIRECT(true, 5 * 1024 * 1024 + 123, 0, 0);
+    DO_TEST_DISK_COPY_DIRECT(false, 5 * 1024 * 1024 + 123, 0, 0);
+    DO_TEST_DISK_COPY_DIRECT(true, 3 * 1024 * 1024 + 17, 64 * 1024, 4);
+    DO_TEST_DISK_COPY_DIRECT(false, 3 * 1024 * 1024 + 17, 64 * 1024, 4);
+    DO_TEST_DISK_COPY_DIRECT(true, 4 * 1024 * 1024, 64 * 1024, 4);
+    DO_TEST_DISK_COPY_DIRECT(false, 4 * 1024 * 1024, 64 * 1024, 4);
+
+    if (virTestGetExpensive()) {
+        unsigned long long size = 1024ULL * 1024 * 1024;
+
+        virTestCounterReset("benchmarkFileDiskCopy ");
+        DO_TEST_DISK_COPY(true, size, 0, 1);
+        DO_TEST_DISK_COPY(false, size, 0, 1);
+        DO_TEST_DISK_COPY(true, size, 0, 8);
+        DO_TEST_DISK_COPY(false, size, 0, 8);
+        DO_TEST_DISK_COPY(true, size, 4 * 1024 * 1024, 32);
+        DO_TEST_DISK_COPY(false, size, 4 * 1024 * 1024, 32);
+    }
+#endif /* WIN32 */
+
     return ret != 0 ? EXIT_FAILURE : EXIT_SUCCESS;
 }
 
@@ -4,6 +4,8 @@
 
 #include "internal.h"
 #include "virjson.h"
+#include "virfile.h"
+#include "virstring.h"
 #include "testutils.h"
 
 #define VIR_FROM_THIS VIR_FROM_NONE
@@ -468,6 +470,189 @@ testJSONObjectFormatSteal(const void *opaque G_GNUC_UNUSED)
 }
 
 
+/* Feeds @doc into virJSONParser in chunks of @chunk bytes and returns
+ * the first parsed value in @value. */
+static int
+testJSONParserParse(const char *doc,
+                    size_t chunk,
+                    virJSONValue **value)
+{
+    g_autoptr(virJSONParser) parser = virJSONParserNew();
+    size_t len = strlen(doc);
+    size_t off = 0;
+    size_t consumed;
+    int rc;
+
+    while (off < len) {
+        rc = virJSONParserFeed(parser, doc + off, MIN(chunk, len - off),
+                               &consumed, value);
+        off += consumed;
+
+        if (rc < 0)
+            return -1;
+
+        if (rc == 1)
+            return 0;
+    }
+
+    /* top level numbers and literals need a delimiter to be complete */
+    if (virJSONParserFeed(parser, " ", 1, &consumed, value) == 1)
+        return 0;
+
+    return -1;
+}
+
+
+static int
+testJSONParser(const void *data)
+{
+    const struct testInfo *info = data;
+    const char *expectstr = info->expect ? info->expect : info->doc;
+    size_t chunks[] = { 1, 3, 4096 };
+    size_t i;
+
+    for (i = 0; i < G_N_ELEMENTS(chunks); i++) {
+        g_autoptr(virJSONValue) json = NULL;
+        g_autofree char *formatted = NULL;
+
+        if (testJSONParserParse(info->doc, chunks[i], &json) < 0) {
+            if (info->pass) {
+                VIR_TEST_VERBOSE("Failed to parse %s", info->doc);
+                return -1;
+            }
+            continue;
+        }
+
+        if (!info->pass) {
+            VIR_TEST_VERBOSE("Unexpected success while parsing %s", info->doc);
+            return -1;
+        }
+
+        if (!(formatted = virJSONValueToString(json, false)))
+            return -1;
+
+        if (virTestCompareToString(expectstr, formatted) < 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+
+/* Parses the whitespace separated QMP messages of a .replies file in
+ * chunks, as the monitor would read them, and compares the result with
+ * the output of virJSONValueFromString of the individual messages. */
+static int
+testJSONParserReplies(const void *data)
+{
+    const char *name = data;
+    g_autofree char *infile = NULL;
+    g_autofree char *indata = NULL;
+    g_autoptr(virJSONParser) parser = virJSONParserNew();
+    size_t chunks[] = { 7, 4096 };
+    long long parseTime = 0;
+    long long refTime = 0;
+    size_t nvalues = 0;
+    size_t len;
+    size_t i;
+
+    infile = g_strdup_printf("%s/qemucapabilitiesdata/%s", abs_srcdir, name);
+
+    if (virTestLoadFile(infile, &indata) < 0)
+        return -1;
+
+    len = strlen(indata);
+
+    for (i = 0; i < G_N_ELEMENTS(chunks); i++) {
+        size_t start = 0;
+        size_t off = 0;
+
+        nvalues = 0;
+
+        while (off < len) {
+            g_autoptr(virJSONValue) value = NULL;
+            g_autoptr(virJSONValue) expect = NULL;
+            g_autofree char *text = NULL;
+            g_autofree char *actualstr = NULL;
+            g_autofree char *expectstr = NULL;
+            long long now = g_get_monotonic_time();
+            size_t consumed;
+            int rc;
+
+            rc = virJSONParserFeed(parser, indata + off,
+                                   MIN(chunks[i], len - off),
+                                   &consumed, &value);
+            off += consumed;
+            parseTime += g_get_monotonic_time() - now;
+
+            if (rc < 0)
+                return -1;
+
+            if (rc == 0)
+                continue;
+
+            nvalues++;
+            text = g_strndup(indata + start, off - start);
+            start = off;
+
+            now = g_get_monotonic_time();
+            expect = virJSONValueFromString(text);
+            refTime += g_get_monotonic_time() - now;
+
+            if (!expect ||
+                !(actualstr = virJSONValueToString(value, false)) ||
+                !(expectstr = virJSONValueToString(expect, false)))
+                return -1;
+
+            if (virTestCompareToString(expectstr, actualstr) < 0)
+                return -1;
+        }
+
+        if (!virJSONParserIsIdle(parser)) {
+            VIR_TEST_VERBOSE("Incomplete message at the end of %s", name);
+            return -1;
+        }
+    }
+
+    VIR_TEST_DEBUG("%s: %zu messages, %zu bytes: parser %.3f ms, virJSONValueFromString %.3f ms",
+                   name, nvalues, len,
+                   (double)parseTime / (1000 * G_N_ELEMENTS(chunks)),
+                   (double)refTime / (1000 * G_N_ELEMENTS(chunks)));
+
+    return 0;
+}
+
+
+static int
+testJSONParserRepliesAll(void)
+{
+    const char *dirname = abs_srcdir "/qemucapabilitiesdata";
+    g_autoptr(DIR) dir = NULL;
+    struct dirent *ent;
+    int ret = 0;
+    int rc;
+
+    if (virDirOpen(&dir, dirname) < 0)
+        return -1;
+
+    while ((rc = virDirRead(dir, &ent, dirname)) > 0) {
+        g_autofree char *testname = NULL;
+
+        if (!virStringHasSuffix(ent->d_name, ".replies"))
+            continue;
+
+        testname = g_strdup_printf("parser %s", ent->d_name);
+        if (virTestRun(testname, testJSONParserReplies, ent->d_name) < 0)
+            ret = -1;
+    }
+
+    if (rc < 0)
+        return -1;
+
+    return ret;
+}
+
+
 static int
 mymain(void)
 {
@@ -607,6 +792,46 @@ mymain(void)
     DO_TEST_DEFLATTEN("qemu-sheepdog", true);
     DO_TEST_DEFLATTEN("dotted-array", true);
 
+#define DO_TEST_PARSER(name, doc, expect) \
+    DO_TEST_FULL("parser " name, Parser, doc, expect, true)
+
+#define DO_TEST_PARSER_FAIL(name, doc) \
+    DO_TEST_FULL("parser " name, Parser, doc, NULL, false)
+
+    DO_TEST_PARSER("object", "{\"a\": [1, -2.5e3, true, false, null], \"b\": {}}",
+                   "{\"a\":[1,-2.5e3,true,false,null],\"b\":{}}");
+    DO_TEST_PARSER("number", "1234", NULL);
+    DO_TEST_PARSER("literal", "null", NULL);
+    DO_TEST_PARSER("string", "\"The meaning of life\"", NULL);
+    DO_TEST_PARSER("escaping symbols", "[\"\\\"\\t\\n\\\\\"]", NULL);
+    DO_TEST_PARSER("unicode escapes", "[\"\\u00e9\\ud83d\\ude00\"]",
+                   "[\"\xc3\xa9\xf0\x9f\x98\x80\"]");
+    DO_TEST_PARSER("duplicate key", "{\"a\": 1, \"b\": 2, \"a\": 3}",
+                   "{\"a\":3,\"b\":2}");
+    DO_TEST_PARSER("duplicate key large object",
+                   "{\"a\":0,\"b\":1,\"c\":2,\"d\":3,\"e\":4,\"f\":5,\"g\":6,"
+                   "\"h\":7,\"i\":8,\"j\":9,\"k\":10,\"l\":11,\"m\":12,\"n\":13,"
+                   "\"o\":14,\"p\":15,\"q\":16,\"r\":17,\"b\":18,\"q\":19}",
+                   "{\"a\":0,\"b\":18,\"c\":2,\"d\":3,\"e\":4,\"f\":5,\"g\":6,"
+                   "\"h\":7,\"i\":8,\"j\":9,\"k\":10,\"l\":11,\"m\":12,\"n\":13,"
+                   "\"o\":14,\"p\":15,\"q\":19,\"r\":17}");
+    DO_TEST_PARSER("NUL escape", "[\"ab\\u0000cd\"]", "[\"ab\"]");
+    DO_TEST_PARSER_FAIL("nothing", "");
+    DO_TEST_PARSER_FAIL("number with garbage", "[ 2345b45 ]");
+    DO_TEST_PARSER_FAIL("float with garbage", "[ 0.0314159ee+100 ]");
+    DO_TEST_PARSER_FAIL("leading zero", "[ 01 ]");
+    DO_TEST_PARSER_FAIL("unterminated string", "[ \"The meaning of lif ]");
+    DO_TEST_PARSER_FAIL("overdone keyword", "[ truest ]");
+    DO_TEST_PARSER_FAIL("trailing comma", "[ 1, ]");
+    DO_TEST_PARSER_FAIL("missing comma", "[ 1 2 ]");
+    DO_TEST_PARSER_FAIL("object with numeric keys", "{ 1:1, 2:1, 3:2 }");
+    DO_TEST_PARSER_FAIL("control character", "[ \"a\nb\" ]");
+    DO_TEST_PARSER_FAIL("lone surrogate", "[ \"\\ud83d\" ]");
+    DO_TEST_PARSER_FAIL("invalid UTF-8", "\"\x80\"");
+
+    if (testJSONParserRepliesAll() < 0)
+        ret = -1;
+
     return (ret == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
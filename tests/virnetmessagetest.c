@@ -99,8 +99,7 @@ static int testMessageHeaderDecode(const void *args G_GNUC_UNUSED)
     if (!msg)
         return -1;
 
-    msg->bufferLength = 4;
-    msg->buffer = g_new0(char, msg->bufferLength);
+    virNetMessageResizeBuffer(msg, 4);
     memcpy(msg->buffer, input_buf, msg->bufferLength);
 
     msg->header.prog = 0x11223344;
@@ -324,8 +323,7 @@ static int testMessagePayloadDecode(const void *args G_GNUC_UNUSED)
     if (!msg)
         return -1;
 
-    msg->bufferLength = 4;
-    msg->buffer = g_new0(char, msg->bufferLength);
+    virNetMessageResizeBuffer(msg, 4);
     memcpy(msg->buffer, input_buffer, msg->bufferLength);
 
     if (virNetMessageDecodeLength(msg) < 0) {
@@ -511,6 +509,281 @@ static int testMessagePayloadStreamEncode(const void *args G_GNUC_UNUSED)
 }
 
 
+static int testMessagePayloadStreamReserve(const void *args G_GNUC_UNUSED)
+{
+    char stream[] = "The quick brown fox jumps over the lazy dog";
+    virNetMessage *msg = virNetMessageNew(true);
+    static const char expect[] = {
+        0x00, 0x00, 0x00, 0x47,  /* Length */
+        0x11, 0x22, 0x33, 0x44,  /* Program */
+        0x00, 0x00, 0x00, 0x01,  /* Version */
+        0x00, 0x00, 0x06, 0x66,  /* Procedure */
+        0x00, 0x00, 0x00, 0x03,  /* Type */
+        0x00, 0x00, 0x00, 0x99,  /* Serial */
+        0x00, 0x00, 0x00, 0x02,  /* Status */
+
+        'T', 'h', 'e', ' ',
+        'q', 'u', 'i', 'c',
+        'k', ' ', 'b', 'r',
+        'o', 'w', 'n', ' ',
+        'f', 'o', 'x', ' ',
+        'j', 'u', 'm', 'p',
+        's', ' ', 'o', 'v',
+        'e', 'r', ' ', 't',
+        'h', 'e', ' ', 'l',
+        'a', 'z', 'y', ' ',
+        'd', 'o', 'g',
+    };
+    char *data;
+    int ret = -1;
+
+    if (!msg)
+        return -1;
+
+    msg->header.prog = 0x11223344;
+    msg->header.vers = 0x01;
+    msg->header.proc = 0x666;
+    msg->header.type = VIR_NET_STREAM;
+    msg->header.serial = 0x99;
+    msg->header.status = VIR_NET_CONTINUE;
+
+    if (virNetMessageEncodeHeader(msg) < 0)
+        goto cleanup;
+
+    /* Reserve the largest chunk but produce less data, as a stream
+     * read from a short file would */
+    if (!(data = virNetMessageReservePayloadRaw(msg,
+                                                VIR_NET_MESSAGE_STREAM_PAYLOAD_MAX)))
+        goto cleanup;
+
+    if (msg->bufferLength < msg->bufferOffset + VIR_NET_MESSAGE_STREAM_PAYLOAD_MAX) {
+        VIR_DEBUG("Expect message length at least %zu got %zu",
+                  msg->bufferOffset + VIR_NET_MESSAGE_STREAM_PAYLOAD_MAX,
+                  msg->bufferLength);
+        goto cleanup;
+    }
+
+    memcpy(data, stream, strlen(stream));
+
+    if (virNetMessageCommitPayloadRaw(msg, strlen(stream)) < 0)
+        goto cleanup;
+
+    if (G_N_ELEMENTS(expect) != msg->bufferLength) {
+        VIR_DEBUG("Expect message length %zu got %zu",
+                  sizeof(expect), msg->bufferLength);
+        goto cleanup;
+    }
+
+    if (msg->bufferOffset != 0) {
+        VIR_DEBUG("Expect message offset 0 got %zu",
+                  msg->bufferOffset);
+        goto cleanup;
+    }
+
+    if (memcmp(expect, msg->buffer, sizeof(expect)) != 0) {
+        virTestDifferenceBin(stderr, expect, msg->buffer, sizeof(expect));
+        goto cleanup;
+    }
+
+    ret = 0;
+ cleanup:
+    virNetMessageFree(msg);
+    return ret;
+}
+
+
+static int testMessagePayloadStreamLarge(const void *args G_GNUC_UNUSED)
+{
+    virNetMessage *msg = virNetMessageNew(true);
+    virNetMessage *rmsg = virNetMessageNew(true);
+    size_t headerLen;
+    char *data;
+    size_t i;
+    int ret = -1;
+
+    if (!msg || !rmsg)
+        goto cleanup;
+
+    msg->header.prog = 0x11223344;
+    msg->header.vers = 0x01;
+    msg->header.proc = 0x666;
+    msg->header.type = VIR_NET_STREAM;
+    msg->header.serial = 0x99;
+    msg->header.status = VIR_NET_CONTINUE;
+
+    if (virNetMessageEncodeHeader(msg) < 0)
+        goto cleanup;
+
+    headerLen = msg->bufferOffset;
+
+    if (!(data = virNetMessageReservePayloadRaw(msg,
+                                                VIR_NET_MESSAGE_STREAM_PAYLOAD_MAX)))
+        goto cleanup;
+
+    for (i = 0; i < VIR_NET_MESSAGE_STREAM_PAYLOAD_MAX; i++)
+        data[i] = i % 251;
+
+    if (virNetMessageCommitPayloadRaw(msg, VIR_NET_MESSAGE_STREAM_PAYLOAD_MAX) < 0)
+        goto cleanup;
+
+    if (msg->bufferLength != headerLen + VIR_NET_MESSAGE_STREAM_PAYLOAD_MAX) {
+        VIR_DEBUG("Expect message length %zu got %zu",
+                  headerLen + VIR_NET_MESSAGE_STREAM_PAYLOAD_MAX,
+                  msg->bufferLength);
+        goto cleanup;
+    }
+
+    /* Feed the message to the receiving side the way virnetclient and
+     * virnetserverclient do: length word first, then the rest */
+    virNetMessageResizeBuffer(rmsg, VIR_NET_MESSAGE_LEN_MAX);
+    memcpy(rmsg->buffer, msg->buffer, rmsg->bufferLength);
+
+    if (virNetMessageDecodeLength(rmsg) < 0)
+        goto cleanup;
+
+    if (rmsg->bufferLength != msg->bufferLength) {
+        VIR_DEBUG("Expect decoded length %zu got %zu",
+                  msg->bufferLength, rmsg->bufferLength);
+        goto cleanup;
+    }
+
+    memcpy(rmsg->buffer, msg->buffer, rmsg->bufferLength);
+
+    if (virNetMessageDecodeHeader(rmsg) < 0)
+        goto cleanup;
+
+    if (rmsg->header.type != VIR_NET_STREAM ||
+        rmsg->header.status != VIR_NET_CONTINUE ||
+        rmsg->header.serial != 0x99) {
+        VIR_DEBUG("Unexpected header type %d status %d serial %u",
+                  rmsg->header.type, rmsg->header.status, rmsg->header.serial);
+        goto cleanup;
+    }
+
+    if (rmsg->bufferLength - rmsg->bufferOffset != VIR_NET_MESSAGE_STREAM_PAYLOAD_MAX) {
+        VIR_DEBUG("Expect payload length %d got %zu",
+                  VIR_NET_MESSAGE_STREAM_PAYLOAD_MAX,
+                  rmsg->bufferLength - rmsg->bufferOffset);
+        goto cleanup;
+    }
+
+    for (i = 0; i < VIR_NET_MESSAGE_STREAM_PAYLOAD_MAX; i++) {
+        if (rmsg->buffer[rmsg->bufferOffset + i] != (char)(i % 251)) {
+            VIR_DEBUG("Payload differs at offset %zu", i);
+            goto cleanup;
+        }
+    }
+
+    ret = 0;
+ cleanup:
+    virNetMessageFree(rmsg);
+    virNetMessageFree(msg);
+    return ret;
+}
+
+
+static int testMessagePayloadStreamReserveTooLarge(const void *args G_GNUC_UNUSED)
+{
+    virNetMessage *msg = virNetMessageNew(true);
+    int ret = -1;
+
+    if (!msg)
+        return -1;
+
+    msg->header.prog = 0x11223344;
+    msg->header.vers = 0x01;
+    msg->header.proc = 0x666;
+    msg->header.type = VIR_NET_STREAM;
+    msg->header.serial = 0x99;
+    msg->header.status = VIR_NET_CONTINUE;
+
+    if (virNetMessageEncodeHeader(msg) < 0)
+        goto cleanup;
+
+    if (virNetMessageReservePayloadRaw(msg, VIR_NET_MESSAGE_MAX) != NULL) {
+        VIR_DEBUG("Reserving more than VIR_NET_MESSAGE_MAX succeeded");
+        goto cleanup;
+    }
+
+    if (virGetLastErrorCode() != VIR_ERR_RPC) {
+        VIR_DEBUG("Expect error %d got %d",
+                  VIR_ERR_RPC, virGetLastErrorCode());
+        goto cleanup;
+    }
+
+    virResetLastError();
+    ret = 0;
+ cleanup:
+    virNetMessageFree(msg);
+    return ret;
+}
+
+
+static int testMessageBufferPool(const void *args G_GNUC_UNUSED)
+{
+    virNetMessage *msg = virNetMessageNew(true);
+    virNetMessageBufferStats before;
+    virNetMessageBufferStats after;
+    g_autofree char *header = NULL;
+    int ret = -1;
+
+    msg->header.prog = 0x11223344;
+    msg->header.vers = 0x01;
+    msg->header.proc = 0x666;
+    msg->header.type = VIR_NET_CALL;
+    msg->header.serial = 0x99;
+    msg->header.status = VIR_NET_OK;
+
+    /* Make sure there's a buffer in the pool */
+    if (virNetMessageEncodeHeader(msg) < 0)
+        goto cleanup;
+    virNetMessageClear(msg);
+
+    virNetMessageGetBufferStats(&before);
+
+    if (virNetMessageEncodeHeader(msg) < 0)
+        goto cleanup;
+
+    virNetMessageGetBufferStats(&after);
+
+    if (after.hits != before.hits + 1 ||
+        after.misses != before.misses ||
+        after.inUse != before.inUse + 1 ||
+        after.cached != before.cached - 1) {
+        VIR_TEST_DEBUG("Buffer not reused from the pool");
+        goto cleanup;
+    }
+
+    /* Growing the buffer must preserve the encoded header */
+    header = g_new0(char, msg->bufferOffset);
+    memcpy(header, msg->buffer, msg->bufferOffset);
+
+    virNetMessageResizeBuffer(msg, VIR_NET_MESSAGE_INITIAL * 3);
+
+    if (msg->bufferLength != VIR_NET_MESSAGE_INITIAL * 3 ||
+        msg->bufferAlloc < msg->bufferLength ||
+        memcmp(header, msg->buffer, msg->bufferOffset) != 0) {
+        VIR_TEST_DEBUG("Resized buffer doesn't match");
+        goto cleanup;
+    }
+
+    virNetMessageClear(msg);
+
+    virNetMessageGetBufferStats(&after);
+
+    if (after.inUse != before.inUse) {
+        VIR_TEST_DEBUG("Expected %zu buffers in use, got %zu",
+                       before.inUse, after.inUse);
+        goto cleanup;
+    }
+
+    ret = 0;
+ cleanup:
+    virNetMessageFree(msg);
+    return ret;
+}
+
+
 static int
 mymain(void)
 {
@@ -520,6 +793,8 @@ mymain(void)
     signal(SIGPIPE, SIG_IGN);
 #endif /* WIN32 */
 
+    virTestQuiesceLibvirtErrors(false);
+
     if (virTestRun("Message Header Encode", testMessageHeaderEncode, NULL) < 0)
         ret = -1;
 
@@ -535,6 +810,19 @@ mymain(void)
     if (virTestRun("Message Payload Stream Encode", testMessagePayloadStreamEncode, NULL) < 0)
         ret = -1;
 
+    if (virTestRun("Message Payload Stream Reserve", testMessagePayloadStreamReserve, NULL) < 0)
+        ret = -1;
+
+    if (virTestRun("Message Payload Stream Large", testMessagePayloadStreamLarge, NULL) < 0)
+        ret = -1;
+
+    if (virTestRun("Message Payload Stream Reserve Too Large",
+                   testMessagePayloadStreamReserveTooLarge, NULL) < 0)
+        ret = -1;
+
+    if (virTestRun("Message Buffer Pool", testMessageBufferPool, NULL) < 0)
+        ret = -1;
+
     return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
@@ -0,0 +1,623 @@
+/*
+ * Copyright (C) 2025 Red Hat, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include "testutils.h"
+#include "virerror.h"
+#include "virevent.h"
+#include "virfile.h"
+#include "virthread.h"
+#include "rpc/virnetclient.h"
+#include "rpc/virnetserver.h"
+
+#define VIR_FROM_THIS VIR_FROM_RPC
+
+#ifndef WIN32
+
+# define TEST_PROGRAM 0x12345678
+# define TEST_VERSION 1
+# define TEST_PROC_ECHO 1
+# define TEST_PAYLOAD_LEN 1024
+
+typedef struct {
+    u_int len;
+    char *val;
+} testEchoData;
+
+static bool_t
+xdr_testEchoData(XDR *xdrs, testEchoData *objp)
+{
+    return xdr_bytes(xdrs, &objp->val, &objp->len, TEST_PAYLOAD_LEN);
+}
+
+
+static int
+testDispatchEcho(virNetServer *server G_GNUC_UNUSED,
+                 virNetServerClient *client G_GNUC_UNUSED,
+                 virNetMessage *msg G_GNUC_UNUSED,
+                 struct virNetMessageError *rerr G_GNUC_UNUSED,
+                 void *args,
+                 void *ret)
+{
+    testEchoData *in = args;
+    testEchoData *out = ret;
+
+    out->len = in->len;
+    out->val = g_memdup2(in->val, in->len);
+
+    return 0;
+}
+
+
+static virNetServerProgramProc testProcs[] = {
+    { 0 },
+    { .func = testDispatchEcho,
+      .arg_len = sizeof(testEchoData),
+      .arg_filter = (xdrproc_t)xdr_testEchoData,
+      .ret_len = sizeof(testEchoData),
+      .ret_filter = (xdrproc_t)xdr_testEchoData },
+};
+
+
+static void *
+testClientNew(virNetServerClient *client G_GNUC_UNUSED,
+              void *opaque G_GNUC_UNUSED)
+{
+    return g_new0(char, 1);
+}
+
+
+static void
+testClientFree(void *opaque)
+{
+    g_free(opaque);
+}
+
+
+static int testEventLoopQuit;
+
+static void
+testEventLoop(void *opaque G_GNUC_UNUSED)
+{
+    while (!g_atomic_int_get(&testEventLoopQuit)) {
+        if (virEventRunDefaultImpl() < 0)
+            break;
+    }
+}
+
+
+struct testClientData {
+    virThread thread;
+    int fd;
+    size_t ncalls;
+    int ret;
+};
+
+/* Issues calls one after another over a raw socket, checking replies */
+static void
+testClientRun(void *opaque)
+{
+    struct testClientData *data = opaque;
+    virNetMessage *msg = virNetMessageNew(false);
+    char payload[TEST_PAYLOAD_LEN];
+    size_t i;
+
+    memset(payload, 'x', sizeof(payload));
+    data->ret = -1;
+
+    for (i = 0; i < data->ncalls; i++) {
+        testEchoData args = { sizeof(payload), payload };
+        testEchoData reply = { 0 };
+
+        virNetMessageClear(msg);
+        msg->header.prog = TEST_PROGRAM;
+        msg->header.vers = TEST_VERSION;
+        msg->header.proc = TEST_PROC_ECHO;
+        msg->header.type = VIR_NET_CALL;
+        msg->header.serial = i;
+        msg->header.status = VIR_NET_OK;
+
+        if (virNetMessageEncodeHeader(msg) < 0 ||
+            virNetMessageEncodePayload(msg, (xdrproc_t)xdr_testEchoData,
+                                       &args) < 0)
+            goto cleanup;
+
+        if (safewrite(data->fd, msg->buffer, msg->bufferLength) < 0) {
+            fprintf(stderr, "Failed to send call: %s\n", g_strerror(errno));
+            goto cleanup;
+        }
+
+        virNetMessageClear(msg);
+        virNetMessageResizeBuffer(msg, VIR_NET_MESSAGE_LEN_MAX);
+
+        if (saferead(data->fd, msg->buffer, msg->bufferLength) != msg->bufferLength ||
+            virNetMessageDecodeLength(msg) < 0 ||
+            saferead(data->fd, msg->buffer + msg->bufferOffset,
+                     msg->bufferLength - msg->bufferOffset) !=
+            msg->bufferLength - msg->bufferOffset ||
+            virNetMessageDecodeHeader(msg) < 0) {
+            fprintf(stderr, "Failed to receive reply\n");
+            goto cleanup;
+        }
+
+        if (msg->header.type != VIR_NET_REPLY ||
+            msg->header.status != VIR_NET_OK ||
+            msg->header.serial != i) {
+            fprintf(stderr, "Unexpected reply type=%d status=%d serial=%u\n",
+                    msg->header.type, msg->header.status, msg->header.serial);
+            goto cleanup;
+        }
+
+        if (virNetMessageDecodePayload(msg, (xdrproc_t)xdr_testEchoData,
+                                       &reply) < 0)
+            goto cleanup;
+
+        if (reply.len != sizeof(payload) ||
+            memcmp(reply.val, payload, sizeof(payload)) != 0) {
+            fprintf(stderr, "Reply doesn't match the call\n");
+            xdr_free((xdrproc_t)xdr_testEchoData, (char *)&reply);
+            goto cleanup;
+        }
+        xdr_free((xdrproc_t)xdr_testEchoData, (char *)&reply);
+    }
+
+    data->ret = 0;
+
+ cleanup:
+    virNetMessageFree(msg);
+}
+
+
+struct testServerData {
+    size_t nclients;
+    size_t ncalls;
+    size_t niothreads;
+};
+
+/*
+ * Drives concurrent clients, each connected over a socket pair, against
+ * a server handling its clients either from the default event loop or
+ * from I/O threads.
+ */
+static int
+testServerClients(const void *opaque)
+{
+    const struct testServerData *data = opaque;
+    g_autoptr(virNetServer) srv = NULL;
+    virNetServerProgram *prog = NULL;
+    g_autofree struct testClientData *clients = NULL;
+    virThread loop;
+    bool loopRunning = false;
+    size_t nstarted = 0;
+    long long start = 0;
+    double elapsed;
+    size_t i;
+    int ret = -1;
+
+    clients = g_new0(struct testClientData, data->nclients);
+    for (i = 0; i < data->nclients; i++)
+        clients[i].fd = -1;
+
+    if (!(srv = virNetServerNew("test", 1, 4, 4, 0,
+                                data->nclients, 0, -1, 0,
+                                testClientNew, NULL, testClientFree, NULL)))
+        goto cleanup;
+
+    if (virNetServerSetIOThreads(srv, data->niothreads) < 0)
+        goto cleanup;
+
+    if (!(prog = virNetServerProgramNew(TEST_PROGRAM, TEST_VERSION,
+                                        testProcs, G_N_ELEMENTS(testProcs))))
+        goto cleanup;
+
+    virNetServerAddProgram(srv, prog);
+
+    for (i = 0; i < data->nclients; i++) {
+        g_autoptr(virNetSocket) sock = NULL;
+        g_autoptr(virNetServerClient) client = NULL;
+        g_autoptr(virIdentity) identity = virIdentityNew();
+        int sv[2];
+
+        if (socketpair(PF_UNIX, SOCK_STREAM, 0, sv) < 0) {
+            virReportSystemError(errno, "%s", "Cannot create socket pair");
+            goto cleanup;
+        }
+        clients[i].fd = sv[1];
+        clients[i].ncalls = data->ncalls;
+
+        if (virNetSocketNewConnectSockFD(sv[0], &sock) < 0) {
+            VIR_FORCE_CLOSE(sv[0]);
+            goto cleanup;
+        }
+
+        if (!(client = virNetServerClientNew(virNetServerNextClientID(srv),
+                                             sock, 0, false, 1, NULL,
+                                             testClientNew, NULL,
+                                             testClientFree, NULL)))
+            goto cleanup;
+
+        /* Avoid looking up the peer of the socket */
+        virNetServerClientSetIdentity(client, identity);
+
+        if (virNetServerAddClient(srv, client) < 0)
+            goto cleanup;
+    }
+
+    if (virThreadCreate(&loop, true, testEventLoop, NULL) < 0)
+        goto cleanup;
+    loopRunning = true;
+
+    start = g_get_monotonic_time();
+
+    for (nstarted = 0; nstarted < data->nclients; nstarted++) {
+        if (virThreadCreate(&clients[nstarted].thread, true,
+                            testClientRun, &clients[nstarted]) < 0)
+            goto cleanup;
+    }
+
+    ret = 0;
+
+ cleanup:
+    for (i = 0; i < nstarted; i++) {
+        virThreadJoin(&clients[i].thread);
+        if (clients[i].ret < 0)
+            ret = -1;
+    }
+
+    if (ret == 0) {
+        elapsed = (g_get_monotonic_time() - start) / 1000000.0;
+        VIR_TEST_DEBUG("%zu clients, %zu I/O threads: %zu calls in %.3fs (%.0f calls/s)",
+                       data->nclients, data->niothreads,
+                       data->nclients * data->ncalls, elapsed,
+                       data->nclients * data->ncalls / elapsed);
+    }
+
+    for (i = 0; i < data->nclients; i++)
+        VIR_FORCE_CLOSE(clients[i].fd);
+
+    virNetServerClose(srv);
+    virObjectUnref(prog);
+
+    if (loopRunning) {
+        g_atomic_int_set(&testEventLoopQuit, 1);
+        g_main_context_wakeup(NULL);
+        virThreadJoin(&loop);
+        g_atomic_int_set(&testEventLoopQuit, 0);
+    }
+
+    if (ret < 0)
+        virDispatchError(NULL);
+    return ret;
+}
+
+
+struct testPipelineData {
+    size_t ncalls;
+    size_t nthreads; /* threads issuing synchronous calls */
+    size_t depth; /* asynchronous calls in flight, if nthreads is 0 */
+};
+
+struct testPipelineState {
+    const struct testPipelineData *data;
+    virNetClient *client;
+    virNetClientProgram *prog;
+    char payload[TEST_PAYLOAD_LEN];
+
+    virMutex lock;
+    virCond cond;
+    unsigned serial;
+    size_t nsent;
+    size_t ndone;
+    bool failed;
+};
+
+struct testPipelineCall {
+    struct testPipelineState *state;
+    testEchoData reply;
+    virThread thread;
+    int ret;
+};
+
+static int testPipelineSend(struct testPipelineCall *call);
+
+static void
+testPipelineDone(int rv,
+                 void *opaque)
+{
+    struct testPipelineCall *call = opaque;
+    struct testPipelineState *state = call->state;
+    VIR_LOCK_GUARD lock = virLockGuardLock(&state->lock);
+
+    if (rv < 0 ||
+        call->reply.len != sizeof(state->payload) ||
+        memcmp(call->reply.val, state->payload, sizeof(state->payload)) != 0) {
+        fprintf(stderr, "Unexpected reply: %s\n", virGetLastErrorMessage());
+        state->failed = true;
+    }
+    xdr_free((xdrproc_t)xdr_testEchoData, (char *)&call->reply);
+    memset(&call->reply, 0, sizeof(call->reply));
+
+    state->ndone++;
+
+    /* Keep the same number of calls in flight */
+    if (!state->failed && state->nsent < state->data->ncalls &&
+        testPipelineSend(call) < 0)
+        state->failed = true;
+
+    if (state->ndone == state->nsent)
+        virCondSignal(&state->cond);
+}
+
+
+/* Must be called with state->lock held */
+static int
+testPipelineSend(struct testPipelineCall *call)
+{
+    struct testPipelineState *state = call->state;
+    testEchoData args = { sizeof(state->payload), state->payload };
+
+    if (virNetClientProgramCallAsync(state->prog, state->client,
+                                     state->serial++, TEST_PROC_ECHO,
+                                     (xdrproc_t)xdr_testEchoData, &args,
+                                     (xdrproc_t)xdr_testEchoData, &call->reply,
+                                     testPipelineDone, call) < 0)
+        return -1;
+
+    state->nsent++;
+    return 0;
+}
+
+
+static void
+testPipelineThread(void *opaque)
+{
+    struct testPipelineCall *call = opaque;
+    struct testPipelineState *state = call->state;
+    size_t ncalls = state->data->ncalls / state->data->nthreads;
+    size_t i;
+
+    call->ret = -1;
+
+    for (i = 0; i < ncalls; i++) {
+        testEchoData args = { sizeof(state->payload), state->payload };
+        testEchoData reply = { 0 };
+        unsigned serial;
+
+        VIR_WITH_MUTEX_LOCK_GUARD(&state->lock) {
+            serial = state->serial++;
+        }
+
+        if (virNetClientProgramCall(state->prog, state->client,
+                                    serial, TEST_PROC_ECHO,
+                                    0, NULL, NULL, NULL,
+                                    (xdrproc_t)xdr_testEchoData, &args,
+                                    (xdrproc_t)xdr_testEchoData, &reply) < 0) {
+            fprintf(stderr, "Call failed: %s\n", virGetLastErrorMessage());
+            return;
+        }
+
+        if (reply.len != sizeof(state->payload) ||
+            memcmp(reply.val, state->payload, sizeof(state->payload)) != 0) {
+            fprintf(stderr, "Reply doesn't match the call\n");
+            xdr_free((xdrproc_t)xdr_testEchoData, (char *)&reply);
+            return;
+        }
+        xdr_free((xdrproc_t)xdr_testEchoData, (char *)&reply);
+    }
+
+    call->ret = 0;
+}
+
+
+/*
+ * Issues calls over a single client connection to a server listening on
+ * a UNIX socket, either synchronously from several threads or keeping
+ * several asynchronous calls in flight from the event loop.
+ */
+static int
+testClientPipeline(const void *opaque)
+{
+    const struct testPipelineData *data = opaque;
+    struct testPipelineState state = { .data = data };
+    g_autofree struct testPipelineCall *calls = NULL;
+    size_t ncalls = data->nthreads ? data->nthreads : data->depth;
+    g_autoptr(virNetServer) srv = NULL;
+    virNetServerProgram *prog = NULL;
+    virNetServerService *svc = NULL;
+    char template[] = "/tmp/libvirt_XXXXXX";
+    char *tmpdir = NULL;
+    g_autofree char *path = NULL;
+    virThread loop;
+    bool loopRunning = false;
+    size_t nstarted = 0;
+    long long start = 0;
+    double elapsed;
+    size_t i;
+    int ret = -1;
+
+    memset(state.payload, 'x', sizeof(state.payload));
+    if (virMutexInit(&state.lock) < 0 ||
+        virCondInit(&state.cond) < 0)
+        return -1;
+
+    if (!(tmpdir = g_mkdtemp(template))) {
+        virReportSystemError(errno, "%s", "Cannot create temporary directory");
+        goto cleanup;
+    }
+    path = g_strdup_printf("%s/test.sock", tmpdir);
+
+    if (!(srv = virNetServerNew("test", 1, 4, 4, 0, 1, 0, -1, 0,
+                                testClientNew, NULL, testClientFree, NULL)))
+        goto cleanup;
+
+    if (!(prog = virNetServerProgramNew(TEST_PROGRAM, TEST_VERSION,
+                                        testProcs, G_N_ELEMENTS(testProcs))))
+        goto cleanup;
+
+    virNetServerAddProgram(srv, prog);
+
+    if (!(svc = virNetServerServiceNewUNIX(path, 0077, getegid(),
+                                           VIR_NET_SERVER_SERVICE_AUTH_NONE,
+                                           NULL, false, 1, ncalls)))
+        goto cleanup;
+
+    virNetServerAddService(srv, svc);
+    virNetServerUpdateServices(srv, true);
+
+    if (virThreadCreate(&loop, true, testEventLoop, NULL) < 0)
+        goto cleanup;
+    loopRunning = true;
+
+    if (!(state.client = virNetClientNewUNIX(path, NULL)) ||
+        virNetClientRegisterAsyncIO(state.client) < 0)
+        goto cleanup;
+
+    if (!(state.prog = virNetClientProgramNew(TEST_PROGRAM, TEST_VERSION,
+                                              NULL, 0, NULL)))
+        goto cleanup;
+
+    virNetClientAddProgram(state.client, state.prog);
+
+    calls = g_new0(struct testPipelineCall, ncalls);
+    for (i = 0; i < ncalls; i++)
+        calls[i].state = &state;
+
+    start = g_get_monotonic_time();
+
+    if (data->nthreads) {
+        for (nstarted = 0; nstarted < data->nthreads; nstarted++) {
+            if (virThreadCreate(&calls[nstarted].thread, true,
+                                testPipelineThread, &calls[nstarted]) < 0)
+                goto cleanup;
+        }
+    } else {
+        VIR_LOCK_GUARD lock = virLockGuardLock(&state.lock);
+
+        for (i = 0; i < data->depth && i < data->ncalls; i++) {
+            if (testPipelineSend(&calls[i]) < 0) {
+                state.failed = true;
+                break;
+            }
+        }
+
+        while (state.ndone < state.nsent)
+            ignore_value(virCondWait(&state.cond, &state.lock));
+
+        if (state.failed)
+            goto cleanup;
+    }
+
+    ret = 0;
+
+ cleanup:
+    for (i = 0; i < nstarted; i++) {
+        virThreadJoin(&calls[i].thread);
+        if (calls[i].ret < 0)
+            ret = -1;
+    }
+
+    if (ret == 0) {
+        elapsed = (g_get_monotonic_time() - start) / 1000000.0;
+        VIR_TEST_DEBUG("%zu calls in %.3fs (%.0f calls/s)",
+                       data->ncalls, elapsed, data->ncalls / elapsed);
+    }
+
+    if (state.client) {
+        virNetClientClose(state.client);
+        virObjectUnref(state.client);
+    }
+    virObjectUnref(state.prog);
+
+    if (srv)
+        virNetServerClose(srv);
+    virObjectUnref(svc);
+    virObjectUnref(prog);
+
+    if (loopRunning) {
+        g_atomic_int_set(&testEventLoopQuit, 1);
+        g_main_context_wakeup(NULL);
+        virThreadJoin(&loop);
+        g_atomic_int_set(&testEventLoopQuit, 0);
+    }
+
+    if (path)
+        unlink(path);
+    if (tmpdir)
+        rmdir(tmpdir);
+    virMutexDestroy(&state.lock);
+    virCondDestroy(&state.cond);
+
+    if (ret < 0)
+        virDispatchError(NULL);
+    return ret;
+}
+
+
+static int
+mymain(void)
+{
+    int ret = 0;
+
+    virEventRegisterDefaultImpl();
+
+# define DO_TEST(nclients, ncalls, niothreads) \
+    do { \
+        struct testServerData data = { nclients, ncalls, niothreads }; \
+        if (virTestRun("Clients " #nclients " I/O threads " #niothreads, \
+                       testServerClients, &data) < 0) \
+            ret = -1; \
+    } while (0)
+
+    DO_TEST(4, 100, 0);
+    DO_TEST(4, 100, 2);
+
+    if (virTestGetExpensive()) {
+        DO_TEST(128, 2000, 0);
+        DO_TEST(128, 2000, 4);
+    }
+
+# define DO_TEST_PIPELINE(ncalls, nthreads, depth) \
+    do { \
+        struct testPipelineData data = { ncalls, nthreads, depth }; \
+        if (virTestRun("Pipeline calls " #ncalls " threads " #nthreads \
+                       " depth " #depth, testClientPipeline, &data) < 0) \
+            ret = -1; \
+    } while (0)
+
+    DO_TEST_PIPELINE(400, 4, 0);
+    DO_TEST_PIPELINE(400, 0, 16);
+
+    if (virTestGetExpensive()) {
+        DO_TEST_PIPELINE(100000, 1, 0);
+        DO_TEST_PIPELINE(100000, 64, 0);
+        DO_TEST_PIPELINE(100000, 0, 64);
+        DO_TEST_PIPELINE(100000, 0, 256);
+    }
+
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+VIR_TEST_MAIN(mymain)
+#else
+static int
+mymain(void)
+{
+    return EXIT_AM_SKIP;
+}
+VIR_TEST_MAIN(mymain);
+#endif
@@ -29,9 +29,11 @@
 #include "viralloc.h"
 #include "virlog.h"
 #include "virfile.h"
+#include "virthread.h"
 
 #include "rpc/virnetsocket.h"
 #include "rpc/virnetclient.h"
+#include "rpc/virnetclientprogram.h"
 
 #define VIR_FROM_THIS VIR_FROM_RPC
 
@@ -430,6 +432,373 @@ static int testSocketCommandFail(const void *data G_GNUC_UNUSED)
     return ret;
 }
 
+# if WITH_ZSTD
+struct testCompressData {
+    virNetSocket *sock;
+    const char *buf;
+    size_t len;
+    int ret;
+};
+
+static void
+testSocketCompressWriter(void *opaque)
+{
+    struct testCompressData *data = opaque;
+    size_t offset = 0;
+
+    data->ret = -1;
+    while (offset < data->len) {
+        ssize_t rv = virNetSocketWrite(data->sock, data->buf + offset,
+                                       data->len - offset);
+        if (rv < 0)
+            return;
+        offset += rv;
+    }
+    data->ret = 0;
+}
+
+static int
+testSocketCompressTransfer(virNetSocket *ssock,
+                           virNetSocket *csock,
+                           const char *buf,
+                           size_t len)
+{
+    struct testCompressData data = { ssock, buf, len, -1 };
+    g_autofree char *out = g_new0(char, len);
+    size_t offset = 0;
+    virThread thread;
+
+    if (virThreadCreate(&thread, true, testSocketCompressWriter, &data) < 0)
+        return -1;
+
+    while (offset < len) {
+        ssize_t rv = virNetSocketRead(csock, out + offset, len - offset);
+        if (rv <= 0)
+            break;
+        offset += rv;
+    }
+
+    virThreadJoin(&thread);
+
+    if (data.ret < 0 || offset != len) {
+        VIR_DEBUG("Transferred %zu of %zu bytes", offset, len);
+        return -1;
+    }
+
+    if (memcmp(buf, out, len) != 0) {
+        VIR_DEBUG("Received data differs from the sent one");
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Pass a short message, a highly compressible one spanning multiple
+ * frames and an incompressible one over a socket pair with compression
+ * enabled on both ends.
+ */
+static int testSocketCompress(const void *data G_GNUC_UNUSED)
+{
+    virNetSocket *ssock = NULL;
+    virNetSocket *csock = NULL;
+    g_autoptr(GString) xml = g_string_new(NULL);
+    g_autofree char *noise = NULL;
+    g_autoptr(GRand) rand = g_rand_new_with_seed(42);
+    const char *hello = "hello";
+    size_t noiseLen = 300 * 1024;
+    int fds[2] = { -1, -1 };
+    size_t i;
+    int ret = -1;
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+        virReportSystemError(errno, "%s", "Cannot create socket pair");
+        return -1;
+    }
+
+    if (virNetSocketNewConnectSockFD(fds[0], &ssock) < 0)
+        goto cleanup;
+    fds[0] = -1;
+    if (virNetSocketNewConnectSockFD(fds[1], &csock) < 0)
+        goto cleanup;
+    fds[1] = -1;
+
+    virNetSocketSetBlocking(ssock, true);
+    virNetSocketSetBlocking(csock, true);
+
+    if (virNetSocketSetCompression(ssock) < 0 ||
+        virNetSocketSetCompression(csock) < 0)
+        goto cleanup;
+
+    for (i = 0; i < 10000; i++)
+        g_string_append_printf(xml,
+                               "<domain type='kvm'><name>vm%zu</name>"
+                               "<memory unit='KiB'>1048576</memory></domain>\n",
+                               i);
+
+    noise = g_new(char, noiseLen);
+    for (i = 0; i < noiseLen; i++)
+        noise[i] = g_rand_int(rand);
+
+    if (testSocketCompressTransfer(ssock, csock, hello, strlen(hello)) < 0 ||
+        testSocketCompressTransfer(csock, ssock, xml->str, xml->len) < 0 ||
+        testSocketCompressTransfer(ssock, csock, noise, noiseLen) < 0)
+        goto cleanup;
+
+    ret = 0;
+
+ cleanup:
+    VIR_FORCE_CLOSE(fds[0]);
+    VIR_FORCE_CLOSE(fds[1]);
+    virObjectUnref(ssock);
+    virObjectUnref(csock);
+    return ret;
+}
+
+#  define TEST_COMPRESS_PROG 0x12345678
+#  define TEST_COMPRESS_VERS 1
+
+enum {
+    TEST_COMPRESS_PROC_QUERY = 1, /* agrees to compress its reply */
+    TEST_COMPRESS_PROC_CALL = 2,
+    TEST_COMPRESS_PROC_EVENT = 3,
+};
+
+static int
+testClientCompressReadAll(virNetSocket *sock,
+                          char *buf,
+                          size_t len)
+{
+    while (len > 0) {
+        ssize_t rv = virNetSocketRead(sock, buf, len);
+        if (rv <= 0)
+            return -1;
+        buf += rv;
+        len -= rv;
+    }
+
+    return 0;
+}
+
+static virNetMessage *
+testClientCompressRecv(virNetSocket *sock)
+{
+    virNetMessage *msg = virNetMessageNew(false);
+
+    virNetMessageResizeBuffer(msg, VIR_NET_MESSAGE_LEN_MAX);
+
+    if (testClientCompressReadAll(sock, msg->buffer, msg->bufferLength) < 0 ||
+        virNetMessageDecodeLength(msg) < 0 ||
+        testClientCompressReadAll(sock, msg->buffer + msg->bufferOffset,
+                                  msg->bufferLength - msg->bufferOffset) < 0 ||
+        virNetMessageDecodeHeader(msg) < 0) {
+        virNetMessageFree(msg);
+        return NULL;
+    }
+
+    return msg;
+}
+
+static int
+testClientCompressSend(virNetSocket *sock,
+                       const virNetMessageHeader *header,
+                       int value)
+{
+    virNetMessage *msg = virNetMessageNew(false);
+    size_t offset = 0;
+    int ret = -1;
+
+    msg->header = *header;
+
+    if (virNetMessageEncodeHeader(msg) < 0 ||
+        virNetMessageEncodePayload(msg, (xdrproc_t)xdr_int, &value) < 0)
+        goto cleanup;
+
+    while (offset < msg->bufferLength) {
+        ssize_t rv = virNetSocketWrite(sock, msg->buffer + offset,
+                                       msg->bufferLength - offset);
+        if (rv < 0)
+            goto cleanup;
+        offset += rv;
+    }
+
+    ret = 0;
+
+ cleanup:
+    virNetMessageFree(msg);
+    return ret;
+}
+
+struct testClientCompressServerData {
+    virNetSocket *sock;
+    int ret;
+};
+
+/*
+ * Plays the daemon: replies to the query, switches to compression right
+ * away and sends an event before answering the next call, the way the
+ * daemon may send an event or a keepalive message.
+ */
+static void
+testClientCompressServer(void *opaque)
+{
+    struct testClientCompressServerData *data = opaque;
+    virNetMessageHeader event = {
+        .prog = TEST_COMPRESS_PROG,
+        .vers = TEST_COMPRESS_VERS,
+        .proc = TEST_COMPRESS_PROC_EVENT,
+        .type = VIR_NET_MESSAGE,
+        .status = VIR_NET_OK,
+    };
+    virNetMessage *msg = NULL;
+
+    data->ret = -1;
+
+    if (!(msg = testClientCompressRecv(data->sock)) ||
+        msg->header.proc != TEST_COMPRESS_PROC_QUERY)
+        goto cleanup;
+
+    msg->header.type = VIR_NET_REPLY;
+    if (testClientCompressSend(data->sock, &msg->header, 1) < 0 ||
+        virNetSocketSetCompression(data->sock) < 0 ||
+        testClientCompressSend(data->sock, &event, 42) < 0)
+        goto cleanup;
+    g_clear_pointer(&msg, virNetMessageFree);
+
+    if (!(msg = testClientCompressRecv(data->sock)) ||
+        msg->header.proc != TEST_COMPRESS_PROC_CALL)
+        goto cleanup;
+
+    msg->header.type = VIR_NET_REPLY;
+    if (testClientCompressSend(data->sock, &msg->header, 2) < 0)
+        goto cleanup;
+
+    data->ret = 0;
+
+ cleanup:
+    /* Let the client see the end of the connection if anything failed */
+    if (data->ret < 0)
+        virNetSocketClose(data->sock);
+    virNetMessageFree(msg);
+}
+
+static void
+testClientCompressEvent(virNetClientProgram *prog G_GNUC_UNUSED,
+                        virNetClient *client G_GNUC_UNUSED,
+                        void *evdata,
+                        void *opaque)
+{
+    *(int *)opaque = *(int *)evdata;
+}
+
+/*
+ * The client has to switch to compression as soon as it receives the
+ * reply agreeing to it, as the data which follows the reply, here an
+ * event, is compressed already.
+ */
+static int testClientCompress(const void *opaque G_GNUC_UNUSED)
+{
+    virNetClientProgramEvent events[] = {
+        { TEST_COMPRESS_PROC_EVENT, testClientCompressEvent,
+          sizeof(int), (xdrproc_t)xdr_int },
+    };
+    struct testClientCompressServerData sdata = { NULL, -1 };
+    virNetSocket *lsock = NULL;
+    virNetClient *client = NULL;
+    virNetClientProgram *prog = NULL;
+    char template[] = "/tmp/libvirt_XXXXXX";
+    char *tmpdir = NULL;
+    g_autofree char *path = NULL;
+    virThread thread;
+    bool threadRunning = false;
+    int eventValue = 0;
+    int value = 0;
+    int ret = -1;
+
+    if (!(tmpdir = g_mkdtemp(template)))
+        return -1;
+    path = g_strdup_printf("%s/test.sock", tmpdir);
+
+    if (virNetSocketNewListenUNIX(path, 0700, -1, getegid(), &lsock) < 0 ||
+        virNetSocketListen(lsock, 0) < 0)
+        goto cleanup;
+
+    /* The connection is queued until it's accepted */
+    if (!(client = virNetClientNewUNIX(path, NULL)) ||
+        virNetSocketAccept(lsock, &sdata.sock) < 0)
+        goto cleanup;
+
+    if (!sdata.sock) {
+        VIR_DEBUG("No connection to accept");
+        goto cleanup;
+    }
+    virNetSocketSetBlocking(sdata.sock, true);
+
+    if (!(prog = virNetClientProgramNew(TEST_COMPRESS_PROG, TEST_COMPRESS_VERS,
+                                        events, G_N_ELEMENTS(events),
+                                        &eventValue)))
+        goto cleanup;
+    virNetClientAddProgram(client, prog);
+
+    if (virThreadCreate(&thread, true, testClientCompressServer, &sdata) < 0)
+        goto cleanup;
+    threadRunning = true;
+
+    if (virNetClientSetCompression(client, TEST_COMPRESS_PROG,
+                                   TEST_COMPRESS_PROC_QUERY) < 0)
+        goto cleanup;
+
+    if (virNetClientProgramCall(prog, client, 1, TEST_COMPRESS_PROC_QUERY,
+                                0, NULL, NULL, NULL,
+                                (xdrproc_t)xdr_void, NULL,
+                                (xdrproc_t)xdr_int, &value) < 0 ||
+        value != 1) {
+        VIR_DEBUG("Query failed or returned %d", value);
+        goto cleanup;
+    }
+
+    if (virNetClientProgramCall(prog, client, 2, TEST_COMPRESS_PROC_CALL,
+                                0, NULL, NULL, NULL,
+                                (xdrproc_t)xdr_void, NULL,
+                                (xdrproc_t)xdr_int, &value) < 0 ||
+        value != 2) {
+        VIR_DEBUG("Compressed call failed or returned %d", value);
+        goto cleanup;
+    }
+
+    if (eventValue != 42) {
+        VIR_DEBUG("Expected event with 42, got %d", eventValue);
+        goto cleanup;
+    }
+
+    virThreadJoin(&thread);
+    threadRunning = false;
+
+    if (sdata.ret < 0)
+        goto cleanup;
+
+    ret = 0;
+
+ cleanup:
+    /* Closing the client makes the server thread see the end of the
+     * connection in case it's still waiting for a call */
+    if (client)
+        virNetClientClose(client);
+    if (threadRunning)
+        virThreadJoin(&thread);
+    virObjectUnref(client);
+    virObjectUnref(prog);
+    virObjectUnref(sdata.sock);
+    if (lsock) {
+        virNetSocketClose(lsock);
+        virObjectUnref(lsock);
+    }
+    if (tmpdir)
+        rmdir(tmpdir);
+    return ret;
+}
+# endif /* WITH_ZSTD */
+
 struct testSSHData {
     const char *nodename;
     const char *service;
@@ -560,6 +929,13 @@ mymain(void)
     if (virTestRun("Socket External Command /dev/does-not-exist", testSocketCommandFail, NULL) < 0)
         ret = -1;
 
+# if WITH_ZSTD
+    if (virTestRun("Socket compression", testSocketCompress, NULL) < 0)
+        ret = -1;
+    if (virTestRun("Client compression", testClientCompress, NULL) < 0)
+        ret = -1;
+# endif
+
     VIR_WARNINGS_NO_DECLARATION_AFTER_STATEMENT
     struct testSSHData sshData1 = {
         .nodename = "somehost",
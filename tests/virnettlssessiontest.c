@@ -60,6 +60,40 @@ static ssize_t testRead(char *buf, size_t len, void *opaque)
     return read(*fd, buf, len);
 }
 
+/*
+ * We have an evil loop to do the handshake in a single thread,
+ * relying on the sockets being non-blocking to avoid deadlocking
+ * ourselves. The loop goes around & around doing handshake on each
+ * session until we get an error, or the handshake completes.
+ */
+static int
+testTLSSessionHandshake(virNetTLSSession *serverSess,
+                        virNetTLSSession *clientSess)
+{
+    bool clientShake = false;
+    bool serverShake = false;
+
+    do {
+        int rv;
+        if (!serverShake) {
+            rv = virNetTLSSessionHandshake(serverSess);
+            if (rv < 0)
+                return -1;
+            if (rv == VIR_NET_TLS_HANDSHAKE_COMPLETE)
+                serverShake = true;
+        }
+        if (!clientShake) {
+            rv = virNetTLSSessionHandshake(clientSess);
+            if (rv < 0)
+                return -1;
+            if (rv == VIR_NET_TLS_HANDSHAKE_COMPLETE)
+                clientShake = true;
+        }
+    } while (!clientShake || !serverShake);
+
+    return 0;
+}
+
 /*
  * This tests validation checking of peer certificates
  *
@@ -79,19 +113,12 @@ static int testTLSSessionInit(const void *opaque)
     virNetTLSSession *serverSess = NULL;
     int ret = -1;
     int channel[2];
-    bool clientShake = false;
-    bool serverShake = false;
 
 
     /* We'll use this for our fake client-server connection */
     if (socketpair(AF_UNIX, SOCK_STREAM, 0, channel) < 0)
         abort();
 
-    /*
-     * We have an evil loop to do the handshake in a single
-     * thread, so we need these non-blocking to avoid deadlock
-     * of ourselves
-     */
     ignore_value(virSetNonBlock(channel[0]));
     ignore_value(virSetNonBlock(channel[1]));
 
@@ -150,29 +177,8 @@ static int testTLSSessionInit(const void *opaque)
     virNetTLSSessionSetIOCallbacks(serverSess, testWrite, testRead, &channel[0]);
     virNetTLSSessionSetIOCallbacks(clientSess, testWrite, testRead, &channel[1]);
 
-    /*
-     * Finally we loop around & around doing handshake on each
-     * session until we get an error, or the handshake completes.
-     * This relies on the socketpair being nonblocking to avoid
-     * deadlocking ourselves upon handshake
-     */
-    do {
-        int rv;
-        if (!serverShake) {
-            rv = virNetTLSSessionHandshake(serverSess);
-            if (rv < 0)
-                goto cleanup;
-            if (rv == VIR_NET_TLS_HANDSHAKE_COMPLETE)
-                serverShake = true;
-        }
-        if (!clientShake) {
-            rv = virNetTLSSessionHandshake(clientSess);
-            if (rv < 0)
-                goto cleanup;
-            if (rv == VIR_NET_TLS_HANDSHAKE_COMPLETE)
-                clientShake = true;
-        }
-    } while (!clientShake || !serverShake);
+    if (testTLSSessionHandshake(serverSess, clientSess) < 0)
+        goto cleanup;
 
 
     /* Finally make sure the server validation does what
@@ -229,6 +235,131 @@ static int testTLSSessionInit(const void *opaque)
 }
 
 
+struct testTLSResumeData {
+    const char *cacrt;
+    const char *servercrt;
+    const char *clientcrt;
+    const char *priority;
+    bool expectResume;
+    size_t nconns;
+};
+
+
+/*
+ * Connect a new client session to a new server session, validate
+ * both peers and pass a byte from the server to the client, which
+ * also delivers TLS 1.3 session tickets to the client.
+ */
+static int
+testTLSSessionConnect(virNetTLSContext *serverCtxt,
+                      virNetTLSContext *clientCtxt,
+                      bool *resumed)
+{
+    g_autoptr(virNetTLSSession) serverSess = NULL;
+    g_autoptr(virNetTLSSession) clientSess = NULL;
+    VIR_AUTOCLOSE serverFD = -1;
+    VIR_AUTOCLOSE clientFD = -1;
+    int channel[2];
+    char c = 'x';
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, channel) < 0)
+        abort();
+    serverFD = channel[0];
+    clientFD = channel[1];
+
+    ignore_value(virSetNonBlock(serverFD));
+    ignore_value(virSetNonBlock(clientFD));
+
+    if (!(serverSess = virNetTLSSessionNew(serverCtxt, NULL)) ||
+        !(clientSess = virNetTLSSessionNew(clientCtxt, "libvirt.org")))
+        return -1;
+
+    virNetTLSSessionSetIOCallbacks(serverSess, testWrite, testRead, &serverFD);
+    virNetTLSSessionSetIOCallbacks(clientSess, testWrite, testRead, &clientFD);
+
+    if (testTLSSessionHandshake(serverSess, clientSess) < 0)
+        return -1;
+
+    if (virNetTLSContextCheckCertificate(serverCtxt, serverSess) < 0 ||
+        virNetTLSContextCheckCertificate(clientCtxt, clientSess) < 0)
+        return -1;
+
+    if (virNetTLSSessionWrite(serverSess, &c, 1) != 1 ||
+        virNetTLSSessionRead(clientSess, &c, 1) != 1) {
+        VIR_WARN("Unable to pass data over TLS session");
+        return -1;
+    }
+
+    if (STRNEQ_NULLABLE(virNetTLSSessionGetX509DName(serverSess),
+                        "C=UK,CN=libvirt")) {
+        VIR_WARN("Unexpected client distinguished name '%s'",
+                 NULLSTR(virNetTLSSessionGetX509DName(serverSess)));
+        return -1;
+    }
+
+    *resumed = virNetTLSSessionIsResumed(clientSess);
+    return 0;
+}
+
+
+/*
+ * Check repeated connections between the same contexts resume the
+ * session established by the first one, unless tickets are disabled
+ */
+static int
+testTLSSessionResume(const void *opaque)
+{
+    const struct testTLSResumeData *data = opaque;
+    g_autoptr(virNetTLSContext) serverCtxt = NULL;
+    g_autoptr(virNetTLSContext) clientCtxt = NULL;
+    gint64 start;
+    double elapsed;
+    size_t nresumed = 0;
+    size_t i;
+
+    if (!(serverCtxt = virNetTLSContextNewServer(data->cacrt, NULL,
+                                                 data->servercrt, KEYFILE,
+                                                 NULL, data->priority,
+                                                 false, true)) ||
+        !(clientCtxt = virNetTLSContextNewClient(data->cacrt, NULL,
+                                                 data->clientcrt, KEYFILE,
+                                                 data->priority,
+                                                 false, true)))
+        return -1;
+
+    start = g_get_monotonic_time();
+
+    for (i = 0; i < data->nconns; i++) {
+        bool resumed;
+
+        if (testTLSSessionConnect(serverCtxt, clientCtxt, &resumed) < 0)
+            return -1;
+
+        /* The client can't have a ticket from this server yet */
+        if (i == 0 && resumed) {
+            VIR_WARN("First session unexpectedly resumed");
+            return -1;
+        }
+
+        if (i > 0 && resumed != data->expectResume) {
+            VIR_WARN("Session %zu %s resumed", i,
+                     resumed ? "unexpectedly" : "not");
+            return -1;
+        }
+
+        if (resumed)
+            nresumed++;
+    }
+
+    elapsed = (g_get_monotonic_time() - start) / 1000000.0;
+    VIR_TEST_DEBUG("%s: %.0f handshakes/s, %zu of %zu resumed",
+                   data->priority, data->nconns / elapsed,
+                   nresumed, data->nconns);
+
+    return 0;
+}
+
+
 static int
 mymain(void)
 {
@@ -457,6 +588,29 @@ mymain(void)
     DO_SESS_TEST("cacertchain-sess.pem", servercertlevel3areq.filename, clientcertlevel2breq.filename,
                  false, false, "libvirt.org", NULL);
 
+# define DO_RESUME_TEST(_priority, _expectResume, _nconns) \
+    do { \
+        static struct testTLSResumeData data; \
+        data.cacrt = cacertreq.filename; \
+        data.servercrt = servercertreq.filename; \
+        data.clientcrt = clientcertreq.filename; \
+        data.priority = _priority; \
+        data.expectResume = _expectResume; \
+        data.nconns = _nconns; \
+        if (virTestRun("TLS Session resume " _priority " " #_nconns, \
+                       testTLSSessionResume, &data) < 0) \
+            ret = -1; \
+    } while (0)
+
+    DO_RESUME_TEST("NORMAL", true, 3);
+    DO_RESUME_TEST("NORMAL:%NO_TICKETS", false, 3);
+    DO_RESUME_TEST("NORMAL:-VERS-ALL:+VERS-TLS1.2", true, 3);
+
+    if (virTestGetExpensive()) {
+        DO_RESUME_TEST("NORMAL", true, 1000);
+        DO_RESUME_TEST("NORMAL:%NO_TICKETS", false, 1000);
+    }
+
     VIR_WARNINGS_RESET
 
     testTLSDiscardCert(&clientcertreq);
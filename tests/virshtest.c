@@ -208,6 +208,45 @@ testVirshPipe(const void *data G_GNUC_UNUSED)
 }
 
 
+static int
+testVirshOutput(const char *const argv[],
+                char **output)
+{
+    g_autoptr(virCommand) cmd = virCommandNewArgs(argv);
+
+    virCommandAddEnvString(cmd, "LANG=C");
+    virCommandSetOutputBuffer(cmd, output);
+
+    return virCommandRun(cmd, NULL);
+}
+
+
+/* The XML description reported by domstats must be the one printed by
+ * dumpxml, which is not worth keeping as a separate expected output. */
+static int
+testVirshDomstatsXML(const void *data G_GNUC_UNUSED)
+{
+    const char *dumpxml[] = { VIRSH_CUSTOM, "-q", "dumpxml", "fc4", NULL };
+    const char *domstats[] = { VIRSH_CUSTOM, "-q", "domstats", "--xml", "fc4", NULL };
+    g_autofree char *xml = NULL;
+    g_autofree char *expected = NULL;
+    g_autofree char *actual = NULL;
+
+    if (testVirshOutput(dumpxml, &xml) < 0 ||
+        testVirshOutput(domstats, &actual) < 0)
+        return -1;
+
+    expected = g_strdup_printf("Domain: 'fc4'\n  xml.desc=%s\n", xml);
+
+    if (STRNEQ(expected, actual)) {
+        virTestDifference(stderr, expected, actual);
+        return -1;
+    }
+
+    return 0;
+}
+
+
 static int
 mymain(void)
 {
@@ -245,6 +284,10 @@ mymain(void)
     DO_TEST_SCRIPT("domain-id", "\nCPU time:", VIRSH_CUSTOM);
     DO_TEST_SCRIPT("blkiotune", NULL, VIRSH_CUSTOM);
     DO_TEST_SCRIPT("iothreads", NULL, VIRSH_CUSTOM);
+    DO_TEST_SCRIPT("domstats-metadata", NULL, VIRSH_CUSTOM);
+
+    if (virTestRun("domstats-xml", testVirshDomstatsXML, NULL) < 0)
+        ret = -1;
 
 # define DO_TEST_INFO(infostruct) \
     if (virTestRun((infostruct)->testname, testCompare, (infostruct)) < 0) \
@@ -19,8 +19,10 @@
 #include <config.h>
 
 #include <unistd.h>
+#include <utime.h>
 
 #include "storage_source.h"
+#include "storage_header_cache.h"
 #include "testutils.h"
 #include "vircommand.h"
 #include "virfile.h"
@@ -432,6 +434,121 @@ testBackingParse(const void *args)
 }
 
 
+static int
+testHeaderCacheWrite(const char *path,
+                     size_t len)
+{
+    g_autofree char *buf = g_strnfill(len, 'x');
+    time_t past = time(NULL) - 60;
+    struct utimbuf times = { .actime = past, .modtime = past };
+
+    if (virFileWriteStr(path, buf, 0600) < 0 ||
+        utime(path, &times) < 0) {
+        fprintf(stderr, "failed to prepare '%s'\n", path);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/*
+ * Checks headers are served from the cache only as long as the image
+ * isn't modified and the cache isn't told otherwise.
+ */
+static int
+testHeaderCache(const void *args G_GNUC_UNUSED)
+{
+    g_autofree char *path = g_strdup_printf("%s/cached", datadir);
+    const char *chain = abs_srcdir "/virstoragetestdata/images/qcow2_raw-raw-relative.qcow2";
+    virStorageHeaderCacheStats before;
+    virStorageHeaderCacheStats after;
+    g_autoptr(virStorageSource) meta = NULL;
+    g_autofree char *buf = NULL;
+    struct stat sb;
+    int ret = -1;
+
+    virStorageHeaderCacheClear();
+
+    if (g_mkdir_with_parents(datadir, 0777) < 0 ||
+        testHeaderCacheWrite(path, 512) < 0 ||
+        stat(path, &sb) < 0)
+        goto cleanup;
+
+    virStorageHeaderCacheStore(path, &sb, "header", 6);
+
+    if (virStorageHeaderCacheLookup(path, &sb, &buf) != 6 ||
+        memcmp(buf, "header", 6) != 0) {
+        fprintf(stderr, "cached header not found\n");
+        goto cleanup;
+    }
+    g_clear_pointer(&buf, g_free);
+
+    /* The size differs now */
+    if (testHeaderCacheWrite(path, 1024) < 0 ||
+        stat(path, &sb) < 0)
+        goto cleanup;
+
+    if (virStorageHeaderCacheLookup(path, &sb, &buf) >= 0) {
+        fprintf(stderr, "modified image served from the cache\n");
+        goto cleanup;
+    }
+
+    virStorageHeaderCacheStore(path, &sb, "header", 6);
+    virStorageHeaderCacheInvalidate(path);
+
+    if (virStorageHeaderCacheLookup(path, &sb, &buf) >= 0) {
+        fprintf(stderr, "invalidated image served from the cache\n");
+        goto cleanup;
+    }
+
+    /* Images modified just now must not be cached at all */
+    if (virFileWriteStr(path, "new", 0600) < 0 ||
+        stat(path, &sb) < 0)
+        goto cleanup;
+
+    virStorageHeaderCacheStore(path, &sb, "header", 6);
+
+    if (virStorageHeaderCacheLookup(path, &sb, &buf) >= 0) {
+        fprintf(stderr, "recently modified image served from the cache\n");
+        goto cleanup;
+    }
+
+    virStorageHeaderCacheGetStats(&before);
+
+    if (before.hits != 1 || before.stale != 1 || before.invalidations != 1) {
+        fprintf(stderr, "unexpected statistics: hits=%llu stale=%llu invalidations=%llu\n",
+                before.hits, before.stale, before.invalidations);
+        goto cleanup;
+    }
+
+    /* Probing the chain again must not need to read any image */
+    if (!(meta = testStorageFileGetMetadata(chain, VIR_STORAGE_FILE_QCOW2, -1, -1)))
+        goto cleanup;
+    g_clear_pointer(&meta, virObjectUnref);
+
+    virStorageHeaderCacheGetStats(&before);
+
+    if (!(meta = testStorageFileGetMetadata(chain, VIR_STORAGE_FILE_QCOW2, -1, -1)))
+        goto cleanup;
+
+    virStorageHeaderCacheGetStats(&after);
+
+    if (after.misses != before.misses || after.hits != before.hits + 2) {
+        fprintf(stderr, "chain not probed from the cache: hits=%llu misses=%llu\n",
+                after.hits - before.hits, after.misses - before.misses);
+        goto cleanup;
+    }
+
+    ret = 0;
+
+ cleanup:
+    virStorageHeaderCacheClear();
+    testCleanupImages();
+    return ret;
+}
+
+
 static int
 mymain(void)
 {
@@ -1231,6 +1348,9 @@ mymain(void)
 
 #endif /* WITH_JSON */
 
+    if (virTestRun("header cache", testHeaderCache, NULL) < 0)
+        ret = -1;
+
     return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
@@ -16,8 +16,13 @@
 
 #include <config.h>
 
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
+#include "storage_header_cache.h"
 #include "testutils.h"
+#include "virfile.h"
 #include "virlog.h"
 
 #include "storage/storage_util.h"
@@ -67,6 +72,375 @@ testGlusterExtractPoolSources(const void *opaque)
 }
 
 
+struct testCopyDataData {
+    unsigned long long size;
+    double fill; /* ratio of the input holding data */
+    bool sparse;
+    bool copy_range;
+    unsigned int nworkers;
+    size_t segment_size;
+};
+
+/*
+ * Creates a sparse file of @size bytes with about @fill of its 1 MiB
+ * blocks holding random data.
+ */
+static int
+testCopyDataMakeInput(const char *path,
+                      unsigned long long size,
+                      double fill)
+{
+    g_autoptr(GRand) rand = g_rand_new_with_seed(42);
+    g_autofree char *buf = g_new0(char, 1024 * 1024);
+    unsigned long long offset;
+    VIR_AUTOCLOSE fd = -1;
+    size_t i;
+
+    if ((fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600)) < 0 ||
+        ftruncate(fd, size) < 0)
+        return -1;
+
+    for (offset = 0; offset < size; offset += 1024 * 1024) {
+        size_t len = MIN(size - offset, 1024 * 1024);
+
+        if (g_rand_double(rand) >= fill)
+            continue;
+
+        for (i = 0; i < len; i++)
+            buf[i] = g_rand_int(rand);
+
+        if (pwrite(fd, buf, len, offset) != len)
+            return -1;
+    }
+
+    return VIR_CLOSE(fd);
+}
+
+
+static int
+testCopyDataCompare(const char *inputpath,
+                    const char *path,
+                    unsigned long long size)
+{
+    g_autofree char *a = g_new0(char, 1024 * 1024);
+    g_autofree char *b = g_new0(char, 1024 * 1024);
+    unsigned long long offset;
+    VIR_AUTOCLOSE inputfd = -1;
+    VIR_AUTOCLOSE fd = -1;
+
+    if ((inputfd = open(inputpath, O_RDONLY)) < 0 ||
+        (fd = open(path, O_RDONLY)) < 0)
+        return -1;
+
+    for (offset = 0; offset < size; offset += 1024 * 1024) {
+        size_t len = MIN(size - offset, 1024 * 1024);
+
+        if (saferead(inputfd, a, len) != len ||
+            saferead(fd, b, len) != len) {
+            fprintf(stderr, "Unable to read data at offset %llu\n", offset);
+            return -1;
+        }
+
+        if (memcmp(a, b, len) != 0) {
+            fprintf(stderr, "Data differs at offset %llu\n", offset);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+
+static int
+testCopyData(const void *opaque)
+{
+    const struct testCopyDataData *data = opaque;
+    g_autofree char *inputpath = g_strdup_printf("%s/virstorageutiltest-input-%d.img",
+                                                 abs_builddir, (int) getpid());
+    g_autofree char *path = g_strdup_printf("%s/virstorageutiltest-output-%d.img",
+                                            abs_builddir, (int) getpid());
+    unsigned long long total = data->size + 4096;
+    VIR_AUTOCLOSE inputfd = -1;
+    VIR_AUTOCLOSE fd = -1;
+    struct stat inputst;
+    struct stat st;
+    gint64 start;
+    double elapsed;
+    int ret = -1;
+
+    if (testCopyDataMakeInput(inputpath, data->size, data->fill) < 0) {
+        fprintf(stderr, "Unable to create input file\n");
+        goto cleanup;
+    }
+
+    if ((inputfd = open(inputpath, O_RDONLY)) < 0 ||
+        (fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600)) < 0 ||
+        ftruncate(fd, data->size) < 0)
+        goto cleanup;
+
+    start = g_get_monotonic_time();
+
+    if (virStorageBackendCopyData(inputfd, inputpath, fd, path, &total,
+                                  data->sparse, data->copy_range,
+                                  data->nworkers, data->segment_size) < 0)
+        goto cleanup;
+
+    elapsed = (g_get_monotonic_time() - start) / 1000000.0;
+
+    VIR_TEST_DEBUG("%llu MiB, %.0f%% filled, %s%s, %u workers: %.2f GB/s",
+                   data->size / 1024 / 1024, data->fill * 100,
+                   data->sparse ? "sparse" : "full",
+                   data->copy_range ? "" : ", read/write", data->nworkers,
+                   data->size / elapsed / 1e9);
+
+    /* Everything but the extra 4 KiB asked for should be copied */
+    if (total != 4096) {
+        fprintf(stderr, "Expected 4096 bytes not copied, got %llu\n", total);
+        goto cleanup;
+    }
+
+    if (testCopyDataCompare(inputpath, path, data->size) < 0)
+        goto cleanup;
+
+    if (fstat(inputfd, &inputst) < 0 || fstat(fd, &st) < 0)
+        goto cleanup;
+
+    /* Holes in the input stay holes in a sparse copy, allowing for the
+     * allocation granularity of the filesystem */
+    if (data->sparse &&
+        st.st_blocks > inputst.st_blocks + data->size / 1024 / 1024 * 8) {
+        fprintf(stderr, "Copy allocates %lld blocks, input %lld\n",
+                (long long) st.st_blocks, (long long) inputst.st_blocks);
+        goto cleanup;
+    }
+
+    ret = 0;
+
+ cleanup:
+    unlink(inputpath);
+    unlink(path);
+    return ret;
+}
+
+
+/*
+ * Writes the header of an empty qcow2 image of @capacity bytes.
+ */
+static int
+testRefreshMakeImage(const char *path,
+                     unsigned long long capacity)
+{
+    char header[512] = "QFI\xfb";
+    uint32_t val32;
+    uint64_t val64;
+    VIR_AUTOCLOSE fd = -1;
+
+    val32 = GUINT32_TO_BE(3); /* version */
+    memcpy(header + 4, &val32, sizeof(val32));
+    val32 = GUINT32_TO_BE(16); /* cluster_bits */
+    memcpy(header + 20, &val32, sizeof(val32));
+    val64 = GUINT64_TO_BE(capacity);
+    memcpy(header + 24, &val64, sizeof(val64));
+    val32 = GUINT32_TO_BE(4); /* refcount_order */
+    memcpy(header + 96, &val32, sizeof(val32));
+    val32 = GUINT32_TO_BE(104); /* header_length */
+    memcpy(header + 100, &val32, sizeof(val32));
+
+    if ((fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600)) < 0 ||
+        safewrite(fd, header, sizeof(header)) != sizeof(header))
+        return -1;
+
+    return VIR_CLOSE(fd);
+}
+
+
+static virStoragePoolObj *
+testRefreshNewPool(const char *dir)
+{
+    virStoragePoolObj *pool;
+    virStoragePoolDef *def = g_new0(virStoragePoolDef, 1);
+
+    def->name = g_strdup("pool");
+    def->type = VIR_STORAGE_POOL_DIR;
+    def->target.path = g_strdup(dir);
+
+    if (!(pool = virStoragePoolObjNew())) {
+        virStoragePoolDefFree(def);
+        return NULL;
+    }
+
+    virStoragePoolObjSetDef(pool, def);
+    return pool;
+}
+
+
+static int
+testRefreshCheckVol(virStoragePoolObj *pool,
+                    const char *name,
+                    unsigned long long capacity)
+{
+    virStorageVolDef *vol;
+
+    if (!(vol = virStorageVolDefFindByName(pool, name))) {
+        fprintf(stderr, "Volume '%s' not found\n", name);
+        return -1;
+    }
+
+    if (vol->target.capacity != capacity) {
+        fprintf(stderr, "Volume '%s' has capacity %llu, expected %llu\n",
+                name, vol->target.capacity, capacity);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+static int
+testRefreshLocal(const void *opaque G_GNUC_UNUSED)
+{
+    g_autofree char *dir = g_strdup_printf("%s/virstorageutiltest-pool-XXXXXX",
+                                           abs_builddir);
+    g_autofree char *a = NULL;
+    g_autofree char *b = NULL;
+    g_autofree char *c = NULL;
+    g_autofree char *d = NULL;
+    virStoragePoolObj *pool = NULL;
+    virStorageVolDef *vola;
+    int ret = -1;
+
+    if (!g_mkdtemp(dir)) {
+        fprintf(stderr, "Unable to create pool directory\n");
+        VIR_FREE(dir);
+        return -1;
+    }
+
+    a = g_strdup_printf("%s/a.qcow2", dir);
+    b = g_strdup_printf("%s/b.qcow2", dir);
+    c = g_strdup_printf("%s/c.img", dir);
+    d = g_strdup_printf("%s/d.qcow2", dir);
+
+    if (testRefreshMakeImage(a, 1024 * 1024) < 0 ||
+        testRefreshMakeImage(b, 2 * 1024 * 1024) < 0 ||
+        virFileWriteStr(c, "raw", 0600) < 0)
+        goto cleanup;
+
+    if (!(pool = testRefreshNewPool(dir)))
+        goto cleanup;
+
+    /* Files modified within a second of being probed are always probed
+     * again */
+    g_usleep(1100 * 1000);
+
+    if (virStorageBackendRefreshLocal(pool) < 0 ||
+        virStoragePoolObjGetVolumesCount(pool) != 3 ||
+        testRefreshCheckVol(pool, "a.qcow2", 1024 * 1024) < 0 ||
+        testRefreshCheckVol(pool, "b.qcow2", 2 * 1024 * 1024) < 0 ||
+        testRefreshCheckVol(pool, "c.img", 3) < 0)
+        goto cleanup;
+
+    vola = virStorageVolDefFindByName(pool, "a.qcow2");
+
+    /* Rewrite 'b' keeping its size, drop 'c' and add 'd' */
+    if (testRefreshMakeImage(b, 4 * 1024 * 1024) < 0 ||
+        unlink(c) < 0 ||
+        testRefreshMakeImage(d, 8 * 1024 * 1024) < 0)
+        goto cleanup;
+
+    if (virStorageBackendRefreshLocal(pool) < 0 ||
+        virStoragePoolObjGetVolumesCount(pool) != 3 ||
+        testRefreshCheckVol(pool, "a.qcow2", 1024 * 1024) < 0 ||
+        testRefreshCheckVol(pool, "b.qcow2", 4 * 1024 * 1024) < 0 ||
+        testRefreshCheckVol(pool, "d.qcow2", 8 * 1024 * 1024) < 0)
+        goto cleanup;
+
+    if (virStorageVolDefFindByName(pool, "c.img")) {
+        fprintf(stderr, "Volume of removed file still present\n");
+        goto cleanup;
+    }
+
+    if (virStorageVolDefFindByName(pool, "a.qcow2") != vola) {
+        fprintf(stderr, "Unchanged volume was probed again\n");
+        goto cleanup;
+    }
+
+    ret = 0;
+
+ cleanup:
+    virStoragePoolObjEndAPI(&pool);
+    if (dir)
+        virFileDeleteTree(dir);
+    return ret;
+}
+
+
+static int
+testRefreshLocalBenchmark(const void *opaque)
+{
+    const size_t *nvols = opaque;
+    g_autofree char *dir = g_strdup_printf("%s/virstorageutiltest-pool-XXXXXX",
+                                           abs_builddir);
+    virStoragePoolObj *pool = NULL;
+    gint64 start;
+    double full;
+    double incremental;
+    size_t i;
+    int ret = -1;
+
+    if (!g_mkdtemp(dir)) {
+        fprintf(stderr, "Unable to create pool directory\n");
+        VIR_FREE(dir);
+        return -1;
+    }
+
+    for (i = 0; i < *nvols; i++) {
+        g_autofree char *path = g_strdup_printf("%s/vol%zu.qcow2", dir, i);
+
+        if (testRefreshMakeImage(path, 1024 * 1024 * 1024) < 0)
+            goto cleanup;
+    }
+
+    if (!(pool = testRefreshNewPool(dir)))
+        goto cleanup;
+
+    g_usleep(1100 * 1000);
+
+    /* Warm up the page cache so that both runs see the same filesystem */
+    if (virStorageBackendRefreshLocal(pool) < 0)
+        goto cleanup;
+
+    /* A full refresh as done at daemon startup */
+    virStoragePoolObjClearVols(pool);
+    virStorageHeaderCacheClear();
+    start = g_get_monotonic_time();
+    if (virStorageBackendRefreshLocal(pool) < 0)
+        goto cleanup;
+    full = (g_get_monotonic_time() - start) / 1000.0;
+
+    start = g_get_monotonic_time();
+    if (virStorageBackendRefreshLocal(pool) < 0)
+        goto cleanup;
+    incremental = (g_get_monotonic_time() - start) / 1000.0;
+
+    VIR_TEST_DEBUG("%zu volumes: full refresh %.1f ms, incremental %.1f ms",
+                   *nvols, full, incremental);
+
+    if (virStoragePoolObjGetVolumesCount(pool) != *nvols) {
+        fprintf(stderr, "Expected %zu volumes, got %zu\n",
+                *nvols, virStoragePoolObjGetVolumesCount(pool));
+        goto cleanup;
+    }
+
+    ret = 0;
+
+ cleanup:
+    virStoragePoolObjEndAPI(&pool);
+    if (dir)
+        virFileDeleteTree(dir);
+    return ret;
+}
+
+
 static int
 mymain(void)
 {
@@ -101,6 +475,59 @@ mymain(void)
 #undef DO_TEST_GLUSTER_EXTRACT_POOL_SOURCES_NETFS
 #undef DO_TEST_GLUSTER_EXTRACT_POOL_SOURCES_FULL
 
+#define DO_TEST_COPY_DATA_FULL(size, fill, sparse, copy_range, nworkers, \
+                               segment_size) \
+    do { \
+        struct testCopyDataData data = { size, fill, sparse, copy_range, \
+                                         nworkers, segment_size }; \
+        if (virTestRun(virTestCounterNext(), testCopyData, &data) < 0) \
+            ret = -1; \
+    } while (0)
+
+/* Small segments so that a few MiB are enough to keep all workers busy */
+#define DO_TEST_COPY_DATA(size, fill, sparse, copy_range, nworkers) \
+    DO_TEST_COPY_DATA_FULL(size, fill, sparse, copy_range, nworkers, \
+                           256 * 1024)
+
+    virTestCounterReset("copy-data-");
+    DO_TEST_COPY_DATA(0, 1, true, true, 0);
+    DO_TEST_COPY_DATA(6 * 1024 * 1024 + 123, 0, true, true, 0);
+    DO_TEST_COPY_DATA(6 * 1024 * 1024 + 123, 0.1, true, true, 0);
+    DO_TEST_COPY_DATA(6 * 1024 * 1024 + 123, 0.5, true, true, 1);
+    DO_TEST_COPY_DATA(6 * 1024 * 1024 + 123, 0.5, true, true, 0);
+    DO_TEST_COPY_DATA(6 * 1024 * 1024 + 123, 0.5, false, true, 0);
+    DO_TEST_COPY_DATA(6 * 1024 * 1024 + 123, 1, true, true, 0);
+    DO_TEST_COPY_DATA(6 * 1024 * 1024 + 123, 0.5, true, false, 0);
+    DO_TEST_COPY_DATA(6 * 1024 * 1024 + 123, 0.5, false, false, 0);
+
+    if (virTestGetExpensive()) {
+        unsigned long long size = 2ULL * 1024 * 1024 * 1024;
+
+        virTestCounterReset("copy-data-benchmark-");
+        DO_TEST_COPY_DATA_FULL(size, 0.05, true, true, 1, 0);
+        DO_TEST_COPY_DATA_FULL(size, 0.05, true, true, 0, 0);
+        DO_TEST_COPY_DATA_FULL(size, 0.5, true, true, 1, 0);
+        DO_TEST_COPY_DATA_FULL(size, 0.5, true, true, 0, 0);
+        DO_TEST_COPY_DATA_FULL(size, 1, true, true, 1, 0);
+        DO_TEST_COPY_DATA_FULL(size, 1, true, true, 0, 0);
+        DO_TEST_COPY_DATA_FULL(size, 0.5, false, true, 0, 0);
+        DO_TEST_COPY_DATA_FULL(size, 0.5, true, false, 0, 0);
+    }
+
+#undef DO_TEST_COPY_DATA
+#undef DO_TEST_COPY_DATA_FULL
+
+    if (virTestRun("refresh-local", testRefreshLocal, NULL) < 0)
+        ret = -1;
+
+    if (virTestGetExpensive()) {
+        size_t nvols = 5000;
+
+        if (virTestRun("refresh-local-benchmark",
+                       testRefreshLocalBenchmark, &nvols) < 0)
+            ret = -1;
+    }
+
     return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
@@ -0,0 +1,489 @@
+/*
+ * Copyright (C) 2025 Red Hat, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include "testutils.h"
+#include "virthread.h"
+#include "virthreadpool.h"
+
+#define VIR_FROM_THIS VIR_FROM_NONE
+
+#define TEST_MAX_JOBS 64
+
+struct testPoolState {
+    virMutex lock;
+    virCond cond;
+
+    bool blocked; /* a job is holding the worker until released */
+    bool release;
+
+    int order[TEST_MAX_JOBS];
+    size_t ndone;
+
+    size_t running;
+    size_t maxRunning;
+};
+
+struct testPoolJob {
+    struct testPoolState *state;
+    int id;
+    bool block;
+    unsigned int sleepMs;
+};
+
+
+static void
+testPoolJobFunc(void *jobdata,
+                void *opaque)
+{
+    struct testPoolJob *job = jobdata;
+    struct testPoolState *state = opaque;
+
+    VIR_WITH_MUTEX_LOCK_GUARD(&state->lock) {
+        if (job->block) {
+            state->blocked = true;
+            virCondBroadcast(&state->cond);
+            while (!state->release)
+                ignore_value(virCondWait(&state->cond, &state->lock));
+            return;
+        }
+
+        state->running++;
+        state->maxRunning = MAX(state->maxRunning, state->running);
+    }
+
+    if (job->sleepMs)
+        g_usleep(job->sleepMs * 1000);
+
+    VIR_WITH_MUTEX_LOCK_GUARD(&state->lock) {
+        state->running--;
+        state->order[state->ndone++] = job->id;
+        virCondBroadcast(&state->cond);
+    }
+}
+
+
+static int
+testPoolInitState(struct testPoolState *state)
+{
+    memset(state, 0, sizeof(*state));
+
+    if (virMutexInit(&state->lock) < 0 ||
+        virCondInit(&state->cond) < 0)
+        return -1;
+
+    return 0;
+}
+
+
+static void
+testPoolWaitDone(struct testPoolState *state,
+                 size_t njobs)
+{
+    VIR_LOCK_GUARD lock = virLockGuardLock(&state->lock);
+
+    while (state->ndone < njobs)
+        ignore_value(virCondWait(&state->cond, &state->lock));
+}
+
+
+/*
+ * With a single worker busy, queue many jobs of one key followed by a
+ * couple of jobs of another key and check the latter don't have to wait
+ * for all the former.
+ */
+static int
+testPoolFairness(const void *opaque G_GNUC_UNUSED)
+{
+    struct testPoolState state;
+    struct testPoolJob blocker = { &state, -1, true, 0 };
+    struct testPoolJob jobs[12];
+    int keyA;
+    int keyB;
+    virThreadPool *pool = NULL;
+    size_t i;
+    int ret = -1;
+
+    if (testPoolInitState(&state) < 0)
+        return -1;
+
+    if (!(pool = virThreadPoolNewFull(1, 1, 0, testPoolJobFunc,
+                                      "test", NULL, &state)))
+        goto cleanup;
+
+    if (virThreadPoolSendJobFull(pool, 0, &blocker, &blocker) < 0)
+        goto cleanup;
+
+    VIR_WITH_MUTEX_LOCK_GUARD(&state.lock) {
+        while (!state.blocked)
+            ignore_value(virCondWait(&state.cond, &state.lock));
+    }
+
+    /* Jobs 0-9 come from key A, 10 and 11 from key B */
+    for (i = 0; i < G_N_ELEMENTS(jobs); i++) {
+        jobs[i] = (struct testPoolJob) { &state, i, false, 0 };
+
+        if (virThreadPoolSendJobFull(pool, 0, i < 10 ? &keyA : &keyB,
+                                     &jobs[i]) < 0)
+            goto cleanup;
+    }
+
+    VIR_WITH_MUTEX_LOCK_GUARD(&state.lock) {
+        state.release = true;
+        virCondBroadcast(&state.cond);
+    }
+
+    testPoolWaitDone(&state, G_N_ELEMENTS(jobs));
+
+    /* Keys are served in turns and each key in order of submission */
+    for (i = 0; i < 4; i++) {
+        int expect = i % 2 ? 10 + i / 2 : i / 2;
+
+        if (state.order[i] != expect) {
+            fprintf(stderr, "Expected job %d to run as #%zu, got job %d\n",
+                    expect, i, state.order[i]);
+            goto cleanup;
+        }
+    }
+
+    for (i = 4; i < G_N_ELEMENTS(jobs); i++) {
+        if (state.order[i] != i - 2) {
+            fprintf(stderr, "Expected job %zu to run as #%zu, got job %d\n",
+                    i - 2, i, state.order[i]);
+            goto cleanup;
+        }
+    }
+
+    ret = 0;
+
+ cleanup:
+    virThreadPoolFree(pool);
+    virMutexDestroy(&state.lock);
+    virCondDestroy(&state.cond);
+    return ret;
+}
+
+
+/*
+ * Check no more than the configured number of workers run jobs of the
+ * same key at once while other workers stay available for other keys.
+ */
+static int
+testPoolKeyLimit(const void *opaque G_GNUC_UNUSED)
+{
+    struct testPoolState state;
+    struct testPoolJob jobs[8];
+    unsigned long long wait[VIR_THREAD_POOL_JOB_WAIT_BUCKETS];
+    unsigned long long total = 0;
+    int key;
+    virThreadPool *pool = NULL;
+    size_t i;
+    int ret = -1;
+
+    if (testPoolInitState(&state) < 0)
+        return -1;
+
+    if (!(pool = virThreadPoolNewFull(4, 4, 0, testPoolJobFunc,
+                                      "test", NULL, &state)))
+        goto cleanup;
+
+    virThreadPoolSetMaxKeyWorkers(pool, 2);
+
+    for (i = 0; i < G_N_ELEMENTS(jobs); i++) {
+        jobs[i] = (struct testPoolJob) { &state, i, false, 10 };
+
+        if (virThreadPoolSendJobFull(pool, 0, &key, &jobs[i]) < 0)
+            goto cleanup;
+    }
+
+    testPoolWaitDone(&state, G_N_ELEMENTS(jobs));
+
+    /* Whether the limit is actually reached depends on scheduling */
+    if (state.maxRunning > 2) {
+        fprintf(stderr, "Expected 2 jobs running at most, got %zu\n",
+                state.maxRunning);
+        goto cleanup;
+    }
+
+    virThreadPoolGetJobWaitStats(pool, wait);
+    for (i = 0; i < G_N_ELEMENTS(wait); i++)
+        total += wait[i];
+
+    if (total != G_N_ELEMENTS(jobs)) {
+        fprintf(stderr, "Expected %zu jobs in wait statistics, got %llu\n",
+                G_N_ELEMENTS(jobs), total);
+        goto cleanup;
+    }
+
+    ret = 0;
+
+ cleanup:
+    virThreadPoolFree(pool);
+    virMutexDestroy(&state.lock);
+    virCondDestroy(&state.cond);
+    return ret;
+}
+
+
+static size_t testPoolFreedJobs;
+
+static void
+testPoolJobDataFree(void *jobdata)
+{
+    g_free(jobdata);
+    testPoolFreedJobs++;
+}
+
+
+/*
+ * Check data of jobs which are still queued when the pool is drained is
+ * freed rather than leaked.
+ */
+static int
+testPoolDrain(const void *opaque G_GNUC_UNUSED)
+{
+    struct testPoolState state;
+    struct testPoolJob blocker = { &state, -1, true, 0 };
+    virThreadPool *pool = NULL;
+    size_t i;
+    int ret = -1;
+
+    if (testPoolInitState(&state) < 0)
+        return -1;
+
+    if (!(pool = virThreadPoolNewFull(1, 1, 0, testPoolJobFunc,
+                                      "test", NULL, &state)))
+        goto cleanup;
+
+    virThreadPoolSetJobDataFree(pool, testPoolJobDataFree);
+    testPoolFreedJobs = 0;
+
+    if (virThreadPoolSendJob(pool, 0, &blocker) < 0)
+        goto cleanup;
+
+    VIR_WITH_MUTEX_LOCK_GUARD(&state.lock) {
+        while (!state.blocked)
+            ignore_value(virCondWait(&state.cond, &state.lock));
+    }
+
+    for (i = 0; i < 5; i++) {
+        struct testPoolJob *job = g_new0(struct testPoolJob, 1);
+
+        *job = (struct testPoolJob) { &state, i, false, 0 };
+
+        if (virThreadPoolSendJob(pool, 0, job) < 0) {
+            g_free(job);
+            goto cleanup;
+        }
+    }
+
+    /* The worker quits once the blocker finishes without running more jobs */
+    virThreadPoolStop(pool);
+
+    VIR_WITH_MUTEX_LOCK_GUARD(&state.lock) {
+        state.release = true;
+        virCondBroadcast(&state.cond);
+    }
+
+    virThreadPoolDrain(pool);
+
+    if (state.ndone != 0 || testPoolFreedJobs != 5) {
+        fprintf(stderr, "Expected 0 jobs run and 5 freed, got %zu and %zu\n",
+                state.ndone, testPoolFreedJobs);
+        goto cleanup;
+    }
+
+    ret = 0;
+
+ cleanup:
+    virThreadPoolFree(pool);
+    virMutexDestroy(&state.lock);
+    virCondDestroy(&state.cond);
+    return ret;
+}
+
+
+/*
+ * Check a burst of jobs gets all the workers it needs at once and those
+ * exceeding the minimum go away once they're idle for long enough.
+ */
+static int
+testPoolScaling(const void *opaque G_GNUC_UNUSED)
+{
+    struct testPoolState state;
+    struct testPoolJob jobs[4];
+    virThreadPool *pool = NULL;
+    size_t i;
+    int ret = -1;
+
+    if (testPoolInitState(&state) < 0)
+        return -1;
+
+    if (!(pool = virThreadPoolNewFull(1, G_N_ELEMENTS(jobs), 0,
+                                      testPoolJobFunc, "test", NULL, &state)))
+        goto cleanup;
+
+    virThreadPoolSetIdleTimeout(pool, 1);
+
+    for (i = 0; i < G_N_ELEMENTS(jobs); i++) {
+        jobs[i] = (struct testPoolJob) { &state, i, false, 200 };
+
+        if (virThreadPoolSendJob(pool, 0, &jobs[i]) < 0)
+            goto cleanup;
+    }
+
+    testPoolWaitDone(&state, G_N_ELEMENTS(jobs));
+
+    if (state.maxRunning != G_N_ELEMENTS(jobs)) {
+        fprintf(stderr, "Expected %zu jobs running at once, got %zu\n",
+                G_N_ELEMENTS(jobs), state.maxRunning);
+        goto cleanup;
+    }
+
+    for (i = 0; i < 50 && virThreadPoolGetCurrentWorkers(pool) > 1; i++)
+        g_usleep(100 * 1000);
+
+    if (virThreadPoolGetCurrentWorkers(pool) != 1) {
+        fprintf(stderr, "Expected idle workers to exit, %zu left\n",
+                virThreadPoolGetCurrentWorkers(pool));
+        goto cleanup;
+    }
+
+    ret = 0;
+
+ cleanup:
+    virThreadPoolFree(pool);
+    virMutexDestroy(&state.lock);
+    virCondDestroy(&state.cond);
+    return ret;
+}
+
+
+struct testPoolBenchState {
+    virMutex lock;
+    virCond cond;
+    size_t ndone;
+    unsigned long long latency; /* sum of queueing delays in microseconds */
+};
+
+static void
+testPoolBenchJobFunc(void *jobdata,
+                     void *opaque)
+{
+    gint64 *queued = jobdata;
+    struct testPoolBenchState *state = opaque;
+    gint64 now = g_get_monotonic_time();
+
+    VIR_WITH_MUTEX_LOCK_GUARD(&state->lock) {
+        state->latency += now - *queued;
+        if (++state->ndone % 1000 == 0)
+            virCondBroadcast(&state->cond);
+    }
+}
+
+
+struct testPoolBenchData {
+    size_t burst;
+    size_t nbursts;
+};
+
+/*
+ * Submits bursts of trivial jobs to a pool starting with a single worker
+ * and reports the throughput and the average delay before a job starts.
+ */
+static int
+testPoolBenchmark(const void *opaque)
+{
+    const struct testPoolBenchData *data = opaque;
+    struct testPoolBenchState state = { 0 };
+    g_autofree gint64 *queued = g_new0(gint64, data->burst);
+    virThreadPool *pool = NULL;
+    gint64 start;
+    double elapsed;
+    size_t i;
+    size_t j;
+    int ret = -1;
+
+    if (virMutexInit(&state.lock) < 0 ||
+        virCondInit(&state.cond) < 0)
+        return -1;
+
+    if (!(pool = virThreadPoolNewFull(1, 20, 0, testPoolBenchJobFunc,
+                                      "test", NULL, &state)))
+        goto cleanup;
+
+    start = g_get_monotonic_time();
+
+    for (i = 0; i < data->nbursts; i++) {
+        for (j = 0; j < data->burst; j++) {
+            queued[j] = g_get_monotonic_time();
+            if (virThreadPoolSendJob(pool, 0, &queued[j]) < 0)
+                goto cleanup;
+        }
+
+        VIR_WITH_MUTEX_LOCK_GUARD(&state.lock) {
+            while (state.ndone < (i + 1) * data->burst)
+                ignore_value(virCondWait(&state.cond, &state.lock));
+        }
+    }
+
+    elapsed = (g_get_monotonic_time() - start) / 1000000.0;
+    VIR_TEST_DEBUG("bursts of %zu jobs: %.0f jobs/s, %.1fus average latency, %zu workers",
+                   data->burst, state.ndone / elapsed,
+                   (double)state.latency / state.ndone,
+                   virThreadPoolGetCurrentWorkers(pool));
+
+    ret = 0;
+
+ cleanup:
+    virThreadPoolFree(pool);
+    virMutexDestroy(&state.lock);
+    virCondDestroy(&state.cond);
+    return ret;
+}
+
+
+static int
+mymain(void)
+{
+    int ret = 0;
+
+    if (virTestRun("Fairness", testPoolFairness, NULL) < 0)
+        ret = -1;
+    if (virTestRun("Key limit", testPoolKeyLimit, NULL) < 0)
+        ret = -1;
+    if (virTestRun("Scaling", testPoolScaling, NULL) < 0)
+        ret = -1;
+    if (virTestRun("Drain", testPoolDrain, NULL) < 0)
+        ret = -1;
+
+    if (virTestGetExpensive()) {
+        struct testPoolBenchData small = { 1000, 100 };
+        struct testPoolBenchData large = { 10000, 10 };
+
+        if (virTestRun("Benchmark small bursts", testPoolBenchmark, &small) < 0)
+            ret = -1;
+        if (virTestRun("Benchmark large bursts", testPoolBenchmark, &large) < 0)
+            ret = -1;
+    }
+
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+VIR_TEST_MAIN(mymain)
@@ -0,0 +1,175 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include "testutils.h"
+
+#define LIBVIRT_VIRZEROPRIV_H_ALLOW
+#include "virzeropriv.h"
+
+#define VIR_FROM_THIS VIR_FROM_NONE
+
+static const char *implNames[] = { "scalar", "SSE2", "AVX2" };
+G_STATIC_ASSERT(G_N_ELEMENTS(implNames) == VIR_ZERO_IMPL_LAST);
+
+
+/*
+ * Places a single non-zero byte at every position of buffers of various
+ * lengths and alignments and checks it's found.
+ */
+static int
+testFindNonZero(const void *opaque)
+{
+    virZeroImpl impl = *(const virZeroImpl *)opaque;
+    g_autofree unsigned char *buf = g_new0(unsigned char, 1024);
+    size_t off;
+    size_t len;
+    size_t pos;
+
+    if (virZeroSetImpl(impl) < 0)
+        return EXIT_AM_SKIP;
+
+    for (off = 0; off < 40; off++) {
+        for (len = 0; len <= 300; len++) {
+            if (virFindNonZero(buf + off, len) != len ||
+                !virIsZero(buf + off, len)) {
+                fprintf(stderr, "Zeroes not detected, offset=%zu len=%zu\n",
+                        off, len);
+                return -1;
+            }
+
+            for (pos = 0; pos < len; pos++) {
+                size_t found;
+
+                buf[off + pos] = 0x80 >> (pos % 8);
+                found = virFindNonZero(buf + off, len);
+                buf[off + pos] = 0;
+
+                if (found != pos) {
+                    fprintf(stderr,
+                            "Expected %zu, got %zu, offset=%zu len=%zu\n",
+                            pos, found, off, len);
+                    return -1;
+                }
+            }
+        }
+    }
+
+    /* Bytes past the end must not be looked at */
+    buf[100] = 1;
+    if (!virIsZero(buf, 100) || virFindNonZero(buf, 101) != 100)
+        return -1;
+
+    return 0;
+}
+
+
+struct testBenchData {
+    virZeroImpl impl;
+    size_t size;
+    unsigned int zeroPercent;
+};
+
+/*
+ * Scans 1GiB worth of buffers of @size bytes where @zeroPercent of them
+ * are all zeroes and the rest have data in their last quarter, which is
+ * roughly what sparse copies of disk images run into.
+ */
+static int
+testBenchmark(const void *opaque)
+{
+    const struct testBenchData *data = opaque;
+    const size_t nbufs = 64;
+    size_t rounds = (1024 * 1024 * 1024) / (data->size * nbufs);
+    g_autofree unsigned char *buf = g_new0(unsigned char, data->size * nbufs);
+    size_t zeroes = 0;
+    gint64 start;
+    double elapsed;
+    size_t i;
+    size_t j;
+
+    if (virZeroSetImpl(data->impl) < 0)
+        return EXIT_AM_SKIP;
+
+    for (i = 0; i < nbufs; i++) {
+        if (i * 100 / nbufs >= data->zeroPercent)
+            buf[i * data->size + data->size - data->size / 4 - 1] = 1;
+    }
+
+    if (rounds == 0)
+        rounds = 1;
+
+    start = g_get_monotonic_time();
+
+    for (i = 0; i < rounds; i++) {
+        for (j = 0; j < nbufs; j++) {
+            if (virIsZero(buf + j * data->size, data->size))
+                zeroes++;
+        }
+    }
+
+    elapsed = (g_get_monotonic_time() - start) / 1000000.0;
+    VIR_TEST_DEBUG("%s, %zu bytes, %u%% zero: %.0f MiB/s (%zu zero)",
+                   implNames[data->impl], data->size, data->zeroPercent,
+                   rounds * nbufs * data->size / (1024.0 * 1024.0) / elapsed,
+                   zeroes / rounds);
+
+    return 0;
+}
+
+
+static int
+mymain(void)
+{
+    int ret = 0;
+    size_t i;
+
+    for (i = 0; i < VIR_ZERO_IMPL_LAST; i++) {
+        virZeroImpl impl = i;
+        g_autofree char *name = g_strdup_printf("Find non-zero %s",
+                                                implNames[i]);
+
+        if (virTestRun(name, testFindNonZero, &impl) < 0)
+            ret = -1;
+    }
+
+    if (virTestGetExpensive()) {
+        const size_t sizes[] = { 512, 4096, 64 * 1024, 1024 * 1024 };
+        const unsigned int ratios[] = { 0, 50, 100 };
+        size_t j;
+        size_t k;
+
+        for (i = 0; i < VIR_ZERO_IMPL_LAST; i++) {
+            for (j = 0; j < G_N_ELEMENTS(sizes); j++) {
+                for (k = 0; k < G_N_ELEMENTS(ratios); k++) {
+                    struct testBenchData data = { i, sizes[j], ratios[k] };
+                    g_autofree char *name = NULL;
+
+                    name = g_strdup_printf("Benchmark %s %zu bytes %u%% zero",
+                                           implNames[i], sizes[j], ratios[k]);
+
+                    if (virTestRun(name, testBenchmark, &data) < 0)
+                        ret = -1;
+                }
+            }
+        }
+    }
+
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+VIR_TEST_MAIN(mymain)
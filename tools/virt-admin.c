@@ -392,8 +392,11 @@ cmdSrvThreadpoolInfo(vshControl *ctl, const vshCmd *cmd)
         goto cleanup;
     }
 
-    for (i = 0; i < nparams; i++)
-        vshPrint(ctl, "%-15s: %u\n", params[i].field, params[i].value.ui);
+    for (i = 0; i < nparams; i++) {
+        g_autofree char *value = vshGetTypedParamValue(ctl, &params[i]);
+
+        vshPrint(ctl, "%-15s: %s\n", params[i].field, value);
+    }
 
     ret = true;
 
@@ -1042,6 +1045,40 @@ cmdDaemonLogOutputs(vshControl *ctl, const vshCmd *cmd)
 }
 
 
+/* --------------------------
+ * Command daemon-cache-stats
+ * --------------------------
+ */
+static const vshCmdInfo info_daemon_cache_stats = {
+    .help = N_("get statistics of the caches of the daemon"),
+    .desc = N_("Retrieve hits, misses and usage of the caches kept by the "
+               "daemon, such as the pool of RPC message buffers."),
+};
+
+static bool
+cmdDaemonCacheStats(vshControl *ctl, const vshCmd *cmd G_GNUC_UNUSED)
+{
+    virTypedParameterPtr params = NULL;
+    int nparams = 0;
+    size_t i;
+    vshAdmControl *priv = ctl->privData;
+
+    if (virAdmConnectGetCacheStats(priv->conn, &params, &nparams, 0) < 0) {
+        vshError(ctl, "%s", _("Unable to get cache statistics"));
+        return false;
+    }
+
+    for (i = 0; i < nparams; i++) {
+        g_autofree char *value = vshGetTypedParamValue(ctl, &params[i]);
+
+        vshPrint(ctl, "%-25s: %s\n", params[i].field, value);
+    }
+
+    virTypedParamsFree(params, nparams);
+    return true;
+}
+
+
 /* --------------------------
  * Command daemon-timeout
  * --------------------------
@@ -1449,6 +1486,12 @@ static const vshCmdDef monitoringCmds[] = {
      .info = &info_srv_clients_info,
      .flags = 0
     },
+    {.name = "daemon-cache-stats",
+     .handler = cmdDaemonCacheStats,
+     .opts = NULL,
+     .info = &info_daemon_cache_stats,
+     .flags = 0
+    },
     {.name = NULL}
 };
 